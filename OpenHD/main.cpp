@@ -31,6 +31,7 @@
 
 #include <csignal>
 #include <cstdlib>
+#include <exception>
 #include <iostream>
 #include <memory>
 
@@ -42,6 +43,7 @@
 #include "openhd_profile.h"
 #include "openhd_spdlog.h"
 #include "openhd_temporary_air_or_ground.h"
+#include "openhd_trace.h"
 
 // |-------------------------------------------------------------------------------|
 // |                         OpenHD core executable | | Weather you run as air
@@ -205,6 +207,14 @@ static OHDRunOptions parse_run_parameters(int argc, char* argv[]) {
 int main(int argc, char* argv[]) {
     // OpenHD needs to be run as root!
     OHDUtil::terminate_if_not_root();
+    // Logging is asynchronous - write out what is still queued before we go
+    // down (e.g. uncaught exception in one of the module threads)
+    // 日志是异步的 - 在进程终止前（例如模块线程中未捕获的异常）写出仍在队列中的日志
+    std::set_terminate([]() {
+        std::cerr << "OpenHD terminate called" << std::endl;
+        openhd::log::flush_all();
+        std::abort();
+    });
 
     // 这段代码的作用是检查 /run/openhd/hold.pid 文件是否存在。如果该文件存在，程序就会立即退出。
     // 这种做法可能用于防止某些重复运行的进程。例如，程序可能在启动时会先检查这个 .pid 文件，若该文件存在则表示程序或服务已经在运行，因此程序选择退出以避免重复启动。
@@ -394,9 +404,17 @@ int main(int argc, char* argv[]) {
             std::cerr << "Got SIGQUIT, exiting\n";
             quit = true;
         });
+        // Frame tracing (for latency debugging) - dump the recorded events with
+        // kill -USR1 <pid>
+        // 帧追踪（用于延迟调试）- 使用 kill -USR1 <pid> 导出记录的事件
+        if (openhd::load_config().GEN_ENABLE_FRAME_TRACING) {
+            openhd::trace::set_enabled(true);
+        }
+        signal(SIGUSR1, [](int) { openhd::trace::request_dump(); });
         const auto run_time_begin = std::chrono::steady_clock::now();
         while (!quit) {
             std::this_thread::sleep_for(std::chrono::seconds(2));
+            openhd::trace::dump_if_requested();
             if (options.run_time_seconds >= 1) {
                 if (std::chrono::steady_clock::now() - run_time_begin >= std::chrono::seconds(options.run_time_seconds)) {
                     m_console->warn("Terminating, exceeded run time {}", options.run_time_seconds);
@@ -452,11 +470,14 @@ int main(int argc, char* argv[]) {
         }
     } catch (std::exception& ex) {
         std::cerr << "Error: " << ex.what() << std::endl;
+        openhd::log::flush_all();
         exit(1);
     } catch (...) {
         std::cerr << "Unknown exception occurred" << std::endl;
+        openhd::log::flush_all();
         exit(1);
     }
     openhd::remove_currently_running_file();
+    openhd::log::flush_all();
     return 0;
 }
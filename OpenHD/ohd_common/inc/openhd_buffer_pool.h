@@ -0,0 +1,134 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#ifndef OPENHD_OPENHD_BUFFER_POOL_H
+#define OPENHD_OPENHD_BUFFER_POOL_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace openhd {
+
+/**
+ * Fixed-size pool of (MTU-sized) byte buffers that are recycled instead of
+ * being freed, such that the allocator is not on the hot path of the video and
+ * telemetry fragment producers.
+ * Thread-safe - acquiring and releasing a buffer is lock-free (bounded MPMC
+ * ring of free buffers). If the pool is drained, a new buffer is allocated
+ * (counted as a miss) and taken back on release as long as there is space in
+ * the ring, otherwise it is freed.
+ * 固定大小（MTU 大小）的缓冲区池，缓冲区被回收复用而不是释放，
+ * 这样视频和遥测分片的生产者在热路径上不再需要调用内存分配器。
+ * 线程安全 - 获取和归还缓冲区都是无锁的（有界 MPMC 环形队列）。
+ */
+class BufferPool : public std::enable_shared_from_this<BufferPool> {
+ public:
+  struct Stats {
+    // Buffer was taken from the pool
+    uint64_t n_hits;
+    // Pool was empty, a new buffer had to be allocated
+    uint64_t n_misses;
+    // Buffers currently handed out
+    int n_in_use;
+    // Max n of buffers that were handed out at the same time
+    int high_water_mark;
+    std::string to_string() const;
+  };
+  /**
+   * @param tag for debugging
+   * @param buffer_size the capacity each buffer is allocated with
+   * @param n_buffers n of buffers that are pre-allocated and kept for re-use
+   * (rounded up to a power of 2)
+   */
+  static std::shared_ptr<BufferPool> create(std::string tag,
+                                            std::size_t buffer_size,
+                                            std::size_t n_buffers);
+  ~BufferPool();
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+  /**
+   * Returns an empty buffer with at least buffer_size capacity, which goes
+   * back into the pool once the last reference is dropped.
+   * Doesn't allocate either - the shared_ptr control block lives next to the
+   * buffer and is recycled with it.
+   */
+  std::shared_ptr<std::vector<uint8_t>> get_buffer();
+  // Same as above, but filled with a copy of the given data
+  std::shared_ptr<std::vector<uint8_t>> get_buffer_and_copy(
+      const uint8_t* data, std::size_t data_len);
+  /**
+   * Low level api (no shared_ptr control block) - every buffer obtained via
+   * acquire() has to be given back via release() exactly once.
+   */
+  std::vector<uint8_t>* acquire();
+  void release(std::vector<uint8_t>* buffer);
+  // Takes ownership of a buffer that was acquire()-d from this pool, it goes
+  // back into the pool once the last reference is dropped.
+  std::shared_ptr<std::vector<uint8_t>> adopt(std::vector<uint8_t>* buffer);
+
+  Stats get_stats() const;
+  std::size_t get_buffer_size() const { return m_buffer_size; }
+  // Used for (rtp) video fragments
+  static const std::shared_ptr<BufferPool>& video();
+  // Used for aggregated telemetry packets
+  static const std::shared_ptr<BufferPool>& telemetry();
+
+ private:
+  // A buffer plus the storage for the shared_ptr control block of get_buffer()
+  // / adopt()
+  struct Slot;
+  template <class T>
+  class ControlBlockAllocator;
+  explicit BufferPool(std::string tag, std::size_t buffer_size,
+                      std::size_t n_buffers);
+  std::vector<uint8_t>* new_buffer() const;
+  static void delete_buffer(std::vector<uint8_t>* buffer);
+  // Lock-free bounded MPMC queue (D. Vyukov)
+  bool try_push(std::vector<uint8_t>* buffer);
+  std::vector<uint8_t>* try_pop();
+  void on_acquired();
+
+ private:
+  const std::string m_tag;
+  const std::size_t m_buffer_size;
+  struct Cell {
+    std::atomic<std::size_t> sequence;
+    std::vector<uint8_t>* buffer;
+  };
+  std::unique_ptr<Cell[]> m_cells;
+  std::size_t m_mask;
+  std::size_t m_n_buffers;
+  alignas(64) std::atomic<std::size_t> m_enqueue_pos{0};
+  alignas(64) std::atomic<std::size_t> m_dequeue_pos{0};
+  alignas(64) std::atomic<uint64_t> m_n_hits{0};
+  std::atomic<uint64_t> m_n_misses{0};
+  std::atomic<int> m_n_in_use{0};
+  std::atomic<int> m_high_water_mark{0};
+};
+
+}  // namespace openhd
+
+#endif  // OPENHD_OPENHD_BUFFER_POOL_H
@@ -48,12 +48,18 @@ struct Config {
   std::string NW_ETHERNET_CARD = RPI_ETHERNET_ONLY;
   std::vector<std::string> NW_MANUAL_FORWARDING_IPS;
   bool NW_FORWARD_TO_LOCALHOST_58XX = false;
+  bool NW_FORWARD_VIDEO_UDP_GSO = false;
+  int NW_VIDEO_JITTER_BUFFER_MS = -1;
+  bool NW_VIDEO_JITTER_BUFFER_WHOLE_FRAMES = false;
+  bool NW_VIDEO_SHM_OUTPUT = false;
 
   // ETHERNET LINK
   std::string GROUND_UNIT_IP = "";
   std::string AIR_UNIT_IP = "";
   int VIDEO_PORT = 5000;
   int TELEMETRY_PORT = 5600;
+  int VIDEO_FEC_PERCENTAGE = 0;
+  int VIDEO_FEC_BLOCK_SIZE = 32;
 
   // ETHERNET LINK FOR MICROHARD
   bool DISABLE_MICROHARD_DETECTION = false;
@@ -70,6 +76,11 @@ struct Config {
   bool GEN_ENABLE_LAST_KNOWN_POSITION = false;
   int GEN_RF_METRICS_LEVEL = 0;
   bool GEN_NO_QOPENHD_AUTOSTART = false;
+  bool GEN_ENABLE_FRAME_TRACING = false;
+  bool GEN_ENABLE_TLOG = false;
+  int GEN_TLOG_FILE_SIZE_MB = 32;
+  std::string GEN_EMULATED_LINK_PROFILE;
+  std::string GEN_EMULATED_LINK_SOCKET = "/tmp/openhd_emulated_link";
 };
 
 // Otherwise, default location is used
@@ -0,0 +1,219 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#ifndef OPENHD_OPENHD_OHD_COMMON_INC_OPENHD_LINK_EMULATOR_H_
+#define OPENHD_OPENHD_OHD_COMMON_INC_OPENHD_LINK_EMULATOR_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "openhd_link.hpp"
+#include "openhd_spdlog.h"
+
+namespace openhd {
+
+/**
+ * Impairment of one direction of an emulated link. Packets first pass a
+ * bandwidth limited tx queue (tail drop), then get lost according to a
+ * Gilbert-Elliott model (random loss in the good state, burst loss in the bad
+ * state), then are delayed by delay + uniform jitter. Jitter keeps the packet
+ * order, only packets selected for reordering overtake / get overtaken.
+ * Deterministic for a given seed and send pattern.
+ * 模拟链路单个方向的损伤。数据包先经过带宽受限的发送队列（尾部丢弃），再按 Gilbert-Elliott
+ * 模型丢失（好状态随机丢包，坏状态突发丢包），然后延迟 delay + 均匀抖动。对于给定的种子确定性。
+ */
+struct LinkImpairment {
+  // 0 - unlimited
+  int bandwidth_kbits = 0;
+  // Packets that would wait longer in the tx queue are dropped
+  int max_queue_ms = 100;
+  int delay_ms = 0;
+  // Additional delay, uniform in [0, jitter_ms]
+  int jitter_ms = 0;
+  // Loss in the good state
+  double loss_perc = 0;
+  // Per packet probability to enter / leave the burst (bad) state
+  double burst_enter_perc = 0;
+  double burst_exit_perc = 100;
+  // Loss in the bad state
+  double burst_loss_perc = 100;
+  // Packets that are held back by reorder_extra_ms
+  double reorder_perc = 0;
+  int reorder_extra_ms = 5;
+  uint32_t seed = 1;
+  /**
+   * Either the name of a preset (ideal, good, marginal, bad, burst), a list
+   * of key=value pairs or a preset followed by overrides, e.g.
+   * "marginal,delay=20,seed=7". Keys: bw (kbit/s), queue, delay, jitter
+   * (ms), loss, burst_enter, burst_exit, burst_loss, reorder (percent),
+   * reorder_extra (ms), seed.
+   * @return nullopt if the string cannot be parsed
+   */
+  static std::optional<LinkImpairment> from_string(const std::string& profile);
+  std::string to_string() const;
+};
+
+struct EmulatedChannelStats {
+  uint64_t n_packets = 0;
+  uint64_t n_delivered = 0;
+  uint64_t n_lost = 0;
+  // Did not fit into the bandwidth limited queue
+  uint64_t n_queue_dropped = 0;
+  // Delivered after a packet that was sent later
+  uint64_t n_reordered = 0;
+  uint64_t bytes_delivered = 0;
+  std::string to_string() const;
+};
+
+// What is transmitted - maps to the OHDLink callbacks
+enum class EmulatedPacketType : uint8_t {
+  TELEMETRY = 0,
+  VIDEO_PRIMARY = 1,
+  VIDEO_SECONDARY = 2,
+  AUDIO = 3
+};
+
+/**
+ * One direction of an emulated link. send() applies the impairment and
+ * schedules the packet, a delivery thread hands it to the callback at the
+ * emulated arrival time.
+ * 模拟链路的一个方向。send() 应用损伤并调度数据包，投递线程在模拟的到达时间将其交给回调。
+ */
+class EmulatedChannel {
+ public:
+  typedef std::function<void(EmulatedPacketType type, const uint8_t* data,
+                             int data_len)>
+      DELIVER_CB;
+  EmulatedChannel(LinkImpairment impairment, DELIVER_CB cb);
+  ~EmulatedChannel();
+  EmulatedChannel(const EmulatedChannel&) = delete;
+  EmulatedChannel& operator=(const EmulatedChannel&) = delete;
+  // Thread-safe. With n_injections > 1 (telemetry), each injection uses
+  // bandwidth, the packet is delivered once if at least one injection arrives
+  void send(EmulatedPacketType type, const uint8_t* data, int data_len,
+            int n_injections = 1);
+  EmulatedChannelStats get_stats();
+  const LinkImpairment& get_impairment() const { return m_impairment; }
+
+ private:
+  typedef std::chrono::steady_clock::time_point TIME_POINT;
+  struct Packet {
+    TIME_POINT deliver_at;
+    uint64_t seq;
+    EmulatedPacketType type;
+    std::vector<uint8_t> data;
+  };
+  struct Later {
+    bool operator()(const Packet& a, const Packet& b) const {
+      if (a.deliver_at != b.deliver_at) return a.deliver_at > b.deliver_at;
+      return a.seq > b.seq;
+    }
+  };
+  bool is_lost();
+  void loop_deliver();
+
+ private:
+  const LinkImpairment m_impairment;
+  const DELIVER_CB m_cb;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::priority_queue<Packet, std::vector<Packet>, Later> m_packets;
+  std::mt19937 m_rng;
+  bool m_burst_state = false;
+  TIME_POINT m_tx_free_at{};
+  TIME_POINT m_last_in_order_deliver_at{};
+  uint64_t m_seq = 0;
+  uint64_t m_highest_delivered_seq = 0;
+  EmulatedChannelStats m_stats{};
+  bool m_stop = false;
+  std::thread m_thread;
+};
+
+/**
+ * OHDLink implementation without any radio - for running OpenHD air and
+ * ground (dummy camera, telemetry, video forwarding) end to end on a dev box
+ * and for benchmarks under reproducible impairment (telemetry RTT, video
+ * latency, recovery after loss bursts).
+ * Either both ends live in one process (create_pair) or each end in its own
+ * process, connected via a unix socket (create_unix, see EMULATED_LINK_PROFILE
+ * in hardware.config). Each end impairs what it transmits.
+ * 不需要任何无线电的 OHDLink 实现 - 用于在开发机上端到端运行 OpenHD 空中和地面（虚拟摄像头、遥测、
+ * 视频转发），以及在可复现的损伤下进行基准测试（遥测 RTT、视频延迟、丢包突发后的恢复）。
+ * 两端可以在同一进程中（create_pair），也可以各自在独立进程中通过 unix socket 连接（create_unix）。
+ */
+class EmulatedLink : public OHDLink {
+ public:
+  static std::pair<std::shared_ptr<EmulatedLink>, std::shared_ptr<EmulatedLink>>
+  create_pair(const LinkImpairment& air_to_ground,
+              const LinkImpairment& ground_to_air);
+  // Ground listens on path, air connects (and re-connects)
+  static std::shared_ptr<EmulatedLink> create_unix(
+      bool is_air, const std::string& path, const LinkImpairment& tx_impairment);
+  static constexpr auto DEFAULT_SOCKET_PATH = "/tmp/openhd_emulated_link";
+  ~EmulatedLink();
+  EmulatedLink(const EmulatedLink&) = delete;
+  EmulatedLink& operator=(const EmulatedLink&) = delete;
+  void transmit_telemetry_data(TelemetryTxPacket packet) override;
+  void transmit_video_data(
+      int stream_index,
+      const openhd::FragmentedVideoFrame& fragmented_video_frame) override;
+  void transmit_audio_data(const openhd::AudioPacket& audio_packet) override;
+  EmulatedChannelStats get_tx_stats();
+  // Unix socket only - true if the other end is connected
+  bool is_connected() const { return m_fd_connected >= 0; }
+
+ private:
+  EmulatedLink(bool is_air, const LinkImpairment& tx_impairment);
+  void on_receive(EmulatedPacketType type, const uint8_t* data, int data_len);
+  void send_unix(EmulatedPacketType type, const uint8_t* data, int data_len);
+  void loop_unix();
+  bool connect_or_accept();
+
+ private:
+  const bool m_is_air;
+  std::shared_ptr<spdlog::logger> m_console;
+  std::unique_ptr<EmulatedChannel> m_tx_channel;
+  // unix socket
+  std::string m_socket_path;
+  int m_fd_listen = -1;
+  std::atomic<int> m_fd_connected{-1};
+  std::mutex m_send_mutex;
+  std::atomic<bool> m_unix_run{false};
+  std::thread m_unix_thread;
+};
+
+}  // namespace openhd
+
+#endif  // OPENHD_OPENHD_OHD_COMMON_INC_OPENHD_LINK_EMULATOR_H_
@@ -24,10 +24,14 @@
 #ifndef OPENHD_OPENHD_OHD_COMMON_OPENHD_LINK_STATISTICS_HPP_
 #define OPENHD_OPENHD_OHD_COMMON_OPENHD_LINK_STATISTICS_HPP_
 
+#include <array>
+#include <cstdint>
 #include <cstring>
+#include <functional>
 #include <optional>
 #include <sstream>
 #include <string>
+#include <vector>
 
 // NOTE: While annoying, we do not want mavlink as a direct dependency inside
 // ohd_common / ohd_interface, So we double-declare the mavlink message
@@ -0,0 +1,166 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#ifndef OPENHD_OPENHD_NETLINK_H
+#define OPENHD_OPENHD_NETLINK_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "openhd_spdlog.h"
+
+struct nlmsghdr;
+
+namespace openhd {
+
+// A network interface (link) as reported by the kernel
+// 内核报告的网络接口（链路）
+struct NetlinkLink {
+  int ifindex = 0;
+  std::string name;
+  // IFF_* flags
+  uint32_t flags = 0;
+  // IF_OPER_* (same as /sys/class/net/<name>/operstate)
+  uint8_t operstate = 0;
+  // Operational state "up" - carrier and (if applicable) negotiated
+  bool is_up() const;
+};
+
+// An IPv4 / IPv6 address assigned to a local interface
+// 分配给本地接口的 IPv4 / IPv6 地址
+struct NetlinkAddress {
+  int ifindex = 0;
+  int family = 0;
+  std::string ip;
+  uint8_t prefix_len = 0;
+};
+
+// An IPv4 route of the main table
+// 主路由表中的 IPv4 路由
+struct NetlinkRoute {
+  int ifindex = 0;
+  // empty for the default route
+  std::string dst;
+  uint8_t dst_len = 0;
+  // empty if directly connected
+  std::string gateway;
+  std::string prefsrc;
+  uint32_t metric = 0;
+  bool is_default() const { return dst_len == 0; }
+};
+
+/**
+ * Keeps local addresses, IPv4 routes and link state up to date from rtnetlink
+ * notifications - replaces running "ip route" / "hostname -I" and parsing
+ * their output. The full state is dumped once on creation, after that only
+ * kernel events update it (re-dumped if the kernel reports that we missed
+ * some). Thread-safe.
+ * Either query the current state, register a listener (called from the
+ * netlink thread after each batch of changes), or block with
+ * wait_for_change() until something changed.
+ * 通过 rtnetlink 通知保持本地地址、IPv4 路由和链路状态的最新状态 - 替代运行 "ip route" /
+ * "hostname -I" 并解析其输出。创建时完整获取一次状态，之后仅由内核事件更新。线程安全。
+ */
+class NetlinkCache {
+ public:
+  static NetlinkCache& instance();
+  ~NetlinkCache();
+  NetlinkCache(const NetlinkCache&) = delete;
+  NetlinkCache& operator=(const NetlinkCache&) = delete;
+  // False if the netlink socket could not be opened - all queries return
+  // nothing in this case.
+  bool is_valid() const { return m_fd >= 0; }
+  std::vector<NetlinkLink> get_links();
+  std::optional<NetlinkLink> get_link(const std::string& ifname);
+  // True if the interface exists and its operstate is up
+  bool is_link_up(const std::string& ifname);
+  std::vector<NetlinkAddress> get_addresses();
+  // True if the given ip is assigned to any local interface (or loopback)
+  bool is_local_address(const std::string& ip);
+  std::vector<NetlinkRoute> get_routes(const std::string& ifname);
+  // Gateway of the default route (lowest metric) via the given interface,
+  // e.g. the phone of a USB tethering connection.
+  std::optional<std::string> get_default_gateway(const std::string& ifname);
+  // Incremented on every change of the cache
+  uint64_t get_generation();
+  // Blocks until the generation differs from last_generation, the timeout
+  // elapsed or notify_waiters() was called. Returns the current generation.
+  uint64_t wait_for_change(uint64_t last_generation,
+                           std::chrono::milliseconds timeout);
+  // Wakes up everybody in wait_for_change (e.g. to check a stop flag)
+  void notify_waiters();
+  // Blocks until condition() returns true (evaluated on every change) or stop
+  // is set - call notify_waiters() after setting it. Returns false on stop.
+  // 阻塞直到 condition() 返回 true（每次变化时评估）或 stop 被设置。
+  bool wait_until(const std::function<bool()>& condition,
+                  const std::atomic<bool>& stop);
+  typedef std::function<void()> CHANGE_CALLBACK;
+  // Returns an id for unregister_listener. Do not (un-) register from within
+  // the callback.
+  int register_listener(CHANGE_CALLBACK cb);
+  void unregister_listener(int id);
+
+ private:
+  explicit NetlinkCache();
+  bool request_dump(int type, int family);
+  // Returns false on error, reads until NLMSG_DONE if dump is set
+  bool receive(bool dump);
+  void process_message(const ::nlmsghdr* nh);
+  void resync();
+  void loop();
+  void on_changed();
+
+ private:
+  std::shared_ptr<spdlog::logger> m_console;
+  int m_fd = -1;
+  int m_wakeup_fd = -1;
+  uint32_t m_seq = 0;
+  std::vector<uint8_t> m_rx_buffer;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::map<int, NetlinkLink> m_links;
+  std::vector<NetlinkAddress> m_addresses;
+  std::vector<NetlinkRoute> m_routes;
+  uint64_t m_generation = 0;
+  bool m_changed_in_batch = false;
+  uint64_t m_n_wakeups = 0;
+  std::mutex m_listeners_mutex;
+  std::map<int, CHANGE_CALLBACK> m_listeners;
+  int m_next_listener_id = 0;
+  std::atomic<bool> m_terminate = false;
+  std::unique_ptr<std::thread> m_thread;
+};
+
+}  // namespace openhd
+
+#endif  // OPENHD_OPENHD_NETLINK_H
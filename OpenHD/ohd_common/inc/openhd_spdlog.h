@@ -39,8 +39,12 @@
 // #include <spdlog/spdlog.h>
 // # define FMT_STRING(s) s
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <vector>
 
 namespace openhd::log {
@@ -52,14 +56,46 @@ namespace openhd::log {
 // 只创建一次实例。由于某些原因，在 spdlog 中没有找到相关的帮助函数
 // （或者我还没有找到）。
 
+// All loggers share one stdout sink and one mavlink sink. Unless the
+// environment variable OPENHD_LOG_SYNC is set (e.g. when debugging a crash),
+// they are asynchronous - a log call only formats the message and pushes it
+// into a bounded queue (ASYNC_QUEUE_SIZE), a single thread writes it out. If
+// the queue is full, the oldest message is dropped - logging never blocks the
+// caller.
+// 所有日志记录器共享一个 stdout sink 和一个 mavlink sink。除非设置了环境变量 OPENHD_LOG_SYNC
+// （例如调试崩溃时），它们都是异步的 - 日志调用只格式化消息并放入有界队列，由单独的线程写出。
+// 队列满时丢弃最旧的消息 - 日志永远不会阻塞调用者。
+static constexpr std::size_t ASYNC_QUEUE_SIZE = 8192;
+
 // Thread-safe but recommended to store result in an intermediate variable
+// (or use OPENHD_CACHED_LOGGER)
 // 线程安全，但建议将结果存储在中间变量中。
 std::shared_ptr<spdlog::logger> create_or_get(const std::string& logger_name);
 
-// Uses the thread-safe create_or_get -> slower than using the intermediate
-// variable approach, but sometimes you just don't care about that.
-// 使用线程安全的 create_or_get -> 比使用中间变量方法慢，但有时你并不在乎这个。
-std::shared_ptr<spdlog::logger> get_default();
+// Cached, no lookup after the first call
+// 已缓存，首次调用后不再查找。
+const std::shared_ptr<spdlog::logger>& get_default();
+
+// Writes out everything that is still queued (async loggers)
+void flush_all();
+
+/**
+ * Limits a (per packet / per frame) log call site to one message per
+ * interval, the number of swallowed messages is reported with the next one.
+ * Thread-safe, lock free. Use via the OPENHD_LOG_EVERY_MS macros.
+ * 将（每个包 / 每帧）的日志调用点限制为每个时间间隔一条消息，被吞掉的消息数量随下一条消息报告。
+ */
+class RateLimiter {
+ public:
+  explicit RateLimiter(int interval_ms) : m_interval_ms(interval_ms) {}
+  // n_suppressed: calls that were swallowed since the last allowed one
+  bool allow(uint32_t& n_suppressed);
+
+ private:
+  const int64_t m_interval_ms;
+  std::atomic<int64_t> m_last_ms{INT64_MIN / 2};
+  std::atomic<uint32_t> m_n_suppressed{0};
+};
 
 // By default, only messages of level warn or higher are forwarded via mavlink
 // (and then shown in QOpenHD). Use this if you want to show a non-warning
@@ -84,12 +120,18 @@ class MavlinkLogMessageBuffer {
   // Dequeues buffered telemetry log messages,
   // called in regular intervals by the telemetry thread
   void enqueue_log_message(MavlinkLogMessage message);
+  // Thread-safe
+  // Called (must not block) every time a message has been enqueued, such that
+  // the telemetry thread can forward it right away instead of polling.
+  // nullptr to remove.
+  void set_enqueue_listener(std::function<void()> listener);
   // We only have one instance of this class inside openhd
   static MavlinkLogMessageBuffer& instance();
 
  private:
   std::mutex m_mutex;
   std::vector<MavlinkLogMessage> m_buffer;
+  std::function<void()> m_enqueue_listener;
 };
 
 // these match the mavlink SEVERITY_LEVEL enum, but this code should not depend
@@ -118,4 +160,33 @@ void warning_log(const std::string& message);
 
 }  // namespace openhd::log
 
+// Logger looked up once per call site, for hot paths without a member logger
+#define OPENHD_CACHED_LOGGER(name)                                            \
+  ([]() -> const std::shared_ptr<spdlog::logger>& {                           \
+    static const auto openhd_cached_logger = openhd::log::create_or_get(name); \
+    return openhd_cached_logger;                                              \
+  }())
+
+// Rate limited logging for per packet / per frame call sites. Disabled levels
+// cost one level check.
+// 用于每个包 / 每帧调用点的限速日志。禁用的级别只需一次级别检查。
+#define OPENHD_LOG_EVERY_MS(logger, level, interval_ms, ...)                   \
+  do {                                                                         \
+    if ((logger)->should_log(level)) {                                         \
+      static openhd::log::RateLimiter openhd_log_rate_limiter{interval_ms};    \
+      uint32_t openhd_log_n_suppressed = 0;                                    \
+      if (openhd_log_rate_limiter.allow(openhd_log_n_suppressed)) {            \
+        (logger)->log(level, __VA_ARGS__);                                     \
+        if (openhd_log_n_suppressed > 0) {                                     \
+          (logger)->log(level, "({} similar messages suppressed)",             \
+                        openhd_log_n_suppressed);                              \
+        }                                                                      \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
+#define OPENHD_DEBUG_EVERY_MS(logger, interval_ms, ...) \
+  OPENHD_LOG_EVERY_MS(logger, spdlog::level::debug, interval_ms, __VA_ARGS__)
+#define OPENHD_WARN_EVERY_MS(logger, interval_ms, ...) \
+  OPENHD_LOG_EVERY_MS(logger, spdlog::level::warn, interval_ms, __VA_ARGS__)
+
 #endif  // OPENHD_OPENHD_OHD_COMMON_OPENHD_SPDLOG_HPP_
@@ -24,21 +24,31 @@
 #ifndef OPENHD_OPENHD_TCP_H
 #define OPENHD_OPENHD_TCP_H
 
+#include <atomic>
+#include <chrono>
 #include <deque>
+#include <map>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 #include "openhd_spdlog.h"
 
 namespace openhd {
 /**
- * Non-blocking multiple-client(s) multi-threaded TCP server
+ * Non-blocking multiple-client(s) TCP server
  * FEATURES:
- * 1) Multiple clients (multi-threaded)
+ * 1) Multiple clients, all served by one epoll reactor thread
  * 2) Automatically disconnect dead clients
  * 3) Generic interface where implementation can overwrite the following events:
  *      a) client connected / disconnected
  *      b) message received (any client)
  *   And send messages with a broadcast-like interface.
+ * Each client has a bounded send queue - if a client cannot keep up, the
+ * oldest (whole) messages are dropped, never a part of one and never the
+ * messages of the other clients.
+ * 非阻塞多客户端 TCP 服务器，所有客户端由一个 epoll 反应器线程服务。每个客户端有一个有界发送队列 -
+ * 客户端跟不上时丢弃最旧的（完整）消息，不影响其他客户端。
  */
 class TCPServer {
  public:
@@ -48,16 +58,18 @@ class TCPServer {
     int port;
   };
   explicit TCPServer(std::string tag, Config config, bool debug = false);
-  ~TCPServer();
+  virtual ~TCPServer();
   /**
    * Needs to be overridden by implementation.
    * Called every time a packet (from any client) has been received.
-   * The thread calling the method is different for every client.
+   * Always called from the reactor thread.
    */
   virtual void on_packet_any_tcp_client(const uint8_t* data, int data_len) = 0;
   /**
    * Send the given message to all (currently) connected clients.
-   * Non-blocking -
+   * Non-blocking - written right away if possible, otherwise (the rest) is
+   * queued and written by the reactor thread once the socket is writable.
+   * Thread-safe.
    */
   void send_message_to_all_clients(const uint8_t* data, int data_len);
   /**
@@ -67,30 +79,66 @@ class TCPServer {
    * caution feature)
    */
   virtual void on_external_device(std::string ip, int port, bool connected) = 0;
+  // Per client, to find clients that cannot keep up
+  struct ClientStats {
+    std::string ip;
+    int port;
+    uint64_t n_bytes_sent = 0;
+    uint64_t n_messages_dropped = 0;
+    // currently queued
+    std::size_t queue_size_bytes = 0;
+    // Age of the oldest queued message (0 if nothing is queued)
+    std::chrono::microseconds lag{0};
+  };
+  std::vector<ClientStats> get_client_stats();
+  // Max. queued bytes per client, older messages are dropped
+  static constexpr std::size_t MAX_CLIENT_QUEUE_BYTES = 256 * 1024;
 
  private:
   const Config m_config;
   const bool m_debug;
   std::shared_ptr<spdlog::logger> m_console;
-  std::unique_ptr<std::thread> m_accept_thread = nullptr;
-  bool m_keep_accept_thread_alive = true;
-  int server_fd = 0;
+  std::unique_ptr<std::thread> m_reactor_thread = nullptr;
+  std::atomic<bool> m_keep_reactor_alive = true;
+  int server_fd = -1;
+  int m_epoll_fd = -1;
+  int m_wakeup_fd = -1;
   static constexpr const size_t READ_BUFF_SIZE = 65507;
-  void loop_accept();
+  bool setup_server_socket();
+  void loop_reactor();
+  void accept_clients();
 
  private:
+  struct QueuedMessage {
+    std::shared_ptr<const std::vector<uint8_t>> data;
+    // Already written (only the first message of a queue)
+    std::size_t offset;
+    std::chrono::steady_clock::time_point enqueue_time;
+  };
   struct ConnectedClient {
     int sock_fd;
     std::string ip;
     int port;
     bool marked_to_be_removed = false;
-    std::shared_ptr<std::thread> rx_loop_thread;
-    void loop_rx();
-    bool keep_rx_looping = true;
-    TCPServer* parent;
+    // EPOLLOUT registered (while the queue is not empty)
+    bool wants_write = false;
+    std::deque<QueuedMessage> queue;
+    std::size_t queue_size_bytes = 0;
+    uint64_t n_bytes_sent = 0;
+    uint64_t n_messages_dropped = 0;
   };
+  // Both need the clients lock
+  void enqueue(ConnectedClient& client,
+               const std::shared_ptr<const std::vector<uint8_t>>& data,
+               std::size_t offset,
+               std::chrono::steady_clock::time_point now);
+  // Writes as much of the queue as possible, returns false on error
+  bool flush_queue(ConnectedClient& client);
+  void set_wants_write(ConnectedClient& client, bool wants_write);
+  void remove_client(int sock_fd);
   std::mutex m_clients_list_mutex;
-  std::deque<std::shared_ptr<ConnectedClient>> m_clients_list;
+  std::map<int, std::shared_ptr<ConnectedClient>> m_clients_list;
+  std::vector<uint8_t> m_read_buffer;
 };
 }  // namespace openhd
 
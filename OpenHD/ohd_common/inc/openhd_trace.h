@@ -0,0 +1,111 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#ifndef OPENHD_OPENHD_TRACE_H
+#define OPENHD_OPENHD_TRACE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Per-frame tracing of the video pipeline, to find out where (air side)
+ * latency comes from. Events are timestamped and keyed by frame (the RTP
+ * timestamp, which is the same for all fragments of a frame and on air and
+ * ground) and written into a per-thread lock-free ring buffer. When disabled,
+ * recording an event is a single relaxed atomic load.
+ * Enable with GEN_ENABLE_FRAME_TRACING in the config file, dump with
+ * `kill -USR1 <pid of openhd>` (writes /tmp/openhd_trace.json (chrome://tracing
+ * / perfetto) and /tmp/openhd_trace.csv).
+ * 视频管道的逐帧跟踪，用于找出（空中端）延迟的来源。事件带有时间戳并按帧（RTP 时间戳）
+ * 标识，写入每个线程独立的无锁环形缓冲区。禁用时记录事件只需一次 relaxed 原子读取。
+ */
+namespace openhd::trace {
+
+enum class Stage : uint16_t {
+  // air: rtp fragment pulled out of appsink, value: size in bytes
+  APPSINK_SAMPLE = 0,
+  // air: all fragments of a frame are there, value: n of fragments
+  FRAME_ASSEMBLED,
+  // air: frame handed to the link (duration), value (end): n dropped frames
+  LINK_ENQUEUE_BEGIN,
+  LINK_ENQUEUE_END,
+  // air: link could not keep up, value: n dropped frames
+  LINK_FRAME_DROPPED,
+  // air: counters reported by the link tx (not per frame, see
+  // record_counter), value: us
+  LINK_FEC_ENCODE_TIME,
+  LINK_TX_DELAY,
+  // ground: rtp fragment received from the link, value: size in bytes
+  GND_VIDEO_RX,
+};
+const char* stage_to_string(Stage stage);
+
+struct Event {
+  uint64_t timestamp_ns;  // steady clock
+  uint32_t frame_id;
+  Stage stage;
+  uint16_t stream_index;
+  int32_t value;
+};
+
+namespace detail {
+extern std::atomic<bool> g_enabled;
+void record(Stage stage, uint32_t frame_id, uint16_t stream_index,
+            int32_t value);
+}  // namespace detail
+
+static inline bool is_enabled() {
+  return detail::g_enabled.load(std::memory_order_relaxed);
+}
+static inline void record(Stage stage, uint32_t frame_id, int32_t value = 0) {
+  if (!is_enabled()) return;
+  detail::record(stage, frame_id, 0, value);
+}
+// For values that are not per frame (frame_id is 0), e.g. link tx stats
+static inline void record_counter(Stage stage, uint16_t stream_index,
+                                  int32_t value) {
+  if (!is_enabled()) return;
+  detail::record(stage, 0, stream_index, value);
+}
+void set_enabled(bool enabled);
+// N of per-thread rings allocated so far - the ring of an exited thread is
+// re-used by the next thread that records
+std::size_t get_n_rings();
+
+// The RTP timestamp of the given rtp packet, 0 if it is not a valid rtp packet.
+// Check is_enabled() first on hot paths.
+uint32_t frame_id_from_rtp(const uint8_t* data, std::size_t data_len);
+
+// Async-signal-safe, the actual dump happens on the next dump_if_requested()
+void request_dump();
+// Writes the dump files if a dump has been requested. Returns true if dumped.
+bool dump_if_requested();
+// Snapshot of all per-thread rings, as chrome trace event json / csv.
+bool write_chrome_trace_json(const std::string& filename);
+bool write_csv(const std::string& filename);
+
+}  // namespace openhd::trace
+
+#endif  // OPENHD_OPENHD_TRACE_H
@@ -26,6 +26,7 @@
 
 #include <netinet/in.h>
 
+#include <atomic>
 #include <functional>
 #include <list>
 #include <memory>
@@ -33,11 +34,18 @@
 #include <optional>
 #include <string>
 #include <thread>
+#include <vector>
 
 //
 // openhd UDP helpers
 //
 namespace openhd {
+
+// Non-owning reference to one packet of a batch
+struct UDPPacketRef {
+  const uint8_t *data;
+  std::size_t size;
+};
 // Wrapper around an UDP port you can send data to
 // opens port on construction, closes port on destruction
 class UDPForwarder {
@@ -51,10 +59,29 @@ class UDPForwarder {
 
   // 将数据包通过 UDP 转发。
   void forwardPacketViaUDP(const uint8_t *packet, std::size_t packetSize) const;
+  /**
+   * Send a burst of packets (e.g. all rtp fragments of a frame) with as few
+   * syscalls as possible - sendmmsg, or (if use_gso is set and the kernel
+   * supports it) UDP GSO for runs of equally sized packets.
+   * 以尽可能少的系统调用发送一批数据包（例如一帧的所有 rtp 分片）——使用 sendmmsg，
+   * 或（如果设置了 use_gso 并且内核支持）对相同大小的连续数据包使用 UDP GSO。
+   */
+  void forwardPacketsViaUDP(const UDPPacketRef *packets, std::size_t n_packets,
+                            bool use_gso = false) const;
+  const struct sockaddr_in &get_saddr() const { return saddr; }
+  void log_send_error(std::size_t packetSize, ssize_t ret) const;
 
  private:
+  void send_batch_sendmmsg(const UDPPacketRef *packets,
+                           std::size_t n_packets) const;
+  // Returns the n of packets sent - less than n_packets if the kernel / the
+  // socket rejected UDP_SEGMENT (the rest has not been sent in this case)
+  std::size_t send_batch_gso(const UDPPacketRef *packets,
+                             std::size_t n_packets) const;
   struct sockaddr_in saddr {};
   int sockfd;
+  // Set once the kernel / the socket rejected UDP_SEGMENT
+  mutable std::atomic<bool> m_gso_unsupported{false};
 
  public:
   // 目标的 IP 地址和 UDP 端口
@@ -69,7 +96,8 @@ class UDPForwarder {
 // 这个类允许将数据包转发到多个 IP 地址和端口。
 class UDPMultiForwarder {
  public:
-  explicit UDPMultiForwarder() = default;
+  explicit UDPMultiForwarder();
+  ~UDPMultiForwarder();
   UDPMultiForwarder(const UDPMultiForwarder &) = delete;
   UDPMultiForwarder &operator=(const UDPMultiForwarder &) = delete;
   /**
@@ -84,20 +112,47 @@ class UDPMultiForwarder {
    */
   void removeForwarder(const std::string &client_addr, int client_udp_port);
   /**
-   * Forward data to all added IP::Port tuples via UDP
-   * 将数据包转发到所有已添加的目标
+   * Forward data to all added IP::Port tuples via UDP - one sendmmsg covering
+   * all destinations.
+   * 将数据包转发到所有已添加的目标 - 一次 sendmmsg 覆盖所有目标。
    */
   void forwardPacketViaUDP(const uint8_t *packet, std::size_t packetSize);
+  /**
+   * Forward a burst of packets (e.g. a whole frame) to all added IP::Port
+   * tuples - one sendmmsg covering all packets and destinations (or, with GSO,
+   * one GSO send per run of equally sized packets and destination) instead of
+   * one sendto per packet and destination.
+   * 将一批数据包（例如一整帧）转发到所有已添加的目标 - 一次 sendmmsg 覆盖所有数据包和目标
+   * （或使用 GSO 时每个目标一次 GSO 发送），而不是每个数据包、每个目标一次 sendto。
+   */
+  void forwardPacketsViaUDP(const UDPPacketRef *packets, std::size_t n_packets);
+  void forwardPacketsViaUDP(const std::vector<UDPPacketRef> &packets) {
+    forwardPacketsViaUDP(packets.data(), packets.size());
+  }
+  // Use UDP GSO (UDP_SEGMENT) for batches if supported, off by default
+  void set_use_gso(bool enable) { m_use_gso = enable; }
 
-  // 返回当前所有转发目标的列表
-  [[nodiscard]] const std::list<std::unique_ptr<UDPForwarder>> &getForwarders()
-      const;
+  typedef std::vector<std::shared_ptr<UDPForwarder>> Forwarders;
+  // 返回当前所有转发目标的列表（快照）
+  [[nodiscard]] std::shared_ptr<const Forwarders> getForwarders() const;
 
  private:
   // list of host::port tuples where we send the data to.
-  std::list<std::unique_ptr<UDPForwarder>> udpForwarders;
-  // modifying the list of forwarders must be thread-safe
+  // Copy on write - add / remove build a new list and swap it in, the send
+  // path only takes a snapshot and never blocks on add / remove.
+  // 写时复制 - 添加 / 移除时构建新列表并替换，发送路径只获取快照，不会因添加 / 移除而阻塞。
+  std::shared_ptr<const Forwarders> udpForwarders =
+      std::make_shared<Forwarders>();
+  // serializes add / remove
   std::mutex udpForwardersLock;
+  std::atomic<bool> m_use_gso = false;
+  // Unconnected socket shared by all destinations, such that one sendmmsg
+  // can cover all of them
+  // 所有目标共享的未连接套接字，使一次 sendmmsg 可以覆盖所有目标
+  int m_sockfd;
+  void send_all_destinations(const Forwarders &forwarders,
+                             const UDPPacketRef *packets,
+                             std::size_t n_packets) const;
 };
 
 // Open the specified port for udp receiving
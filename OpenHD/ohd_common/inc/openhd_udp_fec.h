@@ -0,0 +1,167 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#ifndef OPENHD_OPENHD_OHD_COMMON_INC_OPENHD_UDP_FEC_H_
+#define OPENHD_OPENHD_OHD_COMMON_INC_OPENHD_UDP_FEC_H_
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "openhd_udp.h"
+
+//
+// Frame level FEC for the IP based links (Ethernet / Microhard) - systematic
+// Reed-Solomon (Cauchy matrix over GF(256)) erasure code. A FEC block is
+// (a part of) one video frame, the primary fragments are sent unchanged (plus
+// a small header), followed by the secondary (parity) fragments. Any n_primary
+// fragments of a block are enough to recover it.
+// IP 链路（以太网 / Microhard）的帧级 FEC - 系统 Reed-Solomon（GF(256) 上的 Cauchy 矩阵）纠删码。
+// FEC 块是一个视频帧（的一部分），主分片原样发送（加一个小头部），之后是冗余分片。
+// 一个块中任意 n_primary 个分片即可恢复该块。
+//
+namespace openhd {
+
+// On the wire, in front of each fragment
+// 网络上每个分片前面的头部
+struct UDPFecHeader {
+  // Distinguishes FEC packets from plain rtp (version 2 -> 0x80..0xBF)
+  static constexpr uint8_t MAGIC = 0x4F;
+  uint8_t magic;
+  // 0..n_primary-1 primary, then secondary
+  uint8_t fragment_idx;
+  uint8_t n_primary;
+  uint8_t n_secondary;
+  // network byte order
+  uint32_t block_idx;
+} __attribute__((packed));
+static_assert(sizeof(UDPFecHeader) == 8);
+
+static bool is_udp_fec_packet(const uint8_t* data, std::size_t data_len) {
+  return data_len > sizeof(UDPFecHeader) && data[0] == UDPFecHeader::MAGIC;
+}
+
+class UDPFecEncoder {
+ public:
+  static constexpr int MAX_BLOCK_SIZE = 128;
+  /**
+   * @param fec_percentage n secondary fragments, in percent of the n primary
+   * fragments of a block (rounded up), 0..100
+   * @param max_block_size frames with more fragments are split into multiple
+   * blocks
+   */
+  UDPFecEncoder(int fec_percentage, int max_block_size);
+  /**
+   * Packetizes one frame - the returned references are valid until the next
+   * call (buffers are re-used)
+   */
+  const std::vector<UDPPacketRef>& encode_frame(
+      const std::vector<UDPPacketRef>& fragments);
+  int get_fec_percentage() const { return m_fec_percentage; }
+
+ private:
+  void encode_block(const UDPPacketRef* fragments, int n_primary);
+  std::vector<uint8_t>& next_buffer();
+
+ private:
+  const int m_fec_percentage;
+  const int m_max_block_size;
+  uint32_t m_block_idx = 0;
+  std::vector<std::vector<uint8_t>> m_buffers;
+  std::size_t m_n_used_buffers = 0;
+  std::vector<UDPPacketRef> m_packets;
+};
+
+struct UDPFecDecoderStats {
+  uint64_t n_blocks = 0;
+  // At least one primary fragment was recovered
+  uint64_t n_blocks_recovered = 0;
+  // Not enough fragments, forwarded what was there
+  uint64_t n_blocks_lost = 0;
+  uint64_t n_fragments_recovered = 0;
+  uint64_t n_fragments_lost = 0;
+  uint64_t n_invalid = 0;
+  // Sender restarted (block index went back)
+  uint64_t n_resyncs = 0;
+  std::string to_string() const;
+};
+
+/**
+ * Receiver side. Primary fragments are forwarded as soon as all previous
+ * fragments of the block have been forwarded (in order, no added latency if
+ * nothing is lost), missing ones are recovered as soon as enough fragments of
+ * the block arrived. A block that cannot be recovered is given up once
+ * RX_WINDOW_BLOCKS newer blocks are in flight.
+ * A block index that jumps back by more than RESYNC_BLOCKS, or only late
+ * blocks for RESYNC_TIMEOUT, means the sender restarted (it starts at block 0
+ * again) - the decoder starts over with the new index.
+ * Not thread-safe (use it from the UDPReceiver thread).
+ * 接收端。主分片在块内所有之前的分片都已转发后立即转发（按顺序，无丢失时无额外延迟），
+ * 丢失的分片在收到足够的分片后立即恢复。块索引大幅回退（发送端重启）时重新同步。
+ * 非线程安全（在 UDPReceiver 线程中使用）。
+ */
+class UDPFecDecoder {
+ public:
+  typedef std::function<void(const uint8_t* data, int data_len)> OUTPUT_CB;
+  static constexpr int RX_WINDOW_BLOCKS = 4;
+  static constexpr int RESYNC_BLOCKS = 4 * RX_WINDOW_BLOCKS;
+  static constexpr auto RESYNC_TIMEOUT = std::chrono::seconds(2);
+  explicit UDPFecDecoder(OUTPUT_CB cb);
+  void process_packet(const uint8_t* data, std::size_t data_len);
+  const UDPFecDecoderStats& get_stats() const { return m_stats; }
+
+ private:
+  struct Block {
+    uint32_t block_idx = 0;
+    int n_primary = 0;
+    int n_secondary = 0;
+    // coded payload (length prefix + data), empty if not received
+    std::vector<std::vector<uint8_t>> fragments;
+    std::vector<bool> received;
+    int n_received = 0;
+    int n_forwarded = 0;
+    bool done = false;
+  };
+  Block* get_block(const UDPFecHeader& header);
+  void forward_in_order(Block& block);
+  void recover(Block& block);
+  void give_up(Block& block);
+
+ private:
+  const OUTPUT_CB m_cb;
+  // oldest first
+  std::deque<std::unique_ptr<Block>> m_blocks;
+  // Last block that was forwarded completely / given up
+  bool m_has_last_done = false;
+  uint32_t m_last_done_block_idx = 0;
+  std::chrono::steady_clock::time_point m_last_done_time;
+  UDPFecDecoderStats m_stats;
+};
+
+}  // namespace openhd
+
+#endif  // OPENHD_OPENHD_OHD_COMMON_INC_OPENHD_UDP_FEC_H_
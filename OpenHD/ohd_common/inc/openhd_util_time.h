@@ -43,8 +43,12 @@ std::string time_readable_ns(uint64_t nanoseconds);
 
 uint32_t get_micros(std::chrono::nanoseconds ns);
 
+// Offset (ground - air) between the steady clocks of air and ground unit,
+// established via mavlink TIMESYNC. Only valid on the ground, and only once
+// has_air_unit_time_offset() returns true.
 void store_air_unit_time_offset_us(int64_t offset_us);
 int64_t get_air_unit_time_offset_us();
+bool has_air_unit_time_offset();
 
 }  // namespace openhd::util
 
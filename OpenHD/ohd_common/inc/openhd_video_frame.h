@@ -25,12 +25,104 @@
 #define OPENHD_OPENHD_OHD_COMMON_OPENHD_VIDEO_FRAME_H_
 
 #include <chrono>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <optional>
 #include <sstream>
 #include <vector>
 
+#include "openhd_buffer_pool.h"
+
 namespace openhd {
 
+// A single (rtp) fragment of a video frame.
+// Read-only once created and reference counted - all consumers (the link,
+// localhost forwarding, recording) share the same instance, the memory is
+// released once the last consumer drops its reference.
+// The bytes live in a std::vector (recycled via the video buffer pool where
+// possible), since that is what the wifibroadcast tx api takes - see
+// as_shared_vectors.
+// 视频帧的单个（RTP）分片。
+// 创建后只读，并且带引用计数 - 所有使用者（链路、本地转发、录制）共享同一个实例，
+// 最后一个使用者释放引用时内存才会被释放。
+class VideoFragment {
+ public:
+  virtual ~VideoFragment() = default;
+  VideoFragment(const VideoFragment&) = delete;
+  VideoFragment& operator=(const VideoFragment&) = delete;
+  const uint8_t* data() const { return m_data; }
+  std::size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+  // Returns the vector holding the data if this fragment is backed by one,
+  // nullptr otherwise.
+  virtual const std::vector<uint8_t>* get_backing_vector() const {
+    return nullptr;
+  }
+
+ protected:
+  VideoFragment() = default;
+  // Set by the implementation, need to stay valid for the lifetime of this
+  // object
+  const uint8_t* m_data = nullptr;
+  std::size_t m_size = 0;
+};
+
+// Fragment owning its data in a std::vector
+class VectorVideoFragment : public VideoFragment {
+ public:
+  explicit VectorVideoFragment(std::vector<uint8_t> data)
+      : m_buff(std::move(data)) {
+    m_data = m_buff.data();
+    m_size = m_buff.size();
+  }
+  VectorVideoFragment(const uint8_t* data, std::size_t data_len)
+      : VectorVideoFragment(std::vector<uint8_t>(data, data + data_len)) {}
+  const std::vector<uint8_t>* get_backing_vector() const override {
+    return &m_buff;
+  }
+
+ private:
+  std::vector<uint8_t> m_buff;
+};
+
+// Fragment whose vector is borrowed from a BufferPool and given back on
+// destruction
+class PooledVideoFragment : public VideoFragment {
+ public:
+  PooledVideoFragment(std::shared_ptr<BufferPool> pool, const uint8_t* data,
+                      std::size_t data_len)
+      : m_pool(std::move(pool)), m_buff(m_pool->acquire()) {
+    m_buff->assign(data, data + data_len);
+    m_data = m_buff->data();
+    m_size = m_buff->size();
+  }
+  // Takes ownership of a buffer that was acquire()-d from the given pool and
+  // already holds the fragment data (e.g. written in place by a packetizer)
+  PooledVideoFragment(std::shared_ptr<BufferPool> pool,
+                      std::vector<uint8_t>* acquired_buffer)
+      : m_pool(std::move(pool)), m_buff(acquired_buffer) {
+    m_data = m_buff->data();
+    m_size = m_buff->size();
+  }
+  ~PooledVideoFragment() override { m_pool->release(m_buff); }
+  const std::vector<uint8_t>* get_backing_vector() const override {
+    return m_buff;
+  }
+
+ private:
+  const std::shared_ptr<BufferPool> m_pool;
+  std::vector<uint8_t>* m_buff;
+};
+
+// Copies the given data into a new fragment, the memory is recycled via the
+// video buffer pool.
+static std::shared_ptr<VideoFragment> make_video_fragment(const uint8_t* data,
+                                                          std::size_t data_len) {
+  return std::make_shared<PooledVideoFragment>(BufferPool::video(), data,
+                                               data_len);
+}
+
 // R.n this is the best name i can come up with
 // This is not required to be exactly one frame, but should be
 // already packetized into rtp fragments
@@ -39,7 +131,7 @@ namespace openhd {
 // 这不需要严格是一个帧，但应该已经按照RTP协议分段成RTP片段
 // R.n 它始终是h264、h265或mjpeg，并使用RTP协议进行分段
 struct FragmentedVideoFrame {
-  std::vector<std::shared_ptr<std::vector<uint8_t>>> rtp_fragments;
+  std::vector<std::shared_ptr<VideoFragment>> rtp_fragments;
 
   // Time point of when this frame was produced, as early as possible.
   // ideally, this would be the time point when the frame was generated by the
@@ -68,6 +160,14 @@ struct FragmentedVideoFrame {
   // 如果该帧是IDR帧，则设置为 true，因此我们可以安全地丢弃
   // 之前的帧，而不会导致完全的损坏。
   bool is_idr_frame = false;
+
+  // Time point (steady clock) the frame was captured at, derived from the
+  // buffer timestamp(s) of the encoder / camera pipeline. Unlike creation_time,
+  // this includes capture and encode delay. Not available on all pipelines.
+  // 帧被采集的时间点（steady clock），由编码器/摄像头管道的 buffer 时间戳得出。
+  // 与 creation_time 不同，它包含采集和编码的延迟。并非所有管道都可用。
+  std::optional<std::chrono::steady_clock::time_point> capture_time =
+      std::nullopt;
   std::string to_string() const {
     int total_bytes = 0;
     for (auto& fragment : rtp_fragments) total_bytes += fragment->size();
@@ -78,6 +178,28 @@ struct FragmentedVideoFrame {
     return ss.str();
   }
 };
+
+// The wifibroadcast tx api takes std::shared_ptr<std::vector<uint8_t>>.
+// Fragments that are backed by a vector are handed over without a copy (the
+// returned pointer shares ownership with the fragment), all others are copied.
+// Zero copy ends here - wb only reads the vectors (FEC encode / inject), the
+// const_cast is only for its non-const api.
+static std::vector<std::shared_ptr<std::vector<uint8_t>>> as_shared_vectors(
+    const std::vector<std::shared_ptr<VideoFragment>>& fragments) {
+  std::vector<std::shared_ptr<std::vector<uint8_t>>> ret;
+  ret.reserve(fragments.size());
+  for (const auto& fragment : fragments) {
+    auto* backing = fragment->get_backing_vector();
+    if (backing) {
+      ret.emplace_back(fragment, const_cast<std::vector<uint8_t>*>(backing));
+    } else {
+      ret.emplace_back(std::make_shared<std::vector<uint8_t>>(
+          fragment->data(), fragment->data() + fragment->size()));
+    }
+  }
+  return ret;
+}
+
 typedef std::function<void(int stream_index, const openhd::FragmentedVideoFrame&
                                                  fragmented_video_frame)>
     ON_ENCODE_FRAME_CB;
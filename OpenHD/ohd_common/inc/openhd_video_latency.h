@@ -0,0 +1,83 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#ifndef OPENHD_OPENHD_VIDEO_LATENCY_H
+#define OPENHD_OPENHD_VIDEO_LATENCY_H
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace openhd {
+
+// Capture (air) to arrival (ground) latency of the video frames of one stream,
+// over the last interval. Requires the air and ground clocks to be
+// synchronized (TIMESYNC).
+struct StatsVideoLatency {
+  uint8_t link_index = 0;
+  uint32_t n_samples = 0;
+  int32_t p50_us = 0;
+  int32_t p90_us = 0;
+  int32_t p99_us = 0;
+  int32_t max_us = 0;
+  [[nodiscard]] std::string to_string() const {
+    std::stringstream ss;
+    ss << "StatsVideoLatency{link_index:" << (int)link_index
+       << ",n_samples:" << n_samples << ",p50:" << p50_us
+       << "us,p90:" << p90_us << "us,p99:" << p99_us << "us,max:" << max_us
+       << "us}";
+    return ss.str();
+  }
+};
+
+/**
+ * Collects the capture (air) to arrival (ground) latency of video frames, per
+ * stream. Samples are added by the ground video receiver, which also reads (and
+ * resets) the percentiles periodically and logs them.
+ * Thread-safe.
+ * 按视频流收集帧从采集（空中）到到达（地面）的延迟。
+ * 样本由地面视频接收端添加，并由其定期读取（并重置）百分位数后输出到日志。
+ */
+class VideoLatencyTracker {
+ public:
+  VideoLatencyTracker() = default;
+  VideoLatencyTracker(const VideoLatencyTracker&) = delete;
+  VideoLatencyTracker(const VideoLatencyTracker&&) = delete;
+  static constexpr int MAX_N_STREAMS = 2;
+  void add_sample(int stream_index, int64_t latency_us);
+  // Percentiles of all samples since the last call, then resets.
+  StatsVideoLatency get_and_reset(int stream_index);
+
+ private:
+  // Bounded, once full (stats are not read) new samples are dropped
+  static constexpr size_t MAX_N_SAMPLES = 4096;
+  std::mutex m_mutex;
+  std::array<std::vector<int32_t>, MAX_N_STREAMS> m_samples;
+};
+
+}  // namespace openhd
+
+#endif  // OPENHD_OPENHD_VIDEO_LATENCY_H
@@ -0,0 +1,266 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "openhd_buffer_pool.h"
+
+#include <cassert>
+#include <cstddef>
+#include <sstream>
+#include <type_traits>
+#include <utility>
+
+#include "openhd_spdlog.h"
+#include "openhd_spdlog_include.h"
+
+// The vector has to be the first member - the pool hands out (and takes back)
+// pointers to it
+struct openhd::BufferPool::Slot {
+  std::vector<uint8_t> buffer;
+  // Big enough for the shared_ptr control block (pointer, no-op deleter and
+  // ControlBlockAllocator), checked at compile time in allocate()
+  alignas(std::max_align_t) unsigned char control_block[64];
+};
+
+// Places the control block of the shared_ptr in the slot of the buffer. The
+// buffer goes back into the pool once the control block is deallocated (not in
+// the deleter), such that the slot is not re-used while the control block is
+// still alive.
+template <class T>
+class openhd::BufferPool::ControlBlockAllocator {
+ public:
+  using value_type = T;
+  ControlBlockAllocator(std::shared_ptr<BufferPool> pool, Slot* slot)
+      : m_pool(std::move(pool)), m_slot(slot) {}
+  template <class U>
+  ControlBlockAllocator(const ControlBlockAllocator<U>& other)
+      : m_pool(other.m_pool), m_slot(other.m_slot) {}
+  T* allocate(std::size_t n) {
+    static_assert(sizeof(T) <= sizeof(Slot::control_block) &&
+                  alignof(T) <= alignof(std::max_align_t));
+    assert(n == 1);
+    return reinterpret_cast<T*>(m_slot->control_block);
+  }
+  void deallocate(T* /*p*/, std::size_t /*n*/) {
+    m_pool->release(&m_slot->buffer);
+  }
+  template <class U>
+  bool operator==(const ControlBlockAllocator<U>& other) const {
+    return m_slot == other.m_slot;
+  }
+  template <class U>
+  bool operator!=(const ControlBlockAllocator<U>& other) const {
+    return m_slot != other.m_slot;
+  }
+
+ private:
+  template <class U>
+  friend class ControlBlockAllocator;
+  std::shared_ptr<BufferPool> m_pool;
+  Slot* m_slot;
+};
+
+static std::size_t round_up_power_of_2(std::size_t value) {
+  std::size_t ret = 1;
+  while (ret < value) ret <<= 1;
+  return ret;
+}
+
+std::string openhd::BufferPool::Stats::to_string() const {
+  std::stringstream ss;
+  ss << "BufferPool{hits:" << n_hits << " misses:" << n_misses
+     << " in_use:" << n_in_use << " high_water_mark:" << high_water_mark
+     << "}";
+  return ss.str();
+}
+
+std::shared_ptr<openhd::BufferPool> openhd::BufferPool::create(
+    std::string tag, std::size_t buffer_size, std::size_t n_buffers) {
+  return std::shared_ptr<BufferPool>(
+      new BufferPool(std::move(tag), buffer_size, n_buffers));
+}
+
+openhd::BufferPool::BufferPool(std::string tag, std::size_t buffer_size,
+                               std::size_t n_buffers)
+    : m_tag(std::move(tag)), m_buffer_size(buffer_size) {
+  m_n_buffers = round_up_power_of_2(n_buffers < 2 ? 2 : n_buffers);
+  // The ring has twice the size of the pool - this way it never runs full
+  // under normal conditions (A push racing with a pop on the same cell of a
+  // full ring would otherwise fail and the buffer would be freed)
+  const auto capacity = m_n_buffers * 2;
+  m_cells = std::make_unique<Cell[]>(capacity);
+  m_mask = capacity - 1;
+  for (std::size_t i = 0; i < capacity; i++) {
+    m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    m_cells[i].buffer = nullptr;
+  }
+  for (std::size_t i = 0; i < m_n_buffers; i++) {
+    try_push(new_buffer());
+  }
+}
+
+openhd::BufferPool::~BufferPool() {
+  std::vector<uint8_t>* buffer;
+  while ((buffer = try_pop()) != nullptr) {
+    delete_buffer(buffer);
+  }
+}
+
+std::vector<uint8_t>* openhd::BufferPool::new_buffer() const {
+  static_assert(std::is_standard_layout_v<Slot>);
+  auto slot = new Slot();
+  slot->buffer.reserve(m_buffer_size);
+  return &slot->buffer;
+}
+
+void openhd::BufferPool::delete_buffer(std::vector<uint8_t>* buffer) {
+  delete reinterpret_cast<Slot*>(buffer);
+}
+
+bool openhd::BufferPool::try_push(std::vector<uint8_t>* buffer) {
+  Cell* cell;
+  std::size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+  while (true) {
+    cell = &m_cells[pos & m_mask];
+    const std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+    const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+    if (diff == 0) {
+      if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                              std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // full
+      return false;
+    } else {
+      pos = m_enqueue_pos.load(std::memory_order_relaxed);
+    }
+  }
+  cell->buffer = buffer;
+  cell->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+std::vector<uint8_t>* openhd::BufferPool::try_pop() {
+  Cell* cell;
+  std::size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+  while (true) {
+    cell = &m_cells[pos & m_mask];
+    const std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+    const intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+    if (diff == 0) {
+      if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1,
+                                              std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // empty
+      return nullptr;
+    } else {
+      pos = m_dequeue_pos.load(std::memory_order_relaxed);
+    }
+  }
+  auto ret = cell->buffer;
+  cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+  return ret;
+}
+
+void openhd::BufferPool::on_acquired() {
+  const int in_use = m_n_in_use.fetch_add(1, std::memory_order_relaxed) + 1;
+  int curr_high = m_high_water_mark.load(std::memory_order_relaxed);
+  while (in_use > curr_high) {
+    if (m_high_water_mark.compare_exchange_weak(curr_high, in_use,
+                                                std::memory_order_relaxed)) {
+      // Rare (only while warming up / on load peaks), useful for sizing
+      if (in_use > (int)m_n_buffers) {
+        openhd::log::get_default()->debug(
+            "BufferPool {} new high water mark {} (pool size {})", m_tag,
+            in_use, m_n_buffers);
+      }
+      break;
+    }
+  }
+}
+
+std::vector<uint8_t>* openhd::BufferPool::acquire() {
+  auto ret = try_pop();
+  if (ret) {
+    m_n_hits.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    m_n_misses.fetch_add(1, std::memory_order_relaxed);
+    ret = new_buffer();
+  }
+  on_acquired();
+  return ret;
+}
+
+void openhd::BufferPool::release(std::vector<uint8_t>* buffer) {
+  m_n_in_use.fetch_sub(1, std::memory_order_relaxed);
+  // Don't keep buffers around that have grown way beyond the configured size
+  if (buffer->capacity() > m_buffer_size * 2) {
+    delete_buffer(buffer);
+    return;
+  }
+  buffer->clear();
+  // Buffers allocated on a miss are kept as well, as long as there is space
+  if (!try_push(buffer)) {
+    delete_buffer(buffer);
+  }
+}
+
+std::shared_ptr<std::vector<uint8_t>> openhd::BufferPool::get_buffer() {
+  return adopt(acquire());
+}
+
+std::shared_ptr<std::vector<uint8_t>> openhd::BufferPool::adopt(
+    std::vector<uint8_t>* buffer) {
+  // Released by the allocator, see ControlBlockAllocator
+  return std::shared_ptr<std::vector<uint8_t>>(
+      buffer, [](std::vector<uint8_t>* /*buffer*/) {},
+      ControlBlockAllocator<std::vector<uint8_t>>(
+          shared_from_this(), reinterpret_cast<Slot*>(buffer)));
+}
+
+std::shared_ptr<std::vector<uint8_t>> openhd::BufferPool::get_buffer_and_copy(
+    const uint8_t* data, std::size_t data_len) {
+  auto ret = get_buffer();
+  ret->assign(data, data + data_len);
+  return ret;
+}
+
+openhd::BufferPool::Stats openhd::BufferPool::get_stats() const {
+  return Stats{m_n_hits.load(), m_n_misses.load(), m_n_in_use.load(),
+               m_high_water_mark.load()};
+}
+
+const std::shared_ptr<openhd::BufferPool>& openhd::BufferPool::video() {
+  // Enough for a couple of high bitrate frames in flight (appsink fragments,
+  // lib rtp packetization, ground jitter buffer).
+  static const auto instance = BufferPool::create("video", 1500, 1024);
+  return instance;
+}
+
+const std::shared_ptr<openhd::BufferPool>& openhd::BufferPool::telemetry() {
+  // Telemetry is aggregated into packets of max 1024 bytes
+  static const auto instance = BufferPool::create("telemetry", 1024, 64);
+  return instance;
+}
@@ -80,6 +80,14 @@ static openhd::Config load_or_default() {
         r.GetVector<std::string>("network", "NW_MANUAL_FORWARDING_IPS");//手动转发的 IP 列表
     ret.NW_FORWARD_TO_LOCALHOST_58XX =
         r.Get<bool>("network", "NW_FORWARD_TO_LOCALHOST_58XX", false);//是否将流量转发到 localhost:58XX 端口
+    ret.NW_FORWARD_VIDEO_UDP_GSO =
+        r.Get<bool>("network", "NW_FORWARD_VIDEO_UDP_GSO", false);//视频转发时是否使用 UDP GSO
+    ret.NW_VIDEO_JITTER_BUFFER_MS =
+        r.Get<int>("network", "NW_VIDEO_JITTER_BUFFER_MS", -1);//地面端 rtp 抖动缓冲（毫秒），-1 禁用
+    ret.NW_VIDEO_JITTER_BUFFER_WHOLE_FRAMES =
+        r.Get<bool>("network", "NW_VIDEO_JITTER_BUFFER_WHOLE_FRAMES", false);//抖动缓冲是否按整帧输出
+    ret.NW_VIDEO_SHM_OUTPUT =
+        r.Get<bool>("network", "NW_VIDEO_SHM_OUTPUT", false);//通过共享内存向本地应用输出视频
 
     // Parse Ethernet link configuration
     // 以太网连接配置
@@ -91,6 +99,8 @@ static openhd::Config load_or_default() {
     ret.VIDEO_PORT = r.Get<int>("ethernet", "VIDEO_PORT", 5000);//视频传输端口，默认 5000
     std::cout << "DEBUG: VIDEO_PORT: " << ret.VIDEO_PORT << std::endl;
     ret.TELEMETRY_PORT = r.Get<int>("ethernet", "TELEMETRY_PORT", 5600);//遥测数据端口，默认 5600
+    ret.VIDEO_FEC_PERCENTAGE = r.Get<int>("ethernet", "VIDEO_FEC_PERCENTAGE", 0);//视频 FEC 冗余百分比，0 禁用
+    ret.VIDEO_FEC_BLOCK_SIZE = r.Get<int>("ethernet", "VIDEO_FEC_BLOCK_SIZE", 32);//每个 FEC 块最多的分片数
     std::cout << "DEBUG: TELEMETRY_PORT: " << ret.TELEMETRY_PORT << std::endl;
 
     // Parse Ethernet link Microhard configuration
@@ -138,6 +148,22 @@ static openhd::Config load_or_default() {
     ret.GEN_RF_METRICS_LEVEL = r.Get<int>("generic", "GEN_RF_METRICS_LEVEL", 0);
     ret.GEN_NO_QOPENHD_AUTOSTART =
         r.Get<bool>("generic", "GEN_NO_QOPENHD_AUTOSTART", false);
+    ret.GEN_ENABLE_FRAME_TRACING =
+        r.Get<bool>("generic", "GEN_ENABLE_FRAME_TRACING", false);
+    ret.GEN_ENABLE_TLOG = r.Get<bool>("generic", "GEN_ENABLE_TLOG", false);
+    ret.GEN_TLOG_FILE_SIZE_MB =
+        r.Get<int>("generic", "GEN_TLOG_FILE_SIZE_MB", 32);
+    // 0 / negative would rotate on every write (or overflow the byte size)
+    if (ret.GEN_TLOG_FILE_SIZE_MB < 1) {
+      std::cerr << "WARNING: GEN_TLOG_FILE_SIZE_MB "
+                << ret.GEN_TLOG_FILE_SIZE_MB << " is invalid, using 1"
+                << std::endl;
+      ret.GEN_TLOG_FILE_SIZE_MB = 1;
+    }
+    ret.GEN_EMULATED_LINK_PROFILE =
+        r.Get<std::string>("generic", "GEN_EMULATED_LINK_PROFILE", "");
+    ret.GEN_EMULATED_LINK_SOCKET = r.Get<std::string>(
+        "generic", "GEN_EMULATED_LINK_SOCKET", "/tmp/openhd_emulated_link");
 
     return ret;
   } catch (std::exception& exception) {
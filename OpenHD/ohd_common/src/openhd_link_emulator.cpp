@@ -0,0 +1,494 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "openhd_link_emulator.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <sstream>
+
+namespace {
+
+openhd::LinkImpairment preset_good() {
+  openhd::LinkImpairment ret{};
+  ret.bandwidth_kbits = 16000;
+  ret.delay_ms = 3;
+  ret.jitter_ms = 1;
+  ret.loss_perc = 0.5;
+  return ret;
+}
+
+openhd::LinkImpairment preset_marginal() {
+  openhd::LinkImpairment ret{};
+  ret.bandwidth_kbits = 8000;
+  ret.delay_ms = 5;
+  ret.jitter_ms = 4;
+  ret.loss_perc = 2;
+  ret.burst_enter_perc = 1;
+  ret.burst_exit_perc = 30;
+  ret.burst_loss_perc = 50;
+  ret.reorder_perc = 1;
+  return ret;
+}
+
+openhd::LinkImpairment preset_bad() {
+  openhd::LinkImpairment ret{};
+  ret.bandwidth_kbits = 4000;
+  ret.delay_ms = 10;
+  ret.jitter_ms = 10;
+  ret.loss_perc = 5;
+  ret.burst_enter_perc = 3;
+  ret.burst_exit_perc = 20;
+  ret.burst_loss_perc = 80;
+  ret.reorder_perc = 3;
+  return ret;
+}
+
+// Rare, long outages (e.g. flying behind an obstacle)
+openhd::LinkImpairment preset_burst() {
+  openhd::LinkImpairment ret{};
+  ret.delay_ms = 3;
+  ret.burst_enter_perc = 0.2;
+  ret.burst_exit_perc = 2;
+  ret.burst_loss_perc = 100;
+  return ret;
+}
+
+std::vector<std::string> split(const std::string& s, char delimiter) {
+  std::vector<std::string> ret;
+  std::stringstream ss(s);
+  std::string item;
+  while (std::getline(ss, item, delimiter)) {
+    if (!item.empty()) ret.push_back(item);
+  }
+  return ret;
+}
+
+}  // namespace
+
+std::optional<openhd::LinkImpairment> openhd::LinkImpairment::from_string(
+    const std::string& profile) {
+  const std::map<std::string, LinkImpairment> presets = {
+      {"ideal", LinkImpairment{}},
+      {"good", preset_good()},
+      {"marginal", preset_marginal()},
+      {"bad", preset_bad()},
+      {"burst", preset_burst()}};
+  LinkImpairment ret{};
+  const auto tokens = split(profile, ',');
+  for (std::size_t i = 0; i < tokens.size(); i++) {
+    const auto& token = tokens[i];
+    const auto pos = token.find('=');
+    if (pos == std::string::npos) {
+      // Only the first token may be a preset
+      if (i != 0 || presets.count(token) == 0) return std::nullopt;
+      ret = presets.at(token);
+      continue;
+    }
+    const std::string key = token.substr(0, pos);
+    double value;
+    try {
+      value = std::stod(token.substr(pos + 1));
+    } catch (...) {
+      return std::nullopt;
+    }
+    if (value < 0) return std::nullopt;
+    if (key == "bw") {
+      ret.bandwidth_kbits = static_cast<int>(value);
+    } else if (key == "queue") {
+      ret.max_queue_ms = static_cast<int>(value);
+    } else if (key == "delay") {
+      ret.delay_ms = static_cast<int>(value);
+    } else if (key == "jitter") {
+      ret.jitter_ms = static_cast<int>(value);
+    } else if (key == "loss") {
+      ret.loss_perc = value;
+    } else if (key == "burst_enter") {
+      ret.burst_enter_perc = value;
+    } else if (key == "burst_exit") {
+      ret.burst_exit_perc = value;
+    } else if (key == "burst_loss") {
+      ret.burst_loss_perc = value;
+    } else if (key == "reorder") {
+      ret.reorder_perc = value;
+    } else if (key == "reorder_extra") {
+      ret.reorder_extra_ms = static_cast<int>(value);
+    } else if (key == "seed") {
+      ret.seed = static_cast<uint32_t>(value);
+    } else {
+      return std::nullopt;
+    }
+  }
+  return ret;
+}
+
+std::string openhd::LinkImpairment::to_string() const {
+  std::stringstream ss;
+  ss << "bw=" << bandwidth_kbits << ",queue=" << max_queue_ms
+     << ",delay=" << delay_ms << ",jitter=" << jitter_ms
+     << ",loss=" << loss_perc << ",burst_enter=" << burst_enter_perc
+     << ",burst_exit=" << burst_exit_perc << ",burst_loss=" << burst_loss_perc
+     << ",reorder=" << reorder_perc << ",reorder_extra=" << reorder_extra_ms
+     << ",seed=" << seed;
+  return ss.str();
+}
+
+std::string openhd::EmulatedChannelStats::to_string() const {
+  std::stringstream ss;
+  ss << "EmulatedChannelStats{packets:" << n_packets
+     << " delivered:" << n_delivered << " lost:" << n_lost
+     << " queue_dropped:" << n_queue_dropped << " reordered:" << n_reordered
+     << " bytes:" << bytes_delivered << "}";
+  return ss.str();
+}
+
+openhd::EmulatedChannel::EmulatedChannel(LinkImpairment impairment,
+                                         DELIVER_CB cb)
+    : m_impairment(impairment), m_cb(std::move(cb)), m_rng(impairment.seed) {
+  m_thread = std::thread(&EmulatedChannel::loop_deliver, this);
+}
+
+openhd::EmulatedChannel::~EmulatedChannel() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_cv.notify_all();
+  m_thread.join();
+}
+
+bool openhd::EmulatedChannel::is_lost() {
+  std::uniform_real_distribution<double> dist(0, 100);
+  // Gilbert-Elliott
+  if (m_burst_state) {
+    if (dist(m_rng) < m_impairment.burst_exit_perc) m_burst_state = false;
+  } else {
+    if (dist(m_rng) < m_impairment.burst_enter_perc) m_burst_state = true;
+  }
+  const double loss_perc =
+      m_burst_state ? m_impairment.burst_loss_perc : m_impairment.loss_perc;
+  return dist(m_rng) < loss_perc;
+}
+
+void openhd::EmulatedChannel::send(EmulatedPacketType type,
+                                   const uint8_t* data, int data_len,
+                                   int n_injections) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_stats.n_packets++;
+  const auto now = std::chrono::steady_clock::now();
+  std::optional<TIME_POINT> arrival;
+  bool any_queued = false;
+  for (int i = 0; i < std::max(n_injections, 1); i++) {
+    TIME_POINT tx_done = now;
+    if (m_impairment.bandwidth_kbits > 0) {
+      const auto tx_begin = std::max(now, m_tx_free_at);
+      if (tx_begin - now > std::chrono::milliseconds(m_impairment.max_queue_ms)) {
+        continue;
+      }
+      // kbit/s == bit/ms
+      tx_done = tx_begin + std::chrono::microseconds(
+                               static_cast<int64_t>(data_len) * 8 * 1000 /
+                               m_impairment.bandwidth_kbits);
+      m_tx_free_at = tx_done;
+    }
+    any_queued = true;
+    // Each injection uses air time, even if an earlier one already made it
+    if (!is_lost() && !arrival.has_value()) arrival = tx_done;
+  }
+  if (!arrival.has_value()) {
+    if (any_queued) {
+      m_stats.n_lost++;
+    } else {
+      m_stats.n_queue_dropped++;
+    }
+    return;
+  }
+  auto deliver_at =
+      arrival.value() + std::chrono::milliseconds(m_impairment.delay_ms);
+  if (m_impairment.jitter_ms > 0) {
+    std::uniform_int_distribution<int> jitter_us(
+        0, m_impairment.jitter_ms * 1000);
+    deliver_at += std::chrono::microseconds(jitter_us(m_rng));
+  }
+  std::uniform_real_distribution<double> dist(0, 100);
+  if (m_impairment.reorder_perc > 0 &&
+      dist(m_rng) < m_impairment.reorder_perc) {
+    deliver_at += std::chrono::milliseconds(m_impairment.reorder_extra_ms);
+  } else {
+    // Jitter alone doesn't reorder (like a real link with a single queue)
+    deliver_at = std::max(deliver_at, m_last_in_order_deliver_at);
+    m_last_in_order_deliver_at = deliver_at;
+  }
+  m_packets.push(Packet{deliver_at, ++m_seq, type,
+                        std::vector<uint8_t>(data, data + data_len)});
+  m_cv.notify_one();
+}
+
+openhd::EmulatedChannelStats openhd::EmulatedChannel::get_stats() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_stats;
+}
+
+void openhd::EmulatedChannel::loop_deliver() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (!m_stop) {
+    if (m_packets.empty()) {
+      m_cv.wait(lock);
+      continue;
+    }
+    const auto deliver_at = m_packets.top().deliver_at;
+    if (deliver_at > std::chrono::steady_clock::now()) {
+      m_cv.wait_until(lock, deliver_at);
+      continue;
+    }
+    Packet packet = std::move(const_cast<Packet&>(m_packets.top()));
+    m_packets.pop();
+    if (packet.seq < m_highest_delivered_seq) {
+      m_stats.n_reordered++;
+    } else {
+      m_highest_delivered_seq = packet.seq;
+    }
+    m_stats.n_delivered++;
+    m_stats.bytes_delivered += packet.data.size();
+    lock.unlock();
+    m_cb(packet.type, packet.data.data(), static_cast<int>(packet.data.size()));
+    lock.lock();
+  }
+}
+
+openhd::EmulatedLink::EmulatedLink(bool is_air,
+                                   const LinkImpairment& tx_impairment)
+    : m_is_air(is_air) {
+  m_console = openhd::log::create_or_get("emulated_link");
+  m_console->info("Emulated link {} tx impairment {}",
+                  m_is_air ? "air" : "ground", tx_impairment.to_string());
+}
+
+openhd::EmulatedLink::~EmulatedLink() {
+  if (m_unix_run) {
+    m_unix_run = false;
+    m_unix_thread.join();
+  }
+  if (m_tx_channel) {
+    m_console->debug("{} tx {}", m_is_air ? "air" : "ground",
+                     m_tx_channel->get_stats().to_string());
+    m_tx_channel.reset();
+  }
+  const int fd = m_fd_connected.exchange(-1);
+  if (fd >= 0) close(fd);
+  if (m_fd_listen >= 0) {
+    close(m_fd_listen);
+    unlink(m_socket_path.c_str());
+  }
+}
+
+std::pair<std::shared_ptr<openhd::EmulatedLink>,
+          std::shared_ptr<openhd::EmulatedLink>>
+openhd::EmulatedLink::create_pair(const LinkImpairment& air_to_ground,
+                                  const LinkImpairment& ground_to_air) {
+  std::shared_ptr<EmulatedLink> air(new EmulatedLink(true, air_to_ground));
+  std::shared_ptr<EmulatedLink> ground(new EmulatedLink(false, ground_to_air));
+  // weak - no reference cycle between the two ends
+  std::weak_ptr<EmulatedLink> weak_air = air;
+  std::weak_ptr<EmulatedLink> weak_ground = ground;
+  air->m_tx_channel = std::make_unique<EmulatedChannel>(
+      air_to_ground, [weak_ground](EmulatedPacketType type, const uint8_t* data,
+                                   int data_len) {
+        if (auto ground = weak_ground.lock()) {
+          ground->on_receive(type, data, data_len);
+        }
+      });
+  ground->m_tx_channel = std::make_unique<EmulatedChannel>(
+      ground_to_air, [weak_air](EmulatedPacketType type, const uint8_t* data,
+                                int data_len) {
+        if (auto air = weak_air.lock()) {
+          air->on_receive(type, data, data_len);
+        }
+      });
+  return {air, ground};
+}
+
+std::shared_ptr<openhd::EmulatedLink> openhd::EmulatedLink::create_unix(
+    bool is_air, const std::string& path,
+    const LinkImpairment& tx_impairment) {
+  std::shared_ptr<EmulatedLink> ret(new EmulatedLink(is_air, tx_impairment));
+  sockaddr_un addr{};
+  if (path.size() >= sizeof(addr.sun_path)) {
+    ret->m_console->warn("Socket path {} too long", path);
+    return nullptr;
+  }
+  ret->m_socket_path = path;
+  if (!is_air) {
+    ret->m_fd_listen =
+        socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    // Left over from a previous run
+    unlink(path.c_str());
+    if (ret->m_fd_listen < 0 ||
+        bind(ret->m_fd_listen, reinterpret_cast<sockaddr*>(&addr),
+             sizeof(addr)) != 0 ||
+        listen(ret->m_fd_listen, 1) != 0) {
+      ret->m_console->warn("Cannot listen on {}: {}", path, strerror(errno));
+      return nullptr;
+    }
+  }
+  // The channel and the socket thread only use the raw pointer, both are
+  // stopped in the destructor
+  EmulatedLink* self = ret.get();
+  ret->m_tx_channel = std::make_unique<EmulatedChannel>(
+      tx_impairment,
+      [self](EmulatedPacketType type, const uint8_t* data, int data_len) {
+        self->send_unix(type, data, data_len);
+      });
+  ret->m_unix_run = true;
+  ret->m_unix_thread = std::thread(&EmulatedLink::loop_unix, self);
+  return ret;
+}
+
+void openhd::EmulatedLink::transmit_telemetry_data(TelemetryTxPacket packet) {
+  m_tx_channel->send(EmulatedPacketType::TELEMETRY, packet.data->data(),
+                     static_cast<int>(packet.data->size()),
+                     packet.n_injections);
+}
+
+void openhd::EmulatedLink::transmit_video_data(
+    int stream_index,
+    const openhd::FragmentedVideoFrame& fragmented_video_frame) {
+  const auto type = stream_index == 0 ? EmulatedPacketType::VIDEO_PRIMARY
+                                      : EmulatedPacketType::VIDEO_SECONDARY;
+  if (fragmented_video_frame.rtp_fragments.empty() &&
+      fragmented_video_frame.dirty_frame) {
+    const auto& frame = *fragmented_video_frame.dirty_frame;
+    m_tx_channel->send(type, frame.data(), static_cast<int>(frame.size()));
+    return;
+  }
+  for (const auto& fragment : fragmented_video_frame.rtp_fragments) {
+    m_tx_channel->send(type, fragment->data(),
+                       static_cast<int>(fragment->size()));
+  }
+}
+
+void openhd::EmulatedLink::transmit_audio_data(
+    const openhd::AudioPacket& audio_packet) {
+  m_tx_channel->send(EmulatedPacketType::AUDIO, audio_packet.data->data(),
+                     static_cast<int>(audio_packet.data->size()));
+}
+
+openhd::EmulatedChannelStats openhd::EmulatedLink::get_tx_stats() {
+  return m_tx_channel->get_stats();
+}
+
+void openhd::EmulatedLink::on_receive(EmulatedPacketType type,
+                                      const uint8_t* data, int data_len) {
+  switch (type) {
+    case EmulatedPacketType::TELEMETRY:
+      on_receive_telemetry_data(
+          std::make_shared<std::vector<uint8_t>>(data, data + data_len));
+      break;
+    case EmulatedPacketType::VIDEO_PRIMARY:
+      on_receive_video_data(0, data, data_len);
+      break;
+    case EmulatedPacketType::VIDEO_SECONDARY:
+      on_receive_video_data(1, data, data_len);
+      break;
+    case EmulatedPacketType::AUDIO:
+      on_receive_audio_data(data, data_len);
+      break;
+  }
+}
+
+void openhd::EmulatedLink::send_unix(EmulatedPacketType type,
+                                     const uint8_t* data, int data_len) {
+  std::lock_guard<std::mutex> lock(m_send_mutex);
+  const int fd = m_fd_connected;
+  // Not connected - lost, like with a radio
+  if (fd < 0) return;
+  // One message per packet, the first byte is the type
+  uint8_t header = static_cast<uint8_t>(type);
+  iovec iov[2];
+  iov[0].iov_base = &header;
+  iov[0].iov_len = 1;
+  iov[1].iov_base = const_cast<uint8_t*>(data);
+  iov[1].iov_len = data_len;
+  msghdr msg{};
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 2;
+  if (sendmsg(fd, &msg, MSG_NOSIGNAL) < 0) {
+    m_console->debug("sendmsg failed: {}", strerror(errno));
+  }
+}
+
+bool openhd::EmulatedLink::connect_or_accept() {
+  if (!m_is_air) {
+    pollfd pfd{m_fd_listen, POLLIN, 0};
+    if (poll(&pfd, 1, 100) <= 0) return false;
+    const int fd = accept4(m_fd_listen, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) return false;
+    m_fd_connected = fd;
+    m_console->info("Air connected");
+    return true;
+  }
+  const int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, m_socket_path.c_str(), sizeof(addr.sun_path) - 1);
+  if (fd < 0 ||
+      connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+    if (fd >= 0) close(fd);
+    // Ground not running (yet)
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    return false;
+  }
+  m_fd_connected = fd;
+  m_console->info("Connected to ground {}", m_socket_path);
+  return true;
+}
+
+void openhd::EmulatedLink::loop_unix() {
+  std::vector<uint8_t> buff(64 * 1024);
+  while (m_unix_run) {
+    if (m_fd_connected < 0) {
+      connect_or_accept();
+      continue;
+    }
+    pollfd pfd{m_fd_connected, POLLIN, 0};
+    if (poll(&pfd, 1, 100) <= 0) continue;
+    const ssize_t n = recv(m_fd_connected, buff.data(), buff.size(), 0);
+    if (n <= 0) {
+      m_console->info("Other end disconnected");
+      std::lock_guard<std::mutex> lock(m_send_mutex);
+      close(m_fd_connected.exchange(-1));
+      continue;
+    }
+    if (n < 2) continue;
+    on_receive(static_cast<EmulatedPacketType>(buff[0]), buff.data() + 1,
+               static_cast<int>(n - 1));
+  }
+}
@@ -0,0 +1,446 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "openhd_netlink.h"
+
+#include <arpa/inet.h>
+#include <linux/if.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace {
+
+std::string ip_to_string(int family, const void* data) {
+  char buf[INET6_ADDRSTRLEN] = {};
+  if (inet_ntop(family, data, buf, sizeof(buf)) == nullptr) return "";
+  return buf;
+}
+
+// Same as the "ip route" key for replace / delete in the main table
+bool is_same_route(const openhd::NetlinkRoute& a,
+                   const openhd::NetlinkRoute& b) {
+  return a.dst == b.dst && a.dst_len == b.dst_len && a.metric == b.metric &&
+         a.ifindex == b.ifindex;
+}
+
+}  // namespace
+
+bool openhd::NetlinkLink::is_up() const { return operstate == IF_OPER_UP; }
+
+openhd::NetlinkCache& openhd::NetlinkCache::instance() {
+  static NetlinkCache instance{};
+  return instance;
+}
+
+openhd::NetlinkCache::NetlinkCache() {
+  m_console = openhd::log::create_or_get("netlink");
+  m_rx_buffer.resize(64 * 1024);
+  m_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+  if (m_fd < 0) {
+    m_console->warn("Cannot open netlink socket: {}", strerror(errno));
+    return;
+  }
+  // A burst of changes (e.g. an interface with many routes going away) must
+  // not overflow - if it does anyways, we re-sync.
+  const int rcvbuf = 1024 * 1024;
+  setsockopt(m_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+  struct sockaddr_nl addr {};
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR |
+                   RTMGRP_IPV4_ROUTE;
+  if (bind(m_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) !=
+      0) {
+    m_console->warn("Cannot bind netlink socket: {}", strerror(errno));
+    close(m_fd);
+    m_fd = -1;
+    return;
+  }
+  // Subscribed before the dump, such that nothing in between gets lost
+  resync();
+  m_wakeup_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  m_thread = std::make_unique<std::thread>([this]() { loop(); });
+}
+
+openhd::NetlinkCache::~NetlinkCache() {
+  m_terminate = true;
+  if (m_wakeup_fd >= 0) {
+    const uint64_t one = 1;
+    const auto unused = write(m_wakeup_fd, &one, sizeof(one));
+    (void)unused;
+  }
+  if (m_thread && m_thread->joinable()) {
+    m_thread->join();
+  }
+  m_thread = nullptr;
+  if (m_wakeup_fd >= 0) close(m_wakeup_fd);
+  if (m_fd >= 0) close(m_fd);
+}
+
+bool openhd::NetlinkCache::request_dump(int type, int family) {
+  struct {
+    struct nlmsghdr nh;
+    struct rtgenmsg gen;
+  } req{};
+  req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtgenmsg));
+  req.nh.nlmsg_type = type;
+  req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  req.nh.nlmsg_seq = ++m_seq;
+  req.gen.rtgen_family = family;
+  struct sockaddr_nl kernel {};
+  kernel.nl_family = AF_NETLINK;
+  if (sendto(m_fd, &req, req.nh.nlmsg_len, 0,
+             reinterpret_cast<struct sockaddr*>(&kernel),
+             sizeof(kernel)) < 0) {
+    m_console->warn("netlink dump request failed: {}", strerror(errno));
+    return false;
+  }
+  return receive(true);
+}
+
+bool openhd::NetlinkCache::receive(bool dump) {
+  while (true) {
+    const ssize_t len = recv(m_fd, m_rx_buffer.data(), m_rx_buffer.size(),
+                             dump ? 0 : MSG_DONTWAIT);
+    if (len < 0) {
+      if (errno == EINTR) continue;
+      if (!dump && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+      if (errno == ENOBUFS) {
+        // The kernel dropped notifications, our state is stale
+        m_console->warn("netlink overrun, re-sync");
+        if (dump) return false;
+        resync();
+        return true;
+      }
+      m_console->warn("netlink recv failed: {}", strerror(errno));
+      return false;
+    }
+    int remaining = static_cast<int>(len);
+    for (auto nh = reinterpret_cast<const struct nlmsghdr*>(m_rx_buffer.data());
+         NLMSG_OK(nh, remaining); nh = NLMSG_NEXT(nh, remaining)) {
+      const bool is_dump_reply = nh->nlmsg_seq == m_seq && nh->nlmsg_pid != 0;
+      if (nh->nlmsg_type == NLMSG_DONE) {
+        if (dump && is_dump_reply) return true;
+        continue;
+      }
+      if (nh->nlmsg_type == NLMSG_ERROR) {
+        const auto err = static_cast<const struct nlmsgerr*>(NLMSG_DATA(nh));
+        if (dump && is_dump_reply) {
+          m_console->warn("netlink dump error: {}", strerror(-err->error));
+          return false;
+        }
+        continue;
+      }
+      process_message(nh);
+    }
+  }
+}
+
+void openhd::NetlinkCache::process_message(const struct nlmsghdr* nh) {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  switch (nh->nlmsg_type) {
+    case RTM_NEWLINK:
+    case RTM_DELLINK: {
+      const auto ifi = static_cast<const struct ifinfomsg*>(NLMSG_DATA(nh));
+      if (nh->nlmsg_type == RTM_DELLINK) {
+        m_links.erase(ifi->ifi_index);
+        // The kernel usually reports these itself, but not always for routes
+        const auto same_ifindex = [ifi](const auto& x) {
+          return x.ifindex == ifi->ifi_index;
+        };
+        m_addresses.erase(std::remove_if(m_addresses.begin(),
+                                         m_addresses.end(), same_ifindex),
+                          m_addresses.end());
+        m_routes.erase(
+            std::remove_if(m_routes.begin(), m_routes.end(), same_ifindex),
+            m_routes.end());
+        break;
+      }
+      // RTM_NEWLINK is also sent for changes, only with the changed attributes
+      auto& link = m_links[ifi->ifi_index];
+      link.ifindex = ifi->ifi_index;
+      link.flags = ifi->ifi_flags;
+      int attr_len = IFLA_PAYLOAD(nh);
+      for (auto rta = IFLA_RTA(ifi); RTA_OK(rta, attr_len);
+           rta = RTA_NEXT(rta, attr_len)) {
+        if (rta->rta_type == IFLA_IFNAME) {
+          link.name = static_cast<const char*>(RTA_DATA(rta));
+        } else if (rta->rta_type == IFLA_OPERSTATE) {
+          link.operstate = *static_cast<const uint8_t*>(RTA_DATA(rta));
+        }
+      }
+      break;
+    }
+    case RTM_NEWADDR:
+    case RTM_DELADDR: {
+      const auto ifa = static_cast<const struct ifaddrmsg*>(NLMSG_DATA(nh));
+      NetlinkAddress address{};
+      address.ifindex = static_cast<int>(ifa->ifa_index);
+      address.family = ifa->ifa_family;
+      address.prefix_len = ifa->ifa_prefixlen;
+      int attr_len = IFA_PAYLOAD(nh);
+      std::string ifa_address;
+      for (auto rta = IFA_RTA(ifa); RTA_OK(rta, attr_len);
+           rta = RTA_NEXT(rta, attr_len)) {
+        // On point to point links IFA_ADDRESS is the peer, IFA_LOCAL ours
+        if (rta->rta_type == IFA_LOCAL) {
+          address.ip = ip_to_string(ifa->ifa_family, RTA_DATA(rta));
+        } else if (rta->rta_type == IFA_ADDRESS) {
+          ifa_address = ip_to_string(ifa->ifa_family, RTA_DATA(rta));
+        }
+      }
+      if (address.ip.empty()) address.ip = ifa_address;
+      if (address.ip.empty()) return;
+      m_addresses.erase(
+          std::remove_if(m_addresses.begin(), m_addresses.end(),
+                         [&address](const NetlinkAddress& x) {
+                           return x.ifindex == address.ifindex &&
+                                  x.ip == address.ip;
+                         }),
+          m_addresses.end());
+      if (nh->nlmsg_type == RTM_NEWADDR) m_addresses.push_back(address);
+      break;
+    }
+    case RTM_NEWROUTE:
+    case RTM_DELROUTE: {
+      const auto rtm = static_cast<const struct rtmsg*>(NLMSG_DATA(nh));
+      if (rtm->rtm_family != AF_INET) return;
+      uint32_t table = rtm->rtm_table;
+      NetlinkRoute route{};
+      route.dst_len = rtm->rtm_dst_len;
+      int attr_len = RTM_PAYLOAD(nh);
+      for (auto rta = RTM_RTA(rtm); RTA_OK(rta, attr_len);
+           rta = RTA_NEXT(rta, attr_len)) {
+        switch (rta->rta_type) {
+          case RTA_TABLE:
+            table = *static_cast<const uint32_t*>(RTA_DATA(rta));
+            break;
+          case RTA_DST:
+            route.dst = ip_to_string(AF_INET, RTA_DATA(rta));
+            break;
+          case RTA_GATEWAY:
+            route.gateway = ip_to_string(AF_INET, RTA_DATA(rta));
+            break;
+          case RTA_PREFSRC:
+            route.prefsrc = ip_to_string(AF_INET, RTA_DATA(rta));
+            break;
+          case RTA_OIF:
+            route.ifindex = *static_cast<const int*>(RTA_DATA(rta));
+            break;
+          case RTA_PRIORITY:
+            route.metric = *static_cast<const uint32_t*>(RTA_DATA(rta));
+            break;
+          default:
+            break;
+        }
+      }
+      // Local / broadcast routes live in the local table, not interesting here
+      if (table != RT_TABLE_MAIN) return;
+      m_routes.erase(std::remove_if(m_routes.begin(), m_routes.end(),
+                                    [&route](const NetlinkRoute& x) {
+                                      return is_same_route(x, route);
+                                    }),
+                     m_routes.end());
+      if (nh->nlmsg_type == RTM_NEWROUTE) m_routes.push_back(route);
+      break;
+    }
+    default:
+      return;
+  }
+  m_generation++;
+  m_changed_in_batch = true;
+}
+
+void openhd::NetlinkCache::resync() {
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_links.clear();
+    m_addresses.clear();
+    m_routes.clear();
+    m_generation++;
+    m_changed_in_batch = true;
+  }
+  // One dump at a time, the kernel rejects overlapping ones
+  const bool success = request_dump(RTM_GETLINK, AF_UNSPEC) &&
+                       request_dump(RTM_GETADDR, AF_UNSPEC) &&
+                       request_dump(RTM_GETROUTE, AF_INET);
+  if (!success) {
+    m_console->warn("netlink dump failed");
+  }
+}
+
+void openhd::NetlinkCache::loop() {
+  struct pollfd fds[2] = {{m_fd, POLLIN, 0}, {m_wakeup_fd, POLLIN, 0}};
+  // Changes from the initial dump
+  on_changed();
+  while (!m_terminate) {
+    const int ret = poll(fds, 2, -1);
+    if (ret < 0) {
+      if (errno == EINTR) continue;
+      m_console->warn("netlink poll failed: {}", strerror(errno));
+      break;
+    }
+    if (m_terminate) break;
+    if (fds[0].revents & POLLIN) {
+      if (!receive(false)) {
+        // Don't spin on a broken socket
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+      }
+      on_changed();
+    }
+  }
+}
+
+void openhd::NetlinkCache::on_changed() {
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (!m_changed_in_batch) return;
+    m_changed_in_batch = false;
+  }
+  m_cv.notify_all();
+  // Called without the lock, a listener may (un)register listeners
+  std::vector<CHANGE_CALLBACK> listeners;
+  {
+    std::lock_guard<std::mutex> guard(m_listeners_mutex);
+    listeners.reserve(m_listeners.size());
+    for (const auto& listener : m_listeners) {
+      listeners.push_back(listener.second);
+    }
+  }
+  for (const auto& listener : listeners) {
+    listener();
+  }
+}
+
+std::vector<openhd::NetlinkLink> openhd::NetlinkCache::get_links() {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  std::vector<NetlinkLink> ret;
+  for (const auto& link : m_links) ret.push_back(link.second);
+  return ret;
+}
+
+std::optional<openhd::NetlinkLink> openhd::NetlinkCache::get_link(
+    const std::string& ifname) {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  for (const auto& link : m_links) {
+    if (link.second.name == ifname) return link.second;
+  }
+  return std::nullopt;
+}
+
+bool openhd::NetlinkCache::is_link_up(const std::string& ifname) {
+  const auto link = get_link(ifname);
+  return link.has_value() && link->is_up();
+}
+
+std::vector<openhd::NetlinkAddress> openhd::NetlinkCache::get_addresses() {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  return m_addresses;
+}
+
+bool openhd::NetlinkCache::is_local_address(const std::string& ip) {
+  if (ip == "127.0.0.1") return true;
+  std::lock_guard<std::mutex> guard(m_mutex);
+  return std::any_of(
+      m_addresses.begin(), m_addresses.end(),
+      [&ip](const NetlinkAddress& address) { return address.ip == ip; });
+}
+
+std::vector<openhd::NetlinkRoute> openhd::NetlinkCache::get_routes(
+    const std::string& ifname) {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  std::vector<NetlinkRoute> ret;
+  for (const auto& route : m_routes) {
+    const auto link = m_links.find(route.ifindex);
+    if (link != m_links.end() && link->second.name == ifname) {
+      ret.push_back(route);
+    }
+  }
+  return ret;
+}
+
+std::optional<std::string> openhd::NetlinkCache::get_default_gateway(
+    const std::string& ifname) {
+  std::optional<NetlinkRoute> best;
+  for (const auto& route : get_routes(ifname)) {
+    if (!route.is_default() || route.gateway.empty()) continue;
+    if (!best.has_value() || route.metric < best->metric) best = route;
+  }
+  if (!best.has_value()) return std::nullopt;
+  return best->gateway;
+}
+
+uint64_t openhd::NetlinkCache::get_generation() {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  return m_generation;
+}
+
+uint64_t openhd::NetlinkCache::wait_for_change(
+    uint64_t last_generation, std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  const uint64_t n_wakeups = m_n_wakeups;
+  // Only complete batches are visible to waiters
+  m_cv.wait_for(lock, timeout, [this, last_generation, n_wakeups]() {
+    return (m_generation != last_generation && !m_changed_in_batch) ||
+           m_n_wakeups != n_wakeups;
+  });
+  return m_generation;
+}
+
+void openhd::NetlinkCache::notify_waiters() {
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_n_wakeups++;
+  }
+  m_cv.notify_all();
+}
+
+bool openhd::NetlinkCache::wait_until(const std::function<bool()>& condition,
+                                      const std::atomic<bool>& stop) {
+  uint64_t generation = get_generation();
+  while (!stop) {
+    if (condition()) return true;
+    // The timeout is only a safety net, changes wake us up immediately
+    generation = wait_for_change(generation, std::chrono::seconds(1));
+  }
+  return false;
+}
+
+int openhd::NetlinkCache::register_listener(CHANGE_CALLBACK cb) {
+  std::lock_guard<std::mutex> guard(m_listeners_mutex);
+  const int id = m_next_listener_id++;
+  m_listeners[id] = std::move(cb);
+  return id;
+}
+
+void openhd::NetlinkCache::unregister_listener(int id) {
+  std::lock_guard<std::mutex> guard(m_listeners_mutex);
+  m_listeners.erase(id);
+}
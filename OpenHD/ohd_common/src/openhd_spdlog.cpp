@@ -23,13 +23,20 @@
 
 #include "openhd_spdlog.h"
 
+#include <spdlog/async.h>
+#include <spdlog/async_logger.h>
 #include <spdlog/common.h>
 #include <spdlog/sinks/base_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
 
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
 #include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
 
 #include "openhd_util.h"
 
@@ -90,10 +97,23 @@ void openhd::log::MavlinkLogMessageBuffer::enqueue_log_message(
     openhd::log::MavlinkLogMessage message) {
   std::lock_guard<std::mutex> lock(m_mutex);
   if (m_buffer.size() > 10) {
-    std::cerr << "Dropping log message:" << message.message << std::endl;
+    // Might be called for every log message - don't flood stderr
+    static RateLimiter limiter{1000};
+    uint32_t n_suppressed;
+    if (limiter.allow(n_suppressed)) {
+      std::cerr << "Dropping log message:" << message.message << " (+"
+                << n_suppressed << ")" << std::endl;
+    }
     return;
   }
   m_buffer.push_back(message);
+  if (m_enqueue_listener) m_enqueue_listener();
+}
+
+void openhd::log::MavlinkLogMessageBuffer::set_enqueue_listener(
+    std::function<void()> listener) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_enqueue_listener = std::move(listener);
 }
 
 openhd::log::MavlinkLogMessageBuffer&
@@ -104,33 +124,97 @@ openhd::log::MavlinkLogMessageBuffer::instance() {
 
 
 
+bool openhd::log::RateLimiter::allow(uint32_t& n_suppressed) {
+  const int64_t now_ms =
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count();
+  int64_t last_ms = m_last_ms.load(std::memory_order_relaxed);
+  if (now_ms - last_ms < m_interval_ms ||
+      !m_last_ms.compare_exchange_strong(last_ms, now_ms,
+                                         std::memory_order_relaxed)) {
+    m_n_suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  n_suppressed = m_n_suppressed.exchange(0, std::memory_order_relaxed);
+  return true;
+}
+
+namespace {
+
+std::shared_ptr<spdlog::logger> create_logger(const std::string& logger_name) {
+  // Shared by all loggers (one stdout sink also means no interleaved lines)
+  static const std::vector<spdlog::sink_ptr> sinks = {
+      std::make_shared<spdlog::sinks::stdout_color_sink_mt>(),
+      std::make_shared<openhd::log::sink::MavlinkTelemetrySink>()};
+  static const bool use_async = std::getenv("OPENHD_LOG_SYNC") == nullptr;
+  std::shared_ptr<spdlog::logger> created;
+  if (use_async) {
+    // Owned by the spdlog registry, the queue is written out on exit
+    static const bool pool_initialized = []() {
+      spdlog::init_thread_pool(openhd::log::ASYNC_QUEUE_SIZE, 1);
+      return true;
+    }();
+    (void)pool_initialized;
+    created = std::make_shared<spdlog::async_logger>(
+        logger_name, sinks.begin(), sinks.end(), spdlog::thread_pool(),
+        spdlog::async_overflow_policy::overrun_oldest);
+  } else {
+    created = std::make_shared<spdlog::logger>(logger_name, sinks.begin(),
+                                               sinks.end());
+  }
+  created->set_level(spdlog::level::warn);
+  // Errors should not get stuck in the queue
+  created->flush_on(spdlog::level::err);
+  spdlog::register_logger(created);
+  // This is for debugging for "where a fmt exception occurred"
+  // spdlog::set_error_handler([](const std::string &msg) {
+  //  std::cerr<<msg<<"\n;";
+  //});
+  return created;
+}
+
+}  // namespace
+
 /* 确保在多线程环境下，针对同一个日志记录器的操作是线程安全的。
 如果日志记录器已经存在，则返回已有的日志记录器；
-如果不存在，则创建一个新的日志记录器，设置它的级别和接收器，并返回该记录器。 */
+如果不存在，则创建一个新的日志记录器，设置它的级别和接收器，并返回该记录器。
+查找使用读写锁，已存在的日志记录器不会互相阻塞。 */
 std::shared_ptr<spdlog::logger> openhd::log::create_or_get(
     const std::string& logger_name) {
-  static std::mutex logger_mutex2{};
-  std::lock_guard<std::mutex> guard(logger_mutex2);
-  auto ret = spdlog::get(logger_name);
-  if (ret == nullptr) {
-    auto created = spdlog::stdout_color_mt(logger_name);
-    assert(created);
-    created->set_level(spdlog::level::warn);
-    // Add the sink that sends out warning or higher via UDP
-    // created->sinks().push_back(std::make_shared<openhd::log::sink::UdpTelemetrySink>());
-    created->sinks().push_back(
-        std::make_shared<openhd::log::sink::MavlinkTelemetrySink>());
-    // This is for debugging for "where a fmt exception occurred"
-    // spdlog::set_error_handler([](const std::string &msg) {
-    //  std::cerr<<msg<<"\n;";
-    //});
-    return created;
+  static std::shared_mutex cache_mutex;
+  static std::unordered_map<std::string, std::shared_ptr<spdlog::logger>> cache;
+  {
+    std::shared_lock<std::shared_mutex> lock(cache_mutex);
+    auto it = cache.find(logger_name);
+    if (it != cache.end()) return it->second;
   }
+  std::unique_lock<std::shared_mutex> lock(cache_mutex);
+  auto it = cache.find(logger_name);
+  if (it != cache.end()) return it->second;
+  // Might have been created directly via spdlog
+  auto ret = spdlog::get(logger_name);
+  if (ret == nullptr) ret = create_logger(logger_name);
+  cache[logger_name] = ret;
   return ret;
 }
 
-std::shared_ptr<spdlog::logger> openhd::log::get_default() {
-  return create_or_get("default");
+const std::shared_ptr<spdlog::logger>& openhd::log::get_default() {
+  static const auto logger = create_or_get("default");
+  return logger;
+}
+
+void openhd::log::flush_all() {
+  spdlog::apply_all(
+      [](const std::shared_ptr<spdlog::logger>& logger) { logger->flush(); });
+  // Async flush only queues the request - wait (bounded) until it went through
+  auto pool = spdlog::thread_pool();
+  if (pool == nullptr) return;
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(1);
+  while (pool->queue_size() > 0 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
 }
 
 void openhd::log::log_via_mavlink(int level, std::string message) {
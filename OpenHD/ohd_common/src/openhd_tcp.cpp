@@ -24,53 +24,78 @@
 #include "openhd_tcp.h"
 
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
 #include <unistd.h>
 
 #include <csignal>
-#include <queue>
+#include <cstring>
 #include <utility>
 
+// Max. iovecs (queued messages) per sendmsg
+static constexpr int MAX_IOV_PER_WRITE = 64;
+static constexpr int MAX_EPOLL_EVENTS = 64;
+
 openhd::TCPServer::TCPServer(const std::string tag,
                              openhd::TCPServer::Config config, bool debug)
     : m_config(config), m_debug(debug) {
   m_console = openhd::log::create_or_get(tag);
   assert(m_console);
-  m_accept_thread =
-      std::make_unique<std::thread>(&TCPServer::loop_accept, this);
+  m_read_buffer.resize(READ_BUFF_SIZE);
+  // Listening before the constructor returns - a client can connect right away
+  if (!setup_server_socket()) {
+    return;
+  }
+  m_reactor_thread =
+      std::make_unique<std::thread>(&TCPServer::loop_reactor, this);
   m_console->debug("created with {}", m_config.port);
 }
 
 openhd::TCPServer::~TCPServer() {
   // debug_if("TCPEndpoint::~TCPEndpoint() begin");
-  //  First we make sure we don't accept any new connections anymore
-  m_keep_accept_thread_alive = false;
-  shutdown(server_fd, SHUT_RDWR);  // This will break out of select
-  m_accept_thread->join();
-  m_accept_thread = nullptr;
-  server_fd = 0;
+  //  First we make sure the reactor doesn't accept / serve anything anymore
+  m_keep_reactor_alive = false;
+  if (m_wakeup_fd >= 0) {
+    const uint64_t one = 1;
+    const auto unused = write(m_wakeup_fd, &one, sizeof(one));
+    (void)unused;
+  }
+  if (m_reactor_thread) {
+    m_reactor_thread->join();
+    m_reactor_thread = nullptr;
+  }
   // Then we make sure to clean up any connected client(s) (If there are any)
-  for (const auto& client : m_clients_list) {
-    client->marked_to_be_removed = true;
-    client->keep_rx_looping = false;
-    shutdown(client->sock_fd, SHUT_RDWR);
-    client->rx_loop_thread->join();
-    client->rx_loop_thread = nullptr;
+  {
+    std::lock_guard<std::mutex> guard(m_clients_list_mutex);
+    for (const auto& [sock_fd, client] : m_clients_list) {
+      shutdown(sock_fd, SHUT_RDWR);
+      close(sock_fd);
+    }
+    m_clients_list.clear();
   }
+  if (server_fd >= 0) close(server_fd);
+  if (m_epoll_fd >= 0) close(m_epoll_fd);
+  if (m_wakeup_fd >= 0) close(m_wakeup_fd);
   m_console->debug("TCPEndpoint::~TCPEndpoint() end");
 }
 
-void openhd::TCPServer::loop_accept() {
+bool openhd::TCPServer::setup_server_socket() {
   struct sockaddr_in sockaddr {};
-  if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+  if ((server_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                          0)) < 0) {
     m_console->warn("open socket failed");
-    return;
+    return false;
   }
+  // SO_REUSEADDR only - SO_REUSEPORT would silently let a second instance
+  // share the port
   int opt = 1;
-  if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &opt,
-                 sizeof(opt))) {
+  if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt))) {
     m_console->warn("setsockopt failed");
     close(server_fd);
-    return;
+    server_fd = -1;
+    return false;
   }
   sockaddr.sin_family = AF_INET;
   sockaddr.sin_addr.s_addr = INADDR_ANY;
@@ -78,23 +103,111 @@ void openhd::TCPServer::loop_accept() {
   if (bind(server_fd, (struct sockaddr*)&sockaddr, sizeof(sockaddr)) < 0) {
     m_console->warn("bind failed");
     close(server_fd);
-    return;
+    server_fd = -1;
+    return false;
   }
   // signal readiness to accept clients
-  if (listen(server_fd, 5) < 0) {
+  if (listen(server_fd, 16) < 0) {
     m_console->warn("listen failed");
     close(server_fd);
-    return;
+    server_fd = -1;
+    return false;
+  }
+  m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  m_wakeup_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (m_epoll_fd < 0 || m_wakeup_fd < 0) {
+    m_console->warn("epoll / eventfd failed {}", strerror(errno));
+    return false;
+  }
+  struct epoll_event ev {};
+  ev.events = EPOLLIN;
+  ev.data.fd = server_fd;
+  epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, server_fd, &ev);
+  ev.data.fd = m_wakeup_fd;
+  epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_wakeup_fd, &ev);
+  return true;
+}
+
+void openhd::TCPServer::loop_reactor() {
+  struct epoll_event events[MAX_EPOLL_EVENTS];
+  while (m_keep_reactor_alive) {
+    const int n_events =
+        epoll_wait(m_epoll_fd, events, MAX_EPOLL_EVENTS, 1000);
+    if (n_events < 0) {
+      if (errno == EINTR) continue;
+      m_console->warn("epoll_wait failed {}", strerror(errno));
+      return;
+    }
+    for (int i = 0; i < n_events; i++) {
+      const int fd = events[i].data.fd;
+      const uint32_t flags = events[i].events;
+      if (fd == server_fd) {
+        accept_clients();
+        continue;
+      }
+      if (fd == m_wakeup_fd) {
+        // Clients marked to be removed by the sender are handled below
+        uint64_t unused;
+        const auto unused2 = read(m_wakeup_fd, &unused, sizeof(unused));
+        (void)unused2;
+        continue;
+      }
+      if (flags & EPOLLERR) {
+        remove_client(fd);
+        continue;
+      }
+      if (flags & EPOLLOUT) {
+        std::lock_guard<std::mutex> guard(m_clients_list_mutex);
+        auto it = m_clients_list.find(fd);
+        if (it != m_clients_list.end() && !flush_queue(*it->second)) {
+          it->second->marked_to_be_removed = true;
+        }
+      }
+      if (flags & (EPOLLIN | EPOLLHUP | EPOLLRDHUP)) {
+        // One read per wake up (level triggered) - a chatty client cannot
+        // starve the others
+        const ssize_t message_length =
+            recv(fd, m_read_buffer.data(), m_read_buffer.size(), MSG_DONTWAIT);
+        if (message_length > 0) {
+          on_packet_any_tcp_client(m_read_buffer.data(), (int)message_length);
+        } else if (message_length == 0) {
+          m_console->debug("Client disconnected");
+          remove_client(fd);
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+          m_console->debug("Read error {} {}", message_length, strerror(errno));
+          remove_client(fd);
+        }
+      }
+    }
+    std::vector<int> to_remove;
+    {
+      std::lock_guard<std::mutex> guard(m_clients_list_mutex);
+      for (const auto& [sock_fd, client] : m_clients_list) {
+        if (client->marked_to_be_removed) to_remove.push_back(sock_fd);
+      }
+    }
+    for (const auto sock_fd : to_remove) {
+      remove_client(sock_fd);
+    }
   }
-  const int sockaddr_len = sizeof(sockaddr);
-  while (m_keep_accept_thread_alive) {
-    const auto accept_result = accept(server_fd, (struct sockaddr*)&sockaddr,
-                                      (socklen_t*)&sockaddr_len);
+}
+
+void openhd::TCPServer::accept_clients() {
+  while (true) {
+    struct sockaddr_in sockaddr {};
+    socklen_t sockaddr_len = sizeof(sockaddr);
+    const int accept_result =
+        accept4(server_fd, (struct sockaddr*)&sockaddr, &sockaddr_len,
+                SOCK_NONBLOCK | SOCK_CLOEXEC);
     if (accept_result < 0) {
-      m_console->debug("accept failed");
-      close(server_fd);
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        m_console->debug("accept failed {}", strerror(errno));
+      }
       return;
     }
+    // Telemetry is latency sensitive, many small messages
+    int opt = 1;
+    setsockopt(accept_result, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
     const std::string client_ip = inet_ntoa(sockaddr.sin_addr);
     const int client_port = ntohs(sockaddr.sin_port);
     m_console->debug("accepted client,sockfd:{}, ip:{}, port:{}", accept_result,
@@ -103,53 +216,174 @@ void openhd::TCPServer::loop_accept() {
     new_client->sock_fd = accept_result;
     new_client->ip = client_ip;
     new_client->port = client_port;
-    new_client->keep_rx_looping = true;
-    new_client->parent = this;
-    new_client->rx_loop_thread = std::make_shared<std::thread>(
-        &TCPServer::ConnectedClient::loop_rx, new_client.get());
-    on_external_device(client_ip, client_port, true);
     {
       std::lock_guard<std::mutex> guard(m_clients_list_mutex);
-      m_clients_list.push_back(new_client);
+      struct epoll_event ev {};
+      ev.events = EPOLLIN | EPOLLRDHUP;
+      ev.data.fd = accept_result;
+      epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, accept_result, &ev);
+      m_clients_list[accept_result] = new_client;
     }
+    on_external_device(client_ip, client_port, true);
   }
 }
 
+void openhd::TCPServer::remove_client(int sock_fd) {
+  std::shared_ptr<ConnectedClient> client;
+  {
+    std::lock_guard<std::mutex> guard(m_clients_list_mutex);
+    auto it = m_clients_list.find(sock_fd);
+    if (it == m_clients_list.end()) return;
+    client = it->second;
+    m_clients_list.erase(it);
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, sock_fd, nullptr);
+    // Closed with the lock held - senders only use the fd with the lock held
+    close(sock_fd);
+  }
+  m_console->debug("Removed client {}:{}, sent:{} dropped:{}", client->ip,
+                   client->port, client->n_bytes_sent,
+                   client->n_messages_dropped);
+  on_external_device(client->ip, client->port, false);
+}
+
 void openhd::TCPServer::send_message_to_all_clients(const uint8_t* data,
                                                     int data_len) {
+  if (data_len <= 0) return;
+  // Only copied if any client cannot take it right away, shared by all of them
+  std::shared_ptr<const std::vector<uint8_t>> shared_data = nullptr;
+  const auto now = std::chrono::steady_clock::now();
+  bool wakeup_reactor = false;
   std::lock_guard<std::mutex> guard(m_clients_list_mutex);
-  for (auto& client : m_clients_list) {
-    if (!client->marked_to_be_removed) {
+  for (auto& [sock_fd, client] : m_clients_list) {
+    if (client->marked_to_be_removed) continue;
+    std::size_t written = 0;
+    // Otherwise we'd overtake what is queued
+    if (client->queue.empty()) {
       const int flags =
           MSG_DONTWAIT |  // otherwise we might block if the socket got
                           // disconnected
           MSG_NOSIGNAL;   // otherwise we might crash if the socket disconnects
-      if (!send(client->sock_fd, data, data_len, flags)) {
-        m_console->debug("Client {} disconnected (cannot send data)",
-                         client->ip);
-        // Will be disconnected / removed by the accept thread
-        client->marked_to_be_removed = true;
+      const ssize_t ret = send(sock_fd, data, data_len, flags);
+      if (ret < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+          m_console->debug("Client {} disconnected (cannot send data {})",
+                           client->ip, strerror(errno));
+          // Will be disconnected / removed by the reactor thread
+          client->marked_to_be_removed = true;
+          wakeup_reactor = true;
+          continue;
+        }
+      } else {
+        written = ret;
+        client->n_bytes_sent += ret;
       }
+      if (written == (std::size_t)data_len) continue;
     }
+    // Partial write or the socket buffer is full - the reactor writes the rest
+    if (!shared_data) {
+      shared_data =
+          std::make_shared<const std::vector<uint8_t>>(data, data + data_len);
+    }
+    enqueue(*client, shared_data, written, now);
+  }
+  if (wakeup_reactor) {
+    const uint64_t one = 1;
+    const auto unused = write(m_wakeup_fd, &one, sizeof(one));
+    (void)unused;
   }
 }
 
-void openhd::TCPServer::ConnectedClient::loop_rx() {
-  auto console = openhd::log::create_or_get(fmt::format("TCPClient{}", ip));
-  const auto buff = std::make_unique<std::array<uint8_t, READ_BUFF_SIZE>>();
-  while (keep_rx_looping) {
-    const ssize_t message_length = read(sock_fd, buff->data(), buff->size());
-    if (message_length < 0) {
-      console->debug("Read error {} {}", message_length, strerror(errno));
-      marked_to_be_removed = true;
-      break;
+void openhd::TCPServer::enqueue(
+    ConnectedClient& client,
+    const std::shared_ptr<const std::vector<uint8_t>>& data,
+    std::size_t offset, std::chrono::steady_clock::time_point now) {
+  client.queue.push_back(QueuedMessage{data, offset, now});
+  client.queue_size_bytes += data->size() - offset;
+  // Drop oldest - but never the partially written one (the client would get
+  // a broken message), and always keep the newest
+  while (client.queue_size_bytes > MAX_CLIENT_QUEUE_BYTES &&
+         client.queue.size() > 1) {
+    auto drop = client.queue.begin();
+    if (drop->offset > 0) drop++;
+    if (drop == client.queue.end() - 1) break;
+    client.queue_size_bytes -= drop->data->size();
+    client.queue.erase(drop);
+    client.n_messages_dropped++;
+  }
+  if (client.n_messages_dropped > 0) {
+    OPENHD_WARN_EVERY_MS(m_console, 1000,
+                         "Client {} cannot keep up, dropped {} messages",
+                         client.ip, client.n_messages_dropped);
+  }
+  set_wants_write(client, true);
+}
+
+bool openhd::TCPServer::flush_queue(ConnectedClient& client) {
+  while (!client.queue.empty()) {
+    struct iovec iov[MAX_IOV_PER_WRITE];
+    int n_iov = 0;
+    for (const auto& message : client.queue) {
+      if (n_iov == MAX_IOV_PER_WRITE) break;
+      iov[n_iov].iov_base = (void*)(message.data->data() + message.offset);
+      iov[n_iov].iov_len = message.data->size() - message.offset;
+      n_iov++;
+    }
+    struct msghdr msg {};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = n_iov;
+    ssize_t ret = sendmsg(client.sock_fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (ret < 0) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+      m_console->debug("Client {} disconnected (cannot send data {})",
+                       client.ip, strerror(errno));
+      return false;
+    }
+    client.n_bytes_sent += ret;
+    client.queue_size_bytes -= ret;
+    while (ret > 0) {
+      auto& front = client.queue.front();
+      const std::size_t remaining = front.data->size() - front.offset;
+      if ((std::size_t)ret < remaining) {
+        front.offset += ret;
+        break;
+      }
+      ret -= remaining;
+      client.queue.pop_front();
     }
-    if (message_length == 0) {
-      console->debug("Client disconnected");
-      marked_to_be_removed = true;
-      break;
+  }
+  set_wants_write(client, !client.queue.empty());
+  return true;
+}
+
+void openhd::TCPServer::set_wants_write(ConnectedClient& client,
+                                        bool wants_write) {
+  if (client.wants_write == wants_write) return;
+  client.wants_write = wants_write;
+  struct epoll_event ev {};
+  ev.events = EPOLLIN | EPOLLRDHUP;
+  if (wants_write) ev.events |= EPOLLOUT;
+  ev.data.fd = client.sock_fd;
+  epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, client.sock_fd, &ev);
+}
+
+std::vector<openhd::TCPServer::ClientStats>
+openhd::TCPServer::get_client_stats() {
+  std::vector<ClientStats> ret;
+  const auto now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> guard(m_clients_list_mutex);
+  for (const auto& [sock_fd, client] : m_clients_list) {
+    ClientStats stats;
+    stats.ip = client->ip;
+    stats.port = client->port;
+    stats.n_bytes_sent = client->n_bytes_sent;
+    stats.n_messages_dropped = client->n_messages_dropped;
+    stats.queue_size_bytes = client->queue_size_bytes;
+    if (!client->queue.empty()) {
+      stats.lag = std::chrono::duration_cast<std::chrono::microseconds>(
+          now - client->queue.front().enqueue_time);
     }
-    parent->on_packet_any_tcp_client(buff->data(), message_length);
+    ret.push_back(stats);
   }
-  parent->on_external_device(ip, port, false);
+  return ret;
 }
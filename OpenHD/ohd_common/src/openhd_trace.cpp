@@ -0,0 +1,336 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "openhd_trace.h"
+
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "openhd_spdlog.h"
+
+std::atomic<bool> openhd::trace::detail::g_enabled{false};
+
+namespace {
+
+// Single producer (the owning thread). Each slot carries a sequence word
+// (index + 1 once written, 0 while being written) - the dump only takes the
+// slots whose sequence did not change while reading them.
+struct ThreadRing {
+  static constexpr uint64_t SIZE = 8192;
+  static_assert((SIZE & (SIZE - 1)) == 0);
+  struct Slot {
+    std::atomic<uint64_t> seq{0};
+    std::atomic<uint64_t> timestamp_ns{0};
+    // frame_id << 32 | stage << 16 | stream_index
+    std::atomic<uint64_t> key{0};
+    std::atomic<int32_t> value{0};
+  };
+  std::array<Slot, SIZE> slots{};
+  std::atomic<uint64_t> head{0};
+  // The threads that wrote into this ring, each from its begin index on.
+  // Protected by the registry mutex.
+  struct Owner {
+    uint64_t begin;
+    int tid;
+    std::string thread_name;
+  };
+  std::vector<Owner> owners;
+};
+
+struct Registry {
+  std::mutex mutex;
+  // Rings outlive their thread, such that we don't lose events. Once a thread
+  // exits, its ring is re-used by the next new thread, which continues after
+  // the events of the exited one (the memory is bounded by the max n of
+  // threads that record at the same time).
+  std::vector<std::unique_ptr<ThreadRing>> rings;
+  std::vector<ThreadRing*> free_rings;
+};
+Registry& get_registry() {
+  // Never destroyed - threads might still record while the process exits
+  static auto* registry = new Registry();
+  return *registry;
+}
+
+std::atomic<bool> g_dump_requested{false};
+
+// Takes a (free or new) ring for the calling thread, gives it back on thread
+// exit
+class ThreadRingOwner {
+ public:
+  ThreadRingOwner() {
+    char name[16] = {0};
+    pthread_getname_np(pthread_self(), name, sizeof(name));
+    auto& registry = get_registry();
+    std::lock_guard<std::mutex> guard(registry.mutex);
+    if (registry.free_rings.empty()) {
+      registry.rings.push_back(std::make_unique<ThreadRing>());
+      m_ring = registry.rings.back().get();
+    } else {
+      m_ring = registry.free_rings.back();
+      registry.free_rings.pop_back();
+    }
+    const uint64_t head = m_ring->head.load(std::memory_order_relaxed);
+    auto& owners = m_ring->owners;
+    // Forget the owners whose events got overwritten completely
+    while (owners.size() >= 2 && owners[1].begin + ThreadRing::SIZE <= head) {
+      owners.erase(owners.begin());
+    }
+    owners.push_back(
+        {head, static_cast<int>(syscall(SYS_gettid)), std::string(name)});
+  }
+  ~ThreadRingOwner() {
+    auto& registry = get_registry();
+    std::lock_guard<std::mutex> guard(registry.mutex);
+    registry.free_rings.push_back(m_ring);
+  }
+  ThreadRingOwner(const ThreadRingOwner&) = delete;
+  ThreadRingOwner& operator=(const ThreadRingOwner&) = delete;
+  ThreadRing& ring() { return *m_ring; }
+
+ private:
+  ThreadRing* m_ring;
+};
+
+ThreadRing& get_thread_ring() {
+  thread_local ThreadRingOwner owner;
+  return owner.ring();
+}
+
+uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+struct Snapshot {
+  int tid;
+  std::string thread_name;
+  std::vector<openhd::trace::Event> events;
+};
+
+std::vector<Snapshot> take_snapshot() {
+  // One per owner thread of a ring
+  struct RingInfo {
+    ThreadRing* ring;
+    uint64_t begin;
+    uint64_t end;
+    int tid;
+    std::string thread_name;
+  };
+  std::vector<RingInfo> infos;
+  {
+    auto& registry = get_registry();
+    std::lock_guard<std::mutex> guard(registry.mutex);
+    for (const auto& ring : registry.rings) {
+      const uint64_t head = ring->head.load(std::memory_order_acquire);
+      const uint64_t oldest = head > ThreadRing::SIZE ? head - ThreadRing::SIZE : 0;
+      const auto& owners = ring->owners;
+      for (size_t i = 0; i < owners.size(); i++) {
+        const uint64_t end = i + 1 < owners.size() ? owners[i + 1].begin : head;
+        const uint64_t begin = std::max(owners[i].begin, oldest);
+        if (begin >= end) continue;
+        infos.push_back(
+            {ring.get(), begin, end, owners[i].tid, owners[i].thread_name});
+      }
+    }
+  }
+  std::vector<Snapshot> ret;
+  for (const auto& info : infos) {
+    Snapshot snapshot{info.tid, info.thread_name, {}};
+    snapshot.events.reserve(info.end - info.begin);
+    for (uint64_t i = info.begin; i < info.end; i++) {
+      const auto& slot = info.ring->slots[i & (ThreadRing::SIZE - 1)];
+      const uint64_t seq = slot.seq.load(std::memory_order_acquire);
+      // The writer lapped us (or is writing this slot right now)
+      if (seq != i + 1) continue;
+      const uint64_t timestamp_ns =
+          slot.timestamp_ns.load(std::memory_order_relaxed);
+      const uint64_t key = slot.key.load(std::memory_order_relaxed);
+      const int32_t value = slot.value.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.seq.load(std::memory_order_relaxed) != seq) continue;
+      snapshot.events.push_back(openhd::trace::Event{
+          timestamp_ns, static_cast<uint32_t>(key >> 32),
+          static_cast<openhd::trace::Stage>((key >> 16) & 0xFFFF),
+          static_cast<uint16_t>(key & 0xFFFF), value});
+    }
+    ret.push_back(std::move(snapshot));
+  }
+  return ret;
+}
+
+// Chrome trace event phase
+char phase_for_stage(openhd::trace::Stage stage) {
+  switch (stage) {
+    case openhd::trace::Stage::LINK_ENQUEUE_BEGIN:
+      return 'B';
+    case openhd::trace::Stage::LINK_ENQUEUE_END:
+      return 'E';
+    case openhd::trace::Stage::LINK_FEC_ENCODE_TIME:
+    case openhd::trace::Stage::LINK_TX_DELAY:
+      return 'C';
+    default:
+      return 'i';
+  }
+}
+
+}  // namespace
+
+const char* openhd::trace::stage_to_string(Stage stage) {
+  switch (stage) {
+    case Stage::APPSINK_SAMPLE:
+      return "appsink_sample";
+    case Stage::FRAME_ASSEMBLED:
+      return "frame_assembled";
+    case Stage::LINK_ENQUEUE_BEGIN:
+    case Stage::LINK_ENQUEUE_END:
+      return "link_enqueue";
+    case Stage::LINK_FRAME_DROPPED:
+      return "link_frame_dropped";
+    case Stage::LINK_FEC_ENCODE_TIME:
+      return "link_fec_encode_time_us";
+    case Stage::LINK_TX_DELAY:
+      return "link_tx_delay_us";
+    case Stage::GND_VIDEO_RX:
+      return "gnd_video_rx";
+  }
+  return "unknown";
+}
+
+void openhd::trace::detail::record(Stage stage, uint32_t frame_id,
+                                   uint16_t stream_index, int32_t value) {
+  auto& ring = get_thread_ring();
+  const uint64_t idx = ring.head.load(std::memory_order_relaxed);
+  auto& slot = ring.slots[idx & (ThreadRing::SIZE - 1)];
+  // Mark as being written before any field changes
+  slot.seq.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.timestamp_ns.store(now_ns(), std::memory_order_relaxed);
+  slot.key.store((static_cast<uint64_t>(frame_id) << 32) |
+                     (static_cast<uint64_t>(stage) << 16) | stream_index,
+                 std::memory_order_relaxed);
+  slot.value.store(value, std::memory_order_relaxed);
+  slot.seq.store(idx + 1, std::memory_order_release);
+  ring.head.store(idx + 1, std::memory_order_release);
+}
+
+std::size_t openhd::trace::get_n_rings() {
+  auto& registry = get_registry();
+  std::lock_guard<std::mutex> guard(registry.mutex);
+  return registry.rings.size();
+}
+
+void openhd::trace::set_enabled(bool enabled) {
+  detail::g_enabled.store(enabled, std::memory_order_relaxed);
+  openhd::log::get_default()->debug("Frame tracing {}",
+                                    enabled ? "enabled" : "disabled");
+}
+
+uint32_t openhd::trace::frame_id_from_rtp(const uint8_t* data,
+                                          std::size_t data_len) {
+  if (data_len < 12 || (data[0] >> 6) != 2) return 0;
+  return (static_cast<uint32_t>(data[4]) << 24) |
+         (static_cast<uint32_t>(data[5]) << 16) |
+         (static_cast<uint32_t>(data[6]) << 8) | static_cast<uint32_t>(data[7]);
+}
+
+void openhd::trace::request_dump() {
+  g_dump_requested.store(true, std::memory_order_relaxed);
+}
+
+bool openhd::trace::dump_if_requested() {
+  if (!g_dump_requested.exchange(false)) return false;
+  const bool json_ok = write_chrome_trace_json("/tmp/openhd_trace.json");
+  const bool csv_ok = write_csv("/tmp/openhd_trace.csv");
+  openhd::log::get_default()->info(
+      "Dumped frame trace to /tmp/openhd_trace.json ({}) and "
+      "/tmp/openhd_trace.csv ({})",
+      json_ok ? "ok" : "failed", csv_ok ? "ok" : "failed");
+  return true;
+}
+
+bool openhd::trace::write_chrome_trace_json(const std::string& filename) {
+  std::ofstream f(filename);
+  if (!f.is_open()) return false;
+  const auto snapshots = take_snapshot();
+  f << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  const auto separator = [&f, &first]() {
+    if (!first) f << ",\n";
+    first = false;
+  };
+  for (const auto& snapshot : snapshots) {
+    separator();
+    f << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+      << snapshot.tid << ",\"args\":{\"name\":\"" << snapshot.thread_name
+      << "\"}}";
+    for (const auto& event : snapshot.events) {
+      separator();
+      const char phase = phase_for_stage(event.stage);
+      f << "{\"name\":\"" << stage_to_string(event.stage)
+        << "\",\"cat\":\"video\",\"ph\":\"" << phase << "\",\"pid\":1,\"tid\":"
+        << snapshot.tid << ",\"ts\":" << event.timestamp_ns / 1000 << "."
+        << (event.timestamp_ns % 1000) / 100;
+      if (phase == 'i') f << ",\"s\":\"t\"";
+      if (phase == 'C') {
+        // One counter series per stream
+        f << ",\"args\":{\"stream" << event.stream_index
+          << "\":" << event.value << "}}";
+      } else {
+        f << ",\"args\":{\"frame\":" << event.frame_id
+          << ",\"value\":" << event.value << "}}";
+      }
+    }
+  }
+  f << "]}\n";
+  return f.good();
+}
+
+bool openhd::trace::write_csv(const std::string& filename) {
+  std::ofstream f(filename);
+  if (!f.is_open()) return false;
+  auto snapshots = take_snapshot();
+  f << "timestamp_ns,tid,thread,stage,frame_id,value,stream\n";
+  for (const auto& snapshot : snapshots) {
+    for (const auto& event : snapshot.events) {
+      f << event.timestamp_ns << "," << snapshot.tid << ","
+        << snapshot.thread_name << "," << stage_to_string(event.stage)
+        << (event.stage == Stage::LINK_ENQUEUE_BEGIN  ? "_begin"
+            : event.stage == Stage::LINK_ENQUEUE_END ? "_end"
+                                                      : "")
+        << "," << event.frame_id << "," << event.value << ","
+        << event.stream_index << "\n";
+    }
+  }
+  return f.good();
+}
@@ -24,6 +24,8 @@
 #include "openhd_udp.h"
 
 #include <arpa/inet.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
 #include <unistd.h>
 
 #include <algorithm>
@@ -66,39 +68,218 @@ void openhd::UDPForwarder::forwardPacketViaUDP(const uint8_t* packet, const std:
     // openhd::log::get_default()->debug("Forward {}",packetSize);
     const auto ret = sendto(sockfd, packet, packetSize, 0, (const struct sockaddr*)&saddr, sizeof(saddr));
     if (ret < 0 || ret != packetSize) {
-        get_console()->warn("Error sending packet of size:{} to {}:{} code:{} {}", packetSize, client_addr, client_udp_port, ret, strerror(errno));
+        log_send_error(packetSize, ret);
     }
 }
 
+void openhd::UDPForwarder::log_send_error(std::size_t packetSize, ssize_t ret) const {
+    get_console()->warn("Error sending packet of size:{} to {}:{} code:{} {}", packetSize, client_addr, client_udp_port, ret, strerror(errno));
+}
+
+void openhd::UDPForwarder::forwardPacketsViaUDP(const UDPPacketRef* packets, std::size_t n_packets, bool use_gso) const {
+    if (n_packets == 0) return;
+    if (use_gso && n_packets > 1 && !m_gso_unsupported.load(std::memory_order_relaxed)) {
+        const auto n_sent = send_batch_gso(packets, n_packets);
+        if (n_sent == n_packets) {
+            return;
+        }
+        // Rejected at any point of the burst - never try again, send the rest without GSO
+        get_console()->warn("UDP GSO not supported for {}:{}, using sendmmsg", client_addr, client_udp_port);
+        m_gso_unsupported = true;
+        packets += n_sent;
+        n_packets -= n_sent;
+    }
+    send_batch_sendmmsg(packets, n_packets);
+}
+
+void openhd::UDPForwarder::send_batch_sendmmsg(const UDPPacketRef* packets, std::size_t n_packets) const {
+    // Large enough for a big (key) frame, bigger bursts are split
+    static constexpr std::size_t MAX_BATCH = 64;
+    struct mmsghdr msgs[MAX_BATCH];
+    struct iovec iovecs[MAX_BATCH];
+    std::size_t offset = 0;
+    while (offset < n_packets) {
+        const std::size_t n = std::min(n_packets - offset, MAX_BATCH);
+        for (std::size_t i = 0; i < n; i++) {
+            iovecs[i].iov_base = const_cast<uint8_t*>(packets[offset + i].data);
+            iovecs[i].iov_len = packets[offset + i].size;
+            msgs[i].msg_hdr = {};
+            msgs[i].msg_hdr.msg_name = const_cast<sockaddr_in*>(&saddr);
+            msgs[i].msg_hdr.msg_namelen = sizeof(saddr);
+            msgs[i].msg_hdr.msg_iov = &iovecs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_len = 0;
+        }
+        std::size_t n_sent = 0;
+        while (n_sent < n) {
+            const int ret = sendmmsg(sockfd, &msgs[n_sent], n - n_sent, 0);
+            if (ret <= 0) {
+                // Skip the packet that failed, same as with sendto
+                log_send_error(packets[offset + n_sent].size, ret);
+                n_sent++;
+            } else {
+                n_sent += ret;
+            }
+        }
+        offset += n;
+    }
+}
+
+std::size_t openhd::UDPForwarder::send_batch_gso(const UDPPacketRef* packets, std::size_t n_packets) const {
+#ifdef UDP_SEGMENT
+    // Kernel limits: max 64 segments and 64k per GSO send
+    static constexpr std::size_t MAX_SEGMENTS = 64;
+    static constexpr std::size_t MAX_GSO_BYTES = 65000;
+    struct iovec iovecs[MAX_SEGMENTS];
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(uint16_t))];
+    std::size_t offset = 0;
+    while (offset < n_packets) {
+        // A run of equally sized packets (the last one may be smaller) is sent
+        // as one GSO "super packet" and segmented by the kernel (or the NIC)
+        const std::size_t segment_size = packets[offset].size;
+        std::size_t n = 0;
+        std::size_t total_size = 0;
+        while (offset + n < n_packets && n < MAX_SEGMENTS) {
+            const auto size = packets[offset + n].size;
+            if (size > segment_size || total_size + size > MAX_GSO_BYTES) break;
+            iovecs[n].iov_base = const_cast<uint8_t*>(packets[offset + n].data);
+            iovecs[n].iov_len = size;
+            total_size += size;
+            n++;
+            if (size < segment_size) break;
+        }
+        struct msghdr msg {};
+        msg.msg_name = const_cast<sockaddr_in*>(&saddr);
+        msg.msg_namelen = sizeof(saddr);
+        msg.msg_iov = iovecs;
+        msg.msg_iovlen = n;
+        if (n > 1) {
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            struct cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+            cm->cmsg_level = SOL_UDP;
+            cm->cmsg_type = UDP_SEGMENT;
+            cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            const uint16_t gso_size = segment_size;
+            std::memcpy(CMSG_DATA(cm), &gso_size, sizeof(gso_size));
+        }
+        const auto ret = sendmsg(sockfd, &msg, 0);
+        if (ret < 0) {
+            if (n > 1 && (errno == EINVAL || errno == EIO || errno == ENOPROTOOPT || errno == EOPNOTSUPP)) {
+                // Not supported (e.g. the route changed to a device without GSO), this run has not been sent
+                return offset;
+            }
+            log_send_error(total_size, ret);
+        }
+        offset += n;
+    }
+    return n_packets;
+#else
+    return 0;
+#endif
+}
+
+openhd::UDPMultiForwarder::UDPMultiForwarder() {
+    m_sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (m_sockfd < 0) {
+        get_console()->warn("Error opening socket:{}", strerror(errno));
+    }
+}
+
+openhd::UDPMultiForwarder::~UDPMultiForwarder() {
+    close(m_sockfd);
+}
+
 void openhd::UDPMultiForwarder::addForwarder(const std::string& client_addr, int client_udp_port) {
     std::lock_guard<std::mutex> guard(udpForwardersLock);
+    const auto curr = std::atomic_load(&udpForwarders);
     // check if we already forward data to this IP::Port tuple
-    for (const auto& udpForwarder : udpForwarders) {
+    for (const auto& udpForwarder : *curr) {
         if (udpForwarder->client_addr == client_addr && udpForwarder->client_udp_port == client_udp_port) {
             get_console()->info("UDPMultiForwarder: already forwarding to: {}:{}", client_addr, client_udp_port);
             return;
         }
     }
     get_console()->info("UDPMultiForwarder: add forwarding to: {}:{}", client_addr, client_udp_port);
-    udpForwarders.emplace_back(std::make_unique<openhd::UDPForwarder>(client_addr, client_udp_port));
+    auto updated = std::make_shared<Forwarders>(*curr);
+    updated->emplace_back(std::make_shared<openhd::UDPForwarder>(client_addr, client_udp_port));
+    std::atomic_store(&udpForwarders, std::shared_ptr<const Forwarders>(std::move(updated)));
 }
 
 void openhd::UDPMultiForwarder::removeForwarder(const std::string& client_addr, int client_udp_port) {
     std::lock_guard<std::mutex> guard(udpForwardersLock);
-    udpForwarders.erase(std::find_if(udpForwarders.begin(), udpForwarders.end(), [&client_addr, &client_udp_port](const auto& udpForwarder) {
+    auto updated = std::make_shared<Forwarders>(*std::atomic_load(&udpForwarders));
+    const auto it = std::find_if(updated->begin(), updated->end(), [&client_addr, &client_udp_port](const auto& udpForwarder) {
         return udpForwarder->client_addr == client_addr && udpForwarder->client_udp_port == client_udp_port;
-    }));
+    });
+    if (it == updated->end()) {
+        return;
+    }
+    updated->erase(it);
+    // A send in progress keeps using (and owns) the previous list
+    std::atomic_store(&udpForwarders, std::shared_ptr<const Forwarders>(std::move(updated)));
 }
 
 void openhd::UDPMultiForwarder::forwardPacketViaUDP(const uint8_t* packet, const std::size_t packetSize) {
-    std::lock_guard<std::mutex> guard(udpForwardersLock);
-    for (const auto& udpForwarder : udpForwarders) {
-        udpForwarder->forwardPacketViaUDP(packet, packetSize);
+    const auto forwarders = std::atomic_load(&udpForwarders);
+    const UDPPacketRef ref{packet, packetSize};
+    send_all_destinations(*forwarders, &ref, 1);
+}
+
+void openhd::UDPMultiForwarder::forwardPacketsViaUDP(const UDPPacketRef* packets, std::size_t n_packets) {
+    if (n_packets == 0) return;
+    const auto forwarders = std::atomic_load(&udpForwarders);
+    if (m_use_gso.load(std::memory_order_relaxed) && n_packets > 1) {
+        // GSO segments per destination
+        for (const auto& udpForwarder : *forwarders) {
+            udpForwarder->forwardPacketsViaUDP(packets, n_packets, true);
+        }
+        return;
+    }
+    send_all_destinations(*forwarders, packets, n_packets);
+}
+
+void openhd::UDPMultiForwarder::send_all_destinations(const Forwarders& forwarders, const UDPPacketRef* packets, std::size_t n_packets) const {
+    const std::size_t n_destinations = forwarders.size();
+    if (n_destinations == 0 || n_packets == 0) return;
+    // One message per packet and destination, bigger bursts are split
+    static constexpr std::size_t MAX_BATCH = 64;
+    struct mmsghdr msgs[MAX_BATCH];
+    struct iovec iovecs[MAX_BATCH];
+    const std::size_t n_total = n_packets * n_destinations;
+    std::size_t offset = 0;
+    while (offset < n_total) {
+        const std::size_t n = std::min(n_total - offset, MAX_BATCH);
+        for (std::size_t i = 0; i < n; i++) {
+            const auto& packet = packets[(offset + i) / n_destinations];
+            const auto& forwarder = *forwarders[(offset + i) % n_destinations];
+            iovecs[i].iov_base = const_cast<uint8_t*>(packet.data);
+            iovecs[i].iov_len = packet.size;
+            msgs[i].msg_hdr = {};
+            msgs[i].msg_hdr.msg_name = const_cast<sockaddr_in*>(&forwarder.get_saddr());
+            msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            msgs[i].msg_hdr.msg_iov = &iovecs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_len = 0;
+        }
+        std::size_t n_sent = 0;
+        while (n_sent < n) {
+            const int ret = sendmmsg(m_sockfd, &msgs[n_sent], n - n_sent, 0);
+            if (ret <= 0) {
+                // Skip the message that failed (e.g. destination unreachable), same as with sendto
+                const auto idx = offset + n_sent;
+                forwarders[idx % n_destinations]->log_send_error(packets[idx / n_destinations].size, ret);
+                n_sent++;
+            } else {
+                n_sent += ret;
+            }
+        }
+        offset += n;
     }
 }
 
-const std::list<std::unique_ptr<openhd::UDPForwarder>>& openhd::UDPMultiForwarder::getForwarders() const {
-    return udpForwarders;
+std::shared_ptr<const openhd::UDPMultiForwarder::Forwarders> openhd::UDPMultiForwarder::getForwarders() const {
+    return std::atomic_load(&udpForwarders);
 }
 
 openhd::UDPReceiver::UDPReceiver(std::string client_addr, int client_udp_port, openhd::UDPReceiver::OUTPUT_DATA_CALLBACK cb) : mCb(cb) {
@@ -0,0 +1,350 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "openhd_udp_fec.h"
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+namespace {
+
+// GF(256), polynomial x^8+x^4+x^3+x^2+1 (0x11d)
+struct GF256 {
+  uint8_t mul[256][256];
+  uint8_t inv[256];
+  GF256() {
+    uint8_t exp[512];
+    int log[256] = {0};
+    int x = 1;
+    for (int i = 0; i < 255; i++) {
+      exp[i] = static_cast<uint8_t>(x);
+      log[x] = i;
+      x <<= 1;
+      if (x & 0x100) x ^= 0x11d;
+    }
+    for (int i = 255; i < 512; i++) exp[i] = exp[i - 255];
+    for (int a = 0; a < 256; a++) {
+      for (int b = 0; b < 256; b++) {
+        mul[a][b] = (a == 0 || b == 0) ? 0 : exp[log[a] + log[b]];
+      }
+    }
+    inv[0] = 0;
+    for (int a = 1; a < 256; a++) inv[a] = exp[255 - log[a]];
+  }
+};
+
+const GF256& gf() {
+  static const GF256 instance;
+  return instance;
+}
+
+// Coefficient of primary fragment j for the fragment with index r >= n_primary
+// (Cauchy matrix, x = r, y = j - any n_primary rows of [I; C] are invertible)
+uint8_t cauchy(int r, int j) { return gf().inv[r ^ j]; }
+
+// dst ^= c * src
+void mul_add(uint8_t* dst, const uint8_t* src, std::size_t len, uint8_t c) {
+  if (c == 0) return;
+  const uint8_t* row = gf().mul[c];
+  for (std::size_t i = 0; i < len; i++) dst[i] ^= row[src[i]];
+}
+
+// In place Gauss-Jordan, false if singular
+bool invert(std::vector<uint8_t>& m, int n) {
+  const auto& g = gf();
+  std::vector<uint8_t> inv(n * n, 0);
+  for (int i = 0; i < n; i++) inv[i * n + i] = 1;
+  for (int col = 0; col < n; col++) {
+    int pivot = col;
+    while (pivot < n && m[pivot * n + col] == 0) pivot++;
+    if (pivot == n) return false;
+    if (pivot != col) {
+      for (int k = 0; k < n; k++) {
+        std::swap(m[pivot * n + k], m[col * n + k]);
+        std::swap(inv[pivot * n + k], inv[col * n + k]);
+      }
+    }
+    const uint8_t* scale = g.mul[g.inv[m[col * n + col]]];
+    for (int k = 0; k < n; k++) {
+      m[col * n + k] = scale[m[col * n + k]];
+      inv[col * n + k] = scale[inv[col * n + k]];
+    }
+    for (int row = 0; row < n; row++) {
+      const uint8_t c = m[row * n + col];
+      if (row == col || c == 0) continue;
+      const uint8_t* mul = g.mul[c];
+      for (int k = 0; k < n; k++) {
+        m[row * n + k] ^= mul[m[col * n + k]];
+        inv[row * n + k] ^= mul[inv[col * n + k]];
+      }
+    }
+  }
+  m = std::move(inv);
+  return true;
+}
+
+// Primary fragments are coded with a 2 byte length prefix
+constexpr std::size_t LENGTH_PREFIX_SIZE = 2;
+
+}  // namespace
+
+openhd::UDPFecEncoder::UDPFecEncoder(int fec_percentage, int max_block_size)
+    : m_fec_percentage(std::clamp(fec_percentage, 0, 100)),
+      m_max_block_size(std::clamp(max_block_size, 1, MAX_BLOCK_SIZE)) {}
+
+std::vector<uint8_t>& openhd::UDPFecEncoder::next_buffer() {
+  if (m_n_used_buffers == m_buffers.size()) m_buffers.emplace_back();
+  return m_buffers[m_n_used_buffers++];
+}
+
+const std::vector<openhd::UDPPacketRef>& openhd::UDPFecEncoder::encode_frame(
+    const std::vector<UDPPacketRef>& fragments) {
+  m_n_used_buffers = 0;
+  m_packets.clear();
+  const int n_fragments = static_cast<int>(fragments.size());
+  if (n_fragments == 0) return m_packets;
+  // Evenly sized blocks, no tiny block at the end
+  const int n_blocks = (n_fragments + m_max_block_size - 1) / m_max_block_size;
+  int offset = 0;
+  for (int i = 0; i < n_blocks; i++) {
+    const int n_primary = (n_fragments - offset) / (n_blocks - i);
+    encode_block(fragments.data() + offset, n_primary);
+    offset += n_primary;
+  }
+  // Buffers might have been re-allocated while encoding
+  std::size_t buffer_idx = 0;
+  for (auto& packet : m_packets) {
+    packet.data = m_buffers[buffer_idx++].data();
+  }
+  return m_packets;
+}
+
+void openhd::UDPFecEncoder::encode_block(const UDPPacketRef* fragments,
+                                         int n_primary) {
+  const int n_secondary =
+      (n_primary * m_fec_percentage + 99) / 100;
+  UDPFecHeader header{};
+  header.magic = UDPFecHeader::MAGIC;
+  header.n_primary = static_cast<uint8_t>(n_primary);
+  header.n_secondary = static_cast<uint8_t>(n_secondary);
+  header.block_idx = htonl(m_block_idx++);
+  std::size_t max_coded_size = 0;
+  const std::size_t first_buffer = m_n_used_buffers;
+  for (int j = 0; j < n_primary; j++) {
+    const auto& fragment = fragments[j];
+    const std::size_t size = std::min<std::size_t>(fragment.size, UINT16_MAX);
+    auto& buff = next_buffer();
+    buff.resize(sizeof(UDPFecHeader) + LENGTH_PREFIX_SIZE + size);
+    header.fragment_idx = static_cast<uint8_t>(j);
+    memcpy(buff.data(), &header, sizeof(header));
+    buff[sizeof(header)] = static_cast<uint8_t>(size >> 8);
+    buff[sizeof(header) + 1] = static_cast<uint8_t>(size & 0xff);
+    memcpy(buff.data() + sizeof(header) + LENGTH_PREFIX_SIZE, fragment.data,
+           size);
+    max_coded_size = std::max(max_coded_size, LENGTH_PREFIX_SIZE + size);
+    m_packets.push_back({nullptr, buff.size()});
+  }
+  for (int i = 0; i < n_secondary; i++) {
+    auto& buff = next_buffer();
+    buff.assign(sizeof(UDPFecHeader) + max_coded_size, 0);
+    header.fragment_idx = static_cast<uint8_t>(n_primary + i);
+    memcpy(buff.data(), &header, sizeof(header));
+    for (int j = 0; j < n_primary; j++) {
+      const auto& primary = m_buffers[first_buffer + j];
+      mul_add(buff.data() + sizeof(header), primary.data() + sizeof(header),
+              primary.size() - sizeof(header), cauchy(n_primary + i, j));
+    }
+    m_packets.push_back({nullptr, buff.size()});
+  }
+}
+
+std::string openhd::UDPFecDecoderStats::to_string() const {
+  std::stringstream ss;
+  ss << "UDPFecDecoderStats{blocks:" << n_blocks
+     << " recovered:" << n_blocks_recovered << " lost:" << n_blocks_lost
+     << " fragments recovered:" << n_fragments_recovered
+     << " lost:" << n_fragments_lost << " invalid:" << n_invalid
+     << " resyncs:" << n_resyncs << "}";
+  return ss.str();
+}
+
+openhd::UDPFecDecoder::UDPFecDecoder(OUTPUT_CB cb) : m_cb(std::move(cb)) {}
+
+openhd::UDPFecDecoder::Block* openhd::UDPFecDecoder::get_block(
+    const UDPFecHeader& header) {
+  const uint32_t block_idx = ntohl(header.block_idx);
+  if (m_has_last_done) {
+    const auto diff = static_cast<int32_t>(block_idx - m_last_done_block_idx);
+    if (diff <= 0) {
+      const bool restarted =
+          diff < -RESYNC_BLOCKS ||
+          std::chrono::steady_clock::now() - m_last_done_time > RESYNC_TIMEOUT;
+      // Late / duplicate
+      if (!restarted) return nullptr;
+      // Sender restarted - whatever is pending belongs to the old stream
+      // 发送端已重启 - 丢弃旧流中未完成的块，从新的块索引重新开始
+      m_stats.n_resyncs++;
+      m_blocks.clear();
+      m_has_last_done = false;
+    }
+  }
+  auto it = m_blocks.begin();
+  for (; it != m_blocks.end(); ++it) {
+    const auto diff = static_cast<int32_t>(block_idx - (*it)->block_idx);
+    if (diff == 0) {
+      auto& block = **it;
+      if (block.n_primary != header.n_primary ||
+          block.n_secondary != header.n_secondary) {
+        return nullptr;
+      }
+      return &block;
+    }
+    if (diff < 0) break;
+  }
+  auto block = std::make_unique<Block>();
+  block->block_idx = block_idx;
+  block->n_primary = header.n_primary;
+  block->n_secondary = header.n_secondary;
+  const int n_total = block->n_primary + block->n_secondary;
+  block->fragments.resize(n_total);
+  block->received.resize(n_total, false);
+  return m_blocks.insert(it, std::move(block))->get();
+}
+
+void openhd::UDPFecDecoder::process_packet(const uint8_t* data,
+                                           std::size_t data_len) {
+  if (!is_udp_fec_packet(data, data_len)) {
+    m_stats.n_invalid++;
+    return;
+  }
+  UDPFecHeader header{};
+  memcpy(&header, data, sizeof(header));
+  if (header.n_primary == 0 ||
+      header.fragment_idx >= header.n_primary + header.n_secondary) {
+    m_stats.n_invalid++;
+    return;
+  }
+  Block* block = get_block(header);
+  if (block == nullptr || block->received[header.fragment_idx]) return;
+  block->fragments[header.fragment_idx].assign(data + sizeof(header),
+                                               data + data_len);
+  block->received[header.fragment_idx] = true;
+  block->n_received++;
+  while (!m_blocks.empty()) {
+    auto& front = *m_blocks.front();
+    forward_in_order(front);
+    if (front.n_forwarded < front.n_primary &&
+        front.n_received >= front.n_primary) {
+      recover(front);
+    }
+    if (front.n_forwarded < front.n_primary) {
+      // A newer block being complete means whatever is missing here was lost
+      // (unless the link reorders)
+      const bool newer_complete = std::any_of(
+          m_blocks.begin() + 1, m_blocks.end(),
+          [](const auto& b) { return b->n_received >= b->n_primary; });
+      if (!newer_complete &&
+          m_blocks.size() <= static_cast<std::size_t>(RX_WINDOW_BLOCKS)) {
+        break;
+      }
+      give_up(front);
+    }
+    m_stats.n_blocks++;
+    m_has_last_done = true;
+    m_last_done_block_idx = front.block_idx;
+    m_last_done_time = std::chrono::steady_clock::now();
+    m_blocks.pop_front();
+  }
+}
+
+void openhd::UDPFecDecoder::forward_in_order(Block& block) {
+  while (block.n_forwarded < block.n_primary &&
+         block.received[block.n_forwarded]) {
+    const auto& coded = block.fragments[block.n_forwarded];
+    block.n_forwarded++;
+    if (coded.size() < LENGTH_PREFIX_SIZE) continue;
+    const std::size_t size = (coded[0] << 8) | coded[1];
+    if (size + LENGTH_PREFIX_SIZE > coded.size()) {
+      m_stats.n_invalid++;
+      continue;
+    }
+    m_cb(coded.data() + LENGTH_PREFIX_SIZE, static_cast<int>(size));
+  }
+}
+
+void openhd::UDPFecDecoder::recover(Block& block) {
+  const int k = block.n_primary;
+  // k received fragments, primaries first
+  std::vector<int> used;
+  for (int i = 0; i < k; i++) {
+    if (block.received[i]) used.push_back(i);
+  }
+  std::size_t coded_size = 0;
+  for (int i = k; i < k + block.n_secondary && (int)used.size() < k; i++) {
+    if (block.received[i]) {
+      used.push_back(i);
+      coded_size = std::max(coded_size, block.fragments[i].size());
+    }
+  }
+  std::vector<uint8_t> matrix(k * k, 0);
+  for (int row = 0; row < k; row++) {
+    const int r = used[row];
+    for (int j = 0; j < k; j++) {
+      matrix[row * k + j] = r < k ? (r == j ? 1 : 0) : cauchy(r, j);
+    }
+  }
+  if (!invert(matrix, k)) {
+    m_stats.n_invalid++;
+    return;
+  }
+  // Primaries are shorter than the parity - zero padded
+  for (int r : used) block.fragments[r].resize(coded_size, 0);
+  for (int j = 0; j < k; j++) {
+    if (block.received[j]) continue;
+    auto& fragment = block.fragments[j];
+    fragment.assign(coded_size, 0);
+    for (int row = 0; row < k; row++) {
+      mul_add(fragment.data(), block.fragments[used[row]].data(), coded_size,
+              matrix[j * k + row]);
+    }
+    block.received[j] = true;
+    m_stats.n_fragments_recovered++;
+  }
+  m_stats.n_blocks_recovered++;
+  forward_in_order(block);
+}
+
+void openhd::UDPFecDecoder::give_up(Block& block) {
+  m_stats.n_blocks_lost++;
+  while (block.n_forwarded < block.n_primary) {
+    if (!block.received[block.n_forwarded]) {
+      m_stats.n_fragments_lost++;
+      block.n_forwarded++;
+      continue;
+    }
+    forward_in_order(block);
+  }
+}
@@ -0,0 +1,63 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "openhd_video_latency.h"
+
+#include <algorithm>
+#include <limits>
+
+void openhd::VideoLatencyTracker::add_sample(int stream_index,
+                                             int64_t latency_us) {
+  if (stream_index < 0 || stream_index >= MAX_N_STREAMS) return;
+  const auto clamped = std::clamp<int64_t>(
+      latency_us, 0, std::numeric_limits<int32_t>::max());
+  std::lock_guard<std::mutex> guard(m_mutex);
+  auto& samples = m_samples[stream_index];
+  if (samples.size() < MAX_N_SAMPLES) {
+    samples.push_back(static_cast<int32_t>(clamped));
+  }
+}
+
+openhd::StatsVideoLatency openhd::VideoLatencyTracker::get_and_reset(
+    int stream_index) {
+  StatsVideoLatency ret{};
+  ret.link_index = static_cast<uint8_t>(stream_index);
+  if (stream_index < 0 || stream_index >= MAX_N_STREAMS) return ret;
+  std::vector<int32_t> samples;
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    samples.swap(m_samples[stream_index]);
+    m_samples[stream_index].reserve(samples.size());
+  }
+  if (samples.empty()) return ret;
+  std::sort(samples.begin(), samples.end());
+  const auto percentile = [&samples](int p) {
+    return samples[(samples.size() - 1) * p / 100];
+  };
+  ret.n_samples = samples.size();
+  ret.p50_us = percentile(50);
+  ret.p90_us = percentile(90);
+  ret.p99_us = percentile(99);
+  ret.max_us = samples.back();
+  return ret;
+}
@@ -0,0 +1,69 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#ifndef OPENHD_OPENHD_OHD_COMMON_TEST_OPENHD_TEST_HELPER_H_
+#define OPENHD_OPENHD_OHD_COMMON_TEST_OPENHD_TEST_HELPER_H_
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Shared by the benchmark like tests of all modules
+namespace openhd_test_helper {
+
+inline uint64_t now_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// User + system time of the whole process
+inline double get_cpu_time_s() {
+  struct rusage usage {};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// p in [0,1], 0 if there are no values
+template <class T>
+inline T percentile(std::vector<T> values, double p) {
+  if (values.empty()) return 0;
+  const auto n = static_cast<std::size_t>(p * (values.size() - 1));
+  std::nth_element(values.begin(), values.begin() + n, values.end());
+  return values[n];
+}
+
+inline bool check(bool ok, const std::string& what) {
+  std::cout << (ok ? "OK     " : "FAILED ") << what << std::endl;
+  return ok;
+}
+
+}  // namespace openhd_test_helper
+
+#endif  // OPENHD_OPENHD_OHD_COMMON_TEST_OPENHD_TEST_HELPER_H_
@@ -0,0 +1,131 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "openhd_buffer_pool.h"
+
+// Counts the heap allocations of the whole process. The deletes are noinline,
+// otherwise gcc warns about the malloc / free pair.
+static std::atomic<uint64_t> n_allocations{0};
+
+void* operator new(std::size_t size) {
+  n_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* ret = std::malloc(size == 0 ? 1 : size)) return ret;
+  throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+// Buffers are recycled and the counters add up
+static void test_recycle() {
+  auto pool = openhd::BufferPool::create("test", 1500, 4);
+  const uint8_t data[] = {1, 2, 3, 4};
+  {
+    auto buff = pool->get_buffer_and_copy(data, sizeof(data));
+    if (buff->size() != sizeof(data) || (*buff)[3] != 4) {
+      throw std::runtime_error("Wrong buffer content\n");
+    }
+  }
+  std::vector<std::shared_ptr<std::vector<uint8_t>>> in_use;
+  for (int i = 0; i < 6; i++) {
+    in_use.push_back(pool->get_buffer());
+  }
+  auto stats = pool->get_stats();
+  std::cout << stats.to_string() << "\n";
+  if (stats.n_hits != 5 || stats.n_misses != 2 || stats.n_in_use != 6 ||
+      stats.high_water_mark != 6) {
+    throw std::runtime_error("Stats do not match expected\n");
+  }
+  in_use.clear();
+  stats = pool->get_stats();
+  if (stats.n_in_use != 0) {
+    throw std::runtime_error("Buffers were not given back\n");
+  }
+}
+
+// Neither the buffer nor the shared_ptr control block is allocated on a hit
+static void test_no_allocation() {
+  auto pool = openhd::BufferPool::create("test_alloc", 1500, 4);
+  const uint8_t data[1400] = {};
+  const auto n_allocations_begin = n_allocations.load();
+  for (int i = 0; i < 1000; i++) {
+    auto buff = pool->get_buffer_and_copy(data, sizeof(data));
+    auto copy = buff;
+  }
+  const auto n = n_allocations.load() - n_allocations_begin;
+  std::cout << "Allocations:" << n << "\n";
+  if (n != 0) {
+    throw std::runtime_error("get_buffer allocated\n");
+  }
+}
+
+// Hammer the pool from multiple producer / consumer threads
+static void test_multi_threaded() {
+  auto pool = openhd::BufferPool::create("test_mt", 1500, 256);
+  static constexpr int N_THREADS = 4;
+  static constexpr int N_ITERATIONS = 1000000;
+  const auto begin = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < N_THREADS; t++) {
+    threads.emplace_back([&pool]() {
+      std::vector<std::shared_ptr<std::vector<uint8_t>>> buffers;
+      for (int i = 0; i < N_ITERATIONS; i++) {
+        buffers.push_back(pool->get_buffer());
+        buffers.back()->resize(1440);
+        if (buffers.size() > 32) buffers.clear();
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  const auto elapsed = std::chrono::steady_clock::now() - begin;
+  const auto stats = pool->get_stats();
+  std::cout << stats.to_string() << " took "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed)
+                   .count()
+            << "ms\n";
+  if (stats.n_in_use != 0 ||
+      stats.n_hits + stats.n_misses != (uint64_t)N_THREADS * N_ITERATIONS) {
+    throw std::runtime_error("Stats do not match expected\n");
+  }
+}
+
+int main(int argc, char* argv[]) {
+  test_recycle();
+  test_no_allocation();
+  test_multi_threaded();
+  std::cout << "Done\n";
+  return 0;
+}
@@ -0,0 +1,254 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include <atomic>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "openhd_link_emulator.h"
+#include "openhd_test_helper.h"
+
+//
+// End to end benchmark of the emulated link under the impairment presets -
+// telemetry RTT (ground pings, air echoes), video latency / delivery
+// (60fps, ~8.6MBit/s, air to ground) and the longest video outage. Also
+// validates determinism of the loss model and the unix socket transport.
+// 模拟链路在各损伤预设下的端到端基准测试 - 遥测 RTT（地面 ping，空中回显）、视频延迟/投递率以及
+// 最长的视频中断。同时验证丢包模型的确定性和 unix socket 传输。
+//
+// Usage: test_link_emulator [profile] (e.g. "marginal,delay=20")
+using namespace openhd_test_helper;
+
+namespace {
+
+constexpr int FPS = 60;
+constexpr int FRAGMENTS_PER_FRAME = 15;
+constexpr int FRAGMENT_SIZE = 1200;
+constexpr int PING_INTERVAL_MS = 10;
+constexpr auto SOCKET_PATH = "/tmp/test_openhd_emulated_link";
+
+// seq, send time
+std::vector<uint8_t> create_packet(uint32_t seq, int size) {
+  std::vector<uint8_t> ret(size, 0xAB);
+  const int64_t ts = now_us();
+  memcpy(ret.data(), &seq, sizeof(seq));
+  memcpy(ret.data() + 4, &ts, sizeof(ts));
+  return ret;
+}
+
+int64_t get_latency_us(const uint8_t* data) {
+  int64_t ts;
+  memcpy(&ts, data + 4, sizeof(ts));
+  return now_us() - ts;
+}
+
+struct Result {
+  int n_pings = 0;
+  std::vector<int64_t> rtts_us;
+  int n_fragments = 0;
+  std::vector<int64_t> video_latencies_us;
+  int64_t longest_outage_us = 0;
+  double video_kbits = 0;
+  double tele_loss_perc() const {
+    return 100.0 * (n_pings - rtts_us.size()) / std::max(n_pings, 1);
+  }
+  double video_loss_perc() const {
+    return 100.0 * (n_fragments - video_latencies_us.size()) /
+           std::max(n_fragments, 1);
+  }
+};
+
+Result run(const std::shared_ptr<openhd::EmulatedLink>& air,
+           const std::shared_ptr<openhd::EmulatedLink>& ground,
+           int duration_ms) {
+  Result result;
+  std::mutex mutex;
+  int64_t last_video_us = 0;
+  int64_t video_bytes = 0;
+  // air echoes telemetry back
+  std::weak_ptr<openhd::EmulatedLink> weak_air = air;
+  air->register_on_receive_telemetry_data_cb(
+      [weak_air](std::shared_ptr<std::vector<uint8_t>> data) {
+        if (auto air = weak_air.lock()) {
+          air->transmit_telemetry_data({std::move(data), 1});
+        }
+      });
+  ground->register_on_receive_telemetry_data_cb(
+      [&](std::shared_ptr<std::vector<uint8_t>> data) {
+        std::lock_guard<std::mutex> lock(mutex);
+        result.rtts_us.push_back(get_latency_us(data->data()));
+      });
+  ground->register_on_receive_video_data_cb(
+      [&](int stream_index, const uint8_t* data, int data_len) {
+        std::lock_guard<std::mutex> lock(mutex);
+        const int64_t now = now_us();
+        if (last_video_us != 0) {
+          result.longest_outage_us =
+              std::max(result.longest_outage_us, now - last_video_us);
+        }
+        last_video_us = now;
+        video_bytes += data_len;
+        result.video_latencies_us.push_back(get_latency_us(data));
+      });
+  std::atomic<bool> run_pings{true};
+  std::thread ping_thread([&]() {
+    uint32_t seq = 0;
+    while (run_pings) {
+      ground->transmit_telemetry_data(
+          {std::make_shared<std::vector<uint8_t>>(create_packet(seq++, 40)), 1});
+      std::this_thread::sleep_for(std::chrono::milliseconds(PING_INTERVAL_MS));
+    }
+    result.n_pings = static_cast<int>(seq);
+  });
+  const auto begin = std::chrono::steady_clock::now();
+  uint32_t seq = 0;
+  const int n_frames = duration_ms * FPS / 1000;
+  for (int i = 0; i < n_frames; i++) {
+    std::this_thread::sleep_until(begin +
+                                  std::chrono::microseconds(1000000LL * i / FPS));
+    openhd::FragmentedVideoFrame frame;
+    for (int j = 0; j < FRAGMENTS_PER_FRAME; j++) {
+      const auto packet = create_packet(seq++, FRAGMENT_SIZE);
+      frame.rtp_fragments.push_back(
+          openhd::make_video_fragment(packet.data(), packet.size()));
+    }
+    air->transmit_video_data(0, frame);
+  }
+  run_pings = false;
+  ping_thread.join();
+  // let everything in flight arrive
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  air->register_on_receive_telemetry_data_cb(nullptr);
+  ground->register_on_receive_telemetry_data_cb(nullptr);
+  ground->register_on_receive_video_data_cb(nullptr);
+  std::lock_guard<std::mutex> lock(mutex);
+  result.n_fragments = static_cast<int>(seq);
+  result.video_kbits = video_bytes * 8.0 / duration_ms;
+  return result;
+}
+
+void print(const std::string& tag, const Result& result) {
+  std::cout << std::left << std::setw(10) << tag << std::right << std::fixed
+            << std::setprecision(1) << " rtt p50:" << std::setw(6)
+            << percentile(result.rtts_us, 0.5) / 1000.0
+            << "ms p99:" << std::setw(6) << percentile(result.rtts_us, 0.99) / 1000.0
+            << "ms lost:" << std::setw(5) << result.tele_loss_perc()
+            << "% | video p50:" << std::setw(6)
+            << percentile(result.video_latencies_us, 0.5) / 1000.0
+            << "ms p99:" << std::setw(6)
+            << percentile(result.video_latencies_us, 0.99) / 1000.0
+            << "ms lost:" << std::setw(5) << result.video_loss_perc()
+            << "% " << std::setw(6) << result.video_kbits / 1000
+            << "MBit/s outage:" << std::setw(6)
+            << result.longest_outage_us / 1000.0 << "ms" << std::endl;
+}
+
+// Same seed and send pattern - same losses
+bool check_deterministic() {
+  const auto impairment = openhd::LinkImpairment::from_string("bad,bw=0").value();
+  std::vector<openhd::EmulatedChannelStats> stats;
+  for (int run = 0; run < 2; run++) {
+    openhd::EmulatedChannel channel(
+        impairment, [](openhd::EmulatedPacketType, const uint8_t*, int) {});
+    const std::vector<uint8_t> packet(100);
+    for (int i = 0; i < 10000; i++) {
+      channel.send(openhd::EmulatedPacketType::TELEMETRY, packet.data(),
+                   static_cast<int>(packet.size()));
+    }
+    stats.push_back(channel.get_stats());
+  }
+  std::cout << "deterministic " << stats[0].to_string() << std::endl;
+  return check(stats[0].n_lost == stats[1].n_lost && stats[0].n_lost > 0,
+               "deterministic");
+}
+
+bool check_unix_socket() {
+  const auto impairment = openhd::LinkImpairment::from_string("good").value();
+  auto ground = openhd::EmulatedLink::create_unix(false, SOCKET_PATH, impairment);
+  auto air = openhd::EmulatedLink::create_unix(true, SOCKET_PATH, impairment);
+  if (!check(ground && air, "unix socket create")) return false;
+  for (int i = 0; i < 200 && !(air->is_connected() && ground->is_connected());
+       i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  if (!check(air->is_connected() && ground->is_connected(),
+             "unix socket connect")) {
+    return false;
+  }
+  const auto result = run(air, ground, 1000);
+  print("unix", result);
+  return check(result.tele_loss_perc() < 5 && result.video_loss_perc() < 5,
+               "unix socket");
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  openhd::log::get_default()->set_level(spdlog::level::warn);
+  if (argc > 1) {
+    const auto impairment = openhd::LinkImpairment::from_string(argv[1]);
+    if (!impairment.has_value()) {
+      std::cerr << "Invalid profile " << argv[1] << std::endl;
+      return 1;
+    }
+    auto link = openhd::EmulatedLink::create_pair(impairment.value(),
+                                                  impairment.value());
+    print("custom", run(link.first, link.second, 5000));
+    return 0;
+  }
+  bool ok = true;
+  std::vector<std::pair<std::string, Result>> results;
+  for (const auto& profile : {"ideal", "good", "marginal", "bad", "burst"}) {
+    const auto impairment = openhd::LinkImpairment::from_string(profile).value();
+    auto link = openhd::EmulatedLink::create_pair(impairment, impairment);
+    const auto result = run(link.first, link.second, 2000);
+    print(profile, result);
+    results.emplace_back(profile, result);
+    if (impairment.bandwidth_kbits > 0) {
+      ok &= check(result.video_kbits < impairment.bandwidth_kbits * 1.05,
+                  std::string(profile) + " bandwidth");
+    }
+  }
+  const auto& ideal = results[0].second;
+  ok &= check(ideal.tele_loss_perc() == 0 && ideal.video_loss_perc() == 0,
+              "ideal no loss");
+  ok &= check(percentile(ideal.rtts_us, 0.5) < 2000, "ideal rtt");
+  const auto& good = results[1].second;
+  const auto& bad = results[3].second;
+  ok &= check(bad.video_loss_perc() > good.video_loss_perc(), "bad > good loss");
+  ok &= check(percentile(bad.rtts_us, 0.5) >= 20 * 1000, "bad delay");
+  const auto& burst = results[4].second;
+  ok &= check(burst.longest_outage_us > bad.longest_outage_us, "burst outage");
+  ok &= check_deterministic();
+  ok &= check_unix_socket();
+  ok &= check(!openhd::LinkImpairment::from_string("foo").has_value() &&
+                  !openhd::LinkImpairment::from_string("good,delay=x").has_value() &&
+                  openhd::LinkImpairment::from_string("delay=5,loss=1")->delay_ms == 5,
+              "parse");
+  std::cout << (ok ? "OK" : "FAILED") << std::endl;
+  return ok ? 0 : 1;
+}
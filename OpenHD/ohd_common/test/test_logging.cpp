@@ -21,11 +21,136 @@
  * © OpenHD, All Rights Reserved.
  ******************************************************************************/
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <spdlog/sinks/stdout_color_sinks.h>
+
 #include "openhd_spdlog.h"
 #include "openhd_spdlog_include.h"
+#include "openhd_test_helper.h"
+
+//
+// Cost of a log call on a video-pipeline-like hot path: 4 threads each copy
+// 1400 byte fragments and make one log call per fragment. Reports the cost of
+// the log call (ns, p50 / p99) for the old (lookup on every call) and the new
+// (cached, rate limited, async) way of logging.
+// 在类似视频管线的热路径上测量日志调用的开销：4 个线程复制 1400 字节的分片，每个分片调用一次日志。
+//
+// Usage: test_logging [n_fragments_per_thread]
+
+namespace {
+
+constexpr int N_THREADS = 4;
+constexpr int FRAGMENT_SIZE = 1400;
+
+// What create_or_get did before - global mutex + registry lookup each call
+std::shared_ptr<spdlog::logger> legacy_create_or_get(const std::string& name) {
+  static std::mutex mutex;
+  std::lock_guard<std::mutex> guard(mutex);
+  return spdlog::get(name);
+}
+
+// stdout / stderr to /dev/null while measuring
+class SilenceOutput {
+ public:
+  SilenceOutput() {
+    fflush(stdout);
+    m_stdout = dup(STDOUT_FILENO);
+    m_stderr = dup(STDERR_FILENO);
+    const int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+    dup2(null_fd, STDERR_FILENO);
+    close(null_fd);
+  }
+  ~SilenceOutput() {
+    openhd::log::flush_all();
+    fflush(stdout);
+    dup2(m_stdout, STDOUT_FILENO);
+    dup2(m_stderr, STDERR_FILENO);
+    close(m_stdout);
+    close(m_stderr);
+  }
+
+ private:
+  int m_stdout;
+  int m_stderr;
+};
+
+template <class LOG>
+void run(const std::string& tag, int n_fragments, LOG log) {
+  std::vector<std::vector<uint32_t>> durations_ns(N_THREADS);
+  {
+    SilenceOutput silence;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < N_THREADS; t++) {
+      threads.emplace_back([&durations_ns, t, n_fragments, &log]() {
+        std::vector<uint8_t> src(FRAGMENT_SIZE, t);
+        std::vector<uint8_t> dst(FRAGMENT_SIZE);
+        auto& durations = durations_ns[t];
+        durations.reserve(n_fragments);
+        for (int i = 0; i < n_fragments; i++) {
+          memcpy(dst.data(), src.data(), FRAGMENT_SIZE);
+          src[i % FRAGMENT_SIZE] = dst[(i + 1) % FRAGMENT_SIZE] + 1;
+          const auto begin = std::chrono::steady_clock::now();
+          log(i);
+          durations.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                  std::chrono::steady_clock::now() - begin)
+                                  .count());
+        }
+      });
+    }
+    for (auto& thread : threads) thread.join();
+  }
+  std::vector<uint32_t> all;
+  for (const auto& durations : durations_ns) {
+    all.insert(all.end(), durations.begin(), durations.end());
+  }
+  using openhd_test_helper::percentile;
+  std::cout << std::left << std::setw(34) << tag << std::right
+            << " p50:" << std::setw(6) << percentile(all, 0.5)
+            << "ns p99:" << std::setw(6) << percentile(all, 0.99) << "ns" << std::endl;
+}
+
+}  // namespace
 
 int main(int argc, char *argv[]) {
   openhd::log::get_default()->debug("Example debug");
   openhd::log::get_default()->warn("Example warn");
-  return 0;
-}
\ No newline at end of file
+  OPENHD_WARN_EVERY_MS(openhd::log::get_default(), 1000, "Example rate limited warn");
+  const int n_fragments = argc > 1 ? std::max(1000, std::atoi(argv[1])) : 100000;
+  // Filtered (debug) - the common case on the hot path
+  run("lookup each call, filtered", n_fragments, [](int i) {
+    legacy_create_or_get("default")->debug("fragment {}", i);
+  });
+  run("cached handle, filtered", n_fragments, [](int i) {
+    openhd::log::get_default()->debug("fragment {}", i);
+  });
+  // Emitted (warn)
+  run("rate limited warn", n_fragments, [](int i) {
+    OPENHD_WARN_EVERY_MS(openhd::log::get_default(), 100, "fragment {}", i);
+  });
+  auto sync_logger = spdlog::stdout_color_mt("sync");
+  run("sync warn (stdout)", n_fragments / 10,
+      [&sync_logger](int i) { sync_logger->warn("fragment {}", i); });
+  run("async warn (default)", n_fragments / 10, [](int i) {
+    openhd::log::get_default()->warn("fragment {}", i);
+  });
+  // Nothing suppressed for real
+  uint32_t n_suppressed = 0;
+  openhd::log::RateLimiter limiter{1000};
+  bool ok = limiter.allow(n_suppressed) && !limiter.allow(n_suppressed) &&
+            !limiter.allow(n_suppressed);
+  std::cout << (ok ? "OK" : "FAILED") << std::endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "openhd_netlink.h"
+#include "openhd_util.h"
+
+// Prints the initial dump and checks loopback is there
+static void test_dump() {
+  auto& cache = openhd::NetlinkCache::instance();
+  if (!cache.is_valid()) {
+    throw std::runtime_error("Cannot open netlink\n");
+  }
+  for (const auto& link : cache.get_links()) {
+    std::cout << "Link " << link.ifindex << " " << link.name
+              << " up:" << link.is_up() << "\n";
+    for (const auto& route : cache.get_routes(link.name)) {
+      std::cout << "  Route " << (route.is_default() ? "default" : route.dst)
+                << "/" << (int)route.dst_len << " via:" << route.gateway
+                << " src:" << route.prefsrc << " metric:" << route.metric
+                << "\n";
+    }
+  }
+  for (const auto& address : cache.get_addresses()) {
+    std::cout << "Address " << address.ip << "/" << (int)address.prefix_len
+              << " ifindex:" << address.ifindex << "\n";
+  }
+  if (!cache.get_link("lo").has_value() ||
+      !cache.is_local_address("127.0.0.1")) {
+    throw std::runtime_error("Loopback missing\n");
+  }
+  if (cache.is_local_address("203.0.113.77")) {
+    throw std::runtime_error("Not a local address\n");
+  }
+}
+
+// Waits (event driven) until the condition is true, returns the time it took
+// or -1 on timeout
+template <class PRED>
+static int wait_for(PRED pred) {
+  auto& cache = openhd::NetlinkCache::instance();
+  const auto begin = std::chrono::steady_clock::now();
+  uint64_t generation = cache.get_generation();
+  while (!pred()) {
+    if (std::chrono::steady_clock::now() - begin > std::chrono::seconds(2)) {
+      return -1;
+    }
+    generation =
+        cache.wait_for_change(generation, std::chrono::milliseconds(100));
+  }
+  return static_cast<int>(std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::steady_clock::now() - begin)
+                              .count());
+}
+
+// Emulates a usb tethering device (needs root) with a veth pair - link,
+// address and default route changes must show up without polling.
+static void test_events() {
+  auto& cache = openhd::NetlinkCache::instance();
+  int n_callbacks = 0;
+  const int listener_id =
+      cache.register_listener([&n_callbacks]() { n_callbacks++; });
+  if (OHDUtil::run_command("ip",
+                           {"link add ohdtest0 type veth peer name ohdtest1"},
+                           false) != 0) {
+    std::cout << "Cannot create veth (not root ?), skipping events\n";
+    cache.unregister_listener(listener_id);
+    return;
+  }
+  int took_us = wait_for([&cache]() {
+    return cache.get_link("ohdtest0").has_value();
+  });
+  std::cout << "Link added after " << took_us << "us\n";
+  if (took_us < 0) throw std::runtime_error("Link not added\n");
+  OHDUtil::run_command("ip", {"link set ohdtest1 up"}, false);
+  OHDUtil::run_command("ip", {"link set ohdtest0 up"}, false);
+  OHDUtil::run_command("ip", {"addr add 10.254.0.1/24 dev ohdtest0"}, false);
+  OHDUtil::run_command(
+      "ip", {"route add default via 10.254.0.2 dev ohdtest0 metric 999"},
+      false);
+  took_us = wait_for([&cache]() {
+    return cache.is_link_up("ohdtest0") &&
+           cache.is_local_address("10.254.0.1") &&
+           cache.get_default_gateway("ohdtest0") == "10.254.0.2";
+  });
+  std::cout << "Link up, address and gateway after " << took_us << "us\n";
+  if (took_us < 0) throw std::runtime_error("Link not configured\n");
+  OHDUtil::run_command("ip", {"link del ohdtest0"}, false);
+  took_us = wait_for([&cache]() {
+    return !cache.get_link("ohdtest0").has_value() &&
+           !cache.is_local_address("10.254.0.1") &&
+           !cache.get_default_gateway("ohdtest0").has_value();
+  });
+  std::cout << "Link removed after " << took_us << "us\n";
+  if (took_us < 0) throw std::runtime_error("Link not removed\n");
+  cache.unregister_listener(listener_id);
+  std::cout << "Listener called " << n_callbacks << " times\n";
+  if (n_callbacks == 0) throw std::runtime_error("Listener not called\n");
+}
+
+int main(int argc, char *argv[]) {
+  test_dump();
+  test_events();
+  std::cout << "Done\n";
+  return 0;
+}
@@ -0,0 +1,274 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include "openhd_spdlog_include.h"
+#include "openhd_tcp.h"
+#include "openhd_test_helper.h"
+
+//
+// Load test of the TCP (telemetry) server - 32 simulated GCS clients on
+// localhost, 30 of them read as fast as they can, 2 are (way too) slow.
+// Every client also sends a small message every 100ms.
+// Validates that the fast clients get every message in order (not slowed down
+// by the slow ones), that the slow clients only lose whole messages and that
+// their queue stays bounded. Reports CPU usage (server + clients, whole
+// process) and the per-client lag.
+// TCP（遥测）服务器负载测试 - 本地 32 个模拟地面站客户端，其中 2 个读取过慢。
+// 验证快速客户端按顺序收到所有消息，慢速客户端只丢失完整的消息且队列有界。
+//
+// Usage: test_tcp_server_load [seconds]
+using namespace openhd_test_helper;
+
+namespace {
+
+constexpr int TEST_PORT = 14450;
+constexpr int N_CLIENTS = 32;
+constexpr int N_SLOW_CLIENTS = 2;
+// About the size of a big mavlink message
+constexpr int MESSAGE_SIZE = 280;
+constexpr int MESSAGES_PER_S = 5000;
+constexpr uint32_t MAGIC = 0x4F484454;
+
+class TestServer : public openhd::TCPServer {
+ public:
+  TestServer() : openhd::TCPServer("TestLoad", openhd::TCPServer::Config{TEST_PORT}) {}
+  void on_external_device(std::string ip, int port, bool connected) override {
+    n_connected += connected ? 1 : -1;
+  }
+  void on_packet_any_tcp_client(const uint8_t* data, int data_len) override {
+    n_bytes_received += data_len;
+  }
+  std::atomic<int> n_connected{0};
+  std::atomic<uint64_t> n_bytes_received{0};
+};
+
+// A simulated GCS
+struct Client {
+  int sock_fd = -1;
+  int local_port = 0;
+  bool slow = false;
+  std::thread rx_thread;
+  std::thread tx_thread;
+  std::atomic<bool> stop{false};
+  // Written by rx_thread, read after join
+  uint32_t n_messages = 0;
+  uint32_t n_gaps = 0;
+  uint32_t n_broken = 0;
+  int64_t last_seq = -1;
+  std::vector<uint32_t> lags_us;
+  uint64_t n_bytes_sent = 0;
+
+  bool connect_to_server() {
+    sock_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (slow) {
+      // Such that the kernel buffers fill up fast
+      const int rcvbuf = 4096;
+      setsockopt(sock_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+    struct sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(TEST_PORT);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (connect(sock_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+      return false;
+    }
+    socklen_t len = sizeof(addr);
+    getsockname(sock_fd, (struct sockaddr*)&addr, &len);
+    local_port = ntohs(addr.sin_port);
+    rx_thread = std::thread([this]() { loop_rx(); });
+    tx_thread = std::thread([this]() { loop_tx(); });
+    return true;
+  }
+  void on_message(const uint8_t* data) {
+    uint32_t magic, seq;
+    uint64_t ts;
+    memcpy(&magic, data, sizeof(magic));
+    memcpy(&seq, data + 4, sizeof(seq));
+    memcpy(&ts, data + 8, sizeof(ts));
+    if (magic != MAGIC) {
+      n_broken++;
+      return;
+    }
+    if (last_seq >= 0 && seq != last_seq + 1) n_gaps++;
+    last_seq = seq;
+    n_messages++;
+    lags_us.push_back(static_cast<uint32_t>(now_us() - ts));
+  }
+  void loop_rx() {
+    std::vector<uint8_t> stream;
+    std::vector<uint8_t> buff(slow ? MESSAGE_SIZE : 64 * 1024);
+    while (!stop) {
+      const ssize_t ret = recv(sock_fd, buff.data(), buff.size(), 0);
+      if (ret <= 0) break;
+      stream.insert(stream.end(), buff.data(), buff.data() + ret);
+      std::size_t consumed = 0;
+      while (stream.size() - consumed >= MESSAGE_SIZE) {
+        on_message(stream.data() + consumed);
+        consumed += MESSAGE_SIZE;
+      }
+      stream.erase(stream.begin(), stream.begin() + consumed);
+      if (slow) std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+  }
+  void loop_tx() {
+    // heartbeat sized
+    const std::vector<uint8_t> heartbeat(21, 0xFD);
+    while (!stop) {
+      if (send(sock_fd, heartbeat.data(), heartbeat.size(), MSG_NOSIGNAL) > 0) {
+        n_bytes_sent += heartbeat.size();
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+  }
+  void shutdown_socket() {
+    stop = true;
+    shutdown(sock_fd, SHUT_RDWR);
+  }
+  void join_and_close() {
+    rx_thread.join();
+    tx_thread.join();
+    close(sock_fd);
+  }
+};
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  // Shorter, and the slow clients might not get past the kernel buffers
+  const int duration_s = argc > 1 ? std::max(3, std::atoi(argv[1])) : 3;
+  openhd::log::get_default()->set_level(spdlog::level::warn);
+  TestServer server;
+  std::vector<std::unique_ptr<Client>> clients;
+  for (int i = 0; i < N_CLIENTS; i++) {
+    auto client = std::make_unique<Client>();
+    client->slow = i < N_SLOW_CLIENTS;
+    if (!client->connect_to_server()) {
+      std::cerr << "Cannot connect to server" << std::endl;
+      return 1;
+    }
+    clients.push_back(std::move(client));
+  }
+  while (server.n_connected < N_CLIENTS) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  std::cout << N_CLIENTS << " clients (" << N_SLOW_CLIENTS << " slow), "
+            << MESSAGES_PER_S << " messages/s of " << MESSAGE_SIZE
+            << " bytes, " << duration_s << "s" << std::endl;
+  // Paced in bursts of 10ms, messages aggregated up to 1024 bytes per send
+  // like TCPEndpoint does
+  const int messages_per_burst = MESSAGES_PER_S / 100;
+  const int messages_per_send = 1024 / MESSAGE_SIZE;
+  const int n_bursts = duration_s * 100;
+  uint32_t seq = 0;
+  std::vector<uint8_t> aggregated(messages_per_send * MESSAGE_SIZE, 0xAB);
+  std::size_t max_queue_size = 0;
+  const double cpu_begin = get_cpu_time_s();
+  const auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < n_bursts; i++) {
+    std::this_thread::sleep_until(begin + std::chrono::milliseconds(10 * i));
+    for (int j = 0; j < messages_per_burst; j += messages_per_send) {
+      const int n_messages = std::min(messages_per_send, messages_per_burst - j);
+      const uint64_t ts = now_us();
+      for (int k = 0; k < n_messages; k++) {
+        uint8_t* message = aggregated.data() + k * MESSAGE_SIZE;
+        memcpy(message, &MAGIC, sizeof(MAGIC));
+        memcpy(message + 4, &seq, sizeof(seq));
+        memcpy(message + 8, &ts, sizeof(ts));
+        seq++;
+      }
+      server.send_message_to_all_clients(aggregated.data(),
+                                         n_messages * MESSAGE_SIZE);
+    }
+    for (const auto& stats : server.get_client_stats()) {
+      max_queue_size = std::max(max_queue_size, stats.queue_size_bytes);
+    }
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  const double wall_s =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - begin)
+          .count();
+  const double cpu_s = get_cpu_time_s() - cpu_begin;
+  std::map<int, openhd::TCPServer::ClientStats> server_stats;
+  for (const auto& stats : server.get_client_stats()) {
+    server_stats[stats.port] = stats;
+  }
+  uint64_t n_bytes_sent_by_clients = 0;
+  for (auto& client : clients) {
+    client->shutdown_socket();
+  }
+  for (auto& client : clients) {
+    client->join_and_close();
+    n_bytes_sent_by_clients += client->n_bytes_sent;
+  }
+  const uint32_t n_sent = seq;
+  bool ok = true;
+  bool fast_ok = true;
+  uint32_t worst_p99 = 0;
+  uint32_t worst_max = 0;
+  std::vector<uint32_t> all_lags;
+  for (int i = N_SLOW_CLIENTS; i < N_CLIENTS; i++) {
+    auto& client = *clients[i];
+    fast_ok &= client.n_messages == n_sent && client.n_gaps == 0 &&
+               client.n_broken == 0;
+    all_lags.insert(all_lags.end(), client.lags_us.begin(),
+                    client.lags_us.end());
+    worst_p99 = std::max(worst_p99, percentile(client.lags_us, 0.99));
+    worst_max = std::max(worst_max, percentile(client.lags_us, 1.0));
+  }
+  std::cout << std::fixed << std::setprecision(1)
+            << "CPU:" << 100 * cpu_s / wall_s << "% fast client lag p50:"
+            << percentile(all_lags, 0.5) << "us p99:"
+            << percentile(all_lags, 0.99) << "us worst client p99:" << worst_p99
+            << "us max:" << worst_max << "us" << std::endl;
+  ok &= check(fast_ok, "fast clients got all messages in order");
+  for (int i = 0; i < N_SLOW_CLIENTS; i++) {
+    auto& client = *clients[i];
+    const auto& stats = server_stats[client.local_port];
+    std::cout << "slow client received:" << client.n_messages << "/" << n_sent
+              << " dropped by server:" << stats.n_messages_dropped
+              << " gaps:" << client.n_gaps << " lag:" << stats.lag.count() / 1000
+              << "ms" << std::endl;
+    ok &= check(client.n_broken == 0 && stats.n_messages_dropped > 0 &&
+                    client.n_messages < n_sent,
+                "slow client only loses whole messages");
+  }
+  ok &= check(max_queue_size <= openhd::TCPServer::MAX_CLIENT_QUEUE_BYTES +
+                                    aggregated.size(),
+              "queue bounded");
+  ok &= check(server.n_bytes_received == n_bytes_sent_by_clients,
+              "received from all clients");
+  std::cout << (ok ? "OK" : "FAILED") << std::endl;
+  return ok ? 0 : 1;
+}
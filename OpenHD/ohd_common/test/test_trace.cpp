@@ -0,0 +1,215 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "openhd_trace.h"
+
+static int count_lines(const std::string& filename) {
+  std::ifstream f(filename);
+  int n = 0;
+  std::string line;
+  while (std::getline(f, line)) n++;
+  return n;
+}
+
+// Disabled tracing must be (close to) free
+static void test_disabled_cost() {
+  openhd::trace::set_enabled(false);
+  const int n = 10 * 1000 * 1000;
+  const auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < n; i++) {
+    openhd::trace::record(openhd::trace::Stage::APPSINK_SAMPLE, i, i);
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - begin;
+  std::cout << "Disabled: "
+            << std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                       .count() /
+                   static_cast<double>(n)
+            << "ns/event\n";
+}
+
+// Each thread records into its own ring, a dump contains all of them
+static void test_record_and_dump() {
+  openhd::trace::set_enabled(true);
+  const int n_threads = 4;
+  const int n_events = 1000;
+  std::vector<std::thread> threads;
+  const auto begin = std::chrono::steady_clock::now();
+  for (int t = 0; t < n_threads; t++) {
+    threads.emplace_back([n_events]() {
+      for (int i = 0; i < n_events; i++) {
+        openhd::trace::record(openhd::trace::Stage::LINK_ENQUEUE_BEGIN, i);
+        openhd::trace::record(openhd::trace::Stage::LINK_ENQUEUE_END, i, 0);
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  const auto elapsed = std::chrono::steady_clock::now() - begin;
+  std::cout << "Enabled: "
+            << std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                       .count() /
+                   static_cast<double>(n_threads * n_events * 2)
+            << "ns/event (incl. thread creation)\n";
+  openhd::trace::set_enabled(false);
+  const std::string csv = "/tmp/test_openhd_trace.csv";
+  const std::string json = "/tmp/test_openhd_trace.json";
+  if (!openhd::trace::write_csv(csv) ||
+      !openhd::trace::write_chrome_trace_json(json)) {
+    throw std::runtime_error("Cannot write trace\n");
+  }
+  // header + all events
+  const int n_lines = count_lines(csv);
+  if (n_lines != 1 + n_threads * n_events * 2) {
+    std::stringstream ss;
+    ss << "Expected " << 1 + n_threads * n_events * 2 << " lines, got "
+       << n_lines << "\n";
+    throw std::runtime_error(ss.str());
+  }
+}
+
+// Frame id is the rtp timestamp
+static void test_frame_id() {
+  const uint8_t rtp[] = {0x80, 0x60, 0, 1, 0x12, 0x34, 0x56, 0x78, 0, 0, 0, 0};
+  if (openhd::trace::frame_id_from_rtp(rtp, sizeof(rtp)) != 0x12345678) {
+    throw std::runtime_error("Wrong frame id\n");
+  }
+  if (openhd::trace::frame_id_from_rtp(rtp, 4) != 0) {
+    throw std::runtime_error("Invalid rtp should have frame id 0\n");
+  }
+}
+
+// Counters are per stream and not tied to a frame
+static void test_counter() {
+  openhd::trace::set_enabled(true);
+  openhd::trace::record_counter(openhd::trace::Stage::LINK_TX_DELAY, 1, 42);
+  openhd::trace::set_enabled(false);
+  const std::string csv = "/tmp/test_openhd_trace.csv";
+  if (!openhd::trace::write_csv(csv)) {
+    throw std::runtime_error("Cannot write trace\n");
+  }
+  std::ifstream f(csv);
+  std::string line;
+  bool found = false;
+  while (std::getline(f, line)) {
+    found |= line.find(",link_tx_delay_us,0,42,1") != std::string::npos;
+  }
+  if (!found) {
+    throw std::runtime_error("Counter missing\n");
+  }
+}
+
+// Parses the csv lines of the given stage into (frame_id, value) pairs
+static std::vector<std::pair<long, long>> read_csv_events(
+    const std::string& filename, const std::string& stage) {
+  std::ifstream f(filename);
+  std::string line;
+  std::vector<std::pair<long, long>> ret;
+  const std::string pattern = "," + stage + ",";
+  while (std::getline(f, line)) {
+    const auto pos = line.find(pattern);
+    if (pos == std::string::npos) continue;
+    std::stringstream ss(line.substr(pos + pattern.size()));
+    long frame_id = 0, value = 0;
+    char sep;
+    ss >> frame_id >> sep >> value;
+    ret.emplace_back(frame_id, value);
+  }
+  return ret;
+}
+
+// A dump while a thread records must not contain torn events
+static void test_dump_while_recording() {
+  openhd::trace::set_enabled(true);
+  std::atomic<bool> stop{false};
+  std::thread writer([&stop]() {
+    for (int32_t i = 1; !stop; i++) {
+      openhd::trace::record(openhd::trace::Stage::FRAME_ASSEMBLED, i, i);
+    }
+  });
+  const std::string csv = "/tmp/test_openhd_trace.csv";
+  for (int i = 0; i < 20; i++) {
+    if (!openhd::trace::write_csv(csv)) {
+      throw std::runtime_error("Cannot write trace\n");
+    }
+    for (const auto& event : read_csv_events(csv, "frame_assembled")) {
+      if (event.first != event.second) {
+        throw std::runtime_error("Torn event\n");
+      }
+    }
+  }
+  stop = true;
+  writer.join();
+  openhd::trace::set_enabled(false);
+}
+
+// The ring of an exited thread is re-used by the next thread, without losing
+// the events of the exited one
+static void test_ring_reuse() {
+  openhd::trace::set_enabled(true);
+  // Make sure there is a free ring
+  std::thread([]() {
+    openhd::trace::record(openhd::trace::Stage::GND_VIDEO_RX, 0, 0);
+  }).join();
+  const auto n_rings_before = openhd::trace::get_n_rings();
+  const int n_threads = 50;
+  for (int t = 1; t <= n_threads; t++) {
+    std::thread([t]() {
+      openhd::trace::record(openhd::trace::Stage::GND_VIDEO_RX, t, t);
+    }).join();
+  }
+  openhd::trace::set_enabled(false);
+  if (openhd::trace::get_n_rings() != n_rings_before) {
+    throw std::runtime_error("Ring of an exited thread not re-used\n");
+  }
+  const std::string csv = "/tmp/test_openhd_trace.csv";
+  if (!openhd::trace::write_csv(csv)) {
+    throw std::runtime_error("Cannot write trace\n");
+  }
+  const auto events = read_csv_events(csv, "gnd_video_rx");
+  if (events.size() != 1 + n_threads) {
+    std::stringstream ss;
+    ss << "Expected " << 1 + n_threads << " events, got " << events.size()
+       << "\n";
+    throw std::runtime_error(ss.str());
+  }
+}
+
+int main(int argc, char* argv[]) {
+  test_disabled_cost();
+  test_record_and_dump();
+  test_frame_id();
+  test_counter();
+  test_dump_while_recording();
+  test_ring_reuse();
+  std::cout << "Done\n";
+  return 0;
+}
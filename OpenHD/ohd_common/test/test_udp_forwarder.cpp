@@ -0,0 +1,138 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "openhd_udp.h"
+
+// Forwards frames (bursts of rtp sized packets) to 3 localhost receivers, one
+// send (covering all destinations) per packet vs. one per frame vs. UDP GSO,
+// and validates that every receiver gets all packets in order.
+// Also adds / removes a destination while sending (copy on write membership).
+
+static constexpr int BASE_PORT = 6700;
+static constexpr int N_DESTINATIONS = 3;
+static constexpr int PACKET_SIZE = 1446;
+
+struct Receiver {
+  explicit Receiver(int port)
+      : receiver(openhd::ADDRESS_LOCALHOST, port,
+                 [this](const uint8_t* payload, std::size_t payload_size) {
+                   on_packet(payload, payload_size);
+                 }) {
+    receiver.runInBackground();
+  }
+  void on_packet(const uint8_t* payload, std::size_t payload_size) {
+    uint32_t seq;
+    memcpy(&seq, payload, sizeof(seq));
+    if (seq != next_seq) n_out_of_order++;
+    next_seq = seq + 1;
+    n_packets++;
+  }
+  openhd::UDPReceiver receiver;
+  std::atomic<int> n_packets{0};
+  std::atomic<int> n_out_of_order{0};
+  uint32_t next_seq = 0;
+};
+
+// A frame - 24 full fragments and a smaller last one
+static std::vector<std::vector<uint8_t>> create_frame(uint32_t& seq) {
+  std::vector<std::vector<uint8_t>> ret;
+  for (int i = 0; i < 25; i++) {
+    std::vector<uint8_t> packet(i == 24 ? 500 : PACKET_SIZE, 0xAB);
+    memcpy(packet.data(), &seq, sizeof(seq));
+    seq++;
+    ret.push_back(std::move(packet));
+  }
+  return ret;
+}
+
+enum class Mode { PER_PACKET, SENDMMSG, GSO };
+
+static bool run(Mode mode, const std::string& tag, int n_frames) {
+  std::vector<std::unique_ptr<Receiver>> receivers;
+  for (int i = 0; i < N_DESTINATIONS; i++) {
+    receivers.push_back(std::make_unique<Receiver>(BASE_PORT + i));
+  }
+  openhd::UDPMultiForwarder forwarder;
+  for (int i = 0; i < N_DESTINATIONS; i++) {
+    forwarder.addForwarder(openhd::ADDRESS_LOCALHOST, BASE_PORT + i);
+  }
+  forwarder.set_use_gso(mode == Mode::GSO);
+  // Membership changes while sending must not block / break the send path
+  std::atomic<bool> done{false};
+  std::thread membership_thread([&forwarder, &done]() {
+    while (!done) {
+      forwarder.addForwarder(openhd::ADDRESS_LOCALHOST, BASE_PORT + 10);
+      forwarder.removeForwarder(openhd::ADDRESS_LOCALHOST, BASE_PORT + 10);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  });
+  uint32_t seq = 0;
+  int64_t total_bytes = 0;
+  // Only the time spent in the forwarder counts
+  std::chrono::nanoseconds elapsed{0};
+  for (int i = 0; i < n_frames; i++) {
+    const auto frame = create_frame(seq);
+    const auto begin = std::chrono::steady_clock::now();
+    if (mode == Mode::PER_PACKET) {
+      for (const auto& packet : frame) {
+        forwarder.forwardPacketViaUDP(packet.data(), packet.size());
+      }
+    } else {
+      std::vector<openhd::UDPPacketRef> refs;
+      for (const auto& packet : frame) refs.push_back({packet.data(), packet.size()});
+      forwarder.forwardPacketsViaUDP(refs);
+    }
+    elapsed += std::chrono::steady_clock::now() - begin;
+    for (const auto& packet : frame) total_bytes += packet.size();
+    // Don't overrun the receivers (socket buffers)
+    std::this_thread::sleep_for(std::chrono::microseconds(300));
+  }
+  done = true;
+  membership_thread.join();
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  bool ok = true;
+  for (auto& receiver : receivers) {
+    receiver->receiver.stopBackground();
+    ok &= receiver->n_out_of_order == 0 && receiver->n_packets == static_cast<int>(seq);
+  }
+  const double elapsed_s = std::chrono::duration<double>(elapsed).count();
+  std::cout << tag << ": " << total_bytes * 8 * N_DESTINATIONS / elapsed_s / 1e6 << " MBit/s total (send time only), received ";
+  for (auto& receiver : receivers) std::cout << receiver->n_packets << "/" << seq << " ";
+  std::cout << (ok ? "OK" : "FAILED") << std::endl;
+  return ok;
+}
+
+int main(int argc, char* argv[]) {
+  const int n_frames = argc > 1 ? std::atoi(argv[1]) : 2000;
+  bool ok = run(Mode::PER_PACKET, "sendmmsg per packet", n_frames);
+  ok &= run(Mode::SENDMMSG, "sendmmsg per frame", n_frames);
+  // GSO might not be available, but the fallback has to deliver everything
+  ok &= run(Mode::GSO, "gso", n_frames);
+  return ok ? 0 : 1;
+}
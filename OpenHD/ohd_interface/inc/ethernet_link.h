@@ -25,11 +25,13 @@
 #define OPENHD_ETHERNET_LINK_H
 
 #include <memory>
+#include <mutex>
 #include <thread>
 
 #include "openhd_config.h"
 #include "openhd_link.hpp"
 #include "openhd_udp.h"
+#include "openhd_udp_fec.h"
 #include "openhd_util.h"
 
 // 用于实现基于以太网的通信链接，主要用于 OpenHD 项目中。它支持传输以下类型的数据：
@@ -62,6 +64,13 @@ class EthernetLink : public OHDLink {
     std::unique_ptr<openhd::UDPReceiver> m_video_rx;       // Video receiver 视频数据接收器
     std::unique_ptr<openhd::UDPForwarder> m_telemetry_tx;  // Telemetry transmitter 遥测数据发送器
     std::unique_ptr<openhd::UDPReceiver> m_telemetry_rx;   // Telemetry receiver 遥测数据接收器
+    // Video FEC - encoder on air (if enabled), decoder on ground
+    // 视频 FEC - 空中端编码（如果启用），地面端解码
+    std::mutex m_video_tx_mutex;
+    std::unique_ptr<openhd::UDPFecEncoder> m_video_fec_encoder;
+    std::vector<openhd::UDPPacketRef> m_video_tx_refs;
+    std::unique_ptr<openhd::UDPFecDecoder> m_video_fec_decoder;
+    std::chrono::steady_clock::time_point m_last_fec_stats_log{};
 
     void initialize_air_unit();     // 初始化空中单元的函数
     void initialize_ground_unit();  // 初始化地面单元的函数
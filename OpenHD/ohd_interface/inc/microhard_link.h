@@ -27,6 +27,7 @@
 #include "openhd_link.hpp"
 #include "openhd_settings_imp.h"
 #include "openhd_udp.h"
+#include "openhd_udp_fec.h"
 
 /**
  * Link implementation for microhard modules
@@ -58,6 +59,11 @@ class MicrohardLink : public OHDLink {
     std::unique_ptr<openhd::UDPReceiver> m_video_rx;   // 视频数据接收器
     //
     std::unique_ptr<openhd::UDPReceiver> m_telemetry_tx_rx;  // 遥测数据收发器
+    // Video FEC, see VIDEO_FEC_PERCENTAGE in hardware.config
+    // 视频 FEC，参见 hardware.config 中的 VIDEO_FEC_PERCENTAGE
+    std::unique_ptr<openhd::UDPFecEncoder> m_video_fec_encoder;
+    std::vector<openhd::UDPPacketRef> m_video_tx_refs;
+    std::unique_ptr<openhd::UDPFecDecoder> m_video_fec_decoder;
 };
 
 #endif  // OPENHD_MICROHARD_LINK_H
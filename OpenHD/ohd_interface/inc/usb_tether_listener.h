@@ -39,8 +39,9 @@
 /**
  * USB hotspot (USB Tethering).
  * Since the USB tethering is always initiated by the user (when he switches USB
- * Tethering on on his phone/tablet) we don't need any settings or similar, and
- * checking once every second barely uses any CPU resources. This was created by
+ * Tethering on on his phone/tablet) we don't need any settings or similar.
+ * Link and route changes come from the netlink cache (openhd_netlink.h), no
+ * polling. This was created by
  * translating the tether_functions.sh script from wifibroadcast-scripts into
  * c++. This class configures and forwards the connect and disconnect event(s)
  * for a USB tethering device, such that we can start/stop forwarding to the
@@ -53,7 +54,7 @@
 /**
  * USB 热点（USB 网络共享）。
  * 由于 USB 网络共享始终由用户发起（例如用户在手机或平板上启用 USB 网络共享），
- * 因此我们不需要任何设置或类似的功能，每隔一秒检查一次几乎不会占用 CPU 资源。
+ * 因此我们不需要任何设置或类似的功能。链路和路由变化来自 netlink 缓存（openhd_netlink.h），无需轮询。
  * 该类的实现是将 wifibroadcast-scripts 中的 tether_functions.sh 脚本翻译为 C++。
  * 该类配置并转发 USB 网络共享设备的连接和断开事件，以便我们可以开始/停止向设备的 IP 地址转发数据。
  * 仅支持同时连接一个 USB 网络共享设备。同时假设 USB 网络共享设备始终出现在 /sys/class/net/usb0。
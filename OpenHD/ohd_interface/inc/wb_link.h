@@ -42,8 +42,10 @@
 #include "openhd_settings_imp.h"
 #include "openhd_spdlog.h"
 #include "openhd_util_time.h"
+#include "wb_link_bitrate_controller.h"
 #include "wb_link_helper.h"
 #include "wb_link_manager.h"
+#include "wb_link_scheduler.h"
 #include "wb_link_settings.h"
 #include "wb_link_work_item.hpp"
 #include "wifi_card.h"
@@ -194,6 +196,18 @@ class WBLink : public OHDLink {
     // 定期更新统计信息，更新后的数据通过动作处理器传递给
     // ohd_telemetry 模块
     void loop_do_work();
+    // Adds the tasks below to m_scheduler, see openhd::wb::add_wb_link_tasks
+    // 将以下任务添加到 m_scheduler
+    void setup_scheduler_tasks();
+    // Perform the queued up work item, if it exists (and is ready)
+    // 执行排队的工作项（如果存在且已就绪）
+    void wt_perform_work_item();
+    // If needed, apply the proper tx power (depending on armed / disarmed state)
+    // 如有需要，应用正确的发射功率（取决于解锁/上锁状态）
+    void wt_apply_tx_power_if_requested();
+    // After we've applied the rate, we update the tx header mcs index if necessary
+    // 应用速率后，如有需要更新发送头的 MCS 索引
+    void wt_apply_air_mcs_index_if_requested();
 
     // update statistics, done in regular intervals, updated data is given to the
     // ohd_telemetry module via the action handler
@@ -296,7 +310,11 @@ class WBLink : public OHDLink {
     // 我们有一个工作线程，用于异步执行操作，例如
     // 更改频率，还包括重新计算统计数据，然后将这些数据
     // 转发到openhd_telemetry进行广播
-    bool m_work_thread_run;
+    // The worker thread sleeps until the next task is due or triggered - e.g. a
+    // new work item, rc channel(s) or a dropped frame wake it up immediately
+    // 工作线程休眠到下一个任务到期或被触发 - 例如新的工作项、RC 通道或丢帧会立即唤醒它
+    openhd::wb::DeadlineScheduler m_scheduler;
+    openhd::wb::WBLinkTaskIds m_tasks;
     std::unique_ptr<std::thread> m_work_thread;
     std::mutex m_work_item_queue_mutex;
 
@@ -305,8 +323,6 @@ class WBLink : public OHDLink {
     // 注意：我们一次只支持一个活跃的工作项，
     // 否则，我们会拒绝用户请求的任何更改。
     std::queue<std::shared_ptr<WorkItem>> m_work_item_queue;
-    static constexpr auto RECALCULATE_STATISTICS_INTERVAL = std::chrono::milliseconds(500);
-    std::chrono::steady_clock::time_point m_last_stats_recalculation = std::chrono::steady_clock::now();
     std::atomic<int> m_max_total_rate_for_current_wifi_config_kbits = 0;
     std::atomic<int> m_max_video_rate_for_current_wifi_fec_config = 0;
     // Whenever the frequency has been changed, we reset tx errors and start new
@@ -315,6 +331,12 @@ class WBLink : public OHDLink {
     // bitrate we recommend to the encoder / camera(s)
     // 我们推荐给编码器/摄像头的比特率
     int m_recommended_video_bitrate_kbits = 0;
+    // Reacts to congestion (tx queue, dropped frames, tx errors), only used by the rate adjustment
+    // 对拥塞（发送队列、丢帧、发送错误）做出反应，仅由速率调整使用
+    openhd::wb::BitrateController m_bitrate_controller;
+    int64_t m_rate_adjustment_last_tx_errors = 0;
+    // A fifo of X frame(s) to smooth out extreme edge cases of bitrate overshoot
+    static constexpr int VIDEO_TX_BLOCK_QUEUE_SIZE = 2;
     std::atomic<int> m_curr_n_rate_adjustments = 0;
     // Set to true when armed, disarmed by default
     // Used to differentiate between different tx power levels when armed /
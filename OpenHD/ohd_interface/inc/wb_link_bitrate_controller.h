@@ -0,0 +1,110 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#ifndef OPENHD_OPENHD_OHD_INTERFACE_INC_WB_LINK_BITRATE_CONTROLLER_H_
+#define OPENHD_OPENHD_OHD_INTERFACE_INC_WB_LINK_BITRATE_CONTROLLER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace openhd::wb {
+
+// What the link observed since the last update
+// 自上次更新以来链路观察到的情况
+struct BitrateControllerInput {
+    // Upper limit for the current wifi config (MCS table, FEC overhead
+    // deducted) - a change resets the controller
+    int max_video_rate_kbits = 0;
+    // Occupancy of the video tx queue, 0..100
+    int tx_queue_fill_perc = 0;
+    // Average time a block waited in the tx queue until it was injected
+    int tx_delay_avg_us = 0;
+    // Frames dropped since they did not fit into the tx queue
+    int n_dropped_frames = 0;
+    // Injection error hint(s) / packets dropped by the radio
+    int n_tx_errors = 0;
+};
+
+/**
+ * Closed loop video bitrate controller (AIMD with hysteresis).
+ * Congestion (dropped frames, a full tx queue with delay, a high tx delay or tx errors)
+ * decreases the bitrate multiplicatively, at most once per hold time such
+ * that the encoder has time to react. Only once the link was clear (queue
+ * and delay below the low thresholds, no drops / errors) for a while the
+ * bitrate is increased again in small steps, up to the maximum for the current
+ * wifi config. In between the thresholds the bitrate is kept.
+ * Not thread-safe, time is passed in (for the offline simulator).
+ * 闭环视频码率控制器（带迟滞的 AIMD）。拥塞（丢帧、发送队列满、发送延迟高或发送错误）时按比例降低码率，
+ * 每个保持时间内最多降低一次，以便编码器有时间响应。仅当链路持续畅通一段时间后才小步提高码率，最高到当前
+ * wifi 配置的最大值。位于阈值之间时保持码率不变。非线程安全，时间由调用者传入（用于离线模拟器）。
+ */
+class BitrateController {
+   public:
+    struct Params {
+        // The encoder can't produce a usable image below that anyways
+        int min_bitrate_kbits = 2000;
+        // new = current * decrease_factor_perc / 100
+        int decrease_factor_perc = 80;
+        // in percent of the max rate
+        int increase_step_perc = 10;
+        // The video tx queue is small (a few frames) - full is congested, a
+        // frame waiting is normal
+        int high_queue_fill_perc = 100;
+        int low_queue_fill_perc = 50;
+        int high_tx_delay_us = 25000;
+        int low_tx_delay_us = 8000;
+        int max_tx_errors = 5;
+        std::chrono::milliseconds hold_after_decrease{1000};
+        std::chrono::milliseconds clear_before_increase{2000};
+        // After a reset (new wifi config) the encoder needs time to adjust
+        std::chrono::milliseconds grace_after_reset{5000};
+    };
+    typedef std::chrono::steady_clock::time_point TIME_POINT;
+    explicit BitrateController(Params params);
+    BitrateController() : BitrateController(Params{}) {}
+    // Returns the bitrate to recommend to the encoder
+    int update(const BitrateControllerInput& input, TIME_POINT now);
+    // Starts at the max again on the next update (e.g. frequency changed)
+    void reset() { m_max_video_rate_kbits = -1; }
+    int get_bitrate_kbits() const { return m_bitrate_kbits; }
+    // Since the last reset
+    int get_n_decreases() const { return m_n_decreases; }
+    int get_n_increases() const { return m_n_increases; }
+    std::string to_string() const;
+
+   private:
+    const Params m_params;
+    int m_max_video_rate_kbits = -1;
+    int m_bitrate_kbits = 0;
+    int m_n_decreases = 0;
+    int m_n_increases = 0;
+    TIME_POINT m_grace_until{};
+    TIME_POINT m_last_decrease{};
+    // Last time the link was not clear
+    TIME_POINT m_last_not_clear{};
+};
+
+}  // namespace openhd::wb
+
+#endif  // OPENHD_OPENHD_OHD_INTERFACE_INC_WB_LINK_BITRATE_CONTROLLER_H_
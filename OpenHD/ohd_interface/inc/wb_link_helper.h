@@ -256,50 +256,12 @@ class FrameDropsHelper {
     // reference to the wb_link worker thread
     // 通知帧丢失
     void notify_dropped_frame(int n_dropped = 1) { m_frame_drop_counter += n_dropped; }
-    // Thread-safe as long as it is called from the thread performing management
-    // 检查是否需要降低比特率
-    bool needs_bitrate_reduction() {
-        if (m_opt_no_error_delay.has_value()) {
-            if (std::chrono::steady_clock::now() >= m_opt_no_error_delay) {
-                const auto elapsed = std::chrono::steady_clock::now() - m_last_check;
-                m_last_check = std::chrono::steady_clock::now();
-                const int dropped_since_last_check = m_frame_drop_counter.exchange(0);
-                m_console->debug(
-                    "Dropped {} frames in {} during adjust period (no bitrate "
-                    "reduction)",
-                    dropped_since_last_check, MyTimeHelper::R(elapsed));
-                m_opt_no_error_delay = std::nullopt;
-            }
-            return false;
-        }
-        const auto elapsed = std::chrono::steady_clock::now() - m_last_check;
-        if (elapsed >= std::chrono::seconds(3)) {
-            m_last_check = std::chrono::steady_clock::now();
-            const int dropped_since_last_check = m_frame_drop_counter.exchange(0);
-            static constexpr int MAX_DROPPED_FRAMES_ALLOWED = 3;
-            if (dropped_since_last_check > MAX_DROPPED_FRAMES_ALLOWED) {
-                m_console->debug("Dropped {} frames during {} delta period", dropped_since_last_check, MyTimeHelper::R(elapsed));
-                return true;
-            }
-        }
-        return false;
-    }
-    // 设置日志记录器
-    void set_console(std::shared_ptr<spdlog::logger> console) { m_console = std::move(console); }
-    // Every time we change the bitrate, it might take some time until the camera
-    // reacts (TODO: Define a minumum allowed variance for openhd supported
-    // cameras)
-    // - this results in dropped frame(s) during this period not being reported as
-    // an error (Such that we don't do any rate reduction while the encoder is
-    // still reacting to the newly set bitrate)
-    // 延迟错误检测
-    void delay_for(std::chrono::milliseconds delay) { m_opt_no_error_delay = std::chrono::steady_clock::now() + delay; }
+    // Dropped frames since the last call (bitrate controller input)
+    // 自上次调用以来的丢帧数（码率控制器输入）
+    int get_and_reset_dropped_frames() { return m_frame_drop_counter.exchange(0); }
 
    private:
-    std::shared_ptr<spdlog::logger> m_console;
-    std::chrono::steady_clock::time_point m_last_check = std::chrono::steady_clock::now();
     std::atomic_int m_frame_drop_counter = 0;
-    std::optional<std::chrono::steady_clock::time_point> m_opt_no_error_delay = std::nullopt;
 };
 
 /**
@@ -25,6 +25,7 @@
 #define OPENHD_WBLINKMANAGER_H
 
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <optional>
 #include <string>
@@ -104,6 +105,10 @@ class ManagementGround {
    public:
     std::atomic<int> m_air_reported_curr_frequency = -1;      // 空中端报告的当前频率
     std::atomic<int> m_air_reported_curr_channel_width = -1;  // 空中端报告的当前频道宽度
+    // Called (from the rx thread) whenever the air reports a different frequency / channel width.
+    // Set before start()
+    // 空中端报告的频率 / 频道宽度变化时调用（rx 线程）。需在 start() 之前设置
+    std::function<void()> m_on_air_reported_change = nullptr;
     int get_last_received_packet_ts_ms();                     // 获取最后接收到的管理帧的时间戳（毫秒）
 
    private:
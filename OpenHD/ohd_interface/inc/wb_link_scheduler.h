@@ -0,0 +1,141 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#ifndef OPENHD_OPENHD_OHD_INTERFACE_INC_WB_LINK_SCHEDULER_H_
+#define OPENHD_OPENHD_OHD_INTERFACE_INC_WB_LINK_SCHEDULER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace openhd::wb {
+
+/**
+ * Small deadline scheduler for the wb_link worker thread. Each task runs every
+ * period (if it has one) and as soon as possible after it has been triggered -
+ * instead of polling everything and then sleeping a fixed interval, the
+ * thread sleeps until the next deadline and wakes up immediately on a trigger.
+ * Due tasks run in the order they were added, such that a task triggered by an
+ * earlier task in the same pass runs in that pass.
+ * 用于 wb_link 工作线程的小型截止时间调度器。每个任务按其周期执行（如果有），并在被触发后尽快执行 -
+ * 线程休眠到下一个截止时间，被触发时立即唤醒，而不是轮询后固定休眠。到期任务按添加顺序执行。
+ */
+class DeadlineScheduler {
+   public:
+    typedef std::function<void()> TASK;
+    typedef std::chrono::steady_clock::time_point TIME_POINT;
+    // Task without a period, only runs when triggered
+    // 无周期的任务，仅在被触发时执行
+    static constexpr std::chrono::milliseconds EVENT_ONLY{0};
+    struct TaskStats {
+        std::string tag;
+        int n_runs = 0;
+        // Time between due (deadline / trigger) and start of execution
+        int max_lateness_us = 0;
+        int max_duration_us = 0;
+    };
+    // Not thread-safe, add all tasks before run()
+    // Returns the id for trigger()
+    int add_task(std::string tag, std::chrono::milliseconds period, TASK task);
+    // Thread-safe and cheap - run the task as soon as possible / not before
+    // the given time point. Pending triggers are merged into the earliest one,
+    // a task waiting for a later time point has to re-trigger itself.
+    // Invalid ids (task not added) are ignored.
+    void trigger(int task_id);
+    void trigger_at(int task_id, TIME_POINT time_point);
+    // Executes tasks until stop() is called
+    void run();
+    void stop();
+    // Thread-safe
+    std::vector<TaskStats> get_stats();
+
+   private:
+    struct Task {
+        std::string tag;
+        std::chrono::milliseconds period;
+        TASK task;
+        // Only touched by the thread in run()
+        TIME_POINT next_periodic;
+        // Earliest requested trigger, in steady clock ns, INT64_MAX if none
+        std::atomic<int64_t> triggered_at_ns{INT64_MAX};
+        std::atomic<int> n_runs{0};
+        std::atomic<int> max_lateness_us{0};
+        std::atomic<int> max_duration_us{0};
+    };
+    // Runs all due tasks, returns the next deadline
+    TIME_POINT run_due_tasks();
+    void wake_up();
+
+   private:
+    std::vector<std::unique_ptr<Task>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_wake_up = false;
+    std::atomic<bool> m_stop = false;
+};
+
+// The tasks of the WBLink worker thread - set up by add_wb_link_tasks() such
+// that WBLink and its test (test_wb_link_scheduler) run the same task set.
+// 由 WBLink 工作线程执行的任务 - WBLink 与其测试共用同一套任务设置
+struct WBLinkTaskCallbacks {
+    DeadlineScheduler::TASK work_item;
+    DeadlineScheduler::TASK tx_power;
+    // air only
+    DeadlineScheduler::TASK mcs_via_rc;
+    // ground only
+    DeadlineScheduler::TASK gnd_channel_management;
+    // Optional, not every platform has it
+    DeadlineScheduler::TASK thermal_protection;
+    // air only
+    DeadlineScheduler::TASK rate_adjustment;
+    DeadlineScheduler::TASK apply_air_mcs;
+    DeadlineScheduler::TASK statistics;
+};
+// Ids for DeadlineScheduler::trigger(), -1 if the task was not added
+struct WBLinkTaskIds {
+    int work_item = -1;
+    int tx_power = -1;
+    int mcs_via_rc = -1;
+    int gnd_channel_management = -1;
+    int rate_adjustment = -1;
+    int apply_air_mcs = -1;
+};
+static constexpr auto RECALCULATE_STATISTICS_INTERVAL = std::chrono::milliseconds(500);
+// Also done on every relevant event (settings, dropped frames, ...)
+static constexpr auto RATE_ADJUSTMENT_INTERVAL = std::chrono::milliseconds(500);
+// Safety net for the event driven tasks
+static constexpr auto FALLBACK_INTERVAL = std::chrono::milliseconds(1000);
+static constexpr auto THERMAL_PROTECTION_INTERVAL = std::chrono::milliseconds(1000);
+// Adds the tasks to the scheduler, in the order they need to run
+// 将任务按执行顺序添加到调度器
+WBLinkTaskIds add_wb_link_tasks(DeadlineScheduler& scheduler, bool is_air, WBLinkTaskCallbacks callbacks);
+
+}  // namespace openhd::wb
+
+#endif  // OPENHD_OPENHD_OHD_INTERFACE_INC_WB_LINK_SCHEDULER_H_
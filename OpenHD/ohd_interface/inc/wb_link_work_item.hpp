@@ -80,6 +80,10 @@ class WorkItem {
   bool ready_to_be_executed() {
     return std::chrono::steady_clock::now() >= m_earliest_execution_time;
   }
+  // 任务的最早执行时间点
+  std::chrono::steady_clock::time_point get_earliest_execution_time() const {
+    return m_earliest_execution_time;
+  }
   // 任务的标签，用于标识任务
   const std::string TAG;
 
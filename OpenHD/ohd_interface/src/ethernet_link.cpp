@@ -88,6 +88,10 @@ void EthernetLink::initialize_air_unit() {
   // Initialize video transmitter for sending video to the ground unit
   m_video_tx =
       std::make_unique<openhd::UDPForwarder>(GROUND_UNIT_IP, VIDEO_PORT);
+  if (m_config.VIDEO_FEC_PERCENTAGE > 0) {
+    m_video_fec_encoder = std::make_unique<openhd::UDPFecEncoder>(
+        m_config.VIDEO_FEC_PERCENTAGE, m_config.VIDEO_FEC_BLOCK_SIZE);
+  }
 
   // Initialize telemetry transmitter and receiver for bidirectional telemetry
   m_telemetry_tx =
@@ -102,6 +106,10 @@ void EthernetLink::initialize_air_unit() {
 }
 
 void EthernetLink::initialize_ground_unit() {
+  m_video_fec_decoder = std::make_unique<openhd::UDPFecDecoder>(
+      [this](const uint8_t* data, int data_len) {
+        on_receive_video_data(0, data, data_len);
+      });
   // Initialize video receiver for receiving video from the air unit
   m_video_rx = std::make_unique<openhd::UDPReceiver>(
       "0.0.0.0", VIDEO_PORT, [this](const uint8_t* data, std::size_t len) {
@@ -132,11 +140,19 @@ void EthernetLink::transmit_telemetry_data(TelemetryTxPacket packet) {
 void EthernetLink::transmit_video_data(
     int stream_index,
     const openhd::FragmentedVideoFrame& fragmented_video_frame) {
-  // Send video data fragments to the destination
-  if (m_video_tx) {
-    for (const auto& fragment : fragmented_video_frame.rtp_fragments) {
-      m_video_tx->forwardPacketViaUDP(fragment->data(), fragment->size());
-    }
+  // Send video data fragments to the destination, one sendmmsg per frame
+  if (!m_video_tx) return;
+  std::lock_guard<std::mutex> lock(m_video_tx_mutex);
+  m_video_tx_refs.clear();
+  for (const auto& fragment : fragmented_video_frame.rtp_fragments) {
+    m_video_tx_refs.push_back({fragment->data(), fragment->size()});
+  }
+  if (m_video_fec_encoder) {
+    const auto& packets = m_video_fec_encoder->encode_frame(m_video_tx_refs);
+    m_video_tx->forwardPacketsViaUDP(packets.data(), packets.size());
+  } else {
+    m_video_tx->forwardPacketsViaUDP(m_video_tx_refs.data(),
+                                     m_video_tx_refs.size());
   }
 }
 
@@ -147,7 +163,18 @@ void EthernetLink::transmit_audio_data(
 
 void EthernetLink::handle_video_data(int stream_index, const uint8_t* data,
                                      int data_len) {
-  // Forward incoming video data to the upper layer
+  // Forward incoming video data to the upper layer - FEC protected or plain
+  // rtp (air with FEC disabled)
+  if (m_video_fec_decoder && openhd::is_udp_fec_packet(data, data_len)) {
+    m_video_fec_decoder->process_packet(data, data_len);
+    const auto now = std::chrono::steady_clock::now();
+    if (now - m_last_fec_stats_log >= std::chrono::seconds(10)) {
+      m_last_fec_stats_log = now;
+      openhd::log::get_default()->debug(
+          "Ethernet video {}", m_video_fec_decoder->get_stats().to_string());
+    }
+    return;
+  }
   on_receive_video_data(stream_index, data, data_len);
 }
 
@@ -29,6 +29,7 @@
 #include "networking_settings.h"
 #include "openhd_config.h"
 #include "openhd_external_device.h"
+#include "openhd_netlink.h"
 #include "openhd_platform.h"
 #include "openhd_profile.h"
 #include "openhd_util.h"
@@ -38,21 +39,6 @@
 // detection)
 namespace openhd::ethernet {
 
-// Check if the given ethernet device is in an "up" state by reading linux
-// file(s)
-static bool check_eth_adapter_up(const std::string& eth_device_name = "eth0") {
-  const auto filename_operstate =
-      fmt::format("/sys/class/net/{}/operstate", eth_device_name);
-  if (!OHDFilesystemUtil::exists(filename_operstate)) return false;
-  const auto content_opt = OHDFilesystemUtil::opt_read_file(filename_operstate);
-  if (!content_opt.has_value()) return false;
-  const auto& content = content_opt.value();
-  if (OHDUtil::contains(content, "up")) {
-    return true;
-  }
-  return false;
-}
-
 // find / get the ip address in the given string with the following layout
 // ...(192.168.2.158)... where "192.168.2.158" can be any ip address
 static std::string get_ip_address_in_between_brackets(
@@ -125,9 +111,8 @@ static void create_ethernet_hotspot_connection_if_needed(
 }
 
 static std::optional<std::string> find_ethernet_device_name() {
-  auto devices = OHDFilesystemUtil::getAllEntriesFilenameOnlyInDirectory(
-      "/sys/class/net/");
-  for (auto& device : devices) {
+  for (const auto& link : openhd::NetlinkCache::instance().get_links()) {
+    const auto& device = link.name;
     if (OHDUtil::startsWith(device, "enx") ||
         OHDUtil::startsWith(device, "eth") ||
         OHDUtil::startsWith(device, "enp")) {
@@ -167,15 +152,14 @@ void EthernetManager::loop(int operating_mode) {
     opt_ethernet_card = "eth0";
   }
   if (opt_ethernet_card == std::nullopt) {
-    // We need to figure out the ethernet card ourselves
-    while (!m_terminate) {
-      auto card = find_ethernet_device_name();
-      if (card.has_value()) {
-        opt_ethernet_card = card;
-        break;
-      }
-      std::this_thread::sleep_for(std::chrono::seconds(1));
-    }
+    // We need to figure out the ethernet card ourselves (e.g. wait for an usb
+    // to ethernet adapter to show up)
+    openhd::NetlinkCache::instance().wait_until(
+        [&opt_ethernet_card]() {
+          opt_ethernet_card = find_ethernet_device_name();
+          return opt_ethernet_card.has_value();
+        },
+        m_terminate);
   }
   if (opt_ethernet_card) {
     configure(operating_mode, opt_ethernet_card.value());
@@ -185,6 +169,7 @@ void EthernetManager::loop(int operating_mode) {
 void EthernetManager::stop() {
   m_console->warn("stop begin");
   m_terminate = true;
+  openhd::NetlinkCache::instance().notify_waiters();
   if (m_thread) {
     m_thread->join();
     m_thread = nullptr;
@@ -206,43 +191,39 @@ void EthernetManager::configure(int operating_mode,
 
 void EthernetManager::loop_ethernet_external_device_listener(
     const std::string& device_name) {
-  while (!m_terminate) {
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-    if (openhd::ethernet::check_eth_adapter_up(device_name)) {
-      m_console->warn("Eth0 is up");
-      break;
-    }
-  }
-  const auto run_command_result_opt = OHDUtil::run_command_out(
-      fmt::format("ip route list dev {}", device_name));
-  if (run_command_result_opt == std::nullopt) {
-    m_console->warn("run command out no result");
-    return;
-  }
-  const auto& run_command_result = run_command_result_opt.value();
-  const auto ip_external_device =
-      OHDUtil::string_in_between("default via ", " proto", run_command_result);
-  // const auto ip_self_network= OHDUtil::string_in_between("src ","
-  // metric",run_command_result);
+  auto& netlink = openhd::NetlinkCache::instance();
+  // Wait until the adapter is up and someone provided us with a default route
+  // (dhcp) - the gateway is the external device.
+  std::string ip_external_device;
+  netlink.wait_until(
+      [&netlink, &device_name, &ip_external_device]() {
+        if (!netlink.is_link_up(device_name)) return false;
+        ip_external_device =
+            netlink.get_default_gateway(device_name).value_or("");
+        return !ip_external_device.empty();
+      },
+      m_terminate);
+  if (m_terminate) return;
+  m_console->warn("{} is up", device_name);
   const std::string tag = "ETH_" + device_name;
   const auto external_device = openhd::ExternalDevice{tag, ip_external_device};
-  // Check if both are valid IPs (otherwise, perhaps the parsing got fucked up)
+  // Check if both are valid IPs
   if (!external_device.is_valid()) {
     m_console->warn("{} not valid", external_device.to_string());
+    std::this_thread::sleep_for(std::chrono::seconds(1));
     return;
   }
   m_console->info("found device:{}", external_device.to_string());
   openhd::ExternalDeviceManager::instance().on_new_external_device(
       external_device, true);
-  // check in regular intervals if the device disconnects
-  while (!m_terminate) {
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-    // check if the state is still okay
-    if (!openhd::ethernet::check_eth_adapter_up(device_name)) {
-      m_console->warn("Eth0 is not up anymore,removing ext device");
-      break;
-    }
-  }
+  // notified as soon as the adapter goes down (or the gateway changes)
+  netlink.wait_until(
+      [&netlink, &device_name, &ip_external_device]() {
+        return !netlink.is_link_up(device_name) ||
+               netlink.get_default_gateway(device_name) != ip_external_device;
+      },
+      m_terminate);
+  m_console->warn("{} is not up anymore,removing ext device", device_name);
   openhd::ExternalDeviceManager::instance().on_new_external_device(
       external_device, false);
 }
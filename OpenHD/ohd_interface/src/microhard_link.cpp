@@ -408,6 +408,10 @@ MicrohardLink::MicrohardLink(OHDProfile profile) : m_profile(profile) {
     if (m_profile.is_air) {
         // 初始化视频发送UDP
         m_video_tx = std::make_unique<openhd::UDPForwarder>(DEVICE_IP_GND, MICROHARD_UDP_PORT_VIDEO_AIR_TX);
+        const auto config = openhd::load_config();
+        if (config.VIDEO_FEC_PERCENTAGE > 0) {
+            m_video_fec_encoder = std::make_unique<openhd::UDPFecEncoder>(config.VIDEO_FEC_PERCENTAGE, config.VIDEO_FEC_BLOCK_SIZE);
+        }
         auto cb_telemetry_rx = [this](const uint8_t* data, std::size_t data_len) {
             auto shared = std::make_shared<std::vector<uint8_t>>(data, data + data_len);
             on_receive_telemetry_data(shared);
@@ -416,7 +420,15 @@ MicrohardLink::MicrohardLink(OHDProfile profile) : m_profile(profile) {
         m_telemetry_tx_rx = std::make_unique<openhd::UDPReceiver>(DEVICE_IP_AIR, MICROHARD_UDP_PORT_TELEMETRY_AIR_TX, cb_telemetry_rx);
     } else {
         // 初始化视频接收UDP
-        auto cb_video_rx = [this](const uint8_t* payload, std::size_t payloadSize) { on_receive_video_data(0, payload, payloadSize); };
+        m_video_fec_decoder = std::make_unique<openhd::UDPFecDecoder>([this](const uint8_t* data, int data_len) { on_receive_video_data(0, data, data_len); });
+        auto cb_video_rx = [this](const uint8_t* payload, std::size_t payloadSize) {
+            // FEC protected or plain rtp (air with FEC disabled)
+            if (openhd::is_udp_fec_packet(payload, payloadSize)) {
+                m_video_fec_decoder->process_packet(payload, payloadSize);
+            } else {
+                on_receive_video_data(0, payload, payloadSize);
+            }
+        };
         m_video_rx = std::make_unique<openhd::UDPReceiver>(DEVICE_IP_GND, MICROHARD_UDP_PORT_VIDEO_AIR_TX, cb_video_rx);
 
         // 初始化遥测信息发送和接收UDP
@@ -461,8 +473,16 @@ void MicrohardLink::transmit_telemetry_data(OHDLink::TelemetryTxPacket packet) {
 void MicrohardLink::transmit_video_data(int stream_index, const openhd::FragmentedVideoFrame& fragmented_video_frame) {
     assert(m_profile.is_air);
     if (stream_index == 0) {
+        // One sendmmsg per frame
+        m_video_tx_refs.clear();
         for (const auto& fragment : fragmented_video_frame.rtp_fragments) {
-            m_video_tx->forwardPacketViaUDP(fragment->data(), fragment->size());
+            m_video_tx_refs.push_back({fragment->data(), fragment->size()});
+        }
+        if (m_video_fec_encoder) {
+            const auto& packets = m_video_fec_encoder->encode_frame(m_video_tx_refs);
+            m_video_tx->forwardPacketsViaUDP(packets.data(), packets.size());
+        } else {
+            m_video_tx->forwardPacketsViaUDP(m_video_tx_refs.data(), m_video_tx_refs.size());
         }
     }
 }
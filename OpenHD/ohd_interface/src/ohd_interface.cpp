@@ -33,6 +33,7 @@
 #include "microhard_link.h"
 #include "openhd_config.h"
 #include "openhd_global_constants.hpp"
+#include "openhd_link_emulator.h"
 #include "openhd_util_filesystem.h"
 #include "wb_link.h"
 // Helper function to execute a shell command and return the output
@@ -74,6 +75,23 @@ OHDInterface::OHDInterface(OHDProfile profile1)
   const auto config = openhd::load_config();
   bool microhard_device_present = is_microhard_device_present();
 
+  // Development: no radio at all, air and ground connected via unix socket
+  if (!config.GEN_EMULATED_LINK_PROFILE.empty()) {
+    auto impairment =
+        openhd::LinkImpairment::from_string(config.GEN_EMULATED_LINK_PROFILE);
+    if (!impairment.has_value()) {
+      m_console->warn("Invalid emulated link profile {}, using ideal",
+                      config.GEN_EMULATED_LINK_PROFILE);
+      impairment = openhd::LinkImpairment{};
+    }
+    m_emulated_link = openhd::EmulatedLink::create_unix(
+        m_profile.is_air, config.GEN_EMULATED_LINK_SOCKET, impairment.value());
+    if (m_emulated_link) {
+      m_console->warn("emulated link");
+      return;
+    }
+  }
+
   // 4. 检查以太网连接
   if (OHDFilesystemUtil::exists(std::string(getConfigBasePath()) +
                                 "ethernet.txt")) {
@@ -228,6 +246,10 @@ void OHDInterface::print_internal_fec_optimization_method() {
 }
 
 std::shared_ptr<OHDLink> OHDInterface::get_link_handle() {
+  if (m_emulated_link) {
+    m_console->warn("Using Link: Emulated");
+    return m_emulated_link;
+  }
   if (m_ethernet_link) {
     m_console->warn("Using Link: Ethernet");
     return m_ethernet_link;
@@ -28,6 +28,7 @@
 #include <cassert>
 #include <utility>
 
+#include "openhd_netlink.h"
 #include "openhd_spdlog.h"
 #include "openhd_spdlog_include.h"
 
@@ -41,6 +42,7 @@ USBTetherListener::USBTetherListener() {
 
 USBTetherListener::~USBTetherListener() {
   m_check_connection_thread_stop = true;
+  openhd::NetlinkCache::instance().notify_waiters();
   if (m_check_connection_thread->joinable()) {
     m_check_connection_thread->join();
   }
@@ -54,17 +56,14 @@ void USBTetherListener::loopInfinite() {
 }
 
 static std::vector<std::string> get_usb_tethering_devices() {
-  const auto net_devices =
-      OHDFilesystemUtil::getAllEntriesFilenameOnlyInDirectory(
-          "/sys/class/net/");
   std::vector<std::string> ret;
-  for (const auto& net_device : net_devices) {
+  for (const auto& link : openhd::NetlinkCache::instance().get_links()) {
     const auto opt_file_device_uevent = OHDFilesystemUtil::opt_read_file(
-        fmt::format("/sys/class/net/{}/device/uevent", net_device), false);
+        fmt::format("/sys/class/net/{}/device/uevent", link.name), false);
     if (opt_file_device_uevent.has_value() &&
         OHDUtil::contains(opt_file_device_uevent.value(),
                           "DRIVER=rndis_host")) {
-      ret.push_back(net_device);
+      ret.push_back(link.name);
     }
   }
   return ret;
@@ -72,42 +71,50 @@ static std::vector<std::string> get_usb_tethering_devices() {
 
 void USBTetherListener::connectOnce() {
   m_console->debug("connectOnce()");
-  const std::string connected_devices_directory = "/sys/class/net/";
+  auto& netlink = openhd::NetlinkCache::instance();
   std::string connected_device_name;
-  while (!m_check_connection_thread_stop) {
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-    const auto usb_tether_devices = get_usb_tethering_devices();
-    if (!usb_tether_devices.empty()) {
-      m_console->debug("Found {} tethering devices",
-                       OHDUtil::str_vec_as_string(usb_tether_devices));
-      connected_device_name = usb_tether_devices.at(0);
-      break;
-    }
-  }
+  // Only re-check the driver(s) when the links changed, 0 forces the first
+  // check
+  uint64_t checked_generation = 0;
+  netlink.wait_until(
+      [this, &netlink, &checked_generation, &connected_device_name]() {
+        const auto generation = netlink.get_generation();
+        if (generation == checked_generation) return false;
+        checked_generation = generation;
+        const auto usb_tether_devices = get_usb_tethering_devices();
+        if (usb_tether_devices.empty()) return false;
+        m_console->debug("Found {} tethering devices",
+                         OHDUtil::str_vec_as_string(usb_tether_devices));
+        connected_device_name = usb_tether_devices.at(0);
+        return true;
+      },
+      m_check_connection_thread_stop);
   // We were stopped externally, no reason to continue
   if (connected_device_name.empty()) return;
   m_console->info("Found USB tethering device {}", connected_device_name);
   // now we find the IP of the connected device so we can forward video and more
-  // to it. example on my Ubuntu pc: ip route list dev usb0 default via
-  // 192.168.18.229 proto dhcp metric 101 192.168.18.0/24 proto kernel scope
-  // link src 192.168.18.155 metric 101
-  const auto run_command_result_opt = OHDUtil::run_command_out(
-      fmt::format("ip route list dev {}", connected_device_name));
-  if (run_command_result_opt == std::nullopt) {
-    m_console->warn("run command out no result");
+  // to it - the gateway of the default route the device provides us with via
+  // dhcp (which might take a moment). example on my Ubuntu pc: ip route list
+  // dev usb0 default via 192.168.18.229 proto dhcp metric 101 192.168.18.0/24
+  // proto kernel scope link src 192.168.18.155 metric 101
+  std::string ip_external_device;
+  netlink.wait_until(
+      [&netlink, &connected_device_name, &ip_external_device]() {
+        // Gone before we got an ip
+        if (!netlink.get_link(connected_device_name).has_value()) return true;
+        ip_external_device =
+            netlink.get_default_gateway(connected_device_name).value_or("");
+        return !ip_external_device.empty();
+      },
+      m_check_connection_thread_stop);
+  if (ip_external_device.empty()) {
+    m_console->warn("USB Tether device {} disconnected before dhcp",
+                    connected_device_name);
     return;
   }
-  const auto& run_command_result = run_command_result_opt.value();
-  const auto ip_external_device =
-      OHDUtil::string_in_between("default via ", " proto", run_command_result);
-  // const auto ip_external_device2= OHDUtil::string_in_between("default via ","
-  // proto",run_command_result);
-  const auto ip_self_network =
-      OHDUtil::string_in_between("src ", " metric", run_command_result);
-
   const auto external_device =
       openhd::ExternalDevice{connected_device_name, ip_external_device};
-  // Check if both are valid IPs (otherwise, perhaps the parsing got fucked up)
+  // Check if both are valid IPs
   if (!external_device.is_valid()) {
     m_console->warn("{} not valid", external_device.to_string());
     std::this_thread::sleep_for(std::chrono::seconds(2));  // try again later
@@ -116,16 +123,16 @@ void USBTetherListener::connectOnce() {
   m_console->info("found device:{}", external_device.to_string());
   openhd::ExternalDeviceManager::instance().on_new_external_device(
       external_device, true);
-  // check in regular intervals if the tethering device disconnects.
-  while (!m_check_connection_thread_stop) {
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-    if (!OHDFilesystemUtil::exists(connected_devices_directory +
-                                   connected_device_name)) {
-      m_console->warn("USB Tether device {} disconnected",
-                      connected_device_name);
-      break;
-    }
-  }
+  // notified as soon as the tethering device disconnects (or hands out a
+  // different ip)
+  netlink.wait_until(
+      [&netlink, &connected_device_name, &ip_external_device]() {
+        return !netlink.get_link(connected_device_name).has_value() ||
+               netlink.get_default_gateway(connected_device_name) !=
+                   ip_external_device;
+      },
+      m_check_connection_thread_stop);
+  m_console->warn("USB Tether device {} disconnected", connected_device_name);
   openhd::ExternalDeviceManager::instance().on_new_external_device(
       external_device, false);
 }
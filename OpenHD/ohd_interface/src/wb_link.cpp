@@ -26,6 +26,7 @@
 #include "wifi_command_helper.h"
 // #include "wifi_command_helper2.h"
 
+#include <algorithm>
 #include <iostream>
 #include <utility>
 
@@ -37,6 +38,7 @@
 #include "openhd_reboot_util.h"
 #include "openhd_spdlog.h"
 #include "openhd_thermal.h"
+#include "openhd_trace.h"
 #include "openhd_util_filesystem.h"
 #include "wb_link_helper.h"
 #include "wb_link_rate_helper.hpp"
@@ -48,7 +50,6 @@ WBLink::WBLink(OHDProfile profile, std::vector<WiFiCard> broadcast_cards)
     : m_profile(std::move(profile)), m_broadcast_cards(std::move(broadcast_cards)), m_recommended_max_fec_blk_size_for_this_platform(get_fec_max_block_size_for_platform()) {
     m_console = openhd::log::create_or_get("wb_streams");
     assert(m_console);
-    m_frame_drop_helper.set_console(m_console);
     m_console->info("Broadcast cards:{}", debug_cards(m_broadcast_cards));
     // sanity checks
     if (m_broadcast_cards.empty() || (m_profile.is_air && m_broadcast_cards.size() > 1)) {
@@ -174,7 +175,7 @@ WBLink::WBLink(OHDProfile profile, std::vector<WiFiCard> broadcast_cards)
             // bitrate overshoot
             // TODO: In ohd_video,  differentiate between "frame" and NALU (nalu can
             // also be config data) such that we can make this queue smaller.
-            options_video_tx.block_data_queue_size = 2;
+            options_video_tx.block_data_queue_size = VIDEO_TX_BLOCK_QUEUE_SIZE;
             options_video_tx.radio_port = openhd::VIDEO_PRIMARY_RADIO_PORT;
             auto primary = std::make_unique<WBStreamTx>(m_wb_txrx, options_video_tx, m_tx_header_1);
             options_video_tx.radio_port = openhd::VIDEO_SECONDARY_RADIO_PORT;
@@ -235,9 +236,11 @@ WBLink::WBLink(OHDProfile profile, std::vector<WiFiCard> broadcast_cards)
     }
     apply_frequency_and_channel_width_from_settings();
     apply_txpower();
+    setup_scheduler_tasks();
     if (m_profile.is_ground()) {
         m_management_gnd = std::make_unique<ManagementGround>(m_wb_txrx);
         m_management_gnd->m_tx_header = m_tx_header_1;
+        m_management_gnd->m_on_air_reported_change = [this]() { m_scheduler.trigger(m_tasks.gnd_channel_management); };
         m_management_gnd->start();
         m_gnd_curr_rx_frequency = static_cast<int>(m_settings->unsafe_get_settings().wb_frequency);
     } else {
@@ -246,7 +249,6 @@ WBLink::WBLink(OHDProfile profile, std::vector<WiFiCard> broadcast_cards)
         m_management_air->start();
     }
     m_wb_txrx->start_receiving();
-    m_work_thread_run = true;
     m_work_thread = std::make_unique<std::thread>(&WBLink::loop_do_work, this);
     std::function<bool(openhd::LinkActionHandler::ScanChannelsParam)> cb_scan = [this](openhd::LinkActionHandler::ScanChannelsParam param) {
         return request_start_scan_channels(param);
@@ -256,7 +258,10 @@ WBLink::WBLink(OHDProfile profile, std::vector<WiFiCard> broadcast_cards)
     openhd::LinkActionHandler::instance().wb_cmd_analyze_channels = cb_analyze;
     if (m_profile.is_air) {
         // MCS is only changed on air
-        auto cb_channel = [this](const std::array<int, 18>& rc_channels) { m_rc_channel_helper.set_rc_channels(rc_channels); };
+        auto cb_channel = [this](const std::array<int, 18>& rc_channels) {
+            m_rc_channel_helper.set_rc_channels(rc_channels);
+            m_scheduler.trigger(m_tasks.mcs_via_rc);
+        };
         openhd::FCRcChannelsHelper::instance().action_on_any_rc_channel_register(cb_channel);
     }
     auto cb_arm = [this](bool armed) { update_arming_state(armed); };
@@ -276,7 +281,7 @@ WBLink::WBLink(OHDProfile profile, std::vector<WiFiCard> broadcast_cards)
 WBLink::~WBLink() {
     m_console->debug("WBLink::~WBLink() begin");
     if (m_work_thread) {
-        m_work_thread_run = false;
+        m_scheduler.stop();
         m_work_thread->join();
     }
     m_management_air = nullptr;
@@ -343,6 +348,7 @@ bool WBLink::request_set_frequency(int frequency) {
             // 应用新的频率和信道宽度设置
             apply_frequency_and_channel_width_from_settings();
             m_rate_adjustment_frequency_changed = true;
+            m_scheduler.trigger(m_tasks.rate_adjustment);
         },
         std::chrono::steady_clock::now());  // 设置工作项的时间戳为当前时间
     return try_schedule_work_item(work_item);
@@ -391,6 +397,7 @@ bool WBLink::request_set_tx_power_mw(int tx_power_mw, bool armed) {
             }
             m_settings->persist();
             m_request_apply_tx_power = true;
+            m_scheduler.trigger(m_tasks.tx_power);
         },
         std::chrono::steady_clock::now());
     return try_schedule_work_item(work_item);
@@ -412,6 +419,7 @@ bool WBLink::request_set_tx_power_rtl8812au(int tx_power_index_override, bool ar
             }
             m_settings->persist();
             m_request_apply_tx_power = true;
+            m_scheduler.trigger(m_tasks.tx_power);
         },
         std::chrono::steady_clock::now());
     return try_schedule_work_item(work_item);
@@ -430,6 +438,8 @@ bool WBLink::request_set_air_mcs_index(int mcs_index) {
             m_settings->unsafe_get_settings().wb_air_mcs_index = mcs_index;
             m_settings->persist();
             m_request_apply_air_mcs_index = true;
+            m_scheduler.trigger(m_tasks.rate_adjustment);
+            m_scheduler.trigger(m_tasks.apply_air_mcs);
         },
         std::chrono::steady_clock::now());
     return try_schedule_work_item(work_item);
@@ -441,15 +451,17 @@ bool WBLink::set_air_video_fec_percentage(int fec_percentage) {
     m_settings->unsafe_get_settings().wb_video_fec_percentage = fec_percentage;
     m_settings->persist();
     // The next rate adjustment will adjust the bitrate accordingly
+    m_scheduler.trigger(m_tasks.rate_adjustment);
     return true;
 }
 bool WBLink::set_air_enable_wb_video_variable_bitrate(int value) {
     assert(m_profile.is_air);
     if (!openhd::validate_yes_or_no(value))
         return false;
-    // value is read in regular intervals.
+    // value is read by the rate adjustment
     m_settings->unsafe_get_settings().enable_wb_video_variable_bitrate = value;
     m_settings->persist();
+    m_scheduler.trigger(m_tasks.rate_adjustment);
     return true;
 }
 
@@ -464,6 +476,7 @@ bool WBLink::set_air_wb_video_rate_for_mcs_adjustment_percent(int value) {
         return false;
     m_settings->unsafe_get_settings().wb_video_rate_for_mcs_adjustment_percent = value;
     m_settings->persist();
+    m_scheduler.trigger(m_tasks.rate_adjustment);
     return true;
 }
 bool WBLink::set_dev_air_set_high_retransmit_count(int value) {
@@ -703,60 +716,65 @@ std::vector<openhd::Setting> WBLink::get_all_settings() {
 }
 #pragma clang diagnostic pop
 
-void WBLink::loop_do_work() {
-    while (m_work_thread_run) {
-        // Perform any queued up work if it exists
-        {
-            m_work_item_queue_mutex.lock();
-            if (!m_work_item_queue.empty()) {
-                auto front = m_work_item_queue.front();
-                if (front->ready_to_be_executed()) {
-                    m_console->debug("Start execute work item {}", front->TAG);
-                    front->execute();
-                    m_console->debug("Done executing work item {}", front->TAG);
-                    m_work_item_queue.pop();
-                }
+void WBLink::setup_scheduler_tasks() {
+    openhd::wb::WBLinkTaskCallbacks callbacks;
+    callbacks.work_item = [this]() { wt_perform_work_item(); };
+    callbacks.tx_power = [this]() { wt_apply_tx_power_if_requested(); };
+    callbacks.mcs_via_rc = [this]() { wt_perform_mcs_via_rc_channel_if_enabled(); };
+    callbacks.gnd_channel_management = [this]() { wt_gnd_perform_channel_management(); };
+    if (OHDPlatform::instance().is_x20()) {
+        callbacks.thermal_protection = [this]() {
+            const auto level_before = m_thermal_protection_level.load();
+            wt_perform_update_thermal_protection();
+            if (m_thermal_protection_level != level_before) {
+                m_scheduler.trigger(m_tasks.rate_adjustment);
             }
-            m_work_item_queue_mutex.unlock();
-        }
-        // If needed, apply the proper tx power (depending on armed / disarmed
-        // state).
-        bool tmp_true = true;
-        if (m_request_apply_tx_power.compare_exchange_strong(tmp_true, false)) {
-            apply_txpower();
-        }
-        wt_perform_mcs_via_rc_channel_if_enabled();
-        // wt_perform_bw_via_rc_channel_if_enabled();
-        wt_gnd_perform_channel_management();
-        // air_perform_reset_frequency();
-        // Perform thermal protection level calculation before rate adjustment !
-        wt_perform_update_thermal_protection();
-        wt_perform_rate_adjustment();
-        //  After we've applied the rate, we update the tx header mcs index if
-        //  necessary
-        tmp_true = true;
-        if (m_request_apply_air_mcs_index.compare_exchange_strong(tmp_true, false)) {
-            const int mcs_index = m_settings->unsafe_get_settings().wb_air_mcs_index;
-            m_tx_header_1->update_mcs_index(mcs_index);
-            m_tx_header_2->update_mcs_index(mcs_index);
-        }
-        tmp_true = true;
-        /*if (m_request_apply_air_bw.compare_exchange_strong(tmp_true,
-                                                                  false)) {
-          apply_frequency_and_channel_width_from_settings();
-        }*/
-        // update statistics in regular intervals
-        wt_update_statistics();
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        };
     }
+    callbacks.rate_adjustment = [this]() { wt_perform_rate_adjustment(); };
+    callbacks.apply_air_mcs = [this]() { wt_apply_air_mcs_index_if_requested(); };
+    // update statistics in regular intervals
+    callbacks.statistics = [this]() { wt_update_statistics(); };
+    m_tasks = openhd::wb::add_wb_link_tasks(m_scheduler, m_profile.is_air, std::move(callbacks));
 }
 
-void WBLink::wt_update_statistics() {
-    const auto elapsed_since_last = std::chrono::steady_clock::now() - m_last_stats_recalculation;
-    if (elapsed_since_last < RECALCULATE_STATISTICS_INTERVAL) {
+void WBLink::loop_do_work() {
+    m_scheduler.run();
+}
+
+void WBLink::wt_perform_work_item() {
+    std::lock_guard<std::mutex> lock(m_work_item_queue_mutex);
+    if (m_work_item_queue.empty()) {
         return;
     }
-    m_last_stats_recalculation = std::chrono::steady_clock::now();
+    auto front = m_work_item_queue.front();
+    if (!front->ready_to_be_executed()) {
+        m_scheduler.trigger_at(m_tasks.work_item, front->get_earliest_execution_time());
+        return;
+    }
+    m_console->debug("Start execute work item {}", front->TAG);
+    front->execute();
+    m_console->debug("Done executing work item {}", front->TAG);
+    m_work_item_queue.pop();
+}
+
+void WBLink::wt_apply_tx_power_if_requested() {
+    bool tmp_true = true;
+    if (m_request_apply_tx_power.compare_exchange_strong(tmp_true, false)) {
+        apply_txpower();
+    }
+}
+
+void WBLink::wt_apply_air_mcs_index_if_requested() {
+    bool tmp_true = true;
+    if (m_request_apply_air_mcs_index.compare_exchange_strong(tmp_true, false)) {
+        const int mcs_index = m_settings->unsafe_get_settings().wb_air_mcs_index;
+        m_tx_header_1->update_mcs_index(mcs_index);
+        m_tx_header_2->update_mcs_index(mcs_index);
+    }
+}
+
+void WBLink::wt_update_statistics() {
     // telemetry is available on both air and ground
     openhd::link_statistics::StatsAirGround stats{};
     if (m_wb_tele_tx) {
@@ -802,6 +820,10 @@ void WBLink::wt_update_statistics() {
             air_fec.curr_tx_delay_min_us = curr_tx_stats.curr_block_until_tx_min_us;
             air_fec.curr_tx_delay_max_us = curr_tx_stats.curr_block_until_tx_max_us;
             air_fec.curr_tx_delay_avg_us = curr_tx_stats.curr_block_until_tx_avg_us;
+            // FEC and injection happen inside the wifibroadcast tx - we can only
+            // trace what it reports (not per frame)
+            openhd::trace::record_counter(openhd::trace::Stage::LINK_FEC_ENCODE_TIME, i, static_cast<int32_t>(air_fec.curr_fec_encode_time_avg_us));
+            openhd::trace::record_counter(openhd::trace::Stage::LINK_TX_DELAY, i, static_cast<int32_t>(air_fec.curr_tx_delay_avg_us));
             air_video.curr_fec_percentage = m_settings->unsafe_get_settings().wb_video_fec_percentage;
             stats.stats_wb_video_air.push_back(air_video);
             if (i == 0)
@@ -927,6 +949,8 @@ void WBLink::wt_perform_rate_adjustment() {
         return;  // Only done on air unit
     // Rate adjustment is done on air and only if enabled
     if (!(m_profile.is_air && m_settings->get_settings().enable_wb_video_variable_bitrate)) {
+        // Start from the max once enabled again
+        m_bitrate_controller.reset();
         return;
     }
     const auto& settings = m_settings->get_settings();
@@ -946,43 +970,38 @@ void WBLink::wt_perform_rate_adjustment() {
     // m_foreign_p_helper.update(stats.count_p_any,stats.count_p_valid);
     // m_console->debug("N foreign packets per second
     // :{}",m_foreign_p_helper.get_foreign_packets_per_second());
-    if (m_max_video_rate_for_current_wifi_fec_config != max_video_rate_for_current_wifi_fec_config || m_rate_adjustment_frequency_changed) {
+    if (m_rate_adjustment_frequency_changed) {
         m_rate_adjustment_frequency_changed = false;
-        // Apply the default for this configuration, then return - we will start the
-        // auto-adjustment depending on tx error(s) next time the rate adjustment is
-        // called
+        m_bitrate_controller.reset();
+    }
+    if (m_max_video_rate_for_current_wifi_fec_config != max_video_rate_for_current_wifi_fec_config) {
         m_console->debug("MCS:{} ch_width:{} Calculated max_rate:{}, max_video_rate:{}", settings.wb_air_mcs_index, settings.wb_air_tx_channel_width,
                          openhd::kbits_per_second_to_string(max_rate_for_current_wifi_config), openhd::kbits_per_second_to_string(max_video_rate_for_current_wifi_fec_config));
         m_max_video_rate_for_current_wifi_fec_config = max_video_rate_for_current_wifi_fec_config;
-        m_recommended_video_bitrate_kbits = m_max_video_rate_for_current_wifi_fec_config;
-        m_curr_n_rate_adjustments = 0;
-        recommend_bitrate_to_encoder(m_recommended_video_bitrate_kbits);
-        // We 'give' the camera up to X seconds to adjust to the newly set rate. If
-        // we drop frames during this period, we do not count it as errors that need
-        // bitrate reduction.
-        m_frame_drop_helper.delay_for(std::chrono::seconds(5));
         m_primary_total_dropped_frames = 0;
         m_secondary_total_dropped_frames = 0;
-        return;
     }
-    // const bool
-    // dropping_many_frames=m_frame_drop_helper.needs_bitrate_reduction();
-    const bool dropping_many_frames = false;
-    // m_console->debug("Dropped since last check:{}",dropped_since_last_check);
-    if (dropping_many_frames) {
-        // We are dropping frames / too many tx error hint(s), we need to reduce
-        // bitrate. Reduce video bitrate by 1MBit/s
-        m_recommended_video_bitrate_kbits -= 1000;
-        m_curr_n_rate_adjustments++;
-        // Safety, in case we fall below a certain threshold the encoder won't be
-        // able to produce an image at some point anyways.
-        static constexpr auto MIN_BITRATE_KBITS = 1000 * 2;
-        if (m_recommended_video_bitrate_kbits < MIN_BITRATE_KBITS) {
-            m_console->warn("Reached minimum bitrate {}", openhd::kbits_per_second_to_string(MIN_BITRATE_KBITS));
-            m_recommended_video_bitrate_kbits = MIN_BITRATE_KBITS;
-            m_curr_n_rate_adjustments--;
-        }
-        m_console->warn("TX errors, reducing video bitrate to {}", m_recommended_video_bitrate_kbits);
+    // Feed what the link observed since the last adjustment into the controller. On a new wifi config,
+    // it starts at the max for this config and gives the camera a few seconds to adjust.
+    BitrateControllerInput input{};
+    input.max_video_rate_kbits = max_video_rate_for_current_wifi_fec_config;
+    input.n_dropped_frames = m_frame_drop_helper.get_and_reset_dropped_frames();
+    if (!m_wb_video_tx_list.empty()) {
+        auto& primary = *m_wb_video_tx_list.at(0);
+        const int available = static_cast<int>(primary.get_tx_queue_available_size_approximate());
+        input.tx_queue_fill_perc = std::clamp(VIDEO_TX_BLOCK_QUEUE_SIZE - available, 0, VIDEO_TX_BLOCK_QUEUE_SIZE) * 100 / VIDEO_TX_BLOCK_QUEUE_SIZE;
+        input.tx_delay_avg_us = static_cast<int>(primary.get_latest_stats().curr_block_until_tx_avg_us);
+    }
+    const auto tx_stats = m_wb_txrx->get_tx_stats();
+    const int64_t total_tx_errors = tx_stats.count_tx_injections_error_hint + tx_stats.count_tx_dropped_packets;
+    input.n_tx_errors = static_cast<int>(std::max<int64_t>(total_tx_errors - m_rate_adjustment_last_tx_errors, 0));
+    m_rate_adjustment_last_tx_errors = total_tx_errors;
+    const int n_decreases_before = m_bitrate_controller.get_n_decreases();
+    m_recommended_video_bitrate_kbits = m_bitrate_controller.update(input, std::chrono::steady_clock::now());
+    m_curr_n_rate_adjustments = m_bitrate_controller.get_n_decreases();
+    if (m_bitrate_controller.get_n_decreases() != n_decreases_before) {
+        m_console->warn("Congestion (dropped:{} queue:{}% delay:{}us tx errors:{}), reducing video bitrate to {}", input.n_dropped_frames, input.tx_queue_fill_perc,
+                        input.tx_delay_avg_us, input.n_tx_errors, openhd::kbits_per_second_to_string(m_recommended_video_bitrate_kbits));
     }
     // Extra x20 - thermal protection
     if (OHDPlatform::instance().is_x20()) {
@@ -1015,6 +1034,7 @@ bool WBLink::try_schedule_work_item(const std::shared_ptr<WorkItem>& work_item)
         if (m_work_item_queue.empty()) {
             m_console->debug("Adding work item {} to queue", work_item->TAG);
             m_work_item_queue.push(work_item);
+            m_scheduler.trigger(m_tasks.work_item);
             return true;
         }
         m_console->debug("Work queue full,cannot add {}", work_item->TAG);
@@ -1041,11 +1061,11 @@ void WBLink::transmit_telemetry_data(TelemetryTxPacket packet) {
 void WBLink::transmit_video_data(int stream_index, const openhd::FragmentedVideoFrame& fragmented_video_frame) {
     assert(m_profile.is_air);
     if (stream_index < 0 || stream_index > m_wb_video_tx_list.size()) {
-        m_console->debug("Invalid camera stream_index {}", stream_index);
+        OPENHD_DEBUG_EVERY_MS(m_console, 1000, "Invalid camera stream_index {}", stream_index);
         return;
     }
     if (m_air_close_video_in.load(std::memory_order_relaxed)) {
-        m_console->debug("Video TX temporarily disabled");
+        OPENHD_DEBUG_EVERY_MS(m_console, 1000, "Video TX temporarily disabled");
         return;
     }
     if (m_thermal_protection_level.load(std::memory_order_relaxed) >= THERMAL_PROTECTION_VIDEO_DISABLED) {
@@ -1053,6 +1073,10 @@ void WBLink::transmit_video_data(int stream_index, const openhd::FragmentedVideo
         return;
     }
     // m_console->debug("Got {}",fragmented_video_frame.rtp_fragments.size());
+    const uint32_t trace_frame_id = !openhd::trace::is_enabled() || fragmented_video_frame.rtp_fragments.empty()
+                                        ? 0
+                                        : openhd::trace::frame_id_from_rtp(fragmented_video_frame.rtp_fragments[0]->data(), fragmented_video_frame.rtp_fragments[0]->size());
+    openhd::trace::record(openhd::trace::Stage::LINK_ENQUEUE_BEGIN, trace_frame_id);
     auto& tx = *m_wb_video_tx_list[stream_index];
     tx.set_encryption(fragmented_video_frame.enable_ultra_secure_encryption);
     const int max_fec_block_size = get_max_fec_block_size();
@@ -1066,26 +1090,32 @@ void WBLink::transmit_video_data(int stream_index, const openhd::FragmentedVideo
             n_dropped_frames = 1;
         }
     } else {
+        // wifibroadcast only takes std::vector backed fragments
+        auto fragments = openhd::as_shared_vectors(fragmented_video_frame.rtp_fragments);
         // Pushes out previous enqueued frames if there is not enough space in the
         // queue
         const bool use_dropping_enqueue = fragmented_video_frame.is_intra_stream || fragmented_video_frame.is_idr_frame;
 
         if (use_dropping_enqueue) {
-            const auto count_removed = tx.enqueue_block_dropping(fragmented_video_frame.rtp_fragments, max_fec_block_size, fec_perc, fragmented_video_frame.creation_time);
+            const auto count_removed = tx.enqueue_block_dropping(fragments, max_fec_block_size, fec_perc, fragmented_video_frame.creation_time);
             if (count_removed != 0) {
-                openhd::log::get_default()->debug("Cleared {} frames to make space for frame {}", count_removed, fragmented_video_frame.to_string());
+                OPENHD_DEBUG_EVERY_MS(m_console, 1000, "Cleared {} frames to make space for frame {}", count_removed, fragmented_video_frame.to_string());
                 n_dropped_frames = count_removed;
             }
         } else {
-            const auto res = tx.try_enqueue_block(fragmented_video_frame.rtp_fragments, max_fec_block_size, fec_perc, fragmented_video_frame.creation_time);
+            const auto res = tx.try_enqueue_block(fragments, max_fec_block_size, fec_perc, fragmented_video_frame.creation_time);
             if (!res) {
                 n_dropped_frames = 1;
                 m_console->debug("TX enqueue video frame failed, queue size:{}", tx.get_tx_queue_available_size_approximate());
             }
         }
     }
+    openhd::trace::record(openhd::trace::Stage::LINK_ENQUEUE_END, trace_frame_id, n_dropped_frames);
     if (n_dropped_frames != 0) {
+        openhd::trace::record(openhd::trace::Stage::LINK_FRAME_DROPPED, trace_frame_id, n_dropped_frames);
         m_frame_drop_helper.notify_dropped_frame(n_dropped_frames);
+        // tx queue overflow - let the rate adjustment react right away
+        m_scheduler.trigger(m_tasks.rate_adjustment);
         if (stream_index == 0) {
             m_primary_total_dropped_frames += n_dropped_frames;
         } else {
@@ -1307,6 +1337,9 @@ void WBLink::wt_perform_mcs_via_rc_channel_if_enabled() {
         m_settings->unsafe_get_settings().wb_air_mcs_index = mcs_from_rc;
         m_settings->persist();
         m_request_apply_air_mcs_index = true;
+        // Runs in this pass, right after
+        m_scheduler.trigger(m_tasks.rate_adjustment);
+        m_scheduler.trigger(m_tasks.apply_air_mcs);
     }
 }
 
@@ -1333,6 +1366,9 @@ void WBLink::update_arming_state(bool armed) {
     // apply_tx_power - it will set the right tx power if the user enabled it
     m_is_armed = armed;
     m_request_apply_tx_power = true;
+    m_scheduler.trigger(m_tasks.tx_power);
+    // X20 rate depends on the arming state
+    m_scheduler.trigger(m_tasks.rate_adjustment);
 }
 
 void WBLink::wt_gnd_perform_channel_management() {
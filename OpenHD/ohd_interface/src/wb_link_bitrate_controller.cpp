@@ -0,0 +1,81 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "wb_link_bitrate_controller.h"
+
+#include <algorithm>
+#include <sstream>
+
+openhd::wb::BitrateController::BitrateController(Params params) : m_params(params) {}
+
+int openhd::wb::BitrateController::update(const BitrateControllerInput& input, TIME_POINT now) {
+    if (input.max_video_rate_kbits != m_max_video_rate_kbits) {
+        // New wifi config, start at the max for it
+        m_max_video_rate_kbits = input.max_video_rate_kbits;
+        m_bitrate_kbits = std::max(m_max_video_rate_kbits, m_params.min_bitrate_kbits);
+        m_n_decreases = 0;
+        m_n_increases = 0;
+        m_grace_until = now + m_params.grace_after_reset;
+        m_last_decrease = now;
+        m_last_not_clear = now;
+        return m_bitrate_kbits;
+    }
+    if (now < m_grace_until) {
+        // Drops / a full queue are most likely the encoder still adjusting
+        m_last_not_clear = now;
+        return m_bitrate_kbits;
+    }
+    // The queue fill is a snapshot (a key frame can fill it for a moment) - only
+    // a backlog if the blocks also had to wait
+    const bool queue_backlog = input.tx_queue_fill_perc >= m_params.high_queue_fill_perc && input.tx_delay_avg_us > m_params.low_tx_delay_us;
+    const bool congested = input.n_dropped_frames > 0 || queue_backlog || input.tx_delay_avg_us >= m_params.high_tx_delay_us ||
+                           input.n_tx_errors >= m_params.max_tx_errors;
+    const bool clear = input.n_dropped_frames == 0 && input.n_tx_errors == 0 && input.tx_queue_fill_perc <= m_params.low_queue_fill_perc &&
+                       input.tx_delay_avg_us <= m_params.low_tx_delay_us;
+    if (congested) {
+        m_last_not_clear = now;
+        if (now - m_last_decrease >= m_params.hold_after_decrease && m_bitrate_kbits > m_params.min_bitrate_kbits) {
+            m_bitrate_kbits = std::max(m_bitrate_kbits * m_params.decrease_factor_perc / 100, m_params.min_bitrate_kbits);
+            m_last_decrease = now;
+            m_n_decreases++;
+        }
+    } else if (clear) {
+        if (now - m_last_not_clear >= m_params.clear_before_increase && m_bitrate_kbits < m_max_video_rate_kbits) {
+            const int step = std::max(m_max_video_rate_kbits * m_params.increase_step_perc / 100, 1);
+            m_bitrate_kbits = std::min(m_bitrate_kbits + step, m_max_video_rate_kbits);
+            // Each step has to prove itself
+            m_last_not_clear = now;
+            m_n_increases++;
+        }
+    } else {
+        // Hysteresis band, keep the current bitrate
+        m_last_not_clear = now;
+    }
+    return m_bitrate_kbits;
+}
+
+std::string openhd::wb::BitrateController::to_string() const {
+    std::stringstream ss;
+    ss << "BitrateController{" << m_bitrate_kbits << "/" << m_max_video_rate_kbits << "kBit/s decreases:" << m_n_decreases << " increases:" << m_n_increases << "}";
+    return ss.str();
+}
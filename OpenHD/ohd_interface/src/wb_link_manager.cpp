@@ -178,8 +178,14 @@ void ManagementGround::on_new_management_packet(const uint8_t *data,
     DataManagementTxBandwidth packet{};
     std::memcpy(&packet, &data[1], data_len - 1);
     if (packet.bandwidth_mhz == 20 || packet.bandwidth_mhz == 40) {
+      const bool changed =
+          m_air_reported_curr_channel_width != packet.bandwidth_mhz ||
+          m_air_reported_curr_frequency != packet.center_frequency_mhz;
       m_air_reported_curr_channel_width = packet.bandwidth_mhz;
       m_air_reported_curr_frequency = packet.center_frequency_mhz;
+      if (changed && m_on_air_reported_change) {
+        m_on_air_reported_change();
+      }
     } else {
       m_console->warn("Air reports invalid bandwidth {}", packet.bandwidth_mhz);
     }
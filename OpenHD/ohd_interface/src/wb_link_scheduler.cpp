@@ -0,0 +1,175 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "wb_link_scheduler.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+int64_t to_ns(openhd::wb::DeadlineScheduler::TIME_POINT time_point) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time_point.time_since_epoch()).count();
+}
+
+openhd::wb::DeadlineScheduler::TIME_POINT from_ns(int64_t ns) {
+    return openhd::wb::DeadlineScheduler::TIME_POINT(std::chrono::nanoseconds(ns));
+}
+
+void update_max(std::atomic<int>& max, int value) {
+    if (value > max.load(std::memory_order_relaxed)) {
+        max.store(value, std::memory_order_relaxed);
+    }
+}
+
+}  // namespace
+
+int openhd::wb::DeadlineScheduler::add_task(std::string tag, std::chrono::milliseconds period, TASK task) {
+    auto new_task = std::make_unique<Task>();
+    new_task->tag = std::move(tag);
+    new_task->period = period;
+    new_task->task = std::move(task);
+    // Periodic tasks run once right at the start
+    new_task->next_periodic = std::chrono::steady_clock::now();
+    m_tasks.push_back(std::move(new_task));
+    return static_cast<int>(m_tasks.size()) - 1;
+}
+
+void openhd::wb::DeadlineScheduler::trigger(int task_id) {
+    trigger_at(task_id, std::chrono::steady_clock::now());
+}
+
+void openhd::wb::DeadlineScheduler::trigger_at(int task_id, TIME_POINT time_point) {
+    if (task_id < 0 || task_id >= static_cast<int>(m_tasks.size()))
+        return;
+    auto& triggered_at_ns = m_tasks[task_id]->triggered_at_ns;
+    const int64_t ns = to_ns(time_point);
+    int64_t current = triggered_at_ns.load();
+    // Keep the earliest one
+    while (ns < current && !triggered_at_ns.compare_exchange_weak(current, ns)) {
+    }
+    wake_up();
+}
+
+void openhd::wb::DeadlineScheduler::wake_up() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_wake_up = true;
+    }
+    m_cv.notify_one();
+}
+
+void openhd::wb::DeadlineScheduler::run() {
+    while (!m_stop) {
+        // Bounded, such that we never pass time_point::max() to the cv
+        const auto next_deadline = std::min(run_due_tasks(), std::chrono::steady_clock::now() + std::chrono::seconds(1));
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait_until(lock, next_deadline, [this]() { return m_wake_up || m_stop; });
+        m_wake_up = false;
+    }
+}
+
+void openhd::wb::DeadlineScheduler::stop() {
+    m_stop = true;
+    wake_up();
+}
+
+openhd::wb::DeadlineScheduler::TIME_POINT openhd::wb::DeadlineScheduler::run_due_tasks() {
+    for (auto& task : m_tasks) {
+        if (m_stop)
+            break;
+        const auto now = std::chrono::steady_clock::now();
+        const bool periodic_due = task->period > EVENT_ONLY && now >= task->next_periodic;
+        const int64_t triggered_at_ns = task->triggered_at_ns.load();
+        const bool triggered = triggered_at_ns <= to_ns(now);
+        if (!periodic_due && !triggered)
+            continue;
+        auto due_since = now;
+        if (periodic_due) {
+            due_since = task->next_periodic;
+            task->next_periodic += task->period;
+            // Don't try to catch up after a long running task
+            if (task->next_periodic < now) {
+                task->next_periodic = now + task->period;
+            }
+        }
+        if (triggered) {
+            // A trigger after this point is not lost - the task runs after it
+            task->triggered_at_ns.store(INT64_MAX);
+            due_since = std::min(due_since, from_ns(triggered_at_ns));
+        }
+        task->task();
+        const auto done = std::chrono::steady_clock::now();
+        task->n_runs++;
+        update_max(task->max_lateness_us, static_cast<int>(std::chrono::duration_cast<std::chrono::microseconds>(now - due_since).count()));
+        update_max(task->max_duration_us, static_cast<int>(std::chrono::duration_cast<std::chrono::microseconds>(done - now).count()));
+    }
+    auto next_deadline = TIME_POINT::max();
+    for (const auto& task : m_tasks) {
+        if (task->period > EVENT_ONLY) {
+            next_deadline = std::min(next_deadline, task->next_periodic);
+        }
+        const int64_t triggered_at_ns = task->triggered_at_ns.load();
+        if (triggered_at_ns != INT64_MAX) {
+            next_deadline = std::min(next_deadline, from_ns(triggered_at_ns));
+        }
+    }
+    return next_deadline;
+}
+
+std::vector<openhd::wb::DeadlineScheduler::TaskStats> openhd::wb::DeadlineScheduler::get_stats() {
+    std::vector<TaskStats> ret;
+    for (const auto& task : m_tasks) {
+        TaskStats stats;
+        stats.tag = task->tag;
+        stats.n_runs = task->n_runs;
+        stats.max_lateness_us = task->max_lateness_us;
+        stats.max_duration_us = task->max_duration_us;
+        ret.push_back(stats);
+    }
+    return ret;
+}
+
+openhd::wb::WBLinkTaskIds openhd::wb::add_wb_link_tasks(DeadlineScheduler& scheduler, bool is_air, WBLinkTaskCallbacks callbacks) {
+    WBLinkTaskIds ret;
+    // Order matters - a task triggered by a previous one runs in the same pass
+    ret.work_item = scheduler.add_task("work_item", DeadlineScheduler::EVENT_ONLY, std::move(callbacks.work_item));
+    ret.tx_power = scheduler.add_task("tx_power", DeadlineScheduler::EVENT_ONLY, std::move(callbacks.tx_power));
+    if (is_air) {
+        ret.mcs_via_rc = scheduler.add_task("mcs_via_rc", FALLBACK_INTERVAL, std::move(callbacks.mcs_via_rc));
+    } else {
+        // Triggered by management frames reporting a different frequency / channel width
+        ret.gnd_channel_management = scheduler.add_task("gnd_channel_management", FALLBACK_INTERVAL, std::move(callbacks.gnd_channel_management));
+    }
+    // Perform thermal protection level calculation before rate adjustment !
+    if (callbacks.thermal_protection) {
+        scheduler.add_task("thermal_protection", THERMAL_PROTECTION_INTERVAL, std::move(callbacks.thermal_protection));
+    }
+    if (is_air) {
+        ret.rate_adjustment = scheduler.add_task("rate_adjustment", RATE_ADJUSTMENT_INTERVAL, std::move(callbacks.rate_adjustment));
+        ret.apply_air_mcs = scheduler.add_task("apply_air_mcs", DeadlineScheduler::EVENT_ONLY, std::move(callbacks.apply_air_mcs));
+    }
+    // update statistics in regular intervals
+    scheduler.add_task("statistics", RECALCULATE_STATISTICS_INTERVAL, std::move(callbacks.statistics));
+    return ret;
+}
@@ -0,0 +1,273 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "openhd_test_helper.h"
+#include "wb_link_bitrate_controller.h"
+
+//
+// Offline simulator for the closed loop video bitrate controller. An encoder
+// (60fps, key frame every 30 frames, reacts to a new bitrate after 200ms) feeds
+// a tx queue of 2 frames (like WBLink), which is drained by a link with a
+// capacity that follows a synthetic or recorded trace. The controller runs
+// every 500ms and on every dropped frame (like the WBLink scheduler).
+// Reports throughput, drops and frame latency with the controller and with a
+// fixed bitrate (the max for the wifi config, what WBLink did before).
+// 视频码率闭环控制器的离线模拟器。报告使用控制器和使用固定码率时的吞吐量、丢帧和帧延迟。
+//
+// Usage: test_bitrate_controller [trace.csv]
+// trace.csv: one "time_ms,capacity_kbits" per line, linearly interpolated
+
+namespace {
+
+using namespace openhd_test_helper;
+
+using openhd::wb::BitrateController;
+using openhd::wb::BitrateControllerInput;
+using TIME_POINT = BitrateController::TIME_POINT;
+
+constexpr int MAX_VIDEO_RATE_KBITS = 20000;
+constexpr int FPS = 60;
+constexpr int KEY_FRAME_INTERVAL = 30;
+constexpr int ENCODER_REACTION_MS = 200;
+constexpr int TX_QUEUE_SIZE = 2;
+constexpr int CONTROLLER_INTERVAL_MS = 500;
+
+// capacity in kbits/s (== bits per ms) at the given time
+typedef std::function<double(int time_ms)> Trace;
+
+struct Frame {
+    int created_ms;
+    double remaining_bits;
+    int enqueued_ms;
+};
+
+struct Result {
+    double throughput_kbits = 0;
+    int n_frames = 0;
+    int n_dropped = 0;
+    int p50_latency_ms = 0;
+    int p99_latency_ms = 0;
+    int final_bitrate_kbits = 0;
+    int n_decreases = 0;
+    int n_increases = 0;
+    double drop_perc() const { return n_frames == 0 ? 0 : 100.0 * n_dropped / n_frames; }
+};
+
+Result simulate(const Trace& trace, int duration_ms, bool use_controller) {
+    BitrateController controller;
+    const TIME_POINT begin{};
+    const auto to_tp = [&begin](int time_ms) { return begin + std::chrono::milliseconds(time_ms); };
+    int target_kbits = MAX_VIDEO_RATE_KBITS;
+    int encoder_kbits = MAX_VIDEO_RATE_KBITS;
+    int encoder_change_ms = -1;
+    std::deque<Frame> queue;
+    Frame in_flight{};
+    bool has_in_flight = false;
+    std::vector<int> latencies_ms;
+    Result result;
+    double delivered_bits = 0;
+    int frame_index = 0;
+    int n_dropped_since_update = 0;
+    int64_t tx_delay_sum_ms = 0;
+    int n_tx_delay = 0;
+    int last_update_ms = -CONTROLLER_INTERVAL_MS;
+    const auto run_controller = [&](int now_ms) {
+        BitrateControllerInput input{};
+        input.max_video_rate_kbits = MAX_VIDEO_RATE_KBITS;
+        input.tx_queue_fill_perc = static_cast<int>(queue.size()) * 100 / TX_QUEUE_SIZE;
+        input.tx_delay_avg_us = n_tx_delay == 0 ? 0 : static_cast<int>(tx_delay_sum_ms * 1000 / n_tx_delay);
+        input.n_dropped_frames = n_dropped_since_update;
+        n_dropped_since_update = 0;
+        tx_delay_sum_ms = 0;
+        n_tx_delay = 0;
+        const int new_target = controller.update(input, to_tp(now_ms));
+        if (new_target != target_kbits) {
+            target_kbits = new_target;
+            encoder_change_ms = now_ms + ENCODER_REACTION_MS;
+        }
+        last_update_ms = now_ms;
+    };
+    for (int now_ms = 0; now_ms < duration_ms; now_ms++) {
+        if (encoder_change_ms >= 0 && now_ms >= encoder_change_ms) {
+            encoder_kbits = target_kbits;
+            encoder_change_ms = -1;
+        }
+        // Encoder - key frames are 3x the size of a delta frame, same average
+        if (now_ms * FPS / 1000 >= frame_index) {
+            const double avg_bits = encoder_kbits * 1000.0 / FPS;
+            const double delta_bits = avg_bits * KEY_FRAME_INTERVAL / (KEY_FRAME_INTERVAL + 2);
+            const double bits = frame_index % KEY_FRAME_INTERVAL == 0 ? 3 * delta_bits : delta_bits;
+            frame_index++;
+            result.n_frames++;
+            if (static_cast<int>(queue.size()) >= TX_QUEUE_SIZE) {
+                result.n_dropped++;
+                n_dropped_since_update++;
+                if (use_controller) {
+                    // WBLink triggers the rate adjustment on a dropped frame
+                    run_controller(now_ms);
+                }
+            } else {
+                queue.push_back(Frame{now_ms, bits, now_ms});
+            }
+        }
+        // Link - drains capacity bits per ms
+        double budget = trace(now_ms);
+        while (budget > 0) {
+            if (!has_in_flight) {
+                if (queue.empty())
+                    break;
+                in_flight = queue.front();
+                has_in_flight = true;
+                queue.pop_front();
+                tx_delay_sum_ms += now_ms - in_flight.enqueued_ms;
+                n_tx_delay++;
+            }
+            const double sent = std::min(budget, in_flight.remaining_bits);
+            in_flight.remaining_bits -= sent;
+            budget -= sent;
+            delivered_bits += sent;
+            if (in_flight.remaining_bits <= 0) {
+                latencies_ms.push_back(now_ms + 1 - in_flight.created_ms);
+                has_in_flight = false;
+            }
+        }
+        if (use_controller && now_ms - last_update_ms >= CONTROLLER_INTERVAL_MS) {
+            run_controller(now_ms);
+        }
+    }
+    result.throughput_kbits = delivered_bits / duration_ms;
+    result.p50_latency_ms = percentile(latencies_ms, 0.5);
+    result.p99_latency_ms = percentile(latencies_ms, 0.99);
+    result.final_bitrate_kbits = use_controller ? controller.get_bitrate_kbits() : MAX_VIDEO_RATE_KBITS;
+    result.n_decreases = controller.get_n_decreases();
+    result.n_increases = controller.get_n_increases();
+    return result;
+}
+
+void print(const std::string& tag, const Result& result) {
+    std::cout << std::left << std::setw(24) << tag << std::right << std::fixed << std::setprecision(1) << " throughput:" << std::setw(7) << result.throughput_kbits / 1000
+              << "MBit/s dropped:" << std::setw(5) << result.drop_perc() << "% latency p50:" << std::setw(4) << result.p50_latency_ms << "ms p99:" << std::setw(5)
+              << result.p99_latency_ms << "ms final:" << std::setw(6) << result.final_bitrate_kbits << "kBit/s -" << result.n_decreases << "/+" << result.n_increases
+              << std::endl;
+}
+
+// Runs both, returns the controller result
+std::pair<Result, Result> compare(const std::string& name, const Trace& trace, int duration_ms) {
+    const auto fixed = simulate(trace, duration_ms, false);
+    const auto controlled = simulate(trace, duration_ms, true);
+    print(name + " fixed", fixed);
+    print(name + " controller", controlled);
+    return {fixed, controlled};
+}
+
+std::optional<Trace> load_trace(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file.is_open())
+        return std::nullopt;
+    std::vector<std::pair<int, double>> points;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::stringstream ss(line);
+        int time_ms;
+        char comma;
+        double capacity;
+        if (ss >> time_ms >> comma >> capacity)
+            points.emplace_back(time_ms, capacity);
+    }
+    if (points.empty())
+        return std::nullopt;
+    return Trace([points](int time_ms) {
+        if (time_ms <= points.front().first)
+            return points.front().second;
+        for (size_t i = 1; i < points.size(); i++) {
+            if (time_ms <= points[i].first) {
+                const auto& a = points[i - 1];
+                const auto& b = points[i];
+                return a.second + (b.second - a.second) * (time_ms - a.first) / std::max(b.first - a.first, 1);
+            }
+        }
+        return points.back().second;
+    });
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        const auto trace = load_trace(argv[1]);
+        if (!trace.has_value()) {
+            std::cerr << "Cannot read trace " << argv[1] << std::endl;
+            return 1;
+        }
+        compare("trace", trace.value(), 120 * 1000);
+        return 0;
+    }
+    bool ok = true;
+    {
+        // Link is always good enough - the controller must not do anything
+        const auto res = compare("constant 24MBit/s", [](int) { return 24000.0; }, 60 * 1000);
+        ok &= check(res.second.n_dropped == 0 && res.second.n_decreases == 0, "constant");
+    }
+    {
+        // Interference: capacity halves for 30 seconds
+        const auto res = compare(
+            "step 24->10->24MBit/s", [](int t) { return t >= 10000 && t < 40000 ? 10000.0 : 24000.0; }, 90 * 1000);
+        ok &= check(res.second.drop_perc() < res.first.drop_perc() / 4, "step drops");
+        ok &= check(res.second.p99_latency_ms < res.first.p99_latency_ms, "step latency");
+        ok &= check(res.second.final_bitrate_kbits >= MAX_VIDEO_RATE_KBITS * 9 / 10, "step recovery");
+    }
+    {
+        // Slow fading between 8 and 24MBit/s
+        const auto res = compare(
+            "fading 8..24MBit/s", [](int t) { return 16000.0 + 8000.0 * std::sin(t * 2 * M_PI / 30000.0); }, 120 * 1000);
+        ok &= check(res.second.drop_perc() < res.first.drop_perc(), "fading drops");
+    }
+    {
+        // Random walk, reproducible
+        std::vector<double> walk;
+        std::mt19937 rng(7);
+        std::normal_distribution<double> step(0, 400);
+        double capacity = 20000;
+        for (int i = 0; i < 120 * 10; i++) {
+            capacity = std::clamp(capacity + step(rng), 6000.0, 26000.0);
+            walk.push_back(capacity);
+        }
+        const auto res = compare(
+            "random walk", [walk](int t) { return walk[std::min<size_t>(t / 100, walk.size() - 1)]; }, 120 * 1000);
+        ok &= check(res.second.drop_perc() < res.first.drop_perc(), "random walk drops");
+    }
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,235 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "openhd_test_helper.h"
+#include "wb_link_scheduler.h"
+
+//
+// Measures how long it takes from a MCS change requested via RC channel until
+// the (mocked) tx radiotap header uses the new MCS - once with the old fixed
+// 100ms polling loop of WBLink::loop_do_work and once with the deadline
+// scheduler, set up with the same tasks as WBLink (add_wb_link_tasks). The
+// mock WBTxRx only records when the header was updated, stats / rate
+// adjustment burn a bit of cpu like the real ones.
+// 测量从 RC 通道请求 MCS 变化到（模拟的）发送 radiotap 头使用新 MCS 所需的时间 -
+// 分别使用旧的固定 100ms 轮询循环和截止时间调度器。
+//
+// Usage: test_wb_link_scheduler [n_changes]
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// The parts of WBTxRx / RadiotapHeaderTxHolder a MCS change touches
+class MockWBTxRx {
+   public:
+    void update_mcs_index(int mcs_index) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (mcs_index == m_mcs_index)
+            return;
+        m_mcs_index = mcs_index;
+        m_changes.push_back({mcs_index, Clock::now()});
+    }
+    struct Change {
+        int mcs_index;
+        Clock::time_point time_point;
+    };
+    std::vector<Change> get_changes() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_changes;
+    }
+
+   private:
+    std::mutex m_mutex;
+    int m_mcs_index = 0;
+    std::vector<Change> m_changes;
+};
+
+void burn_cpu_us(int us) {
+    const auto end = Clock::now() + std::chrono::microseconds(us);
+    while (Clock::now() < end) {
+    }
+}
+
+// Minimal stand-in for WBLink - the state the tasks work on
+struct FakeLink {
+    MockWBTxRx tx;
+    std::mutex rc_mutex;
+    std::array<int, 18> rc_channels{};
+    int settings_mcs_index = 0;
+    std::atomic<bool> request_apply_air_mcs_index = false;
+    // Same mapping as RCChannelHelper::get_mcs_from_rc_channel
+    int get_mcs_from_rc_channel() {
+        std::lock_guard<std::mutex> lock(rc_mutex);
+        return std::clamp((rc_channels[0] - 1000) / 100, 0, 9);
+    }
+    // returns true if the mcs changed
+    bool perform_mcs_via_rc_channel() {
+        const int mcs = get_mcs_from_rc_channel();
+        if (mcs == settings_mcs_index)
+            return false;
+        settings_mcs_index = mcs;
+        request_apply_air_mcs_index = true;
+        return true;
+    }
+    void apply_air_mcs_index_if_requested() {
+        bool tmp_true = true;
+        if (request_apply_air_mcs_index.compare_exchange_strong(tmp_true, false)) {
+            tx.update_mcs_index(settings_mcs_index);
+        }
+    }
+    void perform_rate_adjustment() { burn_cpu_us(50); }
+    void update_statistics() { burn_cpu_us(200); }
+};
+
+struct Request {
+    int mcs_index;
+    Clock::time_point time_point;
+};
+
+// The FC sends RC_CHANNELS at 10Hz; the user flips the MCS switch at random
+// points in time, a new pwm value arrives with the next message
+std::vector<Request> run_rc_sender(FakeLink& link, int n_changes, const std::function<void()>& on_rc_channels) {
+    std::vector<Request> requests;
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> delay_ms(0, 99);
+    for (int i = 0; i < n_changes; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100 + delay_ms(rng)));
+        const int mcs = (i % 9) + 1 == link.get_mcs_from_rc_channel() ? 0 : (i % 9) + 1;
+        {
+            std::lock_guard<std::mutex> lock(link.rc_mutex);
+            link.rc_channels[0] = 1000 + mcs * 100 + 50;
+        }
+        requests.push_back({mcs, Clock::now()});
+        on_rc_channels();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    return requests;
+}
+
+bool print_latencies(const std::string& tag, const std::vector<Request>& requests, const std::vector<MockWBTxRx::Change>& changes) {
+    std::vector<int> latencies_us;
+    for (size_t i = 0; i < requests.size() && i < changes.size(); i++) {
+        if (changes[i].mcs_index != requests[i].mcs_index)
+            return false;
+        latencies_us.push_back(static_cast<int>(std::chrono::duration_cast<std::chrono::microseconds>(changes[i].time_point - requests[i].time_point).count()));
+    }
+    using openhd_test_helper::percentile;
+    std::cout << tag << " MCS change latency p50:" << percentile(latencies_us, 0.5) << "us p90:" << percentile(latencies_us, 0.9)
+              << "us p99:" << percentile(latencies_us, 0.99) << "us max:" << percentile(latencies_us, 1.0) << "us applied:" << changes.size() << "/" << requests.size() << std::endl;
+    return changes.size() == requests.size();
+}
+
+// Same structure as the old WBLink::loop_do_work
+bool run_legacy(int n_changes) {
+    FakeLink link;
+    std::atomic<bool> run = true;
+    std::thread worker([&link, &run]() {
+        auto last_stats = Clock::now();
+        while (run) {
+            link.perform_mcs_via_rc_channel();
+            link.perform_rate_adjustment();
+            link.apply_air_mcs_index_if_requested();
+            if (Clock::now() - last_stats >= std::chrono::milliseconds(500)) {
+                last_stats = Clock::now();
+                link.update_statistics();
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    });
+    const auto requests = run_rc_sender(link, n_changes, []() {});
+    run = false;
+    worker.join();
+    return print_latencies("legacy   ", requests, link.tx.get_changes());
+}
+
+// Same tasks as WBLink (air), set up by the production add_wb_link_tasks()
+bool run_scheduler(int n_changes) {
+    using openhd::wb::DeadlineScheduler;
+    FakeLink link;
+    DeadlineScheduler scheduler;
+    openhd::wb::WBLinkTaskIds tasks;
+    openhd::wb::WBLinkTaskCallbacks callbacks;
+    callbacks.work_item = []() {};
+    callbacks.tx_power = []() {};
+    // Like WBLink::wt_perform_mcs_via_rc_channel_if_enabled
+    callbacks.mcs_via_rc = [&link, &scheduler, &tasks]() {
+        if (link.perform_mcs_via_rc_channel()) {
+            scheduler.trigger(tasks.rate_adjustment);
+            scheduler.trigger(tasks.apply_air_mcs);
+        }
+    };
+    callbacks.rate_adjustment = [&link]() { link.perform_rate_adjustment(); };
+    callbacks.apply_air_mcs = [&link]() { link.apply_air_mcs_index_if_requested(); };
+    callbacks.statistics = [&link]() { link.update_statistics(); };
+    tasks = openhd::wb::add_wb_link_tasks(scheduler, true, std::move(callbacks));
+    std::thread worker([&scheduler]() { scheduler.run(); });
+    const auto requests = run_rc_sender(link, n_changes, [&scheduler, &tasks]() { scheduler.trigger(tasks.mcs_via_rc); });
+    scheduler.stop();
+    worker.join();
+    const bool ok = print_latencies("scheduler", requests, link.tx.get_changes());
+    for (const auto& stats : scheduler.get_stats()) {
+        std::cout << "  " << stats.tag << " runs:" << stats.n_runs << " max lateness:" << stats.max_lateness_us << "us max duration:" << stats.max_duration_us << "us"
+                  << std::endl;
+    }
+    return ok;
+}
+
+// Work item scheduled for the future runs on time, not on the next poll
+bool run_delayed_trigger() {
+    using openhd::wb::DeadlineScheduler;
+    DeadlineScheduler scheduler;
+    Clock::time_point executed;
+    const int task = scheduler.add_task("delayed", DeadlineScheduler::EVENT_ONLY, [&executed]() { executed = Clock::now(); });
+    std::thread worker([&scheduler]() { scheduler.run(); });
+    const auto deadline = Clock::now() + std::chrono::milliseconds(250);
+    scheduler.trigger_at(task, deadline);
+    std::this_thread::sleep_for(std::chrono::milliseconds(400));
+    scheduler.stop();
+    worker.join();
+    const auto lateness_us = std::chrono::duration_cast<std::chrono::microseconds>(executed - deadline).count();
+    std::cout << "delayed trigger lateness:" << lateness_us << "us" << std::endl;
+    return lateness_us >= 0 && lateness_us < 20000;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const int n_changes = argc > 1 ? std::max(1, std::atoi(argv[1])) : 30;
+    bool ok = run_legacy(n_changes);
+    ok &= run_scheduler(n_changes);
+    ok &= run_delayed_trigger();
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
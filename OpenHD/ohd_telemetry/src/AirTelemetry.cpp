@@ -27,6 +27,7 @@
 
 #include "mav_helper.h"
 #include "mavsdk_temporary/XMavlinkParamProvider.h"
+#include "openhd_config.h"
 #include "openhd_temporary_air_or_ground.h"
 #include "openhd_util.h"
 #include "openhd_util_time.h"
@@ -37,11 +38,20 @@ AirTelemetry::AirTelemetry() : MavlinkSystem(OHD_SYS_ID_AIR) {
     assert(m_console);
     // 2. 初始化设置管理器
     m_air_settings = std::make_unique<openhd::telemetry::air::SettingsHolder>();
+    // Optional tlog recorder
+    // 可选的 tlog 记录器
+    const auto config = openhd::load_config();
+    if (config.GEN_ENABLE_TLOG) {
+        TLogRecorder::Options options{};
+        options.prefix = "air";
+        options.max_file_size = static_cast<std::size_t>(config.GEN_TLOG_FILE_SIZE_MB) * 1024 * 1024;
+        m_tlog_recorder = std::make_unique<TLogRecorder>(options);
+    }
     // 3. 初始化串口管理器
     m_fc_serial = std::make_unique<SerialEndpointManager>();
     // 4. 创建主组件
     m_ohd_main_component = std::make_shared<OHDMainComponent>(_sys_id, true);
-    m_components.push_back(m_ohd_main_component);
+    add_component(m_ohd_main_component);
     // 5. 创建 MAVLink 参数提供器
     m_generic_mavlink_param_provider = std::make_shared<XMavlinkParamProvider>(_sys_id, MAV_COMP_ID_ONBOARD_COMPUTER);
     // 6. 检查是否为树莓派平台
@@ -53,8 +63,8 @@ AirTelemetry::AirTelemetry() : MavlinkSystem(OHD_SYS_ID_AIR) {
     // modules have provided all their paramters.
     // 7. 添加参数 调用 add_params 方法，将所有设置添加到 MAVLink 参数提供器中。
     m_generic_mavlink_param_provider->add_params(get_all_settings());
-    // 将参数提供器添加到 m_components 列表中。
-    m_components.push_back(m_generic_mavlink_param_provider);
+    // 将参数提供器添加到组件索引中。
+    add_component(m_generic_mavlink_param_provider);
     // 8. 创建 TCP 服务器
     // 创建一个 TCPEndpoint 对象，用于监听 TCP 连接（默认端口为 1445）。
     m_tcp_server = std::make_unique<TCPEndpoint>(openhd::TCPServer::Config{TCPEndpoint::DEFAULT_PORT});  // 1445
@@ -102,6 +112,11 @@ void AirTelemetry::send_messages_ground_unit(std::vector<MavlinkMessage>& messag
     if (m_tcp_server) {
         m_tcp_server->sendMessages(messages);
     }
+    // After sending - re-uses the wire bytes the endpoints created
+    // 在发送之后记录 - 复用端点已生成的线上字节
+    if (m_tlog_recorder) {
+        m_tlog_recorder->record(messages);
+    }
 }
 
 void AirTelemetry::on_messages_fc(std::vector<MavlinkMessage>& messages) {
@@ -116,6 +131,9 @@ void AirTelemetry::on_messages_fc(std::vector<MavlinkMessage>& messages) {
 
 void AirTelemetry::on_messages_ground_unit(std::vector<MavlinkMessage>& messages) {
     // m_console->debug("on_messages_ground_unit {}", messages.size());
+    if (m_tlog_recorder) {
+        m_tlog_recorder->record(messages);
+    }
     //   filter out heartbeats from the openhd ground unit,we do not need to send
     //   them to the FC
     std::vector<MavlinkMessage> filtered_messages_fc;
@@ -128,20 +146,14 @@ void AirTelemetry::on_messages_ground_unit(std::vector<MavlinkMessage>& messages
     send_messages_fc(filtered_messages_fc);
     // any data created by an OpenHD component on the air pi only needs to be sent
     // to the ground pi, the FC cannot do anything with it anyways.
-    std::lock_guard<std::mutex> guard(m_components_lock);
-    for (auto& component : m_components) {
-        std::vector<MavlinkMessage> responses{};
-        OHDUtil::vec_append(responses, component->process_mavlink_messages(messages));
-        send_messages_ground_unit(responses);
-    }
+    auto responses = dispatch_mavlink_messages(messages);
+    send_messages_ground_unit(responses);
 }
 
 void AirTelemetry::loop_infinite(bool& terminate, const bool enableExtendedLogging) {
     const auto log_intervall = std::chrono::seconds(5);
-    const auto loop_intervall = std::chrono::milliseconds(100);
     auto last_log = std::chrono::steady_clock::now();
     while (!terminate) {
-        const auto loopBegin = std::chrono::steady_clock::now();
         if (std::chrono::steady_clock::now() - last_log >= log_intervall) {
             // State debug logging
             last_log = std::chrono::steady_clock::now();
@@ -150,28 +162,23 @@ void AirTelemetry::loop_infinite(bool& terminate, const bool enableExtendedLoggi
             if (enableExtendedLogging && m_wb_endpoint) {
                 m_console->debug(m_wb_endpoint->createInfo());
             }
+            if (enableExtendedLogging) {
+                m_console->debug(get_generate_stats_and_reset());
+            }
+            if (enableExtendedLogging && m_tlog_recorder) {
+                const auto stats = m_tlog_recorder->get_stats();
+                m_console->debug("tlog recorded:{} dropped:{} files:{}", stats.n_recorded, stats.n_dropped, stats.n_files);
+            }
         }
-        // send messages to the ground pi in regular intervals, includes heartbeat.
+        // Sleeps until the next component deadline (e.g. heartbeat) or until a
+        // component has something to send right away (e.g. a log message), then
+        // sends the generated messages to the ground pi.
         // everything else is handled by the callbacks and their threads
+        // 休眠直到下一个组件截止时间或组件请求立即发送，然后将生成的消息发送到地面端
         {
             // NOTE: No component on the air unit ever needs to talk to the FC himself
-            std::lock_guard<std::mutex> guard(m_components_lock);
-            for (auto& component : m_components) {
-                auto messages = component->generate_mavlink_messages();
-                send_messages_ground_unit(messages);
-            }
-        }
-        const auto loopDelta = std::chrono::steady_clock::now() - loopBegin;
-        if (loopDelta > loop_intervall) {
-            // We can't keep up with the wanted loop interval
-            m_console->debug(
-                "Warning AirTelemetry cannot keep up with the wanted loop interval. "
-                "Took {}",
-                openhd::util::time_readable(loopDelta));
-        } else {
-            const auto sleepTime = loop_intervall - loopDelta;
-            // send out in X second intervals
-            std::this_thread::sleep_for(loop_intervall);
+            auto messages = wait_and_generate_mavlink_messages(std::chrono::milliseconds(500));
+            send_messages_ground_unit(messages);
         }
     }
 }
@@ -186,7 +193,6 @@ std::string AirTelemetry::create_debug() {
 }
 
 void AirTelemetry::add_settings_generic(const std::vector<openhd::Setting>& settings) {
-    std::lock_guard<std::mutex> guard(m_components_lock);
     m_generic_mavlink_param_provider->add_params(settings);
     m_console->debug("Added parameter component");
 }
@@ -201,8 +207,7 @@ void AirTelemetry::add_settings_camera_component(int camera_index, const std::ve
     auto param_server = std::make_shared<XMavlinkParamProvider>(_sys_id, cam_comp_id, std::chrono::seconds(1));
     param_server->add_params(settings);
     param_server->set_ready();
-    std::lock_guard<std::mutex> guard(m_components_lock);
-    m_components.push_back(param_server);
+    add_component(param_server);
     m_console->debug("Added camera component");
 }
 
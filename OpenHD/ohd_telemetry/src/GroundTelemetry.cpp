@@ -27,6 +27,7 @@
 #include <iostream>
 
 #include "mav_helper.h"
+#include "openhd_config.h"
 #include "openhd_temporary_air_or_ground.h"
 #include "openhd_util.h"
 #include "openhd_util_time.h"
@@ -36,6 +37,15 @@ GroundTelemetry::GroundTelemetry() : MavlinkSystem(OHD_SYS_ID_GROUND) {
   assert(m_console);
   m_gnd_settings =
       std::make_unique<openhd::telemetry::ground::SettingsHolder>();
+  // Optional tlog recorder
+  const auto config = openhd::load_config();
+  if (config.GEN_ENABLE_TLOG) {
+    TLogRecorder::Options options{};
+    options.prefix = "ground";
+    options.max_file_size =
+        static_cast<std::size_t>(config.GEN_TLOG_FILE_SIZE_MB) * 1024 * 1024;
+    m_tlog_recorder = std::make_unique<TLogRecorder>(options);
+  }
   m_endpoint_tracker = std::make_unique<SerialEndpointManager>();
   m_gcs_endpoint = std::make_unique<UDPEndpoint>(
       "GroundStationUDP", OHD_GROUND_CLIENT_UDP_PORT_OUT,
@@ -45,7 +55,7 @@ GroundTelemetry::GroundTelemetry() : MavlinkSystem(OHD_SYS_ID_GROUND) {
       // and we accept udp data from anybody on 14551
       "0.0.0.0");
   m_gcs_endpoint->registerCallback(
-      [this](std::vector<MavlinkMessage> messages) {
+      [this](const std::vector<MavlinkMessage>& messages) {
         on_messages_ground_station_clients(messages);
       });
   m_tcp_server = std::make_unique<TCPEndpoint>(
@@ -53,12 +63,12 @@ GroundTelemetry::GroundTelemetry() : MavlinkSystem(OHD_SYS_ID_GROUND) {
   // m_tcp_server= nullptr;
   if (m_tcp_server) {
     m_tcp_server->registerCallback(
-        [this](std::vector<MavlinkMessage> messages) {
+        [this](const std::vector<MavlinkMessage>& messages) {
           on_messages_ground_station_clients(messages);
         });
   }
   m_ohd_main_component = std::make_shared<OHDMainComponent>(_sys_id, false);
-  m_components.push_back(m_ohd_main_component);
+  add_component(m_ohd_main_component);
 #ifdef OPENHD_TELEMETRY_SDL_FOR_JOYSTICK_FOUND
   if (m_gnd_settings->get_settings().enable_rc_over_joystick) {
     enable_joystick();
@@ -74,7 +84,7 @@ GroundTelemetry::GroundTelemetry() : MavlinkSystem(OHD_SYS_ID_GROUND) {
   m_generic_mavlink_param_provider = std::make_shared<XMavlinkParamProvider>(
       _sys_id, MAV_COMP_ID_ONBOARD_COMPUTER);
   m_generic_mavlink_param_provider->add_params(get_all_settings());
-  m_components.push_back(m_generic_mavlink_param_provider);
+  add_component(m_generic_mavlink_param_provider);
   setup_uart();
   openhd::ExternalDeviceManager::instance().register_listener(
       [this](openhd::ExternalDevice external_device, bool connected) {
@@ -132,6 +142,9 @@ void GroundTelemetry::on_messages_air_unit(
 void GroundTelemetry::on_messages_ground_station_clients(
     const std::vector<MavlinkMessage>& messages) {
   // debugMavlinkMessages(messages,"GSC");
+  if (m_tlog_recorder) {
+    m_tlog_recorder->record(messages);
+  }
   //  All messages from the ground station(s) are forwarded to the air unit,
   //  unless they have a target sys id of the ohd ground unit itself
   auto [generic, local_only] =
@@ -169,12 +182,9 @@ void GroundTelemetry::on_messages_ground_station_clients(
   // OpenHD components running on the ground station don't need to talk to the
   // air unit. This is not exactly following the mavlink routing standard, but
   // saves a lot of bandwidth.
-  std::lock_guard<std::mutex> guard(m_components_lock);
-  for (auto& component : m_components) {
-    const auto responses = component->process_mavlink_messages(messages);
-    // for now, send to the ground station clients only
-    send_messages_ground_station_clients(responses);
-  }
+  const auto responses = dispatch_mavlink_messages(messages);
+  // for now, send to the ground station clients only
+  send_messages_ground_station_clients(responses);
 }
 
 void GroundTelemetry::send_messages_ground_station_clients(
@@ -185,6 +195,10 @@ void GroundTelemetry::send_messages_ground_station_clients(
   if (m_tcp_server) {
     m_tcp_server->sendMessages(messages);
   }
+  // After sending - re-uses the wire bytes the endpoints created
+  if (m_tlog_recorder) {
+    m_tlog_recorder->record(messages);
+  }
 }
 
 void GroundTelemetry::send_messages_air_unit(
@@ -199,10 +213,8 @@ void GroundTelemetry::send_messages_air_unit(
 void GroundTelemetry::loop_infinite(bool& terminate,
                                     const bool enableExtendedLogging) {
   const auto log_intervall = std::chrono::seconds(5);
-  const auto loop_intervall = std::chrono::milliseconds(100);
   auto last_log = std::chrono::steady_clock::now();
   while (!terminate) {
-    const auto loopBegin = std::chrono::steady_clock::now();
     if (std::chrono::steady_clock::now() - last_log >= log_intervall) {
       last_log = std::chrono::steady_clock::now();
       // m_console->debug("GroundTelemetry::loopInfinite()");
@@ -213,39 +225,34 @@ void GroundTelemetry::loop_infinite(bool& terminate,
       if (enableExtendedLogging && m_gcs_endpoint) {
         m_console->debug(m_gcs_endpoint->createInfo());
       }
+      if (enableExtendedLogging) {
+        m_console->debug(get_generate_stats_and_reset());
+      }
+      if (enableExtendedLogging && m_tlog_recorder) {
+        const auto stats = m_tlog_recorder->get_stats();
+        m_console->debug("tlog recorded:{} dropped:{} files:{}",
+                         stats.n_recorded, stats.n_dropped, stats.n_files);
+      }
     }
-    // send messages to the ground station in regular intervals, includes
-    // heartbeat. everything else is handled by the callbacks and their threads
+    // Sleeps until the next component deadline (e.g. heartbeat) or until a
+    // component has something to send right away, then sends the generated
+    // messages to the ground station. everything else is handled by the
+    // callbacks and their threads
+    // 休眠直到下一个组件截止时间或组件请求立即发送，然后发送到地面站
     {
       // NOTE: No component from the ground station ever needs to talk to the
       // air unit / FC itself
-      std::lock_guard<std::mutex> guard(m_components_lock);
-      for (auto& component : m_components) {
-        assert(component);
-        const auto messages = component->generate_mavlink_messages();
-        send_messages_ground_station_clients(messages);
-        // exception: timesync
-        for (const auto& msg : messages) {
-          if (msg.m.msgid == MAVLINK_MSG_ID_TIMESYNC) {
-            m_console->debug("Sending timesync to air");
-            send_messages_air_unit({msg});
-          }
+      const auto messages =
+          wait_and_generate_mavlink_messages(std::chrono::milliseconds(500));
+      send_messages_ground_station_clients(messages);
+      // exception: timesync
+      for (const auto& msg : messages) {
+        if (msg.m.msgid == MAVLINK_MSG_ID_TIMESYNC) {
+          m_console->debug("Sending timesync to air");
+          send_messages_air_unit({msg});
         }
       }
     }
-    const auto loopDelta = std::chrono::steady_clock::now() - loopBegin;
-    if (loopDelta > loop_intervall) {
-      // We can't keep up with the wanted loop interval
-      // We can't keep up with the wanted loop interval
-      m_console->debug(
-          "Warning GroundTelemetry cannot keep up with the wanted loop "
-          "interval. Took {}",
-          openhd::util::time_readable(loopDelta));
-    } else {
-      const auto sleepTime = loop_intervall - loopDelta;
-      // send out in X second intervals
-      std::this_thread::sleep_for(loop_intervall);
-    }
   }
 }
 
@@ -263,7 +270,6 @@ std::string GroundTelemetry::create_debug() const {
 
 void GroundTelemetry::add_settings_generic(
     const std::vector<openhd::Setting>& settings) {
-  std::lock_guard<std::mutex> guard(m_components_lock);
   m_generic_mavlink_param_provider->add_params(settings);
   m_console->debug("Added parameter component");
 }
@@ -391,7 +397,7 @@ void GroundTelemetry::setup_uart() {
     options.flow_control = false;
     options.enable_reading = false;
     m_endpoint_tracker->configure(options, "gnd_ser",
-                                  [this](std::vector<MavlinkMessage> messages) {
+                                  [this](const std::vector<MavlinkMessage>& messages) {
                                     // We ignore any incoming messages here for
                                     // now, since it is only for mavlink out via
                                     // serial
@@ -405,7 +411,7 @@ void GroundTelemetry::set_link_handle(std::shared_ptr<OHDLink> link) {
   // only call this once, we do not support changing the link handle at run time
   assert(m_wb_endpoint == nullptr);
   m_wb_endpoint = std::make_unique<WBEndpoint>(link, "wb_tx");
-  m_wb_endpoint->registerCallback([this](std::vector<MavlinkMessage> messages) {
+  m_wb_endpoint->registerCallback([this](const std::vector<MavlinkMessage>& messages) {
     on_messages_air_unit(messages);
   });
 }
@@ -36,6 +36,7 @@
 #include "openhd_link.hpp"
 #include "openhd_settings_imp.h"
 #include "openhd_spdlog.h"
+#include "tlog/TLogRecorder.h"
 
 #ifdef OPENHD_TELEMETRY_SDL_FOR_JOYSTICK_FOUND
 #include "rc/JoystickReader.h"
@@ -103,6 +104,9 @@ class GroundTelemetry : public MavlinkSystem {
   void disable_joystick();
 #endif  // OPENHD_TELEMETRY_SDL_FOR_JOYSTICK_FOUND
  private:
+  // Optional (GEN_ENABLE_TLOG), records everything sent to / received from the
+  // ground station clients. Declared first - destroyed after the endpoints.
+  std::unique_ptr<TLogRecorder> m_tlog_recorder;
   std::shared_ptr<spdlog::logger> m_console;
   std::unique_ptr<openhd::telemetry::ground::SettingsHolder> m_gnd_settings;
   // Mavlink to / from gcs station(s)
@@ -114,8 +118,6 @@ class GroundTelemetry : public MavlinkSystem {
   // send/receive data via wb
   std::unique_ptr<WBEndpoint> m_wb_endpoint;
   std::shared_ptr<OHDMainComponent> m_ohd_main_component;
-  std::mutex m_components_lock;
-  std::vector<std::shared_ptr<MavlinkComponent>> m_components;
   std::shared_ptr<XMavlinkParamProvider> m_generic_mavlink_param_provider;
   //
 #ifdef OPENHD_TELEMETRY_SDL_FOR_JOYSTICK_FOUND
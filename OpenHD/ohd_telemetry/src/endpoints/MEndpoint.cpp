@@ -29,7 +29,10 @@
 // #define OHD_TELEMETRY_TESTING_ENABLE_PACKET_LOSS
 
 MEndpoint::MEndpoint(std::string tag, bool debug_mavlink_msg_packet_loss)
-    : TAG(std::move(tag)), m_mavlink_channel(checkoutFreeChannel()), m_debug_mavlink_msg_packet_loss(debug_mavlink_msg_packet_loss) {
+    : TAG(std::move(tag)),
+      m_mavlink_channel(checkoutFreeChannel()),
+      m_frame_scanner(m_mavlink_channel),
+      m_debug_mavlink_msg_packet_loss(debug_mavlink_msg_packet_loss) {
     // 这行代码通过日志系统记录了一条调试信息。
     openhd::log::get_default()->debug("{} using channel:{} debug_mavlink_msg_packet_los:{}", TAG, m_mavlink_channel, m_debug_mavlink_msg_packet_loss);
 }
@@ -76,24 +79,19 @@ void MEndpoint::parseNewData(const uint8_t* data, const int data_len) {
     //<<TAG<<" received data:"<<data_len<<"
     //"<<MavlinkHelpers::raw_content(data,data_len)<<"\n";
     m_rx_n_bytes += data_len;
-    std::vector<MavlinkMessage> messages;
-    mavlink_message_t msg;
-    for (int i = 0; i < data_len; i++) {
-        uint8_t res = mavlink_parse_char(m_mavlink_channel, (uint8_t)data[i], &msg, &receiveMavlinkStatus);
-        if (res) {
-            messages.push_back(MavlinkMessage{msg});
-            // From
-            // https://github.com/mavlink/c_uart_interface_example/blob/master/serial_port.cpp
-            if ((m_last_status.packet_rx_drop_count != receiveMavlinkStatus.packet_rx_drop_count) && m_debug_mavlink_msg_packet_loss) {
-                openhd::log::get_default()->warn("DROPPED {} PACKETS", receiveMavlinkStatus.packet_rx_drop_count);
-            }
-            m_last_status = receiveMavlinkStatus;
-        }
+    // Re-use the message storage of the previous call (no allocation)
+    // 复用上一次调用的消息存储（不分配内存）
+    m_rx_messages.clear();
+    m_frame_scanner.parse(data, data_len, m_rx_messages);
+    const int n_dropped = m_frame_scanner.get_n_dropped();
+    if (n_dropped != m_last_n_dropped && m_debug_mavlink_msg_packet_loss) {
+        openhd::log::get_default()->warn("DROPPED {} PACKETS", n_dropped);
     }
-    onNewMavlinkMessages(messages);
+    m_last_n_dropped = n_dropped;
+    onNewMavlinkMessages(m_rx_messages);
 }
 
-void MEndpoint::onNewMavlinkMessages(std::vector<MavlinkMessage> messages) {
+void MEndpoint::onNewMavlinkMessages(const std::vector<MavlinkMessage>& messages) {
     if (messages.empty())
         return;
     // openhd::log::create_or_get(TAG)->debug("N messages
@@ -33,6 +33,7 @@
 
 #include "../mav_helper.h"
 #include "../mav_include.h"
+#include "MavlinkFrameScanner.h"
 #include "openhd_spdlog.h"
 
 // Mavlink Endpoint
@@ -146,9 +147,13 @@ class MEndpoint {
     // increases message count and forwards the messages via the callback if
     // registered.
     // 增加消息计数，并在回调已注册的情况下通过回调转发消息。
-    void onNewMavlinkMessages(std::vector<MavlinkMessage> messages);
-    mavlink_status_t receiveMavlinkStatus{};
+    void onNewMavlinkMessages(const std::vector<MavlinkMessage>& messages);
     const uint8_t m_mavlink_channel;
+    MavlinkFrameScanner m_frame_scanner;
+    // Messages of the last parseNewData() call, cleared (but not freed) on
+    // each call. parseNewData() is only called by the rx thread of the endpoint.
+    // 上一次 parseNewData() 调用解析出的消息，每次调用时清空（但不释放）。
+    std::vector<MavlinkMessage> m_rx_messages;
     std::chrono::steady_clock::time_point lastMessage{};
     int m_n_messages_received = 0;
     // sendMessage() might be called by different threads.
@@ -171,7 +176,7 @@ class MEndpoint {
 
    private:
     const bool m_debug_mavlink_msg_packet_loss;
-    mavlink_status_t m_last_status;
+    int m_last_n_dropped = 0;
 };
 
 #endif  // XMAVLINKSERVICE_MENDPOINT_H
@@ -0,0 +1,244 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "MavlinkFrameScanner.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+constexpr int V1_HEADER_LEN = 6;
+constexpr int V2_HEADER_LEN = MAVLINK_NUM_HEADER_BYTES;
+
+// X.25 (same as crc_accumulate), slicing-by-8: 8 bytes per step, table k
+// advances the crc of a byte by k more (zero) bytes.
+// X.25 校验（与 crc_accumulate 相同），slicing-by-8：每步处理 8 个字节。
+using CrcTables = std::array<std::array<uint16_t, 256>, 8>;
+constexpr CrcTables create_crc_tables() {
+    CrcTables tables{};
+    for (int i = 0; i < 256; i++) {
+        uint8_t tmp = static_cast<uint8_t>(i);
+        tmp ^= static_cast<uint8_t>(tmp << 4);
+        tables[0][i] = static_cast<uint16_t>((tmp << 8) ^ (tmp << 3) ^ (tmp >> 4));
+    }
+    for (int k = 1; k < 8; k++) {
+        for (int i = 0; i < 256; i++) {
+            const uint16_t prev = tables[k - 1][i];
+            tables[k][i] = (prev >> 8) ^ tables[0][prev & 0xFF];
+        }
+    }
+    return tables;
+}
+constexpr CrcTables CRC_TABLES = create_crc_tables();
+
+uint16_t crc_update(uint16_t crc, const uint8_t* p, int len) {
+    for (; len >= 8; len -= 8, p += 8) {
+        const uint16_t x = crc ^ (p[0] | (p[1] << 8));
+        crc = CRC_TABLES[7][x & 0xFF] ^ CRC_TABLES[6][x >> 8] ^ CRC_TABLES[5][p[2]] ^ CRC_TABLES[4][p[3]] ^ CRC_TABLES[3][p[4]] ^ CRC_TABLES[2][p[5]] ^
+              CRC_TABLES[1][p[6]] ^ CRC_TABLES[0][p[7]];
+    }
+    for (int i = 0; i < len; i++) {
+        crc = (crc >> 8) ^ CRC_TABLES[0][(crc ^ p[i]) & 0xFF];
+    }
+    return crc;
+}
+
+bool is_stx(uint8_t b) { return b == MAVLINK_STX || b == MAVLINK_STX_MAVLINK1; }
+
+// Returns a pointer to the first 0xFD / 0xFE in [p,end), end if there is none
+// 返回 [p,end) 中第一个 0xFD / 0xFE 的指针，没有则返回 end
+const uint8_t* find_stx(const uint8_t* p, const uint8_t* end) {
+    // Most of the time, the next frame starts right where the last one ended
+    if (p < end && is_stx(*p)) return p;
+#if defined(__SSE2__)
+    const __m128i stx_v2 = _mm_set1_epi8(static_cast<char>(MAVLINK_STX));
+    const __m128i stx_v1 = _mm_set1_epi8(static_cast<char>(MAVLINK_STX_MAVLINK1));
+    for (; end - p >= 16; p += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, stx_v2), _mm_cmpeq_epi8(v, stx_v1)));
+        if (mask != 0) return p + __builtin_ctz(mask);
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; end - p >= 16; p += 16) {
+        const uint8x16_t v = vld1q_u8(p);
+        const uint8x16_t match = vorrq_u8(vceqq_u8(v, vdupq_n_u8(MAVLINK_STX)), vceqq_u8(v, vdupq_n_u8(MAVLINK_STX_MAVLINK1)));
+        // 4 bits per byte
+        const uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(match), 4)), 0);
+        if (mask != 0) return p + (__builtin_ctzll(mask) >> 2);
+    }
+#endif
+    for (; p < end; p++) {
+        if (is_stx(*p)) return p;
+    }
+    return end;
+}
+
+enum class FrameResult { OK, INCOMPLETE, INVALID_HEADER, BAD_CRC };
+
+// Checks if there is a complete, valid frame at p (p[0] is STX)
+// 检查 p 处（p[0] 为 STX）是否为完整且有效的帧
+FrameResult check_frame(const uint8_t* p, int available, int& frame_len) {
+    const bool v1 = p[0] == MAVLINK_STX_MAVLINK1;
+    const int header_len = v1 ? V1_HEADER_LEN : V2_HEADER_LEN;
+    if (!v1 && available >= 3 && (p[2] & ~MAVLINK_IFLAG_SIGNED) != 0) {
+        // Unknown incompat flags, the state machine drops those, too
+        return FrameResult::INVALID_HEADER;
+    }
+    if (available < header_len) return FrameResult::INCOMPLETE;
+    const int payload_len = p[1];
+    const bool is_signed = !v1 && (p[2] & MAVLINK_IFLAG_SIGNED);
+    frame_len = header_len + payload_len + MAVLINK_NUM_CHECKSUM_BYTES + (is_signed ? MAVLINK_SIGNATURE_BLOCK_LEN : 0);
+    if (available < frame_len) return FrameResult::INCOMPLETE;
+    const uint32_t msgid = v1 ? p[5] : (p[7] | (p[8] << 8) | (static_cast<uint32_t>(p[9]) << 16));
+    // Unknown messages are checked with crc_extra 0, like mavlink_parse_char does
+    const mavlink_msg_entry_t* entry = mavlink_get_msg_entry(msgid);
+    uint16_t crc = crc_update(0xFFFF, p + 1, header_len - 1 + payload_len);
+    const uint8_t crc_extra = entry ? entry->crc_extra : 0;
+    crc = crc_update(crc, &crc_extra, 1);
+    const uint8_t* ck = p + header_len + payload_len;
+    if (ck[0] != (crc & 0xFF) || ck[1] != (crc >> 8)) return FrameResult::BAD_CRC;
+    return FrameResult::OK;
+}
+
+// Same content as mavlink_parse_char would produce
+// 与 mavlink_parse_char 解析出的内容相同
+void fill_message(const uint8_t* p, int frame_len, MavlinkMessage& out) {
+    mavlink_message_t& msg = out.m;
+    const bool v1 = p[0] == MAVLINK_STX_MAVLINK1;
+    const int header_len = v1 ? V1_HEADER_LEN : V2_HEADER_LEN;
+    const int payload_len = p[1];
+    msg.magic = p[0];
+    msg.len = p[1];
+    if (v1) {
+        msg.incompat_flags = 0;
+        msg.compat_flags = 0;
+        msg.seq = p[2];
+        msg.sysid = p[3];
+        msg.compid = p[4];
+        msg.msgid = p[5];
+    } else {
+        msg.incompat_flags = p[2];
+        msg.compat_flags = p[3];
+        msg.seq = p[4];
+        msg.sysid = p[5];
+        msg.compid = p[6];
+        msg.msgid = p[7] | (p[8] << 8) | (static_cast<uint32_t>(p[9]) << 16);
+    }
+    const uint8_t* ck = p + header_len + payload_len;
+    msg.checksum = ck[0] | (ck[1] << 8);
+    msg.ck[0] = ck[0];
+    msg.ck[1] = ck[1];
+    // Messages in the arena are value-initialized, the rest of the payload is
+    // already zero (zero-fill of short, truncated payloads)
+    std::memcpy(_MAV_PAYLOAD_NON_CONST(&msg), p + header_len, payload_len);
+    if (msg.incompat_flags & MAVLINK_IFLAG_SIGNED) {
+        std::memcpy(msg.signature, ck + MAVLINK_NUM_CHECKSUM_BYTES, MAVLINK_SIGNATURE_BLOCK_LEN);
+    }
+    out.set_wire(p, static_cast<uint16_t>(frame_len));
+}
+
+// The state machine just rejected a frame because of its CRC
+// 状态机刚刚因 CRC 错误丢弃了一帧
+bool is_bad_crc(const mavlink_parse_state_t state_before, const mavlink_parse_state_t state_after) {
+    return (state_before == MAVLINK_PARSE_STATE_GOT_CRC1 || state_before == MAVLINK_PARSE_STATE_GOT_BAD_CRC1) &&
+           state_after <= MAVLINK_PARSE_STATE_IDLE;
+}
+
+}  // namespace
+
+MavlinkFrameScanner::MavlinkFrameScanner(uint8_t mavlink_channel) : m_mavlink_channel(mavlink_channel) {}
+
+void MavlinkFrameScanner::parse(const uint8_t* data, const int data_len, std::vector<MavlinkMessage>& out) {
+    int offset = 0;
+    // Finish the frame that started at the end of the previous buffer
+    // 先完成上一个缓冲区末尾开始的帧
+    if (m_status.parse_state > MAVLINK_PARSE_STATE_IDLE) {
+        offset = finish_split_frame(data, data_len, out);
+    }
+    const uint8_t* p = data + offset;
+    const uint8_t* const end = data + data_len;
+    while (true) {
+        p = find_stx(p, end);
+        if (p == end) break;
+        int frame_len = 0;
+        const auto result = check_frame(p, static_cast<int>(end - p), frame_len);
+        if (result == FrameResult::OK) {
+            fill_message(p, frame_len, out.emplace_back());
+            p += frame_len;
+        } else if (result == FrameResult::INCOMPLETE) {
+            // Continued in the next buffer
+            // 在下一个缓冲区中继续
+            start_split_frame(p, static_cast<int>(end - p), out);
+            break;
+        } else {
+            // Either not a STX at all or a corrupted frame - re-sync on the
+            // next STX
+            // 不是真正的 STX 或帧已损坏 - 在下一个 STX 处重新同步
+            if (result == FrameResult::BAD_CRC) m_n_dropped++;
+            p++;
+        }
+    }
+}
+
+int MavlinkFrameScanner::get_n_dropped() const { return m_n_dropped; }
+
+int MavlinkFrameScanner::finish_split_frame(const uint8_t* data, const int data_len, std::vector<MavlinkMessage>& out) {
+    for (int i = 0; i < data_len; i++) {
+        const auto state_before = m_status.parse_state;
+        if (mavlink_parse_char(m_mavlink_channel, data[i], &m_msg, &m_status)) {
+            out.emplace_back(m_msg);
+            return i + 1;
+        }
+        if (m_status.parse_state <= MAVLINK_PARSE_STATE_IDLE) {
+            if (is_bad_crc(state_before, m_status.parse_state)) m_n_dropped++;
+            // Was not a valid frame (e.g. a STX in garbage) - the bytes eaten by
+            // the state machine might contain the begin of a valid frame, re-sync
+            // from the begin of this buffer.
+            // 不是有效的帧（例如垃圾数据中的 STX）- 从本缓冲区开头重新同步。
+            mavlink_reset_channel_status(m_mavlink_channel);
+            m_status.parse_state = MAVLINK_PARSE_STATE_IDLE;
+            return 0;
+        }
+    }
+    // Still not complete (tiny buffer)
+    return data_len;
+}
+
+void MavlinkFrameScanner::start_split_frame(const uint8_t* data, const int data_len, std::vector<MavlinkMessage>& out) {
+    for (int i = 0; i < data_len; i++) {
+        // Can only complete if the STX the scanner stopped at was garbage
+        const auto state_before = m_status.parse_state;
+        if (mavlink_parse_char(m_mavlink_channel, data[i], &m_msg, &m_status)) {
+            out.emplace_back(m_msg);
+        } else if (is_bad_crc(state_before, m_status.parse_state)) {
+            m_n_dropped++;
+        }
+    }
+}
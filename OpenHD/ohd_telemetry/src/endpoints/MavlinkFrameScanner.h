@@ -0,0 +1,70 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#ifndef OPENHD_MAVLINKFRAMESCANNER_H
+#define OPENHD_MAVLINKFRAMESCANNER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "../mav_include.h"
+
+// Bulk mavlink parser - instead of feeding every byte through the
+// mavlink_parse_char state machine, it searches for the next STX (0xFD / 0xFE,
+// 16 bytes at a time), reads the header and checks the CRC over the whole frame
+// at once. Garbage in front of a frame / frames with a bad CRC are skipped byte
+// by byte, which re-syncs faster than the state machine (that drops everything
+// up to the end of the bad frame).
+// The byte state machine is only used for frames that are split across two
+// buffers (tail of the previous buffer and head of the next one).
+// 批量 MAVLink 解析器 - 不再把每个字节送入 mavlink_parse_char 状态机，而是（每次 16 字节）
+// 查找下一个 STX（0xFD / 0xFE），读取头部并一次性校验整个帧的 CRC。
+// 只有跨越两个缓冲区的帧才使用逐字节状态机。
+class MavlinkFrameScanner {
+   public:
+    explicit MavlinkFrameScanner(uint8_t mavlink_channel);
+    // Appends all messages that could be parsed to out. The received frame is
+    // kept as the wire data of each message (see MavlinkMessage::set_wire).
+    // 将所有解析出的消息追加到 out。
+    void parse(const uint8_t* data, int data_len, std::vector<MavlinkMessage>& out);
+    // Total number of frames dropped because of a bad CRC
+    // 因 CRC 错误而丢弃的帧的总数
+    [[nodiscard]] int get_n_dropped() const;
+
+   private:
+    // Feeds the begin of a frame that is split across two buffers through
+    // mavlink_parse_char.
+    void start_split_frame(const uint8_t* data, int data_len, std::vector<MavlinkMessage>& out);
+    // Feeds bytes through mavlink_parse_char until the split frame is complete.
+    // Returns the n of consumed bytes, 0 if it was not a valid frame.
+    // 将字节送入 mavlink_parse_char 直到跨缓冲区的帧完成。返回消耗的字节数，无效帧返回 0。
+    int finish_split_frame(const uint8_t* data, int data_len, std::vector<MavlinkMessage>& out);
+
+   private:
+    const uint8_t m_mavlink_channel;
+    mavlink_status_t m_status{};
+    mavlink_message_t m_msg{};
+    int m_n_dropped = 0;
+};
+
+#endif  // OPENHD_MAVLINKFRAMESCANNER_H
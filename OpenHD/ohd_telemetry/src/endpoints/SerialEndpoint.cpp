@@ -24,11 +24,15 @@
 #include "SerialEndpoint.h"
 
 #include <fcntl.h>
+#include <linux/serial.h>
 #include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <termios.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cassert>
 #include <map>
 #include <utility>
@@ -67,31 +71,46 @@ static bool is_serial_fd_still_connected(const int fd) {
   return true;
 }
 
+static int64_t elapsed_us(std::chrono::steady_clock::time_point begin,
+                          std::chrono::steady_clock::time_point end) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(end - begin)
+      .count();
+}
+
 SerialEndpoint::SerialEndpoint(std::string TAG1,
                                SerialEndpoint::HWOptions options1)
-    : MEndpoint(std::move(TAG1)), m_options(std::move(options1)) {
+    : MEndpoint(std::move(TAG1)),
+      m_options(std::move(options1)),
+      m_max_write_queue_size(std::max<std::size_t>(
+          MAX_COALESCED_WRITE_SIZE, m_options.baud_rate / 10 / 2)) {
   m_console = openhd::log::create_or_get(TAG);
   assert(m_console);
   // m_limited_rate_logger=std::make_unique<openhd::log::LimitedRateLogger>(m_console,std::chrono::milliseconds(1000));
+  m_wakeup_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  m_write_buffer.reserve(MAX_COALESCED_WRITE_SIZE);
   m_console->info("created with {}", m_options.to_string());
   start();
 }
 
-SerialEndpoint::~SerialEndpoint() { stop(); }
+SerialEndpoint::~SerialEndpoint() {
+  stop();
+  if (m_wakeup_fd >= 0) close(m_wakeup_fd);
+}
 
 bool SerialEndpoint::sendMessagesImpl(
     const std::vector<MavlinkMessage>& messages) {
   auto message_buffers = aggregate_pack_messages(messages);
   bool success = true;
-  for (const auto& message_buffer : message_buffers) {
-    if (!write_data_serial(*message_buffer.aggregated_data)) {
+  for (auto& message_buffer : message_buffers) {
+    if (!write_data_serial(std::move(message_buffer.aggregated_data))) {
       success = false;
     }
   }
   return success;
 }
 
-bool SerialEndpoint::write_data_serial(const std::vector<uint8_t>& data) {
+bool SerialEndpoint::write_data_serial(
+    std::shared_ptr<std::vector<uint8_t>> data) {
   // m_console->debug("Write data serial:{} bytes",data.size());
   if (m_fd == -1) {
     // cannot send data at the time, UART not setup / doesn't exist. Limit
@@ -101,36 +120,110 @@ bool SerialEndpoint::write_data_serial(const std::vector<uint8_t>& data) {
     }
     return false;
   }
-  const auto before = std::chrono::steady_clock::now();
-  // If we have a fd, but the write fails, most likely the UART disconnected
-  // but the linux driver hasn't noticed it yet.
-  const auto send_len = static_cast<int>(write(m_fd, data.data(), data.size()));
-  const auto send_delta = std::chrono::steady_clock::now() - before;
-  if (send_delta > std::chrono::milliseconds(100)) {
-    const auto send_delta_ms =
-        static_cast<float>(
-            std::chrono::duration_cast<std::chrono::microseconds>(send_delta)
-                .count()) /
-        1000.0f;
-    m_console->warn("UART sending data took {}ms", send_delta_ms);
-  }
-  // m_console->debug("Written {} bytes",send_len);
-  // m_console->debug("{}",MEndpoint::get_tx_rx_stats());
-  if (send_len != data.size()) {
-    m_n_failed_writes++;
-    const auto elapsed_since_last_log =
-        std::chrono::steady_clock::now() - m_last_log_serial_write_failed;
-    if (elapsed_since_last_log >
-        MIN_DELAY_BETWEEN_SERIAL_WRITE_FAILED_LOG_MESSAGES) {
-      m_console->warn("wrote {} instead of {} bytes,n failed:{}", send_len,
-                      data.size(), m_n_failed_writes);
-      m_last_log_serial_write_failed = std::chrono::steady_clock::now();
+  {
+    std::lock_guard<std::mutex> guard(m_write_queue_mutex);
+    m_io_stats.queue_size_bytes += data->size();
+    m_write_queue.push_back(
+        QueuedWrite{std::move(data), std::chrono::steady_clock::now()});
+    // The UART cannot keep up - drop the oldest (telemetry is updated
+    // regularly anyways), but always keep the newest
+    while (m_io_stats.queue_size_bytes > m_max_write_queue_size &&
+           m_write_queue.size() > 1) {
+      m_io_stats.queue_size_bytes -= m_write_queue.front().data->size();
+      m_write_queue.pop_front();
+      m_io_stats.n_buffers_dropped++;
     }
-    return false;
+    m_io_stats.queue_size_bytes_max = std::max(m_io_stats.queue_size_bytes_max,
+                                               m_io_stats.queue_size_bytes);
   }
+  wakeup_io_thread();
   return true;
 }
 
+void SerialEndpoint::wakeup_io_thread() {
+  const uint64_t one = 1;
+  const auto unused = write(m_wakeup_fd, &one, sizeof(one));
+  (void)unused;
+}
+
+bool SerialEndpoint::flush_write_queue() {
+  while (true) {
+    if (m_write_buffer_offset == m_write_buffer.size()) {
+      // Everything written, coalesce what is queued
+      m_write_buffer.clear();
+      m_write_buffer_offset = 0;
+      m_write_buffer_enqueue_times.clear();
+      std::lock_guard<std::mutex> guard(m_write_queue_mutex);
+      while (!m_write_queue.empty()) {
+        const auto& front = m_write_queue.front();
+        // A single message bigger than the max is written on its own
+        if (!m_write_buffer.empty() &&
+            m_write_buffer.size() + front.data->size() >
+                MAX_COALESCED_WRITE_SIZE) {
+          break;
+        }
+        m_write_buffer.insert(m_write_buffer.end(), front.data->begin(),
+                              front.data->end());
+        m_write_buffer_enqueue_times.push_back(front.enqueue_time);
+        m_io_stats.queue_size_bytes -= front.data->size();
+        m_write_queue.pop_front();
+      }
+    }
+    if (m_write_buffer.empty()) return true;
+    const auto before = std::chrono::steady_clock::now();
+    // If we have a fd, but the write fails, most likely the UART disconnected
+    // but the linux driver hasn't noticed it yet.
+    const ssize_t send_len =
+        write(m_fd, m_write_buffer.data() + m_write_buffer_offset,
+              m_write_buffer.size() - m_write_buffer_offset);
+    const auto after = std::chrono::steady_clock::now();
+    if (after - before > std::chrono::milliseconds(100)) {
+      m_console->warn("UART sending data took {}ms",
+                      elapsed_us(before, after) / 1000.0f);
+    }
+    if (send_len < 0) {
+      // Driver buffer full, continued once the fd is writable
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        return true;
+      }
+      m_n_failed_writes++;
+      const auto elapsed_since_last_log =
+          std::chrono::steady_clock::now() - m_last_log_serial_write_failed;
+      if (elapsed_since_last_log >
+          MIN_DELAY_BETWEEN_SERIAL_WRITE_FAILED_LOG_MESSAGES) {
+        m_console->warn("write failed: {}, n failed:{}", GET_ERROR(),
+                        m_n_failed_writes);
+        m_last_log_serial_write_failed = std::chrono::steady_clock::now();
+      }
+      // Start over with a fresh queue once reconnected
+      std::lock_guard<std::mutex> guard(m_write_queue_mutex);
+      m_io_stats.n_buffers_dropped +=
+          m_write_buffer_enqueue_times.size() + m_write_queue.size();
+      m_write_buffer.clear();
+      m_write_buffer_offset = 0;
+      m_write_buffer_enqueue_times.clear();
+      m_write_queue.clear();
+      m_io_stats.queue_size_bytes = 0;
+      return false;
+    }
+    m_write_buffer_offset += send_len;
+    std::lock_guard<std::mutex> guard(m_write_queue_mutex);
+    m_io_stats.n_writes++;
+    m_io_stats.n_bytes_written += send_len;
+    if (m_write_buffer_offset < m_write_buffer.size()) {
+      // Partial write, continued once the fd is writable
+      return true;
+    }
+    for (const auto& enqueue_time : m_write_buffer_enqueue_times) {
+      const auto latency_us = elapsed_us(enqueue_time, after);
+      m_io_stats.tx_latency_us_sum += latency_us;
+      m_io_stats.tx_latency_us_max =
+          std::max<uint64_t>(m_io_stats.tx_latency_us_max, latency_us);
+      m_io_stats.n_buffers_written++;
+    }
+  }
+}
+
 int SerialEndpoint::define_from_baudrate(int baudrate) {
   switch (baudrate) {
     case 9600:
@@ -185,19 +278,14 @@ int SerialEndpoint::setup_port(const SerialEndpoint::HWOptions& options,
   // https://blog.mbedded.ninja/programming/operating-systems/linux/linux-serial-ports-using-c-cpp/
 
   // open() hangs on macOS or Linux devices(e.g. pocket beagle) unless you give
-  // it O_NONBLOCK
-  int fd = open(options.linux_filename.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+  // it O_NONBLOCK. We keep it, the I/O thread multiplexes reads and writes
+  // with poll().
+  int fd = open(options.linux_filename.c_str(),
+                O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
   if (fd == -1) {
     m_console->warn("open failed: {}", GET_ERROR());
     return -1;
   }
-  // We need to clear the O_NONBLOCK again because we can block while reading
-  // as we do it in a separate thread.
-  if (fcntl(fd, F_SETFL, 0) == -1) {
-    m_console->warn("fcntl failed: {}", GET_ERROR());
-    close(fd);
-    return -1;
-  }
   // From
   // https://github.com/mavlink/c_uart_interface_example/blob/master/serial_port.cpp
   if (!isatty(fd)) {
@@ -219,8 +307,10 @@ int SerialEndpoint::setup_port(const SerialEndpoint::HWOptions& options,
   tc.c_lflag &= ~(ECHO | ECHONL | ICANON | IEXTEN | ISIG | TOSTOP);
   tc.c_cflag &= ~(CSIZE | PARENB | CRTSCTS);
   tc.c_cflag |= CS8;
-  tc.c_cc[VMIN] = 0;    // We are ok with 0 bytes.
-  tc.c_cc[VTIME] = 10;  // Timeout after  1s (10 deciseconds)
+  // poll() reports readable as soon as the first byte arrived - with VMIN>1
+  // and VTIME=0 the tty layer would wait for VMIN bytes.
+  tc.c_cc[VMIN] = 1;
+  tc.c_cc[VTIME] = 0;
   if (options.flow_control) {
     tc.c_cflag |= CRTSCTS;
   }
@@ -242,10 +332,22 @@ int SerialEndpoint::setup_port(const SerialEndpoint::HWOptions& options,
     close(fd);
     return -1;
   }
+  // Let the driver push received bytes to the tty layer right away instead of
+  // deferring it. Not supported by all drivers (e.g. pty, some usb serial),
+  // not an error.
+  struct serial_struct serial {};
+  if (ioctl(fd, TIOCGSERIAL, &serial) == 0) {
+    serial.flags |= ASYNC_LOW_LATENCY;
+    if (ioctl(fd, TIOCSSERIAL, &serial) != 0) {
+      m_console->debug("Cannot set ASYNC_LOW_LATENCY: {}", GET_ERROR());
+    }
+  } else {
+    m_console->debug("TIOCGSERIAL not supported: {}", GET_ERROR());
+  }
   return fd;
 }
 
-void SerialEndpoint::connect_and_read_loop() {
+void SerialEndpoint::connect_and_io_loop() {
   while (!_stop_requested) {
     if (!OHDFilesystemUtil::exists(m_options.linux_filename)) {
       if (!uart_log_warning_once) {
@@ -266,40 +368,53 @@ void SerialEndpoint::connect_and_read_loop() {
     }
     m_console->debug("Successfully created UART fd for: {}",
                      m_options.to_string());
-    receive_data_until_error();
+    io_until_error();
     // cleanup and start over again
     close(m_fd);
     m_fd = -1;
   }
 }
 
-void SerialEndpoint::receive_data_until_error() {
-  m_console->debug("receive_data_until_error() begin");
+void SerialEndpoint::io_until_error() {
+  m_console->debug("io_until_error() begin");
   // Enough for MTU 1500 bytes.
   uint8_t buffer[2048];
 
-  struct pollfd fds[1];
+  struct pollfd fds[2];
   fds[0].fd = m_fd;
-  fds[0].events = POLLIN;
+  fds[1].fd = m_wakeup_fd;
+  fds[1].events = POLLIN;
   m_n_failed_reads = 0;
+  auto last_stats_log = std::chrono::steady_clock::now();
 
   while (!_stop_requested) {
-    const auto before = std::chrono::steady_clock::now();
-    const int pollrc = poll(fds, 1, 1000);
+    // Newly enqueued data wakes us up via the eventfd, only wait for writable
+    // if the driver didn't take everything
+    fds[0].events = POLLIN;
+    if (m_write_buffer_offset < m_write_buffer.size()) {
+      fds[0].events |= POLLOUT;
+    }
+    const int pollrc = poll(fds, 2, 1000);
+    const auto wakeup = std::chrono::steady_clock::now();
+    if (pollrc == -1) {
+      if (errno == EINTR) continue;
+      m_console->warn("read poll failure: {}", GET_ERROR());
+      // The UART most likely disconnected.
+      return;
+    }
     // on my ubuntu laptop, with usb serial, if the device disconnects I don't
     // get any error results, but poll suddenly never blocks anymore. Therefore,
-    // every time we time out we check if the fd is still valid and exit if not
-    // (which will lead to a re-start)
-    const auto valid = is_serial_fd_still_connected(m_fd);
-    if (!valid) {
-      m_console->debug("Exiting serial, not connected");
-      return;
+    // every time we time out / get an error we check if the fd is still valid
+    // and exit if not (which will lead to a re-start)
+    if (pollrc == 0 || (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL))) {
+      const auto valid = is_serial_fd_still_connected(m_fd);
+      if (!valid) {
+        m_console->debug("Exiting serial, not connected");
+        return;
+      }
     }
-    // const auto
-    // delta=std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-before).count();
-    // std::cout<<"Poll res:"<<pollrc<<" took:"<<delta<<" ms\n";
     // debug_poll_fd(fds[0]);
-    if (pollrc == 0 || !(fds[0].revents & POLLIN)) {
+    if (pollrc == 0) {
       // if we land here, no data has become available after X ms. Not strictly
       // an error, but on a FC which constantly provides a data stream it most
       // likely is an error.
@@ -314,23 +429,59 @@ void SerialEndpoint::receive_data_until_error() {
       } else {
         // m_console->debug("poll probably timeout {}",m_n_failed_reads);
       }
-      continue;
-    } else if (pollrc == -1) {
-      m_console->warn("read poll failure: {}", GET_ERROR());
-      // The UART most likely disconnected.
+    }
+    if (fds[1].revents & POLLIN) {
+      uint64_t unused;
+      const auto unused2 = read(m_wakeup_fd, &unused, sizeof(unused));
+      (void)unused2;
+    }
+    if (fds[0].revents & POLLIN) {
+      const int recv_len = static_cast<int>(read(m_fd, buffer, sizeof(buffer)));
+      if (recv_len > 0) {
+        MEndpoint::parseNewData(buffer, recv_len);
+        const auto latency_us =
+            elapsed_us(wakeup, std::chrono::steady_clock::now());
+        std::lock_guard<std::mutex> guard(m_write_queue_mutex);
+        m_io_stats.n_reads++;
+        m_io_stats.n_bytes_read += recv_len;
+        m_io_stats.rx_latency_us_sum += latency_us;
+        m_io_stats.rx_latency_us_max =
+            std::max<uint64_t>(m_io_stats.rx_latency_us_max, latency_us);
+      } else if (recv_len < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+                 errno != EINTR) {
+        m_console->warn("read failure: {} {}", recv_len, GET_ERROR());
+        return;
+      }
+    }
+    // Not only on POLLOUT - freshly enqueued data is written right away
+    if (!flush_write_queue()) {
       return;
     }
-    // We enter here if (fds[0].revents & POLLIN) == true
-    const int recv_len = static_cast<int>(read(m_fd, buffer, sizeof(buffer)));
-    if (recv_len > 0) {
-      MEndpoint::parseNewData(buffer, recv_len);
-    } else if (recv_len == 0) {
-      // timeout
-    } else {
-      m_console->warn("read failure: {} {}", recv_len, GET_ERROR());
+    if (m_options.enable_debug &&
+        wakeup - last_stats_log >= std::chrono::seconds(5)) {
+      last_stats_log = wakeup;
+      m_console->debug("{}", get_io_stats().to_string());
     }
   }
-  m_console->debug("receive_data_until_error() end");
+  m_console->debug("io_until_error() end");
+}
+
+SerialEndpoint::IOStats SerialEndpoint::get_io_stats() {
+  std::lock_guard<std::mutex> guard(m_write_queue_mutex);
+  return m_io_stats;
+}
+
+std::string SerialEndpoint::IOStats::to_string() const {
+  std::stringstream ss;
+  ss << "SerialIO{rx reads:" << n_reads << " bytes:" << n_bytes_read
+     << " latency avg:" << (n_reads > 0 ? rx_latency_us_sum / n_reads : 0)
+     << "us max:" << rx_latency_us_max << "us, tx writes:" << n_writes
+     << " bytes:" << n_bytes_written << " buffers:" << n_buffers_written
+     << " dropped:" << n_buffers_dropped << " latency avg:"
+     << (n_buffers_written > 0 ? tx_latency_us_sum / n_buffers_written : 0)
+     << "us max:" << tx_latency_us_max << "us queue:" << queue_size_bytes
+     << " max:" << queue_size_bytes_max << "}";
+  return ss.str();
 }
 
 void SerialEndpoint::start() {
@@ -342,7 +493,7 @@ void SerialEndpoint::start() {
   }
   _stop_requested = false;
   m_connect_receive_thread = std::make_unique<std::thread>(
-      &SerialEndpoint::connect_and_read_loop, this);
+      &SerialEndpoint::connect_and_io_loop, this);
   m_console->debug("start()-end");
 }
 
@@ -350,6 +501,7 @@ void SerialEndpoint::stop() {
   std::lock_guard<std::mutex> lock(m_connect_receive_thread_mutex);
   m_console->debug("stop()-begin");
   _stop_requested = true;
+  wakeup_io_thread();
   if (m_connect_receive_thread && m_connect_receive_thread->joinable()) {
     m_connect_receive_thread->join();
   }
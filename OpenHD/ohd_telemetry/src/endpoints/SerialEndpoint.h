@@ -26,11 +26,13 @@
 
 #include <atomic>
 #include <chrono>
+#include <deque>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <thread>
 #include <utility>
+#include <vector>
 
 #include "MEndpoint.h"
 #include "openhd_spdlog.h"
@@ -42,6 +44,11 @@
  * mistakes like a wrong serial fd - In this case, this will constantly log some
  * "warning messages" until the issue is fixed (for example by the user
  * connecting the serial wires, or selecting another type of fd)
+ * All UART I/O happens on one thread - sendMessages() only enqueues (never
+ * blocks on a slow UART), the I/O thread coalesces queued messages into as few
+ * writes as possible and reads with minimal latency.
+ * 所有 UART I/O 都在一个线程上进行 - sendMessages() 只入队（不会因慢速 UART 阻塞），
+ * I/O 线程将排队的消息合并为尽可能少的写入，并以最小延迟读取。
  */
 class SerialEndpoint : public MEndpoint {
  public:
@@ -82,6 +89,28 @@ class SerialEndpoint : public MEndpoint {
   // given baud rate is actually supported by the HW, but checks if it is at
   // least a somewhat sane value
   static bool is_valid_linux_baudrate(int baudrate);
+  struct IOStats {
+    uint64_t n_reads = 0;
+    uint64_t n_bytes_read = 0;
+    // From poll() waking up until the parsed messages have been forwarded
+    uint64_t rx_latency_us_sum = 0;
+    uint64_t rx_latency_us_max = 0;
+    // write() calls, and the (aggregated) buffers they wrote
+    uint64_t n_writes = 0;
+    uint64_t n_bytes_written = 0;
+    uint64_t n_buffers_written = 0;
+    uint64_t n_buffers_dropped = 0;
+    // From sendMessages() until handed over to the driver
+    uint64_t tx_latency_us_sum = 0;
+    uint64_t tx_latency_us_max = 0;
+    std::size_t queue_size_bytes = 0;
+    std::size_t queue_size_bytes_max = 0;
+    [[nodiscard]] std::string to_string() const;
+  };
+  IOStats get_io_stats();
+  // Writes are coalesced up to this size - the transmit buffer of the linux
+  // serial core (UART_XMIT_SIZE), more doesn't fit into the driver anyways
+  static constexpr std::size_t MAX_COALESCED_WRITE_SIZE = 4096;
 
  private:
   bool uart_log_warning_once = false;
@@ -89,20 +118,40 @@ class SerialEndpoint : public MEndpoint {
   static int define_from_baudrate(int baudrate);
   static int setup_port(const HWOptions& options,
                         std::shared_ptr<spdlog::logger> m_console);
-  void connect_and_read_loop();
-  // Receive data until either an error occurs (in this case, the UART most
-  // likely disconnected) Or a stop was requested.
-  void receive_data_until_error();
-  // Write serial data, returns true on success, false otherwise.
-  [[nodiscard]] bool write_data_serial(const std::vector<uint8_t>& data);
+  void connect_and_io_loop();
+  // Receive and write data until either an error occurs (in this case, the
+  // UART most likely disconnected) Or a stop was requested.
+  void io_until_error();
+  // Enqueue serial data for the I/O thread, returns false if there is no UART.
+  [[nodiscard]] bool write_data_serial(
+      std::shared_ptr<std::vector<uint8_t>> data);
+  // Writes as much as possible without blocking, returns false on error
+  bool flush_write_queue();
+  void wakeup_io_thread();
 
  private:
   const HWOptions m_options;
-  int m_fd = -1;
+  std::atomic<int> m_fd = -1;
+  // Wakes up the I/O thread (data enqueued / stop)
+  int m_wakeup_fd = -1;
   std::mutex m_connect_receive_thread_mutex;
   std::unique_ptr<std::thread> m_connect_receive_thread = nullptr;
-  bool _stop_requested = false;
+  std::atomic<bool> _stop_requested = false;
   std::shared_ptr<spdlog::logger> m_console;
+  struct QueuedWrite {
+    std::shared_ptr<std::vector<uint8_t>> data;
+    std::chrono::steady_clock::time_point enqueue_time;
+  };
+  // Any thread enqueues, the I/O thread dequeues. Also guards m_io_stats.
+  std::mutex m_write_queue_mutex;
+  std::deque<QueuedWrite> m_write_queue;
+  // About 0.5 seconds of UART time, older messages are dropped
+  const std::size_t m_max_write_queue_size;
+  IOStats m_io_stats;
+  // Only used by the I/O thread - coalesced data currently being written
+  std::vector<uint8_t> m_write_buffer;
+  std::size_t m_write_buffer_offset = 0;
+  std::vector<std::chrono::steady_clock::time_point> m_write_buffer_enqueue_times;
   // Limit warning console logs to not spam the console
   static constexpr auto MIN_DELAY_BETWEEN_SERIAL_WRITE_FAILED_LOG_MESSAGES =
       std::chrono::seconds(3);
@@ -23,6 +23,7 @@
 
 #include "OHDMainComponent.h"
 
+#include <algorithm>
 #include <iostream>
 #include <openhd_global_constants.hpp>
 #include <utility>
@@ -52,9 +53,24 @@ OHDMainComponent::OHDMainComponent(uint8_t parent_sys_id, bool runsOnAir)
   if (!RUNS_ON_AIR && config.GEN_ENABLE_LAST_KNOWN_POSITION) {
     m_last_known_position = std::make_unique<LastKnowPosition>();
   }
+  // Forward warnings (STATUSTEXT) right away
+  openhd::log::MavlinkLogMessageBuffer::instance().set_enqueue_listener(
+      [this]() { request_generate(); });
 }
 
-OHDMainComponent::~OHDMainComponent() {}
+OHDMainComponent::~OHDMainComponent() {
+  openhd::log::MavlinkLogMessageBuffer::instance().set_enqueue_listener(
+      nullptr);
+}
+
+std::chrono::steady_clock::time_point
+OHDMainComponent::get_next_generate_deadline(
+    std::chrono::steady_clock::time_point last_generate) const {
+  return std::min({m_last_heartbeat + m_heartbeats_interval,
+                   m_last_onboard_computer + m_onboard_computer_status_interval,
+                   m_last_version_message_tp + m_version_message_interval,
+                   m_last_wb_stats + m_wb_stats_interval});
+}
 
 std::vector<MavlinkMessage> OHDMainComponent::generate_mavlink_messages() {
   // m_console->debug("InternalTelemetry::generate_mavlink_messages()");
@@ -75,6 +91,13 @@ std::vector<MavlinkMessage> OHDMainComponent::generate_mavlink_messages() {
   return ret;
 }
 
+std::vector<MavlinkSubscription> OHDMainComponent::get_subscriptions() const {
+  // Timesync requests are answered no matter who they target
+  return {{MAVLINK_MSG_ID_TIMESYNC, true},
+          {MAVLINK_MSG_ID_COMMAND_LONG},
+          {MAVLINK_MSG_ID_GLOBAL_POSITION_INT}};
+}
+
 std::vector<MavlinkMessage> OHDMainComponent::process_mavlink_messages(
     std::vector<MavlinkMessage> messages) {
   std::vector<MavlinkMessage> ret{};
@@ -324,7 +347,7 @@ OHDMainComponent::create_broadcast_stats_if_needed() {
   std::vector<MavlinkMessage> ret;
   const auto now = std::chrono::steady_clock::now();
   const auto elapsed_onboard_computer_status = now - m_last_onboard_computer;
-  if (elapsed_onboard_computer_status > m_onboard_computer_status_interval) {
+  if (elapsed_onboard_computer_status >= m_onboard_computer_status_interval) {
     m_last_onboard_computer = now;
     std::optional<OnboardComputerStatusProvider::ExtraUartInfo> opt_uart_info =
         std::nullopt;
@@ -341,13 +364,13 @@ OHDMainComponent::create_broadcast_stats_if_needed() {
   }
   {
     const auto elapsed_version = now - m_last_version_message_tp;
-    if (elapsed_version > m_version_message_interval) {
+    if (elapsed_version >= m_version_message_interval) {
       m_last_version_message_tp = now;
       ret.push_back(generate_ohd_version());
     }
   }
   const auto elapsed_wb = now - m_last_wb_stats;
-  if (elapsed_wb > m_wb_stats_interval) {
+  if (elapsed_wb >= m_wb_stats_interval) {
     m_last_wb_stats = now;
     OHDUtil::vec_append(ret, generate_mav_wb_stats());
     if (RUNS_ON_AIR) {
@@ -471,10 +494,13 @@ std::vector<MavlinkMessage> OHDMainComponent::perform_time_synchronisation() {
     // We only ever ask the air for a timesync
     return {};
   }
-  if (m_has_synced_time) return {};
+  // Once synced, we re-sync in a lower interval to follow the clock drift
+  // (needed for the video latency measurement)
+  const auto interval = m_has_synced_time ? std::chrono::milliseconds(10000)
+                                          : std::chrono::milliseconds(1000);
   const auto elapsed =
       std::chrono::steady_clock::now() - m_last_timesync_request;
-  if (elapsed > std::chrono::milliseconds(1000)) {
+  if (elapsed > interval) {
     mavlink_timesync_t timesync{};
     timesync.target_system = OHD_SYS_ID_AIR;
     timesync.target_component = MAV_COMP_ID_ONBOARD_COMPUTER;
@@ -485,7 +511,7 @@ std::vector<MavlinkMessage> OHDMainComponent::perform_time_synchronisation() {
     MavlinkMessage msg;
     mavlink_msg_timesync_encode(m_sys_id, m_comp_id, &msg.m, &timesync);
     m_last_timesync_request = std::chrono::steady_clock::now();
-    m_console->debug("Sending timesync");
+    if (!m_has_synced_time) m_console->debug("Sending timesync");
     return {msg};
   }
   return {};
@@ -495,22 +521,35 @@ void OHDMainComponent::handle_timesync_response_self(
     const mavlink_timesync_t& tsync) {
   const auto now_us = get_time_microseconds();
   const auto round_trip_time_us = now_us - tsync.ts1;
-  const auto local_time_offset = now_us + tsync.tc1;
-  m_console->debug(
-      "handle_timesync_response_self, round trip:{}, local_time_offset:{}us",
-      openhd::util::time_readable_ns(round_trip_time_us * 1000),
-      local_time_offset);
-  if (round_trip_time_us >= 0 && round_trip_time_us < 5 * 1000) {
-    const auto local_time_offset_adjusted =
-        now_us - round_trip_time_us / 2 - tsync.tc1;
-    m_good_timesync_offset_count++;
-    m_good_timesync_offset_total += local_time_offset_adjusted;
-    if (m_good_timesync_offset_count > 10) {
-      int64_t average_offset =
-          m_good_timesync_offset_total / m_good_timesync_offset_count;
-      openhd::util::store_air_unit_time_offset_us(average_offset);
-      m_console->debug("Synced time, offset {}", average_offset);
-      m_has_synced_time = true;
-    }
+  // The air responds with its time in ns
+  const auto remote_time_us = tsync.tc1 / 1000;
+  // Offset such that ground time = air time + offset, assuming a symmetric link
+  const auto local_time_offset_us =
+      now_us - round_trip_time_us / 2 - remote_time_us;
+  if (!m_has_synced_time) {
+    m_console->debug(
+        "handle_timesync_response_self, round trip:{}, local_time_offset:{}us",
+        openhd::util::time_readable_ns(round_trip_time_us * 1000),
+        local_time_offset_us);
+  }
+  if (round_trip_time_us < 0 || round_trip_time_us > 100 * 1000) {
+    return;
+  }
+  // The error of the offset is at most half the round trip time - use the
+  // sample with the lowest round trip time out of each group
+  m_good_timesync_offset_count++;
+  if (round_trip_time_us < m_best_timesync_round_trip_us) {
+    m_best_timesync_round_trip_us = round_trip_time_us;
+    m_best_timesync_offset_us = local_time_offset_us;
+  }
+  if (m_good_timesync_offset_count >= 10) {
+    openhd::util::store_air_unit_time_offset_us(m_best_timesync_offset_us);
+    m_console->debug("Synced time, offset {}us, accuracy +-{}",
+                     m_best_timesync_offset_us,
+                     openhd::util::time_readable_ns(
+                         m_best_timesync_round_trip_us / 2 * 1000));
+    m_has_synced_time = true;
+    m_good_timesync_offset_count = 0;
+    m_best_timesync_round_trip_us = INT64_MAX;
   }
 }
@@ -63,6 +63,12 @@ class OHDMainComponent : public MavlinkComponent {
   // override from component
   std::vector<MavlinkMessage> process_mavlink_messages(
       std::vector<MavlinkMessage> messages) override;
+  // override from component
+  std::vector<MavlinkSubscription> get_subscriptions() const override;
+  // override from component - earliest of heartbeat, stats, version interval.
+  // Log messages are forwarded as soon as they are enqueued.
+  std::chrono::steady_clock::time_point get_next_generate_deadline(
+      std::chrono::steady_clock::time_point last_generate) const override;
   void process_command_self(const mavlink_command_long_t& command,
                             int source_sys_id, int source_comp_id,
                             std::vector<MavlinkMessage>& message_buffer);
@@ -115,7 +121,8 @@ class OHDMainComponent : public MavlinkComponent {
   int64_t m_last_timesync_out_us = 0;
   void handle_timesync_response_self(const mavlink_timesync_t& tsync);
   int m_good_timesync_offset_count = 0;
-  int64_t m_good_timesync_offset_total = 0;
+  int64_t m_best_timesync_round_trip_us = INT64_MAX;
+  int64_t m_best_timesync_offset_us = 0;
   std::atomic_bool m_has_synced_time = false;
 };
 
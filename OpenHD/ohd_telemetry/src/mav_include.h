@@ -30,11 +30,15 @@ extern "C" {
 #include <openhd/mavlink.h>
 }
 
+#include <array>
 #include <chrono>
+#include <cstring>
 #include <functional>
 #include <memory>
 #include <vector>
 
+#include "openhd_buffer_pool.h"
+
 // OpenHD mavlink sys IDs
 // Any mavlink message generated by openhd on the ground unit uses this sys id
 // OpenHD 的 MAVLink 系统 ID
@@ -60,19 +64,67 @@ static constexpr auto OHD_SYS_ID_FC_BETAFLIGHT = 0;
 static constexpr auto OHD_GROUND_CLIENT_UDP_PORT_OUT = 14550;
 static constexpr auto OHD_GROUND_CLIENT_UDP_PORT_IN = 14551;
 
+/**
+ * A mavlink message is serialized (packed) lazily, the first time its wire
+ * bytes are needed, into inline storage (no allocation). All endpoints it is
+ * routed to (and the tx statistics) reuse these bytes. Copies only copy the
+ * used part of the storage.
+ * NOTE: m must not be modified once the wire bytes have been used, and the
+ * first serialization must not happen concurrently from multiple threads
+ * (messages are routed by one thread at a time).
+ * MAVLink 消息在第一次需要其线上字节时才进行（一次性）序列化，存放在内联存储中（无内存分配）。
+ * 消息被路由到的所有端点（以及发送统计）都复用这些字节。
+ */
 struct MavlinkMessage {
     // mavlink_message_t，这是 MAVLink 协议中使用的基础消息结构
     mavlink_message_t m{};
     // how often this packet should be injected (increase reliability)
     // 此数据包应被注入的频率（用于提高可靠性）。
     int recommended_n_injections = 1;
+
+    MavlinkMessage() = default;
+    MavlinkMessage(const mavlink_message_t& msg) : m(msg) {}
+    MavlinkMessage(const MavlinkMessage& other) { *this = other; }
+    MavlinkMessage& operator=(const MavlinkMessage& other) {
+        if (this == &other) return *this;
+        m = other.m;
+        recommended_n_injections = other.recommended_n_injections;
+        m_wire_size = other.m_wire_size;
+        std::memcpy(m_wire.data(), other.m_wire.data(), m_wire_size);
+        return *this;
+    }
+    // Serialized message, packed on first use
+    // 序列化后的消息，首次使用时打包。
+    [[nodiscard]] const uint8_t* wire_data() const {
+        pack_once();
+        return m_wire.data();
+    }
+    [[nodiscard]] uint16_t wire_size() const {
+        pack_once();
+        return m_wire_size;
+    }
+    // For received messages - the frame as it came in is the serialized message,
+    // no need to pack it again when it is forwarded.
+    // 对于接收到的消息 - 收到的帧就是序列化后的消息，转发时无需再次打包。
+    void set_wire(const uint8_t* data, uint16_t size) {
+        std::memcpy(m_wire.data(), data, size);
+        m_wire_size = size;
+    }
+    // Allocates - prefer wire_data() / wire_size()
     [[nodiscard]] std::vector<uint8_t> pack() const {
-        std::vector<uint8_t> buf(MAVLINK_MAX_PACKET_LEN);
-        // 使用 mavlink_msg_to_send_buffer 函数将 m 对象（即 MAVLink 消息）序列化为一个字节数组。
-        auto size = mavlink_msg_to_send_buffer(buf.data(), &m);
-        buf.resize(size);
-        return buf;
+        const uint8_t* data = wire_data();
+        return {data, data + m_wire_size};
+    }
+
+   private:
+    void pack_once() const {
+        if (m_wire_size == 0) {
+            m_wire_size = mavlink_msg_to_send_buffer(m_wire.data(), &m);
+        }
     }
+    // 0 - not packed yet
+    mutable uint16_t m_wire_size = 0;
+    mutable std::array<uint8_t, MAVLINK_MAX_PACKET_LEN> m_wire;
 };
 
 struct AggregatedMavlinkPacket {
@@ -96,16 +148,21 @@ struct AggregatedMavlinkPacket {
  */
 static std::vector<AggregatedMavlinkPacket> aggregate_pack_messages(const std::vector<MavlinkMessage>& messages, uint32_t max_mtu = 1024) {
     std::vector<AggregatedMavlinkPacket> ret;
-    auto buff = std::make_shared<std::vector<uint8_t>>();
+    // Buffers (and their shared_ptr control blocks) are recycled via the
+    // telemetry pool (already sized for max_mtu)
+    auto& pool = openhd::BufferPool::telemetry();
+    auto buff = pool->get_buffer();
     buff->reserve(max_mtu);
     int recommended_n_retransmissions = 1;  // 用于跟踪所有聚合的消息中需要重传的最大次数。初始值为 1。
     int n_aggregated_mavlink_packets = 0;   // 用于计数当前聚合的数据包中有多少个 MAVLink 消息。
     for (const auto& msg : messages) {
-        auto data = msg.pack();
+        // Packed once, shared by all endpoints
+        const uint8_t* data = msg.wire_data();
+        const uint16_t data_size = msg.wire_size();
         // 检查当前 buff 的大小加上 data 的大小是否超出最大传输单元（max_mtu）。
-        if (buff->size() + data.size() <= max_mtu) {
+        if (buff->size() + data_size <= max_mtu) {
             // we haven't reached MTU yet
-            buff->insert(buff->end(), data.begin(), data.end());  // 将 data 数据加入到 buff 中
+            buff->insert(buff->end(), data, data + data_size);  // 将 data 数据加入到 buff 中
             n_aggregated_mavlink_packets++;                       // 增加聚合的数据包计数
             // 更新 recommended_n_retransmissions，以确保最大重传次数是合适的。
             if (msg.recommended_n_injections > recommended_n_retransmissions) {
@@ -117,12 +174,12 @@ static std::vector<AggregatedMavlinkPacket> aggregate_pack_messages(const std::v
             if (!buff->empty()) {
                 ret.push_back({buff, recommended_n_retransmissions});
                 // 重新分配一个新的 buff，并为它预留空间，再将当前消息的 data 插入到新 buff 中。
-                buff = std::make_shared<std::vector<uint8_t>>();
+                buff = pool->get_buffer();
                 buff->reserve(max_mtu);
                 recommended_n_retransmissions = 1;
                 n_aggregated_mavlink_packets = 0;
             }
-            buff->insert(buff->end(), data.begin(), data.end());
+            buff->insert(buff->end(), data, data + data_size);
             n_aggregated_mavlink_packets++;
             if (msg.recommended_n_injections > recommended_n_retransmissions) {
                 recommended_n_retransmissions = msg.recommended_n_injections;
@@ -136,10 +193,11 @@ static std::vector<AggregatedMavlinkPacket> aggregate_pack_messages(const std::v
 }
 
 // 计算一个 std::vector<MavlinkMessage> 类型的消息列表总共占用的字节数（即消息的总大小）
+// (packs each message once, the bytes are reused when the messages are sent)
 static int get_size(const std::vector<MavlinkMessage>& messages) {
     int ret = 0;
     for (const auto& message : messages) {
-        ret += message.pack().size();
+        ret += message.wire_size();
     }
     return ret;
 }
@@ -147,7 +205,7 @@ static int get_size(const std::vector<MavlinkMessage>& messages) {
 // For registering a callback that is called every time component X receives one
 // or more mavlink messages
 // 用于注册一个回调函数，该回调函数在组件 X 每次接收到一条或多条 MAVLink 消息时被调用。
-typedef std::function<void(const std::vector<MavlinkMessage> messages)> MAV_MSG_CALLBACK;
+typedef std::function<void(const std::vector<MavlinkMessage>& messages)> MAV_MSG_CALLBACK;
 
 static int64_t get_time_microseconds() {
     const auto time = std::chrono::steady_clock::now().time_since_epoch();
@@ -24,6 +24,7 @@
 #include "XMavlinkParamProvider.h"
 
 #include <openhd_spdlog.h>
+#include <algorithm>
 
 XMavlinkParamProvider::XMavlinkParamProvider(
     uint8_t sys_id, uint8_t comp_id,
@@ -38,6 +39,11 @@ XMavlinkParamProvider::XMavlinkParamProvider(
 }
 
 void XMavlinkParamProvider::add_param(const openhd::Setting& setting) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  add_param_locked(setting);
+}
+
+void XMavlinkParamProvider::add_param_locked(const openhd::Setting& setting) {
   if (std::holds_alternative<openhd::IntSetting>(setting.setting)) {
     const auto intSetting = std::get<openhd::IntSetting>(setting.setting);
     const auto result = _mavlink_parameter_receiver->provide_server_param<int>(
@@ -59,8 +65,9 @@ void XMavlinkParamProvider::add_param(const openhd::Setting& setting) {
 
 void XMavlinkParamProvider::add_params(
     const std::vector<openhd::Setting>& settings) {
+  std::lock_guard<std::mutex> lock(_mutex);
   for (const auto& setting : settings) {
-    add_param(setting);
+    add_param_locked(setting);
   }
 }
 
@@ -68,9 +75,27 @@ void XMavlinkParamProvider::set_ready() {
   _mavlink_parameter_receiver->ready_for_communication();
 }
 
+std::vector<MavlinkSubscription> XMavlinkParamProvider::get_subscriptions()
+    const {
+  // What mavsdk::MavlinkParameterReceiver registers for
+  return {{MAVLINK_MSG_ID_PARAM_SET},
+          {MAVLINK_MSG_ID_PARAM_EXT_SET},
+          {MAVLINK_MSG_ID_PARAM_REQUEST_READ},
+          {MAVLINK_MSG_ID_PARAM_REQUEST_LIST},
+          {MAVLINK_MSG_ID_PARAM_EXT_REQUEST_READ},
+          {MAVLINK_MSG_ID_PARAM_EXT_REQUEST_LIST}};
+}
+
 std::vector<MavlinkMessage> XMavlinkParamProvider::process_mavlink_messages(
     std::vector<MavlinkMessage> messages) {
   std::lock_guard<std::mutex> lock(_mutex);
+  for (const auto& msg : messages) {
+    _mavlink_message_handler->process_message(msg.m);
+  }
+  return do_work_locked();
+}
+
+std::vector<MavlinkMessage> XMavlinkParamProvider::do_work_locked() {
   for (const auto& setting : m_int_settings_with_update_functionality) {
     const auto intSetting = std::get<openhd::IntSetting>(setting.setting);
     const auto currValue =
@@ -87,9 +112,6 @@ std::vector<MavlinkMessage> XMavlinkParamProvider::process_mavlink_messages(
       }
     }
   }
-  for (const auto& msg : messages) {
-    _mavlink_message_handler->process_message(msg.m);
-  }
   for (int i = 0; i < 100; i++) {
     _mavlink_parameter_receiver->do_work();
   }
@@ -99,12 +121,23 @@ std::vector<MavlinkMessage> XMavlinkParamProvider::process_mavlink_messages(
   return msges;
 }
 
+std::chrono::steady_clock::time_point
+XMavlinkParamProvider::get_next_generate_deadline(
+    std::chrono::steady_clock::time_point last_generate) const {
+  const auto ret = last_generate + DEFAULT_GENERATE_INTERVAL;
+  if (m_opt_heartbeat_interval.has_value()) {
+    return std::min(ret, m_last_heartbeat + m_opt_heartbeat_interval.value());
+  }
+  return ret;
+}
+
 std::vector<MavlinkMessage> XMavlinkParamProvider::generate_mavlink_messages() {
-  std::vector<MavlinkMessage> ret;
+  std::lock_guard<std::mutex> lock(_mutex);
+  std::vector<MavlinkMessage> ret = do_work_locked();
   if (m_opt_heartbeat_interval.has_value()) {
     const auto now = std::chrono::steady_clock::now();
     const auto elapsed = now - m_last_heartbeat;
-    if (elapsed > m_opt_heartbeat_interval.value()) {
+    if (elapsed >= m_opt_heartbeat_interval.value()) {
       m_last_heartbeat = now;
       ret.push_back(MavlinkComponent::create_heartbeat());
     }
@@ -53,6 +53,19 @@ class XMavlinkParamProvider : public MavlinkComponent {
       std::vector<MavlinkMessage> messages) override;
   // override from component
   std::vector<MavlinkMessage> generate_mavlink_messages() override;
+  // override from component - the parameter protocol messages
+  std::vector<MavlinkSubscription> get_subscriptions() const override;
+  // override from component - the queued parameter work runs at the default
+  // interval, the heartbeat (if enabled) at its own
+  std::chrono::steady_clock::time_point get_next_generate_deadline(
+      std::chrono::steady_clock::time_point last_generate) const override;
+
+ private:
+  void add_param_locked(const openhd::Setting& setting);
+  // Updates changed int params, runs the (queued) parameter protocol work and
+  // returns the created messages. Called on incoming messages and
+  // periodically (e.g. a long param list goes out even if the gcs is quiet).
+  std::vector<MavlinkMessage> do_work_locked();
 
  private:
   // mavsdk
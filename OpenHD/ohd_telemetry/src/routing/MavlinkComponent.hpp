@@ -24,13 +24,49 @@
 #ifndef OPENHD_OPENHD_OHD_TELEMETRY_SRC_ROUTING_MAVLINKCOMPONENT_H_
 #define OPENHD_OPENHD_OHD_TELEMETRY_SRC_ROUTING_MAVLINKCOMPONENT_H_
 
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <optional>
 #include <utility>
+#include <vector>
 
-#include "MavlinkSystem.hpp"
 #include "mav_include.h"
 
+// Message(s) a component wants to have delivered in process_mavlink_messages
+struct MavlinkSubscription {
+  uint32_t msg_id;
+  // By default, a message with a target sys / comp id (e.g. COMMAND_LONG) is
+  // only delivered if it targets this component (or is a broadcast)
+  bool any_target = false;
+};
+
+// Wakes up the thread that calls generate_mavlink_messages (see
+// MavlinkSystem), e.g. when a component has something to send right away.
+class MavlinkGenerateWaker {
+ public:
+  void wake() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_woken = true;
+    }
+    m_cv.notify_one();
+  }
+  // Returns at the deadline or (earlier) when woken
+  void wait_until(std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait_until(lock, deadline, [this] { return m_woken; });
+    m_woken = false;
+  }
+
+ private:
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  bool m_woken = false;
+};
+
 // A component has a (parent) sys id and its own component id (unique per
 // system). It processes and/or creates mavlink messages.
 class MavlinkComponent {
@@ -52,12 +88,43 @@ class MavlinkComponent {
    */
   virtual std::vector<MavlinkMessage> process_mavlink_messages(
       std::vector<MavlinkMessage> messages) = 0;
+  /**
+   * The message(s) this component handles in process_mavlink_messages, used
+   * by the parent system to only hand over messages the component is
+   * interested in. Empty (default) means all messages.
+   */
+  virtual std::vector<MavlinkSubscription> get_subscriptions() const {
+    return {};
+  }
   /**
    * The parent should call this method in regular intervals and send out the
    * generated mavlink messages. This is for fire and forget messages. For
    * example, a component might return the heartbeat(s) here.
    */
   virtual std::vector<MavlinkMessage> generate_mavlink_messages() = 0;
+  /**
+   * When generate_mavlink_messages() should be called next, a component with
+   * several rates (heartbeat, stats, ...) returns the earliest one.
+   * @param last_generate when generate_mavlink_messages() was called last
+   */
+  virtual std::chrono::steady_clock::time_point get_next_generate_deadline(
+      std::chrono::steady_clock::time_point last_generate) const {
+    return last_generate + DEFAULT_GENERATE_INTERVAL;
+  }
+  static constexpr auto DEFAULT_GENERATE_INTERVAL = std::chrono::milliseconds(100);
+  /**
+   * Thread-safe. Event based - makes the parent call
+   * generate_mavlink_messages() as soon as possible, not only at the next
+   * deadline (e.g. when a log message has been enqueued).
+   */
+  void request_generate() {
+    m_generate_requested.store(true);
+    auto waker = m_generate_waker.load();
+    if (waker) waker->wake();
+  }
+  // Set / used by the parent
+  std::atomic<bool> m_generate_requested{false};
+  std::atomic<MavlinkGenerateWaker*> m_generate_waker{nullptr};
 
  protected:
   // These are protected, and MUST be called in the implementation(s) process
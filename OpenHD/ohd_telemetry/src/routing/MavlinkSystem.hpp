@@ -24,14 +24,38 @@
 #ifndef OPENHD_OPENHD_OHD_TELEMETRY_SRC_ROUTING_MAVLINKSYSTEM_H_
 #define OPENHD_OPENHD_OHD_TELEMETRY_SRC_ROUTING_MAVLINKSYSTEM_H_
 
-#include <map>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "MavlinkComponent.hpp"
+#include "mav_helper.h"
+#include "mav_include.h"
+#include "openhd_util.h"
+
 /**
  * A system has a sys id and allows adding components.
+ * Incoming messages are dispatched via an index (msg id -> subscribed
+ * components, each with its sys / comp id) - a component only gets the
+ * messages it subscribed to (see MavlinkComponent::get_subscriptions), and
+ * messages with a target sys / comp id only if they target the component.
+ * No global lock is held while components run - the index is an immutable
+ * snapshot (replaced when a component is added), each component has its own
+ * lock (process / generate of one component never run concurrently).
+ * generate_mavlink_messages is scheduled per component - at the deadline
+ * the component declares (get_next_generate_deadline), or right away when
+ * the component requests it (request_generate).
  */
 // 这段代码定义了一个名为 MavlinkSystem 的类，用于表示一个 MAVLink 系统。
+// 收到的消息通过索引（消息 ID -> 订阅的组件）分发，组件只会收到其订阅的消息；
+// 带有目标系统/组件 ID 的消息只会发给目标组件。组件运行时不持有全局锁。
 class MavlinkSystem {
    public:
     // 这是一个显式构造函数，用于初始化 MavlinkSystem 对象。explicit 关键字:防止隐式类型转换，确保只能显式调用构造函数
@@ -40,14 +64,173 @@ class MavlinkSystem {
     // 这是一个常量成员变量，表示 MAVLink 系统的 ID,取值范围为 0 到 255。
     // 系统 ID 是 MAVLink 协议中用于唯一标识一个系统的值。
     const uint8_t _sys_id;
-    /*void add_component(std::shared_ptr<MavlinkComponent> component){
-      if(components.find(component->_comp_id)!=components.end()){
-        std::cerr<<"Error Component already exists";
-        return;
-      }
-      components.insert_or_assign(component->_comp_id,component);
+
+    // Thread-safe, can be called at any time (e.g. camera components are added
+    // later)
+    void add_component(std::shared_ptr<MavlinkComponent> component) {
+        std::lock_guard<std::mutex> guard(m_index_write_mutex);
+        auto current = std::atomic_load(&m_index);
+        auto index = std::make_shared<Index>();
+        if (current) index->entries = current->entries;
+        auto entry = std::make_shared<Entry>();
+        entry->component = std::move(component);
+        entry->component->m_generate_waker.store(&m_generate_waker);
+        index->entries.push_back(entry);
+        for (std::size_t i = 0; i < index->entries.size(); i++) {
+            const auto& subscriptions = index->entries[i]->component->get_subscriptions();
+            if (subscriptions.empty()) {
+                index->all_messages.push_back(i);
+            }
+            for (const auto& subscription : subscriptions) {
+                index->by_msg_id[subscription.msg_id].push_back({i, subscription.any_target});
+            }
+        }
+        std::atomic_store(&m_index, std::shared_ptr<const Index>(std::move(index)));
+        // generate for the new component right away
+        m_generate_waker.wake();
+    }
+
+    /**
+     * Hands the given messages to all components that are interested in them.
+     * @return all messages the components created as a response
+     * 将给定的消息交给所有感兴趣的组件，返回组件生成的所有响应消息。
+     */
+    std::vector<MavlinkMessage> dispatch_mavlink_messages(const std::vector<MavlinkMessage>& messages) {
+        std::vector<MavlinkMessage> ret;
+        const auto index = std::atomic_load(&m_index);
+        if (!index || messages.empty()) return ret;
+        std::vector<std::vector<MavlinkMessage>> batches(index->entries.size());
+        for (const auto& msg : messages) {
+            const auto it = index->by_msg_id.find(msg.m.msgid);
+            if (it == index->by_msg_id.end()) continue;
+            const MTarget target = get_target(msg.m);
+            for (const auto& subscriber : it->second) {
+                const auto& component = *index->entries[subscriber.entry_idx]->component;
+                if (subscriber.any_target || targets(target, component)) {
+                    batches[subscriber.entry_idx].push_back(msg);
+                }
+            }
+        }
+        for (const auto entry_idx : index->all_messages) {
+            batches[entry_idx] = messages;
+        }
+        for (std::size_t i = 0; i < batches.size(); i++) {
+            if (batches[i].empty()) continue;
+            auto& entry = *index->entries[i];
+            std::lock_guard<std::mutex> guard(entry.mutex);
+            OHDUtil::vec_append(ret, entry.component->process_mavlink_messages(std::move(batches[i])));
+        }
+        return ret;
+    }
+
+    /**
+     * Sleeps until the earliest generate deadline of all components (or until
+     * a component requests to generate, but at most max_wait), then returns
+     * the messages of all components that are due. Call in a loop from one
+     * (telemetry) thread.
+     * 休眠直到所有组件中最早的生成截止时间（或组件请求生成，最长 max_wait），
+     * 然后返回所有到期组件生成的消息。
+     */
+    std::vector<MavlinkMessage> wait_and_generate_mavlink_messages(std::chrono::milliseconds max_wait) {
+        std::vector<MavlinkMessage> ret;
+        const auto index = std::atomic_load(&m_index);
+        auto now = std::chrono::steady_clock::now();
+        auto wake_up = now + max_wait;
+        if (index) {
+            for (const auto& entry : index->entries) {
+                wake_up = std::min(wake_up, entry->next_deadline);
+            }
+        }
+        m_generate_waker.wait_until(wake_up);
+        if (!index) return ret;
+        now = std::chrono::steady_clock::now();
+        for (const auto& entry : index->entries) {
+            auto& component = *entry->component;
+            const bool requested = component.m_generate_requested.exchange(false);
+            if (!requested && now < entry->next_deadline) continue;
+            std::lock_guard<std::mutex> guard(entry->mutex);
+            auto& stats = entry->stats;
+            stats.n_runs++;
+            if (now < entry->next_deadline) {
+                stats.n_runs_requested++;
+            } else if (entry->next_deadline != std::chrono::steady_clock::time_point{}) {
+                const auto late_us = std::chrono::duration_cast<std::chrono::microseconds>(now - entry->next_deadline).count();
+                stats.late_us_sum += late_us;
+                stats.late_us_max = std::max<int64_t>(stats.late_us_max, late_us);
+                stats.n_runs_deadline++;
+            }
+            OHDUtil::vec_append(ret, component.generate_mavlink_messages());
+            entry->next_deadline = component.get_next_generate_deadline(now);
+        }
+        return ret;
+    }
+
+    // Scheduling jitter (how late generate ran after its deadline) and runs per
+    // component, for debugging. Resets the stats.
+    std::string get_generate_stats_and_reset() {
+        std::stringstream ss;
+        const auto index = std::atomic_load(&m_index);
+        if (!index) return ss.str();
+        ss << "GenerateScheduler{";
+        for (const auto& entry : index->entries) {
+            std::lock_guard<std::mutex> guard(entry->mutex);
+            auto& stats = entry->stats;
+            ss << "comp:" << static_cast<int>(entry->component->m_comp_id) << " runs:" << stats.n_runs << " requested:" << stats.n_runs_requested
+               << " late avg:" << (stats.n_runs_deadline > 0 ? stats.late_us_sum / stats.n_runs_deadline : 0) << "us max:" << stats.late_us_max << "us,";
+            stats = {};
+        }
+        ss << "}";
+        return ss.str();
+    }
+
+   private:
+    struct GenerateStats {
+        int n_runs = 0;
+        // Woken up via request_generate before the deadline
+        int n_runs_requested = 0;
+        int n_runs_deadline = 0;
+        int64_t late_us_sum = 0;
+        int64_t late_us_max = 0;
+    };
+    struct Entry {
+        std::shared_ptr<MavlinkComponent> component;
+        std::mutex mutex;
+        // Only used by the generate thread, the epoch means due right away
+        std::chrono::steady_clock::time_point next_deadline{};
+        GenerateStats stats;
+    };
+    struct Subscriber {
+        std::size_t entry_idx;
+        bool any_target;
+    };
+    struct Index {
+        std::vector<std::shared_ptr<Entry>> entries;
+        std::unordered_map<uint32_t, std::vector<Subscriber>> by_msg_id;
+        // Components without subscriptions get everything
+        std::vector<std::size_t> all_messages;
+    };
+    // Target sys / comp id from the payload (0 - broadcast / no target)
+    static MTarget get_target(const mavlink_message_t& msg) {
+        MTarget ret{0, 0};
+        const mavlink_msg_entry_t* info = mavlink_get_msg_entry(msg.msgid);
+        if (info == nullptr) return ret;
+        const auto payload = reinterpret_cast<const uint8_t*>(_MAV_PAYLOAD(&msg));
+        if (info->flags & MAV_MSG_ENTRY_FLAG_HAVE_TARGET_SYSTEM) {
+            ret.sys_id = payload[info->target_system_ofs];
+        }
+        if (info->flags & MAV_MSG_ENTRY_FLAG_HAVE_TARGET_COMPONENT) {
+            ret.comp_id = payload[info->target_component_ofs];
+        }
+        return ret;
+    }
+    static bool targets(const MTarget& target, const MavlinkComponent& component) {
+        return (target.sys_id == 0 || target.sys_id == component.m_sys_id) &&
+               (target.comp_id == 0 || target.comp_id == component.m_comp_id);
     }
-    std::map<uint8_t,std::shared_ptr<MavlinkComponent>> components;*/
+    // Declared first - components keep a pointer to it until the index is gone
+    MavlinkGenerateWaker m_generate_waker;
+    std::mutex m_index_write_mutex;
+    std::shared_ptr<const Index> m_index;
 };
 
 #endif  // OPENHD_OPENHD_OHD_TELEMETRY_SRC_ROUTING_MAVLINKSYSTEM_H_
@@ -0,0 +1,340 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "TLogRecorder.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+
+#include "openhd_spdlog.h"
+#include "openhd_spdlog_include.h"
+#include "openhd_util_filesystem.h"
+
+static constexpr auto TLOG_SUFFIX = ".tlog";
+static constexpr int TIMESTAMP_SIZE = 8;
+
+// Size of the mavlink frame at p, 0 if there is no (complete) frame
+static std::size_t get_frame_size(const uint8_t* p, std::size_t available) {
+  if (available < 3) return 0;
+  std::size_t size = 0;
+  if (p[0] == MAVLINK_STX) {
+    size = MAVLINK_NUM_HEADER_BYTES + p[1] + MAVLINK_NUM_CHECKSUM_BYTES +
+           ((p[2] & MAVLINK_IFLAG_SIGNED) ? MAVLINK_SIGNATURE_BLOCK_LEN : 0);
+  } else if (p[0] == MAVLINK_STX_MAVLINK1) {
+    size = 6 + p[1] + MAVLINK_NUM_CHECKSUM_BYTES;
+  }
+  return size <= available ? size : 0;
+}
+
+static bool is_tlog_of(const std::string& filename, const std::string& prefix) {
+  const std::string suffix = TLOG_SUFFIX;
+  return filename.rfind(prefix, 0) == 0 && filename.size() > suffix.size() &&
+         filename.compare(filename.size() - suffix.size(), suffix.size(),
+                          suffix) == 0;
+}
+
+static std::string create_filename(const TLogRecorder::Options& options,
+                                   int index) {
+  auto t = std::time(nullptr);
+  auto tm = *std::localtime(&t);
+  std::stringstream ss;
+  ss << options.directory << options.prefix << "_"
+     << std::put_time(&tm, "%Y-%m-%d_%H-%M-%S") << "_" << std::setw(3)
+     << std::setfill('0') << index << TLOG_SUFFIX;
+  return ss.str();
+}
+
+TLogRecorder::TLogRecorder(Options options)
+    : m_options(std::move(options)),
+      m_buffer(BUFFER_SIZE),
+      m_write_buffer(BUFFER_SIZE) {
+  openhd::log::get_default()->debug("Recording tlog to [{}]",
+                                    m_options.directory);
+  m_write_thread =
+      std::make_unique<std::thread>([this]() { this->write_loop(); });
+}
+
+TLogRecorder::~TLogRecorder() {
+  m_write_run = false;
+  m_buffer_cv.notify_one();
+  m_write_thread->join();
+  m_write_thread = nullptr;
+}
+
+void TLogRecorder::record(const std::vector<MavlinkMessage>& messages) {
+  if (messages.empty()) return;
+  const uint64_t now_us =
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count();
+  uint8_t timestamp[TIMESTAMP_SIZE];
+  for (int i = 0; i < TIMESTAMP_SIZE; i++) {
+    timestamp[i] = static_cast<uint8_t>(now_us >> (56 - 8 * i));
+  }
+  bool wake_up_writer;
+  {
+    std::lock_guard<std::mutex> guard(m_buffer_mutex);
+    for (const auto& msg : messages) {
+      // Already serialized by the endpoint(s) the message was received from /
+      // sent to
+      const auto size = msg.wire_size();
+      if (m_buffer_fill + TIMESTAMP_SIZE + size > m_buffer.size()) {
+        m_n_dropped++;
+        continue;
+      }
+      uint8_t* dst = m_buffer.data() + m_buffer_fill;
+      std::memcpy(dst, timestamp, TIMESTAMP_SIZE);
+      std::memcpy(dst + TIMESTAMP_SIZE, msg.wire_data(), size);
+      m_buffer_fill += TIMESTAMP_SIZE + size;
+      m_n_recorded++;
+    }
+    wake_up_writer = m_buffer_fill >= m_buffer.size() / 2;
+  }
+  if (wake_up_writer) m_buffer_cv.notify_one();
+}
+
+TLogRecorder::Stats TLogRecorder::get_stats() const {
+  Stats stats;
+  {
+    std::lock_guard<std::mutex> guard(m_buffer_mutex);
+    stats.n_recorded = m_n_recorded;
+    stats.n_dropped = m_n_dropped;
+  }
+  stats.n_bytes_written = m_n_bytes_written;
+  stats.n_files = m_n_files;
+  return stats;
+}
+
+std::string TLogRecorder::get_current_filename() const {
+  std::lock_guard<std::mutex> guard(m_filename_mutex);
+  return m_current_filename;
+}
+
+void TLogRecorder::write_loop() {
+  recover_and_remove_old_files();
+  m_last_sync = std::chrono::steady_clock::now();
+  while (true) {
+    std::size_t fill;
+    {
+      std::unique_lock<std::mutex> lock(m_buffer_mutex);
+      m_buffer_cv.wait_for(lock, WRITE_INTERVAL, [this]() {
+        return !m_write_run || m_buffer_fill >= m_buffer.size() / 2;
+      });
+      std::swap(m_buffer, m_write_buffer);
+      fill = m_buffer_fill;
+      m_buffer_fill = 0;
+    }
+    if (fill > 0) {
+      write_to_file(m_write_buffer.data(), fill);
+    }
+    if (std::chrono::steady_clock::now() - m_last_sync >= SYNC_INTERVAL) {
+      sync_file();
+    }
+    // Everything recorded until now has been written
+    if (!m_write_run) break;
+  }
+  close_file();
+}
+
+void TLogRecorder::write_to_file(const uint8_t* data, std::size_t size) {
+  std::size_t pos = 0;
+  while (pos < size) {
+    if (m_map == nullptr && !open_next_file()) {
+      // Nothing we can do (e.g. sd card full), try again with the next data
+      return;
+    }
+    const std::size_t available = m_options.max_file_size - m_file_offset;
+    std::size_t n = size - pos;
+    if (n > available) {
+      // Only whole records, the rest goes into the next file
+      n = 0;
+      while (true) {
+        const std::size_t frame_size =
+            get_frame_size(data + pos + n + TIMESTAMP_SIZE,
+                           size - pos - n - TIMESTAMP_SIZE);
+        if (frame_size == 0 || n + TIMESTAMP_SIZE + frame_size > available) {
+          break;
+        }
+        n += TIMESTAMP_SIZE + frame_size;
+      }
+      if (n == 0 && m_file_offset == 0) {
+        // Doesn't even fit into an empty file
+        return;
+      }
+    }
+    std::memcpy(m_map + m_file_offset, data + pos, n);
+    m_file_offset += n;
+    m_n_bytes_written += n;
+    pos += n;
+    if (pos < size) {
+      // Full - rotate
+      close_file();
+    }
+  }
+}
+
+bool TLogRecorder::open_next_file() {
+  const auto filename = create_filename(m_options, m_file_index++);
+  const int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+                      0644);
+  if (fd < 0) {
+    openhd::log::get_default()->warn("Cannot create tlog {}: {}", filename,
+                                     strerror(errno));
+    return false;
+  }
+  // Allocate the whole file up front - no metadata updates (file size) while
+  // recording, and the data we sync is always reachable after a power loss
+  const int res =
+      posix_fallocate(fd, 0, static_cast<off_t>(m_options.max_file_size));
+  void* map = MAP_FAILED;
+  if (res == 0) {
+    map = mmap(nullptr, m_options.max_file_size, PROT_READ | PROT_WRITE,
+               MAP_SHARED, fd, 0);
+  }
+  if (res != 0 || map == MAP_FAILED) {
+    openhd::log::get_default()->warn("Cannot allocate tlog {}: {}", filename,
+                                     strerror(res != 0 ? res : errno));
+    close(fd);
+    OHDFilesystemUtil::remove_if_existing(filename);
+    return false;
+  }
+  fsync(fd);
+  OHDFilesystemUtil::make_file_read_write_everyone(filename);
+  m_fd = fd;
+  m_map = static_cast<uint8_t*>(map);
+  m_file_offset = 0;
+  m_synced_offset = 0;
+  {
+    std::lock_guard<std::mutex> guard(m_filename_mutex);
+    m_current_filename = filename;
+  }
+  m_n_files++;
+  recover_and_remove_old_files();
+  return true;
+}
+
+void TLogRecorder::close_file() {
+  if (m_map == nullptr) return;
+  sync_file();
+  munmap(m_map, m_options.max_file_size);
+  m_map = nullptr;
+  // Cut off the preallocated, unused part
+  if (ftruncate(m_fd, static_cast<off_t>(m_file_offset)) != 0) {
+    openhd::log::get_default()->warn("Cannot truncate tlog: {}",
+                                     strerror(errno));
+  }
+  fsync(m_fd);
+  close(m_fd);
+  m_fd = -1;
+  if (m_file_offset == 0) {
+    OHDFilesystemUtil::remove_if_existing(get_current_filename());
+  }
+}
+
+void TLogRecorder::sync_file() {
+  m_last_sync = std::chrono::steady_clock::now();
+  if (m_map == nullptr || m_file_offset == m_synced_offset) return;
+  static const std::size_t page_size = sysconf(_SC_PAGESIZE);
+  const std::size_t begin = m_synced_offset / page_size * page_size;
+  // Blocks only this thread
+  msync(m_map + begin, m_file_offset - begin, MS_SYNC);
+  m_synced_offset = m_file_offset;
+}
+
+void TLogRecorder::recover_and_remove_old_files() {
+  OHDFilesystemUtil::create_directories(m_options.directory);
+  struct TLogFile {
+    std::string path;
+    time_t mtime;
+  };
+  std::vector<TLogFile> files;
+  for (const auto& filename :
+       OHDFilesystemUtil::getAllEntriesFilenameOnlyInDirectory(
+           m_options.directory)) {
+    if (!is_tlog_of(filename, m_options.prefix)) continue;
+    const std::string path = m_options.directory + filename;
+    if (path == get_current_filename()) continue;
+    // Only a file from a previous run can have a zero tail
+    if (m_n_files == 0) recover_file(path);
+    struct stat st {};
+    if (stat(path.c_str(), &st) != 0) continue;
+    files.push_back({path, st.st_mtime});
+  }
+  // the current file counts, too
+  const int n_files_max = m_options.max_n_files - (m_map != nullptr ? 1 : 0);
+  if (static_cast<int>(files.size()) <= n_files_max) return;
+  std::sort(files.begin(), files.end(),
+            [](const TLogFile& a, const TLogFile& b) {
+              return a.mtime < b.mtime;
+            });
+  for (std::size_t i = 0; i < files.size() - std::max(n_files_max, 0); i++) {
+    openhd::log::get_default()->debug("Removing old tlog {}", files[i].path);
+    OHDFilesystemUtil::remove_if_existing(files[i].path);
+  }
+}
+
+std::size_t TLogRecorder::recover_file(const std::string& filename) {
+  const int fd = open(filename.c_str(), O_RDWR | O_CLOEXEC);
+  if (fd < 0) return 0;
+  struct stat st {};
+  fstat(fd, &st);
+  const auto size = static_cast<std::size_t>(st.st_size);
+  // Files that have been closed properly end with a frame (crc), not zeroes
+  uint8_t tail[TIMESTAMP_SIZE] = {};
+  if (size < sizeof(tail) ||
+      pread(fd, tail, sizeof(tail), static_cast<off_t>(size - sizeof(tail))) !=
+          sizeof(tail) ||
+      std::any_of(tail, tail + sizeof(tail), [](uint8_t b) { return b != 0; })) {
+    close(fd);
+    return size;
+  }
+  void* map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    close(fd);
+    return size;
+  }
+  const auto data = static_cast<const uint8_t*>(map);
+  std::size_t valid = 0;
+  while (valid + TIMESTAMP_SIZE < size) {
+    const auto frame_size = get_frame_size(data + valid + TIMESTAMP_SIZE,
+                                           size - valid - TIMESTAMP_SIZE);
+    if (frame_size == 0) break;
+    valid += TIMESTAMP_SIZE + frame_size;
+  }
+  munmap(map, size);
+  if (ftruncate(fd, static_cast<off_t>(valid)) == 0) {
+    fsync(fd);
+    openhd::log::get_default()->info("Recovered tlog {} ({} bytes)", filename,
+                                     valid);
+  }
+  close(fd);
+  return valid;
+}
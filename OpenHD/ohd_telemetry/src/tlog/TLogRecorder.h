@@ -0,0 +1,122 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#ifndef OPENHD_OPENHD_OHD_TELEMETRY_SRC_TLOG_TLOGRECORDER_H_
+#define OPENHD_OPENHD_OHD_TELEMETRY_SRC_TLOG_TLOGRECORDER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../mav_include.h"
+
+/**
+ * Flight recorder for the mavlink traffic, in the standard tlog format
+ * (8 byte big endian unix time in us, followed by the raw mavlink frame) that
+ * QGroundControl / MAVProxy / pymavlink can replay.
+ * record() only copies the (already serialized) wire bytes of the messages
+ * into a preallocated buffer - never blocks on disk I/O, if the writer cannot
+ * keep up messages are dropped (and counted). A dedicated thread appends the
+ * buffer to a preallocated, memory mapped file, rotates the file when it is
+ * full and syncs it to disk every SYNC_INTERVAL - on power loss, at most the
+ * last SYNC_INTERVAL of data is lost. The zero-filled tail a power loss leaves
+ * behind is cut off the next time the recorder starts.
+ * MAVLink 流量的飞行记录器，采用标准 tlog 格式（8 字节大端 unix 微秒时间戳 + 原始 MAVLink 帧）。
+ * record() 只把消息（已序列化的）线上字节复制到预分配的缓冲区 - 从不因磁盘 I/O 而阻塞。
+ * 专用线程把缓冲区追加到预分配的内存映射文件，文件满时轮转，并每 SYNC_INTERVAL 同步到磁盘 -
+ * 断电时最多丢失最后 SYNC_INTERVAL 的数据。
+ */
+class TLogRecorder {
+ public:
+  struct Options {
+    // Must end with '/'
+    std::string directory = "/home/openhd/tlog/";
+    // air / ground
+    std::string prefix = "openhd";
+    // Each file is preallocated to this size, then the next file is started
+    std::size_t max_file_size = 32 * 1024 * 1024;
+    // Oldest files are deleted, so we never fill up the sd card
+    int max_n_files = 20;
+  };
+  explicit TLogRecorder(Options options);
+  ~TLogRecorder();
+  TLogRecorder(const TLogRecorder&) = delete;
+  TLogRecorder& operator=(const TLogRecorder&) = delete;
+  // Thread-safe, cheap (memcpy of the wire bytes)
+  void record(const std::vector<MavlinkMessage>& messages);
+  struct Stats {
+    uint64_t n_recorded = 0;
+    uint64_t n_dropped = 0;
+    uint64_t n_bytes_written = 0;
+    int n_files = 0;
+  };
+  Stats get_stats() const;
+  std::string get_current_filename() const;
+  // Cuts off the unused (zero) tail of a file left behind by a power loss /
+  // crash. Returns the size of the valid data.
+  static std::size_t recover_file(const std::string& filename);
+  // While the writer thread is busy with I/O, this much data can be buffered
+  static constexpr std::size_t BUFFER_SIZE = 256 * 1024;
+  static constexpr auto WRITE_INTERVAL = std::chrono::milliseconds(100);
+  static constexpr auto SYNC_INTERVAL = std::chrono::seconds(1);
+
+ private:
+  void write_loop();
+  void write_to_file(const uint8_t* data, std::size_t size);
+  bool open_next_file();
+  void close_file();
+  void sync_file();
+  void recover_and_remove_old_files();
+
+ private:
+  const Options m_options;
+  std::unique_ptr<std::thread> m_write_thread;
+  std::atomic<bool> m_write_run = true;
+  // Filled by record(), swapped with the writer's buffer
+  mutable std::mutex m_buffer_mutex;
+  std::condition_variable m_buffer_cv;
+  std::vector<uint8_t> m_buffer;
+  std::size_t m_buffer_fill = 0;
+  uint64_t m_n_recorded = 0;
+  uint64_t m_n_dropped = 0;
+  // Only used by the writer thread
+  std::vector<uint8_t> m_write_buffer;
+  int m_fd = -1;
+  uint8_t* m_map = nullptr;
+  std::size_t m_file_offset = 0;
+  std::size_t m_synced_offset = 0;
+  int m_file_index = 0;
+  std::chrono::steady_clock::time_point m_last_sync;
+  std::atomic<uint64_t> m_n_bytes_written = 0;
+  std::atomic<int> m_n_files = 0;
+  mutable std::mutex m_filename_mutex;
+  std::string m_current_filename;
+};
+
+#endif  // OPENHD_OPENHD_OHD_TELEMETRY_SRC_TLOG_TLOGRECORDER_H_
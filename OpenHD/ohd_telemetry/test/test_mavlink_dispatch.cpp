@@ -0,0 +1,164 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "../src/routing/MavlinkSystem.hpp"
+#include "openhd_spdlog_include.h"
+
+//
+// Validates the MavlinkSystem dispatch index - components only get the
+// messages they subscribed to, targeted messages only reach their target, and
+// a slow component does not block the others. Also checks the generate
+// scheduler (deadlines and request_generate wake-up).
+// 验证 MavlinkSystem 的分发索引 - 组件只会收到其订阅的消息，带目标的消息只会到达目标组件，
+// 慢组件不会阻塞其他组件。
+
+namespace {
+
+class TestComponent : public MavlinkComponent {
+ public:
+  TestComponent(uint8_t sys_id, uint8_t comp_id,
+                std::vector<MavlinkSubscription> subscriptions,
+                std::chrono::milliseconds delay = std::chrono::milliseconds(0))
+      : MavlinkComponent(sys_id, comp_id),
+        m_subscriptions(std::move(subscriptions)),
+        m_delay(delay) {}
+  std::vector<MavlinkMessage> process_mavlink_messages(
+      std::vector<MavlinkMessage> messages) override {
+    std::this_thread::sleep_for(m_delay);
+    m_n_received += messages.size();
+    return {};
+  }
+  std::vector<MavlinkMessage> generate_mavlink_messages() override {
+    return {create_heartbeat()};
+  }
+  std::vector<MavlinkSubscription> get_subscriptions() const override {
+    return m_subscriptions;
+  }
+  std::atomic<int> m_n_received{0};
+
+ private:
+  const std::vector<MavlinkSubscription> m_subscriptions;
+  const std::chrono::milliseconds m_delay;
+};
+
+MavlinkMessage command_long(uint8_t target_sys, uint8_t target_comp) {
+  mavlink_command_long_t command{};
+  command.target_system = target_sys;
+  command.target_component = target_comp;
+  MavlinkMessage msg;
+  mavlink_msg_command_long_encode(QOPENHD_SYS_ID, 0, &msg.m, &command);
+  return msg;
+}
+
+MavlinkMessage heartbeat() {
+  MavlinkMessage msg;
+  mavlink_msg_heartbeat_pack(QOPENHD_SYS_ID, 0, &msg.m, MAV_TYPE_GENERIC,
+                             MAV_AUTOPILOT_GENERIC, 0, 0, MAV_STATE_ACTIVE);
+  return msg;
+}
+
+bool check(bool ok, const std::string& what) {
+  std::cout << (ok ? "OK     " : "FAILED ") << what << std::endl;
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  MavlinkSystem system(OHD_SYS_ID_GROUND);
+  auto main_component = std::make_shared<TestComponent>(
+      OHD_SYS_ID_GROUND, MAV_COMP_ID_ONBOARD_COMPUTER,
+      std::vector<MavlinkSubscription>{{MAVLINK_MSG_ID_COMMAND_LONG}});
+  auto camera_component = std::make_shared<TestComponent>(
+      OHD_SYS_ID_GROUND, MAV_COMP_ID_CAMERA,
+      std::vector<MavlinkSubscription>{{MAVLINK_MSG_ID_COMMAND_LONG}},
+      std::chrono::milliseconds(200));
+  auto any_target_component = std::make_shared<TestComponent>(
+      OHD_SYS_ID_GROUND, 1,
+      std::vector<MavlinkSubscription>{{MAVLINK_MSG_ID_COMMAND_LONG, true}});
+  auto all_component = std::make_shared<TestComponent>(
+      OHD_SYS_ID_GROUND, 2, std::vector<MavlinkSubscription>{});
+  system.add_component(main_component);
+  system.add_component(camera_component);
+  system.add_component(any_target_component);
+  system.add_component(all_component);
+  bool ok = true;
+  // 3 heartbeats (nobody but "all" subscribed), 1 command for the main
+  // component, 1 for another system, 1 for all components of this system
+  system.dispatch_mavlink_messages(
+      {heartbeat(), heartbeat(), heartbeat(),
+       command_long(OHD_SYS_ID_GROUND, MAV_COMP_ID_ONBOARD_COMPUTER),
+       command_long(OHD_SYS_ID_AIR, MAV_COMP_ID_ONBOARD_COMPUTER),
+       command_long(OHD_SYS_ID_GROUND, 0)});
+  ok &= check(main_component->m_n_received == 2, "targeted + broadcast");
+  ok &= check(camera_component->m_n_received == 1, "broadcast only");
+  ok &= check(any_target_component->m_n_received == 3, "any target");
+  ok &= check(all_component->m_n_received == 6, "no subscription - all");
+  // The slow camera component must not block the main component
+  std::thread slow([&system]() {
+    system.dispatch_mavlink_messages(
+        {command_long(OHD_SYS_ID_GROUND, MAV_COMP_ID_CAMERA)});
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  const auto begin = std::chrono::steady_clock::now();
+  system.dispatch_mavlink_messages(
+      {command_long(OHD_SYS_ID_GROUND, MAV_COMP_ID_ONBOARD_COMPUTER)});
+  const auto elapsed = std::chrono::steady_clock::now() - begin;
+  slow.join();
+  ok &= check(main_component->m_n_received == 3 &&
+                  elapsed < std::chrono::milliseconds(100),
+              "no global lock");
+  // Scheduler - all components are due right away, then at their deadline
+  // (100ms) unless one requests to generate earlier
+  ok &= check(system.wait_and_generate_mavlink_messages(
+                        std::chrono::milliseconds(500))
+                      .size() == 4,
+              "generate");
+  std::thread requester([&camera_component]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    camera_component->request_generate();
+  });
+  auto generate_begin = std::chrono::steady_clock::now();
+  auto generated =
+      system.wait_and_generate_mavlink_messages(std::chrono::milliseconds(500));
+  auto generate_elapsed = std::chrono::steady_clock::now() - generate_begin;
+  requester.join();
+  ok &= check(generated.size() == 1 &&
+                  generate_elapsed < std::chrono::milliseconds(60),
+              "request generate wakes up");
+  generate_begin = std::chrono::steady_clock::now();
+  generated =
+      system.wait_and_generate_mavlink_messages(std::chrono::milliseconds(500));
+  generate_elapsed = std::chrono::steady_clock::now() - generate_begin;
+  ok &= check(generated.size() >= 3 &&
+                  generate_elapsed < std::chrono::milliseconds(100),
+              "deadline");
+  std::cout << system.get_generate_stats_and_reset() << std::endl;
+  std::cout << (ok ? "OK" : "FAILED") << std::endl;
+  return ok ? 0 : 1;
+}
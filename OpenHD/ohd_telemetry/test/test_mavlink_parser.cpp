@@ -0,0 +1,349 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../src/endpoints/MavlinkFrameScanner.h"
+#include "../src/mav_include.h"
+
+//
+// Compares the bulk MavlinkFrameScanner with the old byte-at-a-time parser
+// (mavlink_parse_char + a new vector per buffer) - both have to produce the
+// exact same messages, the scanner should be a lot faster. The stream is cut
+// into random chunks (like UART reads), so frames are split across buffers.
+// Also checks v1 / signed frames and that the scanner doesn't lose more
+// messages than the old parser on a corrupted stream.
+// 比较批量 MavlinkFrameScanner 与旧的逐字节解析器（mavlink_parse_char + 每个缓冲区一个新 vector）
+// - 两者必须解析出完全相同的消息，且扫描器应快得多。
+//
+// Usage: test_mavlink_parser [file.tlog]
+// Without a tlog, an ArduPilot like stream is generated: 50Hz ATTITUDE, 10Hz
+// GLOBAL_POSITION_INT / VFR_HUD, 1Hz HEARTBEAT and a full parameter download.
+
+namespace {
+
+constexpr int N_ITERATIONS = 20;
+constexpr int N_PARAMS = 1200;
+
+struct Stream {
+  std::vector<uint8_t> data;
+  // (offset, size) - like UART reads
+  std::vector<std::pair<int, int>> chunks;
+};
+
+void append(std::vector<uint8_t>& data, const mavlink_message_t& msg) {
+  uint8_t buf[MAVLINK_MAX_PACKET_LEN];
+  const auto len = mavlink_msg_to_send_buffer(buf, &msg);
+  data.insert(data.end(), buf, buf + len);
+}
+
+std::vector<uint8_t> create_ardupilot_like_stream(int duration_s) {
+  std::vector<uint8_t> data;
+  mavlink_message_t msg;
+  int param_index = 0;
+  for (int tick = 0; tick < duration_s * 50; tick++) {
+    const uint32_t time_ms = tick * 20;
+    if (tick % 50 == 0) {
+      mavlink_msg_heartbeat_pack(1, MAV_COMP_ID_AUTOPILOT1, &msg, MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_ARDUPILOTMEGA, MAV_MODE_GUIDED_ARMED, 5, MAV_STATE_ACTIVE);
+      append(data, msg);
+    }
+    mavlink_msg_attitude_pack(1, MAV_COMP_ID_AUTOPILOT1, &msg, time_ms, 0.01f * tick, -0.02f, 1.5f, 0.001f, 0.002f, 0.003f);
+    append(data, msg);
+    if (tick % 5 == 0) {
+      mavlink_msg_global_position_int_pack(1, MAV_COMP_ID_AUTOPILOT1, &msg, time_ms, 473977418 + tick, 85455938 - tick, 500000 + tick, 12000, 100, -50, 0, 9000);
+      append(data, msg);
+      mavlink_msg_vfr_hud_pack(1, MAV_COMP_ID_AUTOPILOT1, &msg, 12.5f, 11.0f, 90, 45, 120.0f, 0.5f);
+      append(data, msg);
+    }
+    // Parameter download when the GCS connects - as fast as the link allows
+    for (int i = 0; i < 20 && param_index < N_PARAMS && tick >= 100; i++, param_index++) {
+      const std::string param_id = "PARAM_" + std::to_string(param_index);
+      mavlink_msg_param_value_pack(1, MAV_COMP_ID_AUTOPILOT1, &msg, param_id.c_str(), 0.5f * param_index, MAV_PARAM_TYPE_REAL32, N_PARAMS, param_index);
+      append(data, msg);
+    }
+  }
+  return data;
+}
+
+// tlog: 8 byte (big endian) timestamp in us, followed by one mavlink frame
+std::vector<uint8_t> read_tlog(const std::string& filename) {
+  std::ifstream file(filename, std::ios::binary);
+  const std::vector<uint8_t> tlog((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  std::vector<uint8_t> data;
+  std::size_t i = 0;
+  while (i + 8 + 2 <= tlog.size()) {
+    const uint8_t* frame = &tlog[i + 8];
+    std::size_t frame_len = 0;
+    if (frame[0] == MAVLINK_STX) {
+      frame_len = MAVLINK_NUM_HEADER_BYTES + frame[1] + MAVLINK_NUM_CHECKSUM_BYTES;
+      if (i + 8 + 3 <= tlog.size() && (frame[2] & MAVLINK_IFLAG_SIGNED)) frame_len += MAVLINK_SIGNATURE_BLOCK_LEN;
+    } else if (frame[0] == MAVLINK_STX_MAVLINK1) {
+      frame_len = 6 + frame[1] + MAVLINK_NUM_CHECKSUM_BYTES;
+    } else {
+      std::cerr << "Invalid tlog at offset " << i << std::endl;
+      break;
+    }
+    if (i + 8 + frame_len > tlog.size()) break;
+    data.insert(data.end(), frame, frame + frame_len);
+    i += 8 + frame_len;
+  }
+  return data;
+}
+
+// Whatever read() returns on a busy UART / socket
+std::vector<std::pair<int, int>> create_chunks(int data_len, uint32_t seed, int max_chunk_size = 512) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> chunk_size(1, max_chunk_size);
+  std::vector<std::pair<int, int>> chunks;
+  for (int offset = 0; offset < data_len;) {
+    const int size = std::min(chunk_size(rng), data_len - offset);
+    chunks.emplace_back(offset, size);
+    offset += size;
+  }
+  return chunks;
+}
+
+// What MEndpoint::parseNewData used to do
+template <class CB>
+void parse_legacy(const Stream& stream, uint8_t channel, CB cb) {
+  mavlink_status_t status{};
+  for (const auto& [offset, size] : stream.chunks) {
+    std::vector<MavlinkMessage> messages;
+    mavlink_message_t msg;
+    for (int i = 0; i < size; i++) {
+      if (mavlink_parse_char(channel, stream.data[offset + i], &msg, &status)) {
+        messages.push_back(MavlinkMessage{msg});
+      }
+    }
+    cb(messages);
+  }
+}
+
+template <class CB>
+int parse_scanner(const Stream& stream, uint8_t channel, CB cb) {
+  MavlinkFrameScanner scanner(channel);
+  std::vector<MavlinkMessage> arena;
+  for (const auto& [offset, size] : stream.chunks) {
+    arena.clear();
+    scanner.parse(stream.data.data() + offset, size, arena);
+    cb(arena);
+  }
+  return scanner.get_n_dropped();
+}
+
+bool is_same(const MavlinkMessage& a, const MavlinkMessage& b) {
+  const auto& ma = a.m;
+  const auto& mb = b.m;
+  if (ma.magic != mb.magic || ma.len != mb.len || ma.incompat_flags != mb.incompat_flags || ma.compat_flags != mb.compat_flags || ma.seq != mb.seq ||
+      ma.sysid != mb.sysid || ma.compid != mb.compid || ma.msgid != mb.msgid || ma.checksum != mb.checksum) {
+    return false;
+  }
+  // Including the zero-filled part components rely on (whatever is behind that
+  // is left over from previous messages in the mavlink_parse_char buffer)
+  const mavlink_msg_entry_t* entry = mavlink_get_msg_entry(ma.msgid);
+  const int n_bytes = std::max<int>(ma.len, entry ? entry->max_msg_len : 0);
+  if (std::memcmp(_MAV_PAYLOAD(&ma), _MAV_PAYLOAD(&mb), n_bytes) != 0) return false;
+  return a.wire_size() == b.wire_size() && std::memcmp(a.wire_data(), b.wire_data(), a.wire_size()) == 0;
+}
+
+// Both parsers have to produce the same messages (in the same order)
+bool validate(const Stream& stream, const std::string& tag) {
+  std::vector<MavlinkMessage> legacy;
+  std::vector<MavlinkMessage> scanned;
+  parse_legacy(stream, 0, [&legacy](const std::vector<MavlinkMessage>& messages) { legacy.insert(legacy.end(), messages.begin(), messages.end()); });
+  parse_scanner(stream, 1, [&scanned](const std::vector<MavlinkMessage>& messages) { scanned.insert(scanned.end(), messages.begin(), messages.end()); });
+  bool ok = legacy.size() == scanned.size() && !legacy.empty();
+  for (std::size_t i = 0; ok && i < legacy.size(); i++) {
+    if (!is_same(legacy[i], scanned[i])) {
+      std::cerr << tag << ": message " << i << " differs" << std::endl;
+      ok = false;
+    }
+  }
+  std::cout << tag << ": legacy:" << legacy.size() << " scanner:" << scanned.size() << (ok ? " OK" : " FAILED") << std::endl;
+  return ok;
+}
+
+template <class F>
+double measure_s(F f) {
+  const auto begin = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+void benchmark(const Stream& stream, const std::string& tag) {
+  // Touch each message like a consumer would (msgid), so nothing is optimized away
+  std::size_t n_legacy = 0;
+  std::size_t n_scanner = 0;
+  uint32_t sum = 0;
+  const double legacy_s = measure_s([&]() {
+    for (int i = 0; i < N_ITERATIONS; i++) {
+      parse_legacy(stream, 2, [&](const std::vector<MavlinkMessage>& messages) {
+        n_legacy += messages.size();
+        for (const auto& msg : messages) sum += msg.m.msgid;
+      });
+    }
+  });
+  const double scanner_s = measure_s([&]() {
+    for (int i = 0; i < N_ITERATIONS; i++) {
+      parse_scanner(stream, 3, [&](const std::vector<MavlinkMessage>& messages) {
+        n_scanner += messages.size();
+        for (const auto& msg : messages) sum += msg.m.msgid;
+      });
+    }
+  });
+  const double n_mb = static_cast<double>(stream.data.size()) * N_ITERATIONS / 1e6;
+  std::cout << tag << std::fixed << std::setprecision(1) << std::endl;
+  std::cout << "legacy:  " << n_mb / legacy_s << " MB/s " << legacy_s * 1e9 / n_legacy << " ns/msg" << std::endl;
+  std::cout << "scanner: " << n_mb / scanner_s << " MB/s " << scanner_s * 1e9 / n_scanner << " ns/msg" << std::endl;
+  std::cout << "speedup: " << legacy_s / scanner_s << "x (" << sum % 10 << ")" << std::endl;
+}
+
+// Both parsers drop corrupted frames, but the scanner re-syncs on the next STX
+// inside the bad frame instead of skipping it completely
+bool check_corrupted(const Stream& stream) {
+  Stream corrupted = stream;
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<std::size_t> position(0, corrupted.data.size() - 1);
+  for (std::size_t i = 0; i < corrupted.data.size() / 2000; i++) {
+    corrupted.data[position(rng)] ^= 0x5A;
+  }
+  std::size_t n_legacy = 0;
+  std::size_t n_scanner = 0;
+  parse_legacy(corrupted, 4, [&n_legacy](const std::vector<MavlinkMessage>& messages) { n_legacy += messages.size(); });
+  const int n_dropped = parse_scanner(corrupted, 5, [&n_scanner](const std::vector<MavlinkMessage>& messages) { n_scanner += messages.size(); });
+  const bool ok = n_scanner >= n_legacy && n_dropped > 0;
+  std::cout << "corrupted: legacy:" << n_legacy << " scanner:" << n_scanner << " dropped:" << n_dropped << (ok ? " OK" : " FAILED") << std::endl;
+  return ok;
+}
+
+// Frame the generated stream doesn't have - v1 and signed v2
+std::vector<uint8_t> create_frame(bool v1, bool is_signed, uint32_t msgid, const std::vector<uint8_t>& payload, uint8_t seq) {
+  std::vector<uint8_t> frame;
+  if (v1) {
+    frame = {MAVLINK_STX_MAVLINK1, static_cast<uint8_t>(payload.size()), seq, 1, 1, static_cast<uint8_t>(msgid)};
+  } else {
+    frame = {MAVLINK_STX,
+             static_cast<uint8_t>(payload.size()),
+             static_cast<uint8_t>(is_signed ? MAVLINK_IFLAG_SIGNED : 0),
+             0,
+             seq,
+             1,
+             1,
+             static_cast<uint8_t>(msgid),
+             static_cast<uint8_t>(msgid >> 8),
+             static_cast<uint8_t>(msgid >> 16)};
+  }
+  frame.insert(frame.end(), payload.begin(), payload.end());
+  uint16_t crc = crc_calculate(frame.data() + 1, static_cast<uint16_t>(frame.size() - 1));
+  const mavlink_msg_entry_t* entry = mavlink_get_msg_entry(msgid);
+  crc_accumulate(entry ? entry->crc_extra : 0, &crc);
+  frame.push_back(crc & 0xFF);
+  frame.push_back(crc >> 8);
+  if (is_signed) {
+    for (int i = 0; i < MAVLINK_SIGNATURE_BLOCK_LEN; i++) frame.push_back(static_cast<uint8_t>(0xF0 + i));
+  }
+  return frame;
+}
+
+bool check_v1_and_signed() {
+  Stream stream;
+  const std::vector<uint8_t> attitude(28, 0xFD);
+  // heartbeat truncated (trailing zeroes), needs zero fill
+  const std::vector<uint8_t> heartbeat = {5, 0, 0, 0, 2, 3};
+  for (uint8_t seq = 0; seq < 100; seq++) {
+    for (const auto& frame : {create_frame(true, false, MAVLINK_MSG_ID_ATTITUDE, attitude, seq), create_frame(false, true, MAVLINK_MSG_ID_ATTITUDE, attitude, seq),
+                              create_frame(false, false, MAVLINK_MSG_ID_HEARTBEAT, heartbeat, seq), create_frame(true, false, MAVLINK_MSG_ID_HEARTBEAT, heartbeat, seq)}) {
+      stream.data.insert(stream.data.end(), frame.begin(), frame.end());
+    }
+    // Some garbage in between (without STX, the parsers re-sync differently)
+    stream.data.insert(stream.data.end(), {0x00, 0x55, 0xAA});
+  }
+  stream.chunks = create_chunks(static_cast<int>(stream.data.size()), 7);
+  return validate(stream, "v1/signed");
+}
+
+// Each frame with a bad CRC is counted once, no matter if the scanner or the
+// state machine (frame split across buffers) rejects it
+bool check_n_dropped() {
+  Stream stream;
+  const std::vector<uint8_t> heartbeat = {5, 0, 0, 0, 2, 3};
+  const auto is_stx = [](uint8_t b) { return b == MAVLINK_STX || b == MAVLINK_STX_MAVLINK1; };
+  int n_corrupted = 0;
+  for (int seq = 0; seq < 250; seq++) {
+    auto frame = create_frame(false, false, MAVLINK_MSG_ID_HEARTBEAT, heartbeat, static_cast<uint8_t>(seq));
+    if (seq % 4 == 0) {
+      frame.back() ^= 0x01;
+      n_corrupted++;
+    }
+    // A STX inside a bad frame is re-synced on (and might be dropped, too)
+    if (std::any_of(frame.begin() + 1, frame.end(), is_stx)) {
+      if (seq % 4 == 0) n_corrupted--;
+      continue;
+    }
+    stream.data.insert(stream.data.end(), frame.begin(), frame.end());
+  }
+  bool ok = true;
+  uint8_t channel = 6;
+  for (int max_chunk_size : {1, 7, 512}) {
+    stream.chunks = create_chunks(static_cast<int>(stream.data.size()), 3, max_chunk_size);
+    const int n_dropped = parse_scanner(stream, channel++, [](const std::vector<MavlinkMessage>&) {});
+    ok &= n_dropped == n_corrupted;
+    std::cout << "dropped (chunks up to " << max_chunk_size << "): " << n_dropped << "/" << n_corrupted << (n_dropped == n_corrupted ? " OK" : " FAILED")
+              << std::endl;
+  }
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Stream stream;
+  if (argc > 1) {
+    stream.data = read_tlog(argv[1]);
+    std::cout << "tlog " << argv[1] << ": " << stream.data.size() << " bytes" << std::endl;
+  } else {
+    stream.data = create_ardupilot_like_stream(60);
+    std::cout << "Generated 60s ArduPilot like stream: " << stream.data.size() << " bytes" << std::endl;
+  }
+  if (stream.data.empty()) {
+    std::cerr << "No data" << std::endl;
+    return 1;
+  }
+  stream.chunks = create_chunks(static_cast<int>(stream.data.size()), 1);
+  bool ok = validate(stream, "stream");
+  ok &= check_v1_and_signed();
+  ok &= check_corrupted(stream);
+  ok &= check_n_dropped();
+  benchmark(stream, "reads of 1-512 bytes (UART)");
+  stream.chunks = create_chunks(static_cast<int>(stream.data.size()), 2, 4096);
+  benchmark(stream, "reads of 1-4096 bytes (UDP / TCP)");
+  std::cout << (ok ? "OK" : "FAILED") << std::endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,212 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include "../src/endpoints/MEndpoint.h"
+#include "../src/mav_include.h"
+#include "openhd_spdlog_include.h"
+#include "openhd_test_helper.h"
+
+//
+// Micro benchmark: routes FC UART traffic (1000 msgs/s, delivered in 10ms
+// chunks like a serial read) to three endpoints (e.g. WB, UDP, TCP). Compares
+// the old way (every endpoint packs every message twice - once for the tx
+// byte count, once for aggregation) with the cached wire bytes. Reports heap
+// allocations per message and the CPU usage at 1000 msgs/s, validates that
+// both produce the same bytes.
+// 微基准测试：将飞控串口流量（1000 条消息/秒）路由到三个端点，比较旧方式（每个端点打包每条消息两次）
+// 与缓存线上字节的方式。报告每条消息的堆分配次数和 1000 条消息/秒时的 CPU 占用。
+//
+// Usage: test_mavlink_routing [simulated seconds]
+
+static std::atomic<uint64_t> g_n_allocations{0};
+
+// Counts every heap allocation
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void* operator new(std::size_t size) {
+  g_n_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size)) return ptr;
+  throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+namespace {
+
+constexpr int MESSAGES_PER_SECOND = 1000;
+constexpr int CHUNK_MS = 10;
+constexpr int N_ENDPOINTS = 3;
+
+// What MavlinkMessage::pack / get_size / aggregate_pack_messages did before
+std::vector<uint8_t> legacy_pack(const mavlink_message_t& m) {
+  std::vector<uint8_t> buf(MAVLINK_MAX_PACKET_LEN);
+  auto size = mavlink_msg_to_send_buffer(buf.data(), &m);
+  buf.resize(size);
+  return buf;
+}
+int legacy_get_size(const std::vector<MavlinkMessage>& messages) {
+  int ret = 0;
+  for (const auto& message : messages) ret += legacy_pack(message.m).size();
+  return ret;
+}
+std::vector<AggregatedMavlinkPacket> legacy_aggregate_pack_messages(
+    const std::vector<MavlinkMessage>& messages, uint32_t max_mtu = 1024) {
+  std::vector<AggregatedMavlinkPacket> ret;
+  auto& pool = openhd::BufferPool::telemetry();
+  auto buff = pool->get_buffer();
+  buff->reserve(max_mtu);
+  for (const auto& msg : messages) {
+    auto data = legacy_pack(msg.m);
+    if (buff->size() + data.size() > max_mtu && !buff->empty()) {
+      ret.push_back({buff, 1});
+      buff = pool->get_buffer();
+      buff->reserve(max_mtu);
+    }
+    buff->insert(buff->end(), data.begin(), data.end());
+  }
+  if (!buff->empty()) ret.push_back({buff, 1});
+  return ret;
+}
+
+// Sums up what would go out over the link
+uint64_t checksum(uint64_t sum, const std::vector<uint8_t>& data) {
+  for (const auto byte : data) sum = sum * 31 + byte;
+  return sum;
+}
+
+class BenchEndpoint : public MEndpoint {
+ public:
+  explicit BenchEndpoint(std::string tag) : MEndpoint(std::move(tag)) {}
+  void feed(const uint8_t* data, int data_len) { parseNewData(data, data_len); }
+  uint64_t m_checksum = 0;
+
+ private:
+  bool sendMessagesImpl(const std::vector<MavlinkMessage>& messages) override {
+    for (const auto& packet : aggregate_pack_messages(messages)) {
+      m_checksum = checksum(m_checksum, *packet.aggregated_data);
+    }
+    return true;
+  }
+};
+
+// One chunk (CHUNK_MS) of what a FC typically sends
+std::vector<uint8_t> create_fc_chunk(int chunk_idx) {
+  std::vector<uint8_t> ret;
+  const int n_messages = MESSAGES_PER_SECOND * CHUNK_MS / 1000;
+  for (int i = 0; i < n_messages; i++) {
+    mavlink_message_t msg;
+    const int type = (chunk_idx * n_messages + i) % 10;
+    if (type == 0) {
+      mavlink_msg_heartbeat_pack(OHD_SYS_ID_FC, MAV_COMP_ID_AUTOPILOT1, &msg, MAV_TYPE_HELICOPTER,
+                                 MAV_AUTOPILOT_GENERIC, MAV_MODE_GUIDED_ARMED, 0, MAV_STATE_ACTIVE);
+    } else if (type == 9) {
+      mavlink_msg_statustext_pack(OHD_SYS_ID_FC, MAV_COMP_ID_AUTOPILOT1, &msg, 6,
+                                  "Benchmark status text", 0, 0);
+    } else if (type % 2 == 0) {
+      mavlink_msg_attitude_pack(OHD_SYS_ID_FC, MAV_COMP_ID_AUTOPILOT1, &msg, chunk_idx, 0.1f * i, 0.2f,
+                                0.3f, 0.01f, 0.02f, 0.03f);
+    } else {
+      mavlink_msg_local_position_ned_pack(OHD_SYS_ID_FC, MAV_COMP_ID_AUTOPILOT1, &msg, chunk_idx, 1.0f * i,
+                                          2.0f, 3.0f, 0.1f, 0.2f, 0.3f);
+    }
+    uint8_t buf[MAVLINK_MAX_PACKET_LEN];
+    const auto len = mavlink_msg_to_send_buffer(buf, &msg);
+    ret.insert(ret.end(), buf, buf + len);
+  }
+  return ret;
+}
+
+struct Result {
+  uint64_t n_messages = 0;
+  uint64_t n_allocations = 0;
+  double cpu_s = 0;
+  uint64_t checksum = 0;
+};
+
+Result run(const std::vector<std::vector<uint8_t>>& chunks, bool legacy) {
+  BenchEndpoint fc("FC");
+  std::vector<std::unique_ptr<BenchEndpoint>> endpoints;
+  for (int i = 0; i < N_ENDPOINTS; i++) {
+    endpoints.push_back(std::make_unique<BenchEndpoint>("EP" + std::to_string(i)));
+  }
+  Result result;
+  fc.registerCallback([&endpoints, &result, legacy](const std::vector<MavlinkMessage>& messages) {
+    result.n_messages += messages.size();
+    for (auto& endpoint : endpoints) {
+      if (legacy) {
+        volatile int n_bytes = legacy_get_size(messages);
+        (void)n_bytes;
+        for (const auto& packet : legacy_aggregate_pack_messages(messages)) {
+          endpoint->m_checksum = checksum(endpoint->m_checksum, *packet.aggregated_data);
+        }
+      } else {
+        endpoint->sendMessages(messages);
+      }
+    }
+  });
+  const uint64_t n_allocations_begin = g_n_allocations.load();
+  const double cpu_begin = openhd_test_helper::get_cpu_time_s();
+  for (const auto& chunk : chunks) {
+    fc.feed(chunk.data(), static_cast<int>(chunk.size()));
+  }
+  result.cpu_s = openhd_test_helper::get_cpu_time_s() - cpu_begin;
+  result.n_allocations = g_n_allocations.load() - n_allocations_begin;
+  for (const auto& endpoint : endpoints) result.checksum = checksum(result.checksum, {static_cast<uint8_t>(endpoint->m_checksum)});
+  return result;
+}
+
+void print_result(const std::string& tag, const Result& result, int duration_s) {
+  std::cout << std::left << std::setw(8) << tag << std::right << std::fixed << std::setprecision(2)
+            << " allocations/msg:" << static_cast<double>(result.n_allocations) / result.n_messages
+            << " CPU at " << MESSAGES_PER_SECOND << " msgs/s:" << std::setprecision(3)
+            << 100 * result.cpu_s / duration_s << "%"
+            << " (" << std::setprecision(0) << 1e9 * result.cpu_s / result.n_messages << "ns/msg)" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const int duration_s = argc > 1 ? std::max(1, std::atoi(argv[1])) : 60;
+  std::vector<std::vector<uint8_t>> chunks;
+  for (int i = 0; i < duration_s * 1000 / CHUNK_MS; i++) {
+    chunks.push_back(create_fc_chunk(i));
+  }
+  // Warm up the buffer pool
+  run(chunks, false);
+  const auto legacy = run(chunks, true);
+  const auto cached = run(chunks, false);
+  print_result("legacy", legacy, duration_s);
+  print_result("cached", cached, duration_s);
+  const bool ok = legacy.n_messages == static_cast<uint64_t>(duration_s * MESSAGES_PER_SECOND) &&
+                  cached.n_messages == legacy.n_messages && cached.checksum == legacy.checksum &&
+                  cached.n_allocations < legacy.n_allocations;
+  std::cout << (ok ? "OK" : "FAILED") << std::endl;
+  return ok ? 0 : 1;
+}
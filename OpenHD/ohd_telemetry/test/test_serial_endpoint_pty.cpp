@@ -0,0 +1,236 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../src/endpoints/SerialEndpoint.h"
+#include "openhd_spdlog_include.h"
+#include "openhd_test_helper.h"
+
+//
+// Benchmark of the SerialEndpoint I/O thread over a pty pair. The test
+// emulates the FC on the master side, paced like a 921600 baud UART in both
+// directions. The FC streams PING messages to OpenHD (rx), and 4 threads
+// (e.g. the WB receive path) send PING messages to the FC (tx).
+// Reports rx / tx latency (send time is in the PING), how long sendMessages()
+// blocked the caller, the endpoint I/O stats and CPU usage.
+// 通过 pty 对测试 SerialEndpoint 的 I/O 线程。在主端模拟飞控，双向按 921600 波特率的 UART 节奏收发。
+//
+// Usage: test_serial_endpoint_pty [seconds]
+
+namespace {
+
+using namespace openhd_test_helper;
+
+constexpr int BAUD_RATE = 921600;
+// 8N1
+constexpr int BYTES_PER_S = BAUD_RATE / 10;
+// FC -> OpenHD, about 70% of the link
+constexpr int RX_MESSAGES_PER_S = 2400;
+constexpr int N_TX_THREADS = 4;
+constexpr int TX_MESSAGES_PER_S_PER_THREAD = 400;
+
+MavlinkMessage create_ping(uint32_t seq) {
+  mavlink_ping_t ping{};
+  ping.time_usec = now_us();
+  ping.seq = seq;
+  MavlinkMessage msg;
+  mavlink_msg_ping_encode(1, 1, &msg.m, &ping);
+  return msg;
+}
+
+struct Latencies {
+  std::mutex mutex;
+  std::vector<uint32_t> values_us;
+  void add(const mavlink_message_t& msg) {
+    if (msg.msgid != MAVLINK_MSG_ID_PING) return;
+    mavlink_ping_t ping;
+    mavlink_msg_ping_decode(&msg, &ping);
+    const auto latency = static_cast<uint32_t>(now_us() - ping.time_usec);
+    std::lock_guard<std::mutex> guard(mutex);
+    values_us.push_back(latency);
+  }
+  std::string to_string() {
+    std::lock_guard<std::mutex> guard(mutex);
+    const auto& v = values_us;
+    std::stringstream ss;
+    ss << "n:" << v.size() << " p50:" << percentile(v, 0.5)
+       << "us p99:" << percentile(v, 0.99) << "us max:" << percentile(v, 1.0)
+       << "us";
+    return ss.str();
+  }
+};
+
+// Like the wire - never more than BYTES_PER_S on average
+class Pacer {
+ public:
+  Pacer() : m_begin(std::chrono::steady_clock::now()) {}
+  // How many bytes may be transferred right now
+  int64_t budget() const {
+    const double elapsed_s = std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now() - m_begin)
+                                 .count();
+    return static_cast<int64_t>(elapsed_s * BYTES_PER_S) - m_n_bytes;
+  }
+  void consume(int64_t n_bytes) { m_n_bytes += n_bytes; }
+
+ private:
+  const std::chrono::steady_clock::time_point m_begin;
+  int64_t m_n_bytes = 0;
+};
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const int duration_s = argc > 1 ? std::max(1, std::atoi(argv[1])) : 3;
+  // The master side is the FC
+  const int master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master_fd < 0 || grantpt(master_fd) != 0 || unlockpt(master_fd) != 0) {
+    std::cerr << "Cannot create pty" << std::endl;
+    return 1;
+  }
+  const std::string slave_name = ptsname(master_fd);
+  std::cout << "pty " << slave_name << " " << BAUD_RATE << " baud, "
+            << duration_s << "s" << std::endl;
+  Latencies rx_latencies;
+  Latencies tx_latencies;
+  SerialEndpoint::HWOptions options{};
+  options.linux_filename = slave_name;
+  options.baud_rate = BAUD_RATE;
+  auto endpoint = std::make_unique<SerialEndpoint>("ser_bench", options);
+  endpoint->registerCallback([&rx_latencies](const std::vector<MavlinkMessage>& messages) {
+    for (const auto& msg : messages) rx_latencies.add(msg.m);
+  });
+  // Wait until the endpoint has opened the slave
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  std::atomic<bool> stop{false};
+  uint32_t n_rx_sent = 0;
+  // FC -> OpenHD
+  std::thread fc_tx([&]() {
+    Pacer pacer;
+    const auto begin = std::chrono::steady_clock::now();
+    const int n_messages = duration_s * RX_MESSAGES_PER_S;
+    uint8_t buff[MAVLINK_MAX_PACKET_LEN];
+    for (int i = 0; i < n_messages; i++) {
+      std::this_thread::sleep_until(
+          begin + std::chrono::microseconds(1000000LL * i / RX_MESSAGES_PER_S));
+      const auto msg = create_ping(i);
+      const int len = mavlink_msg_to_send_buffer(buff, &msg.m);
+      while (pacer.budget() < len) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      }
+      pacer.consume(len);
+      if (write(master_fd, buff, len) == len) n_rx_sent++;
+    }
+  });
+  // OpenHD -> FC
+  std::thread fc_rx([&]() {
+    Pacer pacer;
+    mavlink_message_t msg;
+    mavlink_status_t status{};
+    const uint8_t channel = MAVLINK_COMM_NUM_BUFFERS - 1;
+    uint8_t buff[1024];
+    struct pollfd fds[1];
+    fds[0].fd = master_fd;
+    fds[0].events = POLLIN;
+    while (!stop) {
+      const int64_t budget = std::min<int64_t>(pacer.budget(), sizeof(buff));
+      if (budget < 64) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        continue;
+      }
+      if (poll(fds, 1, 100) <= 0) continue;
+      const ssize_t len = read(master_fd, buff, budget);
+      if (len <= 0) continue;
+      pacer.consume(len);
+      for (ssize_t i = 0; i < len; i++) {
+        if (mavlink_parse_char(channel, buff[i], &msg, &status)) {
+          tx_latencies.add(msg);
+        }
+      }
+    }
+  });
+  std::vector<std::thread> tx_threads;
+  std::atomic<uint32_t> n_tx_sent{0};
+  std::atomic<uint64_t> max_send_call_us{0};
+  const double cpu_begin = get_cpu_time_s();
+  const auto begin = std::chrono::steady_clock::now();
+  for (int t = 0; t < N_TX_THREADS; t++) {
+    tx_threads.emplace_back([&, t]() {
+      const int n_messages = duration_s * TX_MESSAGES_PER_S_PER_THREAD;
+      for (int i = 0; i < n_messages; i++) {
+        std::this_thread::sleep_until(
+            begin + std::chrono::microseconds(1000000LL * i /
+                                              TX_MESSAGES_PER_S_PER_THREAD));
+        const auto before = now_us();
+        endpoint->sendMessages({create_ping(i)});
+        const auto send_call_us = now_us() - before;
+        auto current = max_send_call_us.load();
+        while (send_call_us > current &&
+               !max_send_call_us.compare_exchange_weak(current, send_call_us)) {
+        }
+        n_tx_sent++;
+      }
+    });
+  }
+  for (auto& thread : tx_threads) thread.join();
+  fc_tx.join();
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  const double wall_s =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - begin)
+          .count();
+  const double cpu_s = get_cpu_time_s() - cpu_begin;
+  stop = true;
+  fc_rx.join();
+  const auto io_stats = endpoint->get_io_stats();
+  endpoint.reset();
+  close(master_fd);
+  std::cout << std::fixed << std::setprecision(1)
+            << "CPU:" << 100 * cpu_s / wall_s << "%" << std::endl;
+  std::cout << "rx (FC -> OpenHD) " << rx_latencies.to_string() << std::endl;
+  std::cout << "tx (OpenHD -> FC) " << tx_latencies.to_string() << std::endl;
+  std::cout << "sendMessages() max:" << max_send_call_us << "us" << std::endl;
+  std::cout << io_stats.to_string() << std::endl;
+  bool ok = true;
+  ok &= check(rx_latencies.values_us.size() == n_rx_sent, "rx all received");
+  ok &= check(tx_latencies.values_us.size() + io_stats.n_buffers_dropped ==
+                  n_tx_sent,
+              "tx all received or dropped");
+  // The callers must never wait for the UART
+  ok &= check(max_send_call_us < 5000, "sendMessages() does not block");
+  std::cout << (ok ? "OK" : "FAILED") << std::endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,262 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../src/tlog/TLogRecorder.h"
+#include "openhd_test_helper.h"
+#include "openhd_util_filesystem.h"
+
+//
+// Records 2000 msgs/s (like a busy FC + parameter download) and validates
+// that every message ends up in the tlog files (in order, with rotation), that
+// the recorder stays below 1% CPU, that a killed writer loses at most the
+// last WRITE_INTERVAL of data (the zero tail of the preallocated file is cut
+// off on the next start) and that old files are removed.
+// 以 2000 条/秒记录消息，验证所有消息（按顺序、跨文件轮转）都写入 tlog，记录器 CPU 占用低于 1%，
+// 被杀死的写入进程最多丢失最后 WRITE_INTERVAL 的数据，并且旧文件会被删除。
+//
+// Usage: test_tlog_recorder [seconds]
+using namespace openhd_test_helper;
+
+namespace {
+
+constexpr auto DIRECTORY = "/tmp/openhd_tlog_test/";
+constexpr int MSGS_PER_S = 2000;
+constexpr int BATCHES_PER_S = 100;
+constexpr int MSGS_PER_BATCH = MSGS_PER_S / BATCHES_PER_S;
+
+// time_boot_ms is the index, each 10th message is a (bigger) param value.
+// Serialized up front, like the endpoints already did before they are recorded.
+std::vector<MavlinkMessage> create_messages(int n) {
+  std::vector<MavlinkMessage> messages(n);
+  for (int i = 0; i < n; i++) {
+    if (i % 10 == 0) {
+      const std::string param_id = "PARAM_" + std::to_string(i);
+      mavlink_msg_param_value_pack(1, MAV_COMP_ID_AUTOPILOT1, &messages[i].m,
+                                   param_id.c_str(), static_cast<float>(i),
+                                   MAV_PARAM_TYPE_REAL32, n, i);
+    } else {
+      mavlink_msg_attitude_pack(1, MAV_COMP_ID_AUTOPILOT1, &messages[i].m, i,
+                                0.1f, 0.2f, 0.3f, 0.0f, 0.0f, 0.0f);
+    }
+    (void)messages[i].wire_size();
+  }
+  return messages;
+}
+
+// Calls record() paced at MSGS_PER_S
+template <class F>
+void run_producer(const std::vector<MavlinkMessage>& messages, F record) {
+  const auto begin = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < messages.size(); i += MSGS_PER_BATCH) {
+    std::this_thread::sleep_until(
+        begin + std::chrono::microseconds(1000000LL * i / MSGS_PER_S));
+    const auto end = std::min(messages.size(), i + MSGS_PER_BATCH);
+    record(std::vector<MavlinkMessage>(messages.begin() + i,
+                                       messages.begin() + end));
+  }
+}
+
+std::vector<std::string> get_files(const std::string& prefix) {
+  std::vector<std::string> files;
+  for (const auto& filename :
+       OHDFilesystemUtil::getAllEntriesFilenameOnlyInDirectory(DIRECTORY)) {
+    if (filename.rfind(prefix, 0) == 0) files.push_back(DIRECTORY + filename);
+  }
+  // same second, then index
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+struct Record {
+  uint64_t timestamp_us;
+  std::vector<uint8_t> frame;
+};
+
+// Returns false if a file has trailing garbage / incomplete records
+bool read_tlogs(const std::vector<std::string>& files,
+                std::vector<Record>& records) {
+  for (const auto& file : files) {
+    std::ifstream in(file, std::ios::binary);
+    const std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)),
+                                    std::istreambuf_iterator<char>());
+    std::size_t pos = 0;
+    while (pos + 8 + 2 <= data.size()) {
+      uint64_t ts = 0;
+      for (int i = 0; i < 8; i++) ts = (ts << 8) | data[pos + i];
+      const uint8_t* frame = &data[pos + 8];
+      if (frame[0] != MAVLINK_STX) return false;
+      const std::size_t frame_len =
+          MAVLINK_NUM_HEADER_BYTES + frame[1] + MAVLINK_NUM_CHECKSUM_BYTES;
+      if (pos + 8 + frame_len > data.size()) return false;
+      records.push_back({ts, {frame, frame + frame_len}});
+      pos += 8 + frame_len;
+    }
+    if (pos != data.size()) return false;
+  }
+  return true;
+}
+
+bool matches(const std::vector<Record>& records,
+             const std::vector<MavlinkMessage>& messages) {
+  uint64_t last_ts = 0;
+  for (std::size_t i = 0; i < records.size(); i++) {
+    const auto& frame = records[i].frame;
+    const auto& msg = messages[i];
+    if (frame.size() != msg.wire_size() ||
+        std::memcmp(frame.data(), msg.wire_data(), frame.size()) != 0) {
+      std::cerr << "Record " << i << " differs" << std::endl;
+      return false;
+    }
+    if (records[i].timestamp_us < last_ts) {
+      std::cerr << "Record " << i << " timestamp goes back" << std::endl;
+      return false;
+    }
+    last_ts = records[i].timestamp_us;
+  }
+  return true;
+}
+
+// A recorder process is killed (like a crash - on power loss, additionally
+// the data since the last sync is lost), its file is recovered on the next start
+bool test_killed_writer() {
+  const auto messages = create_messages(MSGS_PER_S * 2);
+  int pipe_fds[2];
+  if (pipe(pipe_fds) != 0) return false;
+  const pid_t pid = fork();
+  if (pid == 0) {
+    close(pipe_fds[0]);
+    TLogRecorder recorder({DIRECTORY, "crash", 4 * 1024 * 1024, 10});
+    run_producer(messages, [&recorder, &pipe_fds](
+                               const std::vector<MavlinkMessage>& batch) {
+      recorder.record(batch);
+      const int n = static_cast<int>(batch.size());
+      if (write(pipe_fds[1], &n, sizeof(n)) != sizeof(n)) _exit(1);
+    });
+    // Never gets here
+    pause();
+    _exit(0);
+  }
+  close(pipe_fds[1]);
+  int n_recorded = 0;
+  int n;
+  while (n_recorded < MSGS_PER_S * 3 / 2 &&
+         read(pipe_fds[0], &n, sizeof(n)) == sizeof(n)) {
+    n_recorded += n;
+  }
+  kill(pid, SIGKILL);
+  waitpid(pid, nullptr, 0);
+  close(pipe_fds[0]);
+  const auto files = get_files("crash");
+  const bool preallocated =
+      files.size() == 1 &&
+      OHDFilesystemUtil::get_file_size_bytes(files[0]) == 4 * 1024 * 1024;
+  { TLogRecorder recorder({DIRECTORY, "crash", 4 * 1024 * 1024, 10}); }
+  std::vector<Record> records;
+  const bool valid = read_tlogs(get_files("crash"), records);
+  const int max_lost =
+      MSGS_PER_S * TLogRecorder::WRITE_INTERVAL.count() / 1000 +
+      2 * MSGS_PER_BATCH;
+  const bool ok = preallocated && valid && matches(records, messages) &&
+                  static_cast<int>(records.size()) >= n_recorded - max_lost;
+  std::cout << "killed writer: recorded:" << n_recorded
+            << " recovered:" << records.size() << " (max lost:" << max_lost
+            << ")" << (ok ? " OK" : " FAILED") << std::endl;
+  return ok;
+}
+
+bool test_load(int duration_s) {
+  const auto messages = create_messages(MSGS_PER_S * duration_s);
+  // Small files, to test rotation
+  constexpr std::size_t FILE_SIZE = 128 * 1024;
+  TLogRecorder::Stats stats;
+  const double cpu_begin = get_cpu_time_s();
+  const auto begin = std::chrono::steady_clock::now();
+  {
+    TLogRecorder recorder({DIRECTORY, "load", FILE_SIZE, 100});
+    run_producer(messages, [&recorder](const std::vector<MavlinkMessage>& batch) {
+      recorder.record(batch);
+    });
+    stats = recorder.get_stats();
+  }
+  const double wall_s =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - begin)
+          .count();
+  const double cpu_s = get_cpu_time_s() - cpu_begin;
+  // Same, without the recorder (producer wake ups / vector copies)
+  const double baseline_cpu_begin = get_cpu_time_s();
+  run_producer(messages, [](const std::vector<MavlinkMessage>&) {});
+  const double baseline_cpu_s = get_cpu_time_s() - baseline_cpu_begin;
+  const double cpu_percent = 100 * (cpu_s - baseline_cpu_s) / wall_s;
+  std::vector<Record> records;
+  const auto files = get_files("load");
+  const bool valid = read_tlogs(files, records);
+  const bool ok = valid && records.size() == messages.size() &&
+                  stats.n_dropped == 0 && files.size() >= 2 &&
+                  matches(records, messages) && cpu_percent < 1.0;
+  std::cout << std::fixed << std::setprecision(2) << "load: " << MSGS_PER_S
+            << " msgs/s recorded:" << stats.n_recorded
+            << " on disk:" << records.size() << " dropped:" << stats.n_dropped
+            << " files:" << files.size() << " CPU:" << cpu_percent << "%"
+            << (ok ? " OK" : " FAILED") << std::endl;
+  return ok;
+}
+
+bool test_remove_old_files() {
+  const auto messages = create_messages(10);
+  {
+    TLogRecorder recorder({DIRECTORY, "load", 128 * 1024, 2});
+    recorder.record(messages);
+  }
+  const auto n_files = get_files("load").size();
+  const bool ok = n_files == 2;
+  std::cout << "remove old files: " << n_files << (ok ? " OK" : " FAILED")
+            << std::endl;
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const int duration_s = argc > 1 ? std::max(2, std::atoi(argv[1])) : 5;
+  OHDFilesystemUtil::safe_delete_directory(DIRECTORY);
+  OHDFilesystemUtil::create_directories(DIRECTORY);
+  // fork before any other thread is running
+  bool ok = test_killed_writer();
+  ok &= test_load(duration_s);
+  ok &= test_remove_old_files();
+  OHDFilesystemUtil::safe_delete_directory(DIRECTORY);
+  std::cout << (ok ? "OK" : "FAILED") << std::endl;
+  return ok ? 0 : 1;
+}
@@ -32,6 +32,7 @@
 #include <vector>
 
 #include "openhd_spdlog.h"
+#include "openhd_video_frame.h"
 
 // TODO for some reason, I cannot make fucking appsrc work !
 // Dummy until this issue is resolved
@@ -39,7 +40,7 @@ class GstVideoRecorder {
  public:
   GstVideoRecorder();
   ~GstVideoRecorder();
-  void enqueue_rtp_fragment(std::shared_ptr<std::vector<uint8_t>> fragment);
+  void enqueue_rtp_fragment(std::shared_ptr<openhd::VideoFragment> fragment);
   void on_video_data(const uint8_t *data, int data_len);
   void start();
   void stop_and_cleanup();
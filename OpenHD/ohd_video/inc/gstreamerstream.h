@@ -27,6 +27,7 @@
 #include <gst/gst.h>
 
 #include <array>
+#include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <thread>
@@ -40,6 +41,7 @@
 // #include "gst_recorder.h"
 #include "nalu/CodecConfigFinder.hpp"
 #include "openhd_rtp.h"
+#include "rtp_frame_assembler.hpp"
 
 // Implementation of OHD CameraStream for pretty much everything, using
 // gstreamer.
@@ -82,6 +84,20 @@ class GStreamerStream : public CameraStream {
     // immediately to not block the param server
     // 为了减少参数回调的时间——它们需要立即返回，以避免阻塞参数服务器
     void request_restart();
+    // Wakes up the stream thread (restart / bitrate change / terminate)
+    // 唤醒流线程（重启 / 比特率变化 / 终止）
+    void notify_stream_thread();
+    // Blocks the stream thread until an event is signalled or the timeout
+    // elapsed
+    void wait_for_event(std::chrono::milliseconds timeout);
+
+   public:
+    // public due to c/c++ mix (appsink callbacks)
+    // Called for every sample pulled out of appsink, either from the gstreamer
+    // streaming thread (event driven mode) or from the stream thread (polling
+    // mode)
+    void on_appsink_sample(GstSample* sample);
+    GstFlowReturn on_appsink_new_sample_cb();
 
    private:
     // points to a running gst pipeline instance
@@ -117,17 +133,50 @@ class GStreamerStream : public CameraStream {
     std::atomic_bool m_keep_looping = false;
     std::unique_ptr<std::thread> m_loop_thread = nullptr;
 
+    // By default, appsink hands samples to us via the new-sample callback (on
+    // the gstreamer streaming thread) as soon as they are produced, and the
+    // stream thread only wakes up on events. The old approach (pulling with a
+    // 40ms timeout on the stream thread) can be enabled by creating
+    // appsink_poll.txt in the config directory.
+    // 默认情况下，appsink 通过 new-sample 回调（在 gstreamer 流线程上）在数据产生后立即交给我们，
+    // 流线程只在有事件时才被唤醒。旧的方式（在流线程上以 40ms 超时轮询）可以通过在配置目录中创建 appsink_poll.txt 启用。
+    bool m_use_appsink_polling = false;
+    std::mutex m_events_mutex;
+    std::condition_variable m_events_cv;
+    bool m_has_pending_event = false;
+    // Guards against the appsink callback running while the pipeline is torn
+    // down - uncontended during streaming
+    std::mutex m_appsink_cb_mutex;
+    bool m_appsink_cb_enabled = false;
+    std::atomic_bool m_has_first_frame = false;
+    std::atomic<std::chrono::steady_clock::time_point> m_last_camera_frame = std::chrono::steady_clock::now();
+
    private:
     // The stuff here is to pull the data out of the gstreamer pipeline, such that
     // we can forward it to the WB link
     // 这里的内容是为了从 GStreamer 管道中提取数据，以便
     // 我们可以将其转发到 WB 链接
-    void on_new_rtp_frame_fragment(std::shared_ptr<std::vector<uint8_t>> fragment, uint64_t dts);
-    void on_new_rtp_fragmented_frame();
-    std::vector<std::shared_ptr<std::vector<uint8_t>>> m_frame_fragments;
-
-    void x_on_new_rtp_fragmented_frame(std::vector<std::shared_ptr<std::vector<uint8_t>>> frame_fragments);
-    bool m_last_fu_s_idr = false;
+    void on_new_rtp_frame_fragment(std::shared_ptr<openhd::VideoFragment> fragment, std::optional<std::chrono::steady_clock::time_point> capture_time);
+    void on_new_rtp_fragmented_frame(std::vector<std::shared_ptr<openhd::VideoFragment>>& frame_fragments, bool is_idr_frame);
+    // Created with the pipeline, since the codec is known then
+    std::unique_ptr<openhd::AnyRTPFrameAssembler> m_frame_assembler;
+
+    void x_on_new_rtp_fragmented_frame(std::vector<std::shared_ptr<openhd::VideoFragment>> frame_fragments);
+    // Capture time of the frame currently being assembled, taken from its first
+    // fragment
+    // 当前正在组装的帧的采集时间，取自其第一个分片
+    std::optional<std::chrono::steady_clock::time_point> m_curr_frame_capture_time = std::nullopt;
+    // Sets the capture time on the frame, if known (the first fragment already
+    // carries it in-stream)
+    void add_capture_time(openhd::FragmentedVideoFrame& frame);
+    // Frames completed while processing a sample. They are handed to
+    // m_output_cb (the WB link) after m_appsink_cb_mutex has been released,
+    // such that teardown never waits for a transmit.
+    // 处理样本时完成的帧。在释放 m_appsink_cb_mutex 之后才交给 m_output_cb（WB 链路）
+    std::vector<openhd::FragmentedVideoFrame> m_pending_frames;
+    // Only used by the appsink callback (on the gstreamer streaming thread)
+    std::vector<openhd::FragmentedVideoFrame> m_frames_to_forward;
+    void forward_frames(std::vector<openhd::FragmentedVideoFrame>& frames);
     bool dirty_use_raw = false;
     std::chrono::steady_clock::time_point m_last_log_streaming_disabled = std::chrono::steady_clock::now();
 
@@ -26,6 +26,8 @@
 
 #include <unistd.h>
 
+#include "openhd_buffer_pool.h"
+
 static std::vector<std::shared_ptr<std::vector<uint8_t>>> make_fragments(
     const uint8_t* data, int data_len) {
   std::vector<std::shared_ptr<std::vector<uint8_t>>> fragments;
@@ -41,7 +43,7 @@ static std::vector<std::shared_ptr<std::vector<uint8_t>>> make_fragments(
       len = remaining;
     }
     std::shared_ptr<std::vector<uint8_t>> fragment =
-        std::make_shared<std::vector<uint8_t>>(p, p + len);
+        openhd::BufferPool::video()->get_buffer_and_copy(p, len);
     fragments.emplace_back(fragment);
     p = p + len;
     bytes_used += len;
@@ -26,6 +26,21 @@
 
 #include <unistd.h>
 
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+// Legacy byte-by-byte state machine, returns the size of the NAL at data[0]
+// (including its start code). Kept for reference / benchmarking, use
+// split_nal_units() for new code.
 static int find_next_nal(const uint8_t* data, int data_len) {
   int nalu_search_state = 0;
   for (int i = 0; i < data_len; i++) {
@@ -59,6 +74,97 @@ static int find_next_nal(const uint8_t* data, int data_len) {
   return data_len;
 }
 
+// Returns a pointer to the first 3 byte start code (0,0,1) in [p,end) or end if
+// there is none. Scalar fallback - on every 3rd byte we can decide if a start
+// code might overlap with it, so most of the data is skipped 3 bytes at a time.
+static const uint8_t* find_start_code_scalar(const uint8_t* p,
+                                             const uint8_t* end) {
+  if (end - p < 3) return end;
+  const uint8_t* last = end - 3;
+  while (p <= last) {
+    if (p[2] > 1) {
+      p += 3;
+    } else if (p[2] == 0) {
+      p += 1;
+    } else {
+      if (p[0] == 0 && p[1] == 0) return p;
+      p += 3;
+    }
+  }
+  return end;
+}
+
+// Same as find_start_code_scalar, but checks 16 bytes at a time (SSE2 / NEON).
+// Blocks without a zero byte can't contain the beginning of a start code and
+// are skipped with one compare.
+static const uint8_t* find_start_code(const uint8_t* p, const uint8_t* end) {
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi8(1);
+  // We read up to 2 bytes past the 16 byte block
+  while (end - p >= 18) {
+    const __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    const int zero_mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v0, zero));
+    if (zero_mask != 0) {
+      const __m128i v1 =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+      const __m128i v2 =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 2));
+      const int mask = zero_mask &
+                       _mm_movemask_epi8(_mm_cmpeq_epi8(v1, zero)) &
+                       _mm_movemask_epi8(_mm_cmpeq_epi8(v2, one));
+      if (mask != 0) return p + __builtin_ctz(mask);
+    }
+    p += 16;
+  }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  while (end - p >= 18) {
+    const uint8x16_t is_zero = vceqq_u8(vld1q_u8(p), vdupq_n_u8(0));
+#if defined(__aarch64__)
+    const bool has_zero = vmaxvq_u8(is_zero) != 0;
+#else
+    const uint8x8_t folded =
+        vorr_u8(vget_low_u8(is_zero), vget_high_u8(is_zero));
+    const bool has_zero =
+        vget_lane_u64(vreinterpret_u64_u8(folded), 0) != 0;
+#endif
+    if (has_zero) {
+      // Rare case, resolve the exact position within the block
+      const uint8_t* found = find_start_code_scalar(p, p + 18);
+      if (found < p + 16) return found;
+    }
+    p += 16;
+  }
+#endif
+  return find_start_code_scalar(p, end);
+}
+
+// A NAL unit inside a buffer, including its (3 or 4 byte) start code
+struct NalUnitSpan {
+  int offset;
+  int size;
+};
+
+// Splits an access unit (or any other Annex-B byte stream chunk) into its NAL
+// units in one pass. Each span begins with its start code (4 byte start codes
+// include the leading zero byte) and ends where the next one begins. Data
+// before the first start code is not a NAL unit and is skipped. Spans are
+// appended to out (clear it yourself if you re-use it).
+static void split_nal_units(const uint8_t* data, int data_len,
+                            std::vector<NalUnitSpan>& out) {
+  const uint8_t* end = data + data_len;
+  const uint8_t* sc = find_start_code(data, end);
+  while (sc != end) {
+    int begin = static_cast<int>(sc - data);
+    if (begin > 0 && data[begin - 1] == 0) begin--;
+    const uint8_t* next = find_start_code(sc + 3, end);
+    int next_begin = static_cast<int>(next - data);
+    if (next != end && data[next_begin - 1] == 0) next_begin--;
+    out.push_back({begin, next_begin - begin});
+    sc = next;
+  }
+}
+
 static std::array<uint8_t, 6> EXAMPLE_AUD = {0, 0, 0, 1, 9, 48};
 static std::shared_ptr<std::vector<uint8_t>> get_h264_aud() {
   return std::make_shared<std::vector<uint8_t>>(
@@ -24,9 +24,16 @@
 #ifndef OPENHD_OPENHD_OHD_VIDEO_INC_OHD_VIDEO_GROUND_H_
 #define OPENHD_OPENHD_OHD_VIDEO_INC_OHD_VIDEO_GROUND_H_
 
+#include <array>
+#include <chrono>
+#include <mutex>
+
 #include "openhd_external_device.h"
 #include "openhd_link.hpp"
 #include "openhd_udp.h"
+#include "openhd_video_latency.h"
+#include "rtp_jitter_buffer.h"
+#include "video_shm_writer.h"
 
 // The ground just stupidly forwards video (rtp fragments, to be exact) via UDP
 // for QOpenHD and/or more device(s) to decode and display.
@@ -56,6 +63,13 @@ class OHDVideoGround {
   std::unique_ptr<openhd::UDPMultiForwarder> m_primary_video_forwarder;
   std::unique_ptr<openhd::UDPMultiForwarder> m_secondary_video_forwarder;
   std::unique_ptr<openhd::UDPMultiForwarder> m_audio_forwarder;
+  // Optional (see NW_VIDEO_SHM_OUTPUT) shared memory output for local
+  // consumers, per stream. If enabled, video to localhost 5600 / 5601 goes
+  // through m_localhost_video_forwarders and is only sent while no local app
+  // reads the shm.
+  std::array<std::unique_ptr<openhd::VideoShmWriter>, 2> m_shm_writers;
+  std::array<std::unique_ptr<openhd::UDPMultiForwarder>, 2>
+      m_localhost_video_forwarders;
   /**
    * Forward video to all device(s) consuming video.
    * Called by the ohd link handle (aka only wb right now)
@@ -63,6 +77,40 @@ class OHDVideoGround {
    * @param data and @param data_len: r.n always a full rtp frame fragment
    */
   void on_video_data(int stream_index, const uint8_t* data, int data_len);
+  // Forward to all video consumers (UDP, shm). Fragments from the link are
+  // forwarded one by one as they come in (no added latency), one sendmmsg
+  // covering all destinations per fragment. What the jitter buffer releases at
+  // once is forwarded as a batch.
+  // 转发到所有视频消费者（UDP、共享内存）。来自链路的分片到达即逐个转发（不增加延迟），
+  // 每个分片一次 sendmmsg 覆盖所有目标；抖动缓冲一次释放的分片成批转发。
+  void forward_video(int stream_index, const openhd::UDPPacketRef* packets,
+                     std::size_t n_packets);
+  // Only used by the jitter buffer out cb (never called concurrently)
+  std::array<std::vector<openhd::UDPPacketRef>, 2> m_video_refs;
+  // The shm writer is single producer, but the jitter buffer forwards from its
+  // timer thread, too
+  std::array<std::mutex, 2> m_shm_mutex;
+  // rtp timestamp of the written but not yet published frame, per stream
+  std::array<uint32_t, 2> m_shm_frame_timestamp{};
+  // Writes to the shm ring, publishes once per frame (on the rtp marker bit,
+  // or once the next frame starts if the last fragment got lost)
+  // 写入共享内存环形缓冲，每帧发布一次（在 rtp marker 位，或最后一个分片丢失时在下一帧开始时）
+  void write_shm(int stream_index, const openhd::UDPPacketRef* packets,
+                 std::size_t n_packets);
+  // Optional (see NW_VIDEO_JITTER_BUFFER_MS), per stream. The stats are
+  // logged periodically.
+  std::array<std::unique_ptr<openhd::RTPJitterBuffer>, 2> m_jitter_buffers;
+  std::array<std::chrono::steady_clock::time_point, 2>
+      m_jitter_buffer_log_time{};
+  void on_jitter_buffer_fragments(
+      int stream_index,
+      std::vector<std::shared_ptr<std::vector<uint8_t>>>& fragments);
+  // If the fragment carries the capture time of its frame, measure the capture
+  // (air) to arrival (ground) latency. The percentiles are logged periodically.
+  void measure_capture_latency(int stream_index, const uint8_t* data,
+                               int data_len);
+  openhd::VideoLatencyTracker m_latency_tracker;
+  std::array<std::chrono::steady_clock::time_point, 2> m_latency_log_time{};
 
   /**
    * Forward audio. We only have up to 1 audio stream
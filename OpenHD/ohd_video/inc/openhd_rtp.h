@@ -24,13 +24,23 @@
 #ifndef OPENHD_OPENHD_RTP_H
 #define OPENHD_OPENHD_RTP_H
 
+#include <optional>
+
 #include "nalu/CodecConfigFinder.hpp"
+#include "nalu/nalu_helper.h"
 #include "openhd_link.hpp"
 #include "openhd_spdlog.h"
 #include "rtp-payload-internal.h"
+#include "rtp_frame_assembler.hpp"
 
 namespace openhd {
 
+// Max size of the rtp packets handed to the link, for both packetization paths
+// below. The packetizers leave room for the capture time extension (see
+// rtp_capture_time), such that the tagged first fragment of a frame still fits.
+// 交给链路的 RTP 包最大尺寸。打包器为采集时间扩展预留空间，使带扩展的第一个分片仍不超过此值。
+static constexpr int RTP_MAX_PACKET_SIZE = 1440;
+
 /**
  * Due to legacy reasons, we have 2 cases:
  * 1) We use gstreamer for rtp encoding - in this case, we get rtp fragments out
@@ -44,11 +54,31 @@ namespace openhd {
  */
 class RTPHelper {
  public:
-  explicit RTPHelper(bool is_h265);
+  /**
+   * Each instance owns its packetization memory (a buffer pool of rtp MTU
+   * sized buffers) - lib rtp writes the fragments directly into those buffers,
+   * which are then handed out as VideoFragments without another copy.
+   * Therefore, multiple instances (e.g. one per camera) can packetize
+   * concurrently on different threads.
+   * The pool is sized from the expected max frame size, which is estimated from
+   * the given resolution / framerate / bitrate (0 if unknown).
+   * 每个实例拥有自己的打包内存（RTP MTU 大小的缓冲池）- lib rtp 直接把分片写入这些缓冲区，
+   * 然后无需再次拷贝即可作为 VideoFragment 交出。因此多个实例（例如每个摄像头一个）可以在不同线程上并发打包。
+   */
+  explicit RTPHelper(bool is_h265, int width = 0, int height = 0,
+                     int framerate = 0, int bitrate_kbits = 0);
   ~RTPHelper();
+  RTPHelper(const RTPHelper&) = delete;
+  RTPHelper& operator=(const RTPHelper&) = delete;
+
+  // N of rtp packetization buffers needed to keep ~2 worst case (key) frames
+  // in flight (one being packetized, one queued in the link)
+  static int calculate_n_arena_buffers(int width, int height, int framerate,
+                                       int bitrate_kbits, int rtp_mtu);
+  BufferPool::Stats get_arena_stats() const { return m_arena->get_stats(); }
 
   typedef std::function<void(
-      std::vector<std::shared_ptr<std::vector<uint8_t>>> frame_fragments)>
+      std::vector<std::shared_ptr<openhd::VideoFragment>> frame_fragments)>
       OUT_CB;
   void set_out_cb(RTPHelper::OUT_CB cb);
 
@@ -59,10 +89,17 @@ class RTPHelper {
   // Feeds exactly one NALU
   void feed_nalu(const uint8_t* data, int data_len);
 
+  // Capture time of the NALU(s) fed next (air unit steady clock, us). If set,
+  // the first fragment of each packetized frame carries it as rtp header
+  // extension, written in place into the room reserved in the arena buffer.
+  void set_capture_time(std::optional<int64_t> capture_time_us);
+
  public:
   // public due to c/c++ mix (callbacks)
   void on_new_rtp_fragment(const uint8_t* nalu, int bytes, uint32_t timestamp,
                            int last);
+  void* on_rtp_alloc(int bytes);
+  void on_rtp_free(void* packet);
 
  private:
   void on_new_split_nalu(const uint8_t* data, int data_len);
@@ -72,33 +109,65 @@ class RTPHelper {
   rtp_payload_t m_handler{};
   void* encoder;
   std::shared_ptr<spdlog::logger> m_console;
-  std::vector<std::shared_ptr<std::vector<uint8_t>>> m_frame_fragments;
+  std::vector<std::shared_ptr<openhd::VideoFragment>> m_frame_fragments;
+  // Packetization arena - lib rtp allocates exactly one packet at a time
+  // (alloc - packet - free), which is written into m_curr_packet_buffer
+  std::shared_ptr<BufferPool> m_arena;
+  std::vector<uint8_t>* m_curr_packet_buffer = nullptr;
+  std::optional<int64_t> m_capture_time_us = std::nullopt;
   CodecConfigFinder m_config_finder;
+  // re-used to not allocate on every access unit
+  std::vector<NalUnitSpan> m_nal_spans;
   std::chrono::steady_clock::time_point m_last_codec_config_send_ts =
       std::chrono::steady_clock::now();
 };
 
 class RTPFragmentBuffer {
  public:
-  explicit RTPFragmentBuffer();
-  void buffer_and_forward(std::shared_ptr<std::vector<uint8_t>> fragment,
-                          uint64_t dts);
+  explicit RTPFragmentBuffer(bool is_h265);
+  void buffer_and_forward(std::shared_ptr<openhd::VideoFragment> fragment);
+  // Called with each complete (fragmented) frame
+  void set_out_cb(openhd::ON_ENCODE_FRAME_CB cb);
 
  public:
   bool m_enable_ultra_secure_encryption = false;
-  bool m_is_h265 = false;
   bool m_uses_intra_refresh = false;
   int m_stream_index = 0;
 
  private:
-  void on_new_rtp_fragmented_frame();
+  void on_new_rtp_fragmented_frame(
+      std::vector<std::shared_ptr<openhd::VideoFragment>>& frame_fragments,
+      bool is_idr_frame);
 
  private:
   std::shared_ptr<spdlog::logger> m_console;
-  bool m_last_fu_s_idr = false;
-  std::vector<std::shared_ptr<std::vector<uint8_t>>> m_frame_fragments;
+  AnyRTPFrameAssembler m_frame_assembler;
+  openhd::ON_ENCODE_FRAME_CB m_out_cb = nullptr;
 };
 
+/**
+ * The capture time of a frame is sent to the ground in-stream, as a RTP header
+ * extension (RFC 8285, one-byte header) on the first fragment of the frame.
+ * The value is the air unit steady clock in us (8 bytes, big endian) - the
+ * ground maps it to its own clock using the TIMESYNC offset. Receivers that
+ * don't know about the extension (e.g. the decoder in QOpenHD) just skip it.
+ * 帧的采集时间作为 RTP 头扩展（RFC 8285，单字节头）随帧的第一个分片发送到地面。
+ */
+namespace rtp_capture_time {
+
+static constexpr uint8_t EXTENSION_ID = 7;
+// 4 bytes extension header, 1 byte element header, 8 bytes value, 3 bytes pad
+static constexpr int EXTENSION_SIZE = 16;
+// Adds the extension in place, the packet grows by EXTENSION_SIZE (within the
+// capacity the packetizer reserved, no allocation). Returns false (and leaves
+// the packet untouched) if the packet is not a valid rtp packet or already has
+// a header extension.
+bool add_extension(std::vector<uint8_t>& packet, int64_t capture_time_us);
+// Returns the capture time if the given rtp packet carries the extension
+std::optional<int64_t> get_extension(const uint8_t* data, int data_len);
+
+}  // namespace rtp_capture_time
+
 }  // namespace openhd
 
 #endif  // OPENHD_OPENHD_RTP_H
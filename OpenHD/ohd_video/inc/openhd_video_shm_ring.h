@@ -0,0 +1,287 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#ifndef OPENHD_VIDEO_SHM_RING_H_
+#define OPENHD_VIDEO_SHM_RING_H_
+
+/**
+ * Shared memory video output of the OpenHD ground unit - for local consumers
+ * (e.g. QOpenHD, a WebRTC bridge) as an alternative to the UDP forwarding to
+ * 127.0.0.1:5600 / 5601. Self-contained C header (linux only, no OpenHD
+ * dependencies), copy it into your project.
+ *
+ * One POSIX shm object per video stream (OHD_VIDEO_SHM_NAME_PRIMARY /
+ * SECONDARY), one writer (OpenHD), any number of readers. The writer never
+ * waits for readers - a reader that is too slow gets overrun and re-syncs to
+ * the newest data (returns OHD_VIDEO_SHM_OVERRUN once).
+ * Each record is one rtp packet (exactly what would have been sent via UDP),
+ * records are published per frame (or burst), OHD_VIDEO_SHM_FLAG_FRAME_END is
+ * set on the last packet of a frame. Readers sleep on a futex in the shared
+ * header, the writer only wakes if there is a waiting reader.
+ *
+ * Zero copy usage:
+ *   ohd_video_shm_reader reader;
+ *   if (ohd_video_shm_reader_open(&reader, OHD_VIDEO_SHM_NAME_PRIMARY) != 0) {
+ *     // OpenHD not running / shm output disabled - use UDP 5600
+ *   }
+ *   for (;;) {
+ *     const uint8_t* data; uint32_t len, flags;
+ *     int r = ohd_video_shm_reader_next(&reader, &data, &len, &flags);
+ *     if (r == OHD_VIDEO_SHM_NONE) { ohd_video_shm_reader_wait(&reader, 100); continue; }
+ *     if (r == OHD_VIDEO_SHM_OVERRUN) continue;  // packets were lost
+ *     // ... consume data (or copy it) ...
+ *     if (!ohd_video_shm_reader_valid(&reader)) { ...  data was overwritten while reading }
+ *   }
+ *
+ * OpenHD 地面端的共享内存视频输出 - 供本地使用者（例如 QOpenHD、WebRTC 桥接）使用，
+ * 用于替代转发到 127.0.0.1:5600 / 5601 的 UDP。独立的 C 头文件（仅限 linux，无 OpenHD 依赖）。
+ * 每个视频流一个 POSIX shm 对象，一个写入者（OpenHD），任意数量的读取者。写入者从不等待读取者 -
+ * 太慢的读取者会被覆盖，并重新同步到最新的数据。
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define OHD_VIDEO_SHM_NAME_PRIMARY "/openhd_video_0"
+#define OHD_VIDEO_SHM_NAME_SECONDARY "/openhd_video_1"
+
+#define OHD_VIDEO_SHM_MAGIC 0x4F484456u /* "OHDV" */
+#define OHD_VIDEO_SHM_VERSION 1u
+
+/* record flags */
+#define OHD_VIDEO_SHM_FLAG_FRAME_END 0x01u
+/* internal - skip to the begin of the ring */
+#define OHD_VIDEO_SHM_FLAG_WRAP 0x80000000u
+
+/* return values of ohd_video_shm_reader_next */
+#define OHD_VIDEO_SHM_NONE 0
+#define OHD_VIDEO_SHM_PACKET 1
+#define OHD_VIDEO_SHM_OVERRUN (-1)
+
+struct ohd_video_shm_header {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t capacity; /* size of the data region (after this header), bytes */
+  uint32_t writer_pid;
+  uint32_t header_size;
+  /* all positions are absolute (not wrapped) byte offsets, position % capacity
+   * is the offset into the data region */
+  /* the writer might be touching data up to here (seqlock for zero copy) */
+  uint64_t reserve_pos __attribute__((aligned(64)));
+  /* published, readers may read up to here */
+  uint64_t write_pos __attribute__((aligned(64)));
+  /* incremented on each publish, readers wait on it */
+  uint32_t futex_seq __attribute__((aligned(64)));
+  uint32_t n_waiters;
+  /* CLOCK_MONOTONIC ms of the last reader activity - lets the writer know
+   * whether somebody is reading */
+  uint64_t reader_heartbeat_ms __attribute__((aligned(64)));
+} __attribute__((aligned(64)));
+
+struct ohd_video_shm_record {
+  uint32_t size; /* payload bytes, payload follows, padded to 8 bytes */
+  uint32_t flags;
+  uint64_t write_time_us; /* CLOCK_MONOTONIC, for latency measurements */
+};
+
+static inline uint64_t ohd_video_shm_align(uint64_t size) {
+  return (size + 7u) & ~(uint64_t)7u;
+}
+
+static inline uint64_t ohd_video_shm_clock_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+/* Records never wrap - if there is no space for a record header left before
+ * the end of the ring, the next record starts at the begin */
+static inline uint64_t ohd_video_shm_skip_tail(uint64_t pos, uint64_t capacity) {
+  const uint64_t left = capacity - pos % capacity;
+  return left < sizeof(struct ohd_video_shm_record) ? pos + left : pos;
+}
+
+typedef struct {
+  int fd;
+  void* map;
+  size_t map_size;
+  struct ohd_video_shm_header* header;
+  uint8_t* data;
+  uint64_t read_pos;
+  /* start of the last record returned by next() */
+  uint64_t curr_record_pos;
+  uint32_t futex_seq;
+  uint64_t n_overruns;
+  /* last value written to header->reader_heartbeat_ms */
+  uint64_t heartbeat_ms;
+} ohd_video_shm_reader;
+
+/* @return 0 on success, -errno otherwise */
+static inline int ohd_video_shm_reader_open(ohd_video_shm_reader* r,
+                                            const char* name) {
+  struct stat st;
+  struct ohd_video_shm_header* header;
+  memset(r, 0, sizeof(*r));
+  r->fd = shm_open(name, O_RDWR, 0);
+  if (r->fd < 0) return -errno;
+  if (fstat(r->fd, &st) != 0 ||
+      (size_t)st.st_size < sizeof(struct ohd_video_shm_header)) {
+    close(r->fd);
+    return -EINVAL;
+  }
+  /* read / write - the futex word and the heartbeat are written by readers */
+  r->map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                r->fd, 0);
+  if (r->map == MAP_FAILED) {
+    const int err = errno;
+    close(r->fd);
+    return -err;
+  }
+  r->map_size = (size_t)st.st_size;
+  header = (struct ohd_video_shm_header*)r->map;
+  if (header->magic != OHD_VIDEO_SHM_MAGIC ||
+      header->version != OHD_VIDEO_SHM_VERSION ||
+      header->header_size + header->capacity > r->map_size) {
+    munmap(r->map, r->map_size);
+    close(r->fd);
+    return -EPROTO;
+  }
+  r->header = header;
+  r->data = (uint8_t*)r->map + header->header_size;
+  /* start with the newest data */
+  r->read_pos = __atomic_load_n(&header->write_pos, __ATOMIC_ACQUIRE);
+  r->futex_seq = __atomic_load_n(&header->futex_seq, __ATOMIC_ACQUIRE);
+  return 0;
+}
+
+static inline void ohd_video_shm_reader_close(ohd_video_shm_reader* r) {
+  if (r->map) munmap(r->map, r->map_size);
+  if (r->fd > 0) close(r->fd);
+  memset(r, 0, sizeof(*r));
+}
+
+/* True if the data between pos and the end of the ring was not overwritten */
+static inline int ohd_video_shm_reader_pos_valid(ohd_video_shm_reader* r,
+                                                 uint64_t pos) {
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&r->header->reserve_pos, __ATOMIC_RELAXED) - pos <=
+         r->header->capacity;
+}
+
+/* Tells the writer this reader is alive - the shared cache line is only
+ * written once per ms */
+static inline void ohd_video_shm_reader_heartbeat(ohd_video_shm_reader* r) {
+  const uint64_t now_ms = ohd_video_shm_clock_us() / 1000u;
+  if (now_ms == r->heartbeat_ms) return;
+  r->heartbeat_ms = now_ms;
+  __atomic_store_n(&r->header->reader_heartbeat_ms, now_ms, __ATOMIC_RELAXED);
+}
+
+/* @return OHD_VIDEO_SHM_PACKET (data, len, flags are set and valid until the
+ * next call), OHD_VIDEO_SHM_NONE or OHD_VIDEO_SHM_OVERRUN */
+static inline int ohd_video_shm_reader_next(ohd_video_shm_reader* r,
+                                            const uint8_t** data,
+                                            uint32_t* len, uint32_t* flags) {
+  const uint64_t capacity = r->header->capacity;
+  const uint64_t write_pos =
+      __atomic_load_n(&r->header->write_pos, __ATOMIC_ACQUIRE);
+  /* a reader that is never idle does not call wait() */
+  ohd_video_shm_reader_heartbeat(r);
+  for (;;) {
+    const struct ohd_video_shm_record* record;
+    uint32_t record_size, record_flags;
+    r->read_pos = ohd_video_shm_skip_tail(r->read_pos, capacity);
+    if (r->read_pos >= write_pos) return OHD_VIDEO_SHM_NONE;
+    if (!ohd_video_shm_reader_pos_valid(r, r->read_pos)) {
+      r->read_pos = write_pos;
+      r->n_overruns++;
+      return OHD_VIDEO_SHM_OVERRUN;
+    }
+    record = (const struct ohd_video_shm_record*)(r->data +
+                                                  r->read_pos % capacity);
+    record_size = record->size;
+    record_flags = record->flags;
+    if (!ohd_video_shm_reader_pos_valid(r, r->read_pos)) continue;
+    if (record_flags & OHD_VIDEO_SHM_FLAG_WRAP) {
+      r->read_pos += capacity - r->read_pos % capacity;
+      continue;
+    }
+    r->curr_record_pos = r->read_pos;
+    r->read_pos += sizeof(struct ohd_video_shm_record) +
+                   ohd_video_shm_align(record_size);
+    *data = (const uint8_t*)(record + 1);
+    *len = record_size;
+    *flags = record_flags;
+    return OHD_VIDEO_SHM_PACKET;
+  }
+}
+
+/* Call after consuming the data returned by next() without copying it - if 0,
+ * the writer overwrote it in the meantime, drop what was read */
+static inline int ohd_video_shm_reader_valid(ohd_video_shm_reader* r) {
+  return ohd_video_shm_reader_pos_valid(r, r->curr_record_pos);
+}
+
+/* Sleeps until the writer published new data or timeout_ms elapsed
+ * @return 1 if there might be new data, 0 on timeout */
+static inline int ohd_video_shm_reader_wait(ohd_video_shm_reader* r,
+                                            int timeout_ms) {
+  struct timespec timeout;
+  uint32_t seq;
+  int ret;
+  ohd_video_shm_reader_heartbeat(r);
+  seq = __atomic_load_n(&r->header->futex_seq, __ATOMIC_ACQUIRE);
+  if (seq != r->futex_seq) {
+    r->futex_seq = seq;
+    return 1;
+  }
+  timeout.tv_sec = timeout_ms / 1000;
+  timeout.tv_nsec = (long)(timeout_ms % 1000) * 1000000L;
+  __atomic_fetch_add(&r->header->n_waiters, 1, __ATOMIC_SEQ_CST);
+  /* not FUTEX_PRIVATE_FLAG - shared between processes */
+  ret = (int)syscall(SYS_futex, &r->header->futex_seq, FUTEX_WAIT, seq,
+                     &timeout, NULL, 0);
+  __atomic_fetch_sub(&r->header->n_waiters, 1, __ATOMIC_SEQ_CST);
+  r->futex_seq = __atomic_load_n(&r->header->futex_seq, __ATOMIC_ACQUIRE);
+  return ret == 0 || errno != ETIMEDOUT;
+}
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* OPENHD_VIDEO_SHM_RING_H_ */
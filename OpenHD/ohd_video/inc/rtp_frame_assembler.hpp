@@ -0,0 +1,234 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#ifndef OPENHD_OPENHD_OHD_VIDEO_INC_RTP_FRAME_ASSEMBLER_HPP_
+#define OPENHD_OPENHD_OHD_VIDEO_INC_RTP_FRAME_ASSEMBLER_HPP_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "camera_enums.hpp"
+#include "openhd_video_frame.h"
+
+namespace openhd {
+
+/**
+ * Everything the frame assembler needs to know about a h264 / h265 rtp packet,
+ * parsed in one go (rtp header, then payload header / FU header).
+ * 帧组装器需要了解的关于 h264 / h265 rtp 包的所有信息，一次解析完成。
+ */
+struct RTPPacketInfo {
+  bool valid = false;
+  // rtp marker bit - set by (most) packetizers on the last packet of a frame
+  bool marker = false;
+  bool is_fu_start = false;
+  bool is_fu_end = false;
+  // type of the (reconstructed) NAL unit, set for single NAL unit packets and
+  // FU start packets, -1 otherwise
+  int nal_unit_type = -1;
+};
+
+template <VideoCodec CODEC>
+struct RTPCodecTraits;
+
+template <>
+struct RTPCodecTraits<VideoCodec::H264> {
+  static constexpr int PAYLOAD_HEADER_SIZE = 1;
+  static constexpr int FU_TYPE = 28;  // FU-A
+  static int nal_unit_type(const uint8_t* payload) { return payload[0] & 0x1f; }
+  static int fu_nal_unit_type(const uint8_t* fu_header) {
+    return fu_header[0] & 0x1f;
+  }
+  static bool is_idr(int nal_unit_type) { return nal_unit_type == 5; }
+};
+
+template <>
+struct RTPCodecTraits<VideoCodec::H265> {
+  static constexpr int PAYLOAD_HEADER_SIZE = 2;
+  static constexpr int FU_TYPE = 49;
+  static int nal_unit_type(const uint8_t* payload) {
+    return (payload[0] >> 1) & 0x3f;
+  }
+  static int fu_nal_unit_type(const uint8_t* fu_header) {
+    return fu_header[0] & 0x3f;
+  }
+  // IDR_W_RADL, IDR_N_LP
+  static bool is_idr(int nal_unit_type) {
+    return nal_unit_type == 19 || nal_unit_type == 20;
+  }
+};
+
+template <VideoCodec CODEC>
+static RTPPacketInfo parse_rtp_packet(const uint8_t* data, std::size_t data_len) {
+  using Traits = RTPCodecTraits<CODEC>;
+  RTPPacketInfo ret{};
+  if (data_len < 12 || (data[0] & 0xC0) != 0x80) {
+    return ret;
+  }
+  std::size_t header_size = 12;
+  if (__builtin_expect(data[0] & 0x1f, 0)) {
+    // CSRC(s) and / or header extension (length in 32 bit words)
+    header_size += (data[0] & 0x0f) * 4;
+    if (data[0] & 0x10) {
+      if (data_len < header_size + 4) return ret;
+      header_size +=
+          4 + ((data[header_size + 2] << 8) | data[header_size + 3]) * 4;
+    }
+  }
+  if (data_len < header_size + Traits::PAYLOAD_HEADER_SIZE) {
+    return ret;
+  }
+  ret.marker = (data[1] & 0x80) != 0;
+  const uint8_t* payload = data + header_size;
+  const int type = Traits::nal_unit_type(payload);
+  if (type == Traits::FU_TYPE) {
+    if (data_len < header_size + Traits::PAYLOAD_HEADER_SIZE + 1) {
+      return ret;
+    }
+    const uint8_t* fu_header = payload + Traits::PAYLOAD_HEADER_SIZE;
+    ret.is_fu_start = (fu_header[0] & 0x80) != 0;
+    ret.is_fu_end = (fu_header[0] & 0x40) != 0;
+    if (ret.is_fu_start) {
+      ret.nal_unit_type = Traits::fu_nal_unit_type(fu_header);
+    }
+  } else {
+    ret.nal_unit_type = type;
+  }
+  ret.valid = true;
+  return ret;
+}
+
+/**
+ * Aggregates rtp fragments (h264 / h265, codec known at compile time) into
+ * frames. A frame is complete on the end of a fragmentation unit (FU-E) or if
+ * the rtp marker bit is set, whatever comes first. Each packet is parsed once.
+ * Used by GStreamerStream (rtp out of appsink) and RTPFragmentBuffer.
+ * 将 rtp 分片（h264 / h265，编解码器在编译期确定）聚合为帧。
+ * 分片单元结束（FU-E）或 rtp marker 位被设置时，帧即完成。每个包只解析一次。
+ */
+template <VideoCodec CODEC>
+class RTPFrameAssembler {
+ public:
+  using Traits = RTPCodecTraits<CODEC>;
+  // Called with the fragments of each complete frame
+  typedef std::function<void(
+      std::vector<std::shared_ptr<VideoFragment>>& frame_fragments,
+      bool is_idr_frame)>
+      OUT_CB;
+  // Protects against a missing end of frame (e.g. corrupted stream)
+  static constexpr std::size_t MAX_N_FRAGMENTS_PER_FRAME = 500;
+
+  explicit RTPFrameAssembler(OUT_CB out_cb) : m_out_cb(std::move(out_cb)) {
+    m_frame_fragments.reserve(MAX_N_FRAGMENTS_PER_FRAME);
+  }
+  void add_fragment(const std::shared_ptr<VideoFragment>& fragment) {
+    const auto info =
+        parse_rtp_packet<CODEC>(fragment->data(), fragment->size());
+    m_frame_fragments.push_back(fragment);
+    if (info.nal_unit_type >= 0 && Traits::is_idr(info.nal_unit_type)) {
+      m_curr_frame_is_idr = true;
+    }
+    if (info.marker || info.is_fu_end ||
+        m_frame_fragments.size() >= MAX_N_FRAGMENTS_PER_FRAME) {
+      forward_frame();
+    }
+  }
+  // True if the next fragment is the first fragment of a new frame
+  bool empty() const { return m_frame_fragments.empty(); }
+  // True if the given (already complete) frame contains an IDR slice
+  static bool contains_idr(
+      const std::vector<std::shared_ptr<VideoFragment>>& frame_fragments) {
+    for (const auto& fragment : frame_fragments) {
+      const auto info =
+          parse_rtp_packet<CODEC>(fragment->data(), fragment->size());
+      if (info.nal_unit_type >= 0 && Traits::is_idr(info.nal_unit_type)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+ private:
+  // Once per frame, keep it out of the per fragment path
+  __attribute__((noinline)) void forward_frame() {
+    m_out_cb(m_frame_fragments, m_curr_frame_is_idr);
+    m_frame_fragments.clear();
+    m_curr_frame_is_idr = false;
+  }
+  const OUT_CB m_out_cb;
+  std::vector<std::shared_ptr<VideoFragment>> m_frame_fragments;
+  bool m_curr_frame_is_idr = false;
+};
+
+/**
+ * For call sites that only know the codec at run time (e.g. when the pipeline
+ * is (re-)created) - the codec is resolved once on construction, not per
+ * fragment.
+ * 用于只在运行时才知道编解码器的地方（例如（重新）创建管道时）- 编解码器在构造时确定一次，而不是每个分片都判断。
+ */
+class AnyRTPFrameAssembler {
+ public:
+  using OUT_CB = RTPFrameAssembler<VideoCodec::H264>::OUT_CB;
+  AnyRTPFrameAssembler(VideoCodec codec, OUT_CB out_cb)
+      : m_assembler(create(codec, std::move(out_cb))) {}
+  void add_fragment(const std::shared_ptr<VideoFragment>& fragment) {
+    // cheaper than std::visit (no valueless_by_exception check)
+    if (auto* h264 = std::get_if<0>(&m_assembler)) {
+      h264->add_fragment(fragment);
+    } else {
+      std::get_if<1>(&m_assembler)->add_fragment(fragment);
+    }
+  }
+  bool empty() const {
+    return std::visit([](const auto& assembler) { return assembler.empty(); },
+                      m_assembler);
+  }
+  bool contains_idr(const std::vector<std::shared_ptr<VideoFragment>>&
+                        frame_fragments) const {
+    return std::visit(
+        [&frame_fragments](const auto& assembler) {
+          return std::decay_t<decltype(assembler)>::contains_idr(
+              frame_fragments);
+        },
+        m_assembler);
+  }
+
+ private:
+  using Variant = std::variant<RTPFrameAssembler<VideoCodec::H264>,
+                               RTPFrameAssembler<VideoCodec::H265>>;
+  static Variant create(VideoCodec codec, OUT_CB out_cb) {
+    if (codec == VideoCodec::H265) {
+      return Variant{std::in_place_index<1>, std::move(out_cb)};
+    }
+    return Variant{std::in_place_index<0>, std::move(out_cb)};
+  }
+  Variant m_assembler;
+};
+
+}  // namespace openhd
+
+#endif  // OPENHD_OPENHD_OHD_VIDEO_INC_RTP_FRAME_ASSEMBLER_HPP_
@@ -0,0 +1,130 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#ifndef OPENHD_OPENHD_OHD_VIDEO_INC_RTP_JITTER_BUFFER_H_
+#define OPENHD_OPENHD_OHD_VIDEO_INC_RTP_JITTER_BUFFER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct rtp_demuxer_t;
+
+namespace openhd {
+
+/**
+ * Optional ground stage between the link and the video forwarding - a bounded
+ * rtp jitter / reorder buffer (librtp rtp_demuxer). Packets are handed out in
+ * sequence number order, a missing packet is waited for at most jitter_ms.
+ * jitter_ms 0 is a pass through (no added latency, stats only).
+ * With whole frames enabled, all fragments of a frame are handed out at once
+ * (on the rtp marker bit, once the next frame starts if the last fragment got
+ * lost, or after FRAME_TIMEOUT_MS without input if the stream stopped).
+ * Fragments of an already handed out frame are dropped then.
+ * Input is called from the link rx thread. With jitter_ms > 0 or whole frames,
+ * a timer thread releases the packets after a gap once jitter_ms expired and
+ * flushes an unfinished whole frame, even if no more packets come in - the out
+ * cb is called from either thread, but never concurrently.
+ * The demuxer copies each packet once into a video buffer pool buffer, which is
+ * handed out as is.
+ * 链路与视频转发之间的可选地面处理阶段 - 有界的 rtp 抖动 / 重排序缓冲（librtp rtp_demuxer）。
+ * 按序列号顺序输出数据包，最多等待 jitter_ms 来接收缺失的包。jitter_ms 为 0 时直接透传（只统计）。
+ * 启用整帧输出时，一帧的所有分片一次性输出（流中断时最多等待 FRAME_TIMEOUT_MS），已输出帧的迟到分片被丢弃。
+ * jitter_ms > 0 或启用整帧输出时，定时器线程在等待超时后释放缺口之后的包（即使没有新的包到达），
+ * 输出回调可能来自任一线程，但不会并发调用。
+ */
+class RTPJitterBuffer {
+ public:
+  // In order rtp fragments, a whole frame if whole frames are enabled
+  typedef std::function<void(
+      std::vector<std::shared_ptr<std::vector<uint8_t>>>& fragments)>
+      OUT_CB;
+  // Counters since the stream started
+  struct Stats {
+    int stream_index = 0;
+    int jitter_ms = 0;
+    uint32_t count_lost = 0;  // not received within the jitter
+    uint32_t count_late = 0;  // received after the packets after it
+    uint32_t count_misordered = 0;
+    uint32_t count_duplicate = 0;
+    uint32_t count_frames = 0;
+    uint32_t count_frames_incomplete = 0;  // forwarded with a fragment missing
+    [[nodiscard]] std::string to_string() const;
+  };
+  // Protects against a missing end of frame (e.g. corrupted stream)
+  static constexpr std::size_t MAX_N_FRAGMENTS_PER_FRAME = 500;
+  // Whole frames - the end of the frame got lost and the stream stopped
+  static constexpr int FRAME_TIMEOUT_MS = 100;
+  RTPJitterBuffer(int stream_index, int jitter_ms, bool emit_whole_frames,
+                  OUT_CB out_cb);
+  ~RTPJitterBuffer();
+  RTPJitterBuffer(const RTPJitterBuffer&) = delete;
+  RTPJitterBuffer& operator=(const RTPJitterBuffer&) = delete;
+  // Returns false if the data is not rtp (not consumed, forward it as is)
+  bool input(const uint8_t* data, int data_len);
+  Stats get_stats() const;
+
+ private:
+  static int on_packet(void* param, const void* packet, int bytes,
+                       uint32_t timestamp, int flags);
+  static void* on_packet_alloc(void* param, int bytes, void** handle);
+  static void on_packet_free(void* param, void* handle);
+  // The buffer of the packet handed out by the demuxer (no copy)
+  std::shared_ptr<std::vector<uint8_t>> take_packet(const uint8_t* data,
+                                                    int bytes);
+  void loop_timer();
+  void end_frame(bool marker);
+  void forward_fragments();
+
+ private:
+  const int m_stream_index;
+  const int m_jitter_ms;
+  const bool m_emit_whole_frames;
+  const OUT_CB m_out_cb;
+  // protects everything below, recursive since the out cb may query the stats
+  mutable std::recursive_mutex m_mutex;
+  rtp_demuxer_t* m_demuxer = nullptr;
+  std::unique_ptr<std::thread> m_timer_thread;
+  std::condition_variable_any m_timer_cv;
+  // nothing queued, the timer thread waits for input
+  bool m_timer_idle = true;
+  bool m_timer_stop = false;
+  std::vector<std::shared_ptr<std::vector<uint8_t>>> m_fragments;
+  bool m_in_frame = false;
+  uint32_t m_curr_frame_timestamp = 0;
+  // a fragment of the current frame got lost
+  bool m_curr_frame_lost = false;
+  std::chrono::steady_clock::time_point m_last_fragment_time{};
+  uint32_t m_count_frames = 0;
+  uint32_t m_count_frames_incomplete = 0;
+};
+
+}  // namespace openhd
+
+#endif  // OPENHD_OPENHD_OHD_VIDEO_INC_RTP_JITTER_BUFFER_H_
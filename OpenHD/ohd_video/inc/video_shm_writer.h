@@ -0,0 +1,94 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#ifndef OPENHD_OPENHD_OHD_VIDEO_INC_VIDEO_SHM_WRITER_H_
+#define OPENHD_OPENHD_OHD_VIDEO_INC_VIDEO_SHM_WRITER_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "openhd_udp.h"
+#include "openhd_video_shm_ring.h"
+
+namespace openhd {
+
+/**
+ * Writer side of the shared memory video output (see openhd_video_shm_ring.h
+ * for the layout and the reader API). Never blocks on readers.
+ * Not thread-safe, one writer per shm object.
+ * 共享内存视频输出的写入端（布局和读取 API 见 openhd_video_shm_ring.h）。从不因读取者而阻塞。
+ */
+class VideoShmWriter {
+ public:
+  // 8MB - more than 1 second at 50MBit/s
+  static constexpr std::size_t DEFAULT_CAPACITY = 8 * 1024 * 1024;
+  // A reader is considered gone if it didn't wait on the futex for that long
+  static constexpr int READER_TIMEOUT_MS = 1000;
+  // Returns nullptr if the shm object cannot be created
+  static std::unique_ptr<VideoShmWriter> create(
+      const std::string& name, std::size_t capacity = DEFAULT_CAPACITY);
+  ~VideoShmWriter();
+  VideoShmWriter(const VideoShmWriter&) = delete;
+  VideoShmWriter& operator=(const VideoShmWriter&) = delete;
+  // Writes all packets, but doesn't publish them yet (readers don't see them
+  // until publish()). If end_of_frame is set, the last packet is flagged as
+  // end of frame.
+  // 写入所有数据包，但尚不发布（在 publish() 之前读取者看不到它们）。
+  void write_packets(const UDPPacketRef* packets, std::size_t n_packets,
+                     bool end_of_frame);
+  void write_packets(const std::vector<UDPPacketRef>& packets,
+                     bool end_of_frame) {
+    write_packets(packets.data(), packets.size(), end_of_frame);
+  }
+  // Publishes everything written so far at once and wakes up waiting readers
+  // (if any). Call it once per frame (or burst), not per packet.
+  // 一次性发布目前写入的所有数据，并唤醒等待的读取者。每帧（或每批）调用一次，而不是每个包。
+  void publish();
+  bool has_unpublished() const { return m_write_pos != m_published_pos; }
+  // True if a reader was active within READER_TIMEOUT_MS
+  bool has_active_reader() const;
+  const std::string& get_name() const { return m_name; }
+
+ private:
+  VideoShmWriter(std::string name, int fd, void* map, std::size_t map_size);
+  void write_record(const uint8_t* data, uint32_t size, uint32_t flags,
+                    uint64_t write_time_us);
+
+ private:
+  const std::string m_name;
+  const int m_fd;
+  void* const m_map;
+  const std::size_t m_map_size;
+  ohd_video_shm_header* m_header;
+  uint8_t* m_data;
+  uint64_t m_capacity;
+  // not published yet
+  uint64_t m_write_pos;
+  uint64_t m_published_pos;
+};
+
+}  // namespace openhd
+
+#endif  // OPENHD_OPENHD_OHD_VIDEO_INC_VIDEO_SHM_WRITER_H_
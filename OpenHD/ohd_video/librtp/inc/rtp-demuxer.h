@@ -10,24 +10,41 @@ extern "C" {
 struct rtp_demuxer_t;
 
 /// @param[in] param rtp_demuxer_create input param
-/// @param[in] packet rtp payload data
-/// @param[in] bytes rtp payload length in byte
+/// @param[in] packet rtp packet (header included, OpenHD doesn't build the payload decoders)
+/// @param[in] bytes rtp packet length in byte
 /// @param[in] timestamp rtp timestamp(relation at sample rate)
 /// @param[in] flags rtp packet flags, RTP_PAYLOAD_FLAG_PACKET_xxx, see more @rtp-payload.h
 /// @return 0-ok, other-error
 typedef int (*rtp_demuxer_onpacket)(void* param, const void *packet, int bytes, uint32_t timestamp, int flags);
 
-/// @param[in] jitter rtp reorder jitter(ms), e.g. 200(ms)
+/// @param[in] jitter rtp reorder jitter(ms), e.g. 200(ms), 0 - pass through (no reordering)
 /// @param[in] frequency audio/video sample rate, e.g. video 90000, audio 48000
-/// @param[in] payload rtp payload id, see more @rtp-profile.h
+/// @param[in] payload rtp payload id, see more @rtp-profile.h, -1 - any
 /// @param[in] encoding rtp payload encoding, see more @rtp-profile.h
 struct rtp_demuxer_t* rtp_demuxer_create(int jitter, int frequency, int payload, const char* encoding, rtp_demuxer_onpacket onpkt, void* param);
 int rtp_demuxer_destroy(struct rtp_demuxer_t** rtp);
 
+/// Optional packet memory of the jitter buffer (jitter > 0), such that the packets can be handed out without another copy.
+/// @param[in] bytes packet length in byte
+/// @param[out] handle opaque, given back via rtp_demuxer_packet_free / rtp_demuxer_take_packet
+/// @return buffer of at least bytes, NULL - error
+typedef void* (*rtp_demuxer_packet_alloc)(void* param, int bytes, void** handle);
+typedef void (*rtp_demuxer_packet_free)(void* param, void* handle);
+/// Call it before the first input
+void rtp_demuxer_set_allocator(struct rtp_demuxer_t* rtp, rtp_demuxer_packet_alloc palloc, rtp_demuxer_packet_free pfree);
+/// Only valid during onpacket - takes ownership of the current packet, the demuxer doesn't free it
+/// @return the handle of the packet, NULL - the packet is not from the allocator (e.g. pass through)
+void* rtp_demuxer_take_packet(struct rtp_demuxer_t* rtp);
+
 /// @param[in] data a rtp/rtcp packet
 /// @return >0-rtcp message, 0-ok, <0-error
 int rtp_demuxer_input(struct rtp_demuxer_t* rtp, const void* data, int bytes);
 
+/// Release the packets the jitter buffer waited for long enough, without new input
+/// (e.g. the stream stopped after a gap). Not thread-safe, don't call it concurrently with rtp_demuxer_input.
+/// @return ms until the next packet is due, -1 - nothing queued (or pass through)
+int rtp_demuxer_poll(struct rtp_demuxer_t* rtp);
+
 /// @return >0-rtcp report length, 0-don't need send rtcp
 int rtp_demuxer_rtcp(struct rtp_demuxer_t* rtp, void* buf, int len);
 
@@ -15,6 +15,9 @@ int rtp_queue_destroy(rtp_queue_t* queue);
 /// @return 1-ok, 0-discard, <0-error
 int rtp_queue_write(rtp_queue_t* queue, struct rtp_packet_t* pkt);
 struct rtp_packet_t* rtp_queue_read(rtp_queue_t* queue);
+/// Call it once rtp_queue_read returned NULL
+/// @return ms until rtp_queue_read releases the packets after the oldest gap, -1 - queue empty
+int rtp_queue_timeout(rtp_queue_t* queue);
 
 
 struct rtp_queue_stats_t
@@ -0,0 +1,294 @@
+#include "rtp-demuxer.h"
+#include "rtp-queue.h"
+#include "rtp-packet.h"
+#include "rtp-payload.h"
+#include "rtp-util.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// Reorder / jitter stage for (video) rtp receivers.
+// NOTE: This tree doesn't build the rtp payload decoders (depacketizers) - the
+// demuxer hands out the complete rtp packets (header included) in sequence
+// number order instead of the depacketized payload, which is what the ground
+// needs to forward the stream. RTCP is not used by OpenHD and ignored.
+// jitter 0 - pass through, packets are forwarded as they come in (only stats).
+// 注意：这里没有编译 rtp 负载解码器（解包器）- 解复用器按序列号顺序输出完整的 rtp 包（包含头部），
+// 而不是解包后的负载，这正是地面端转发视频流所需要的。OpenHD 不使用 RTCP，直接忽略。
+
+// Buffers of this size are recycled, bigger packets are allocated on demand
+#define RTP_DEMUXER_SLOT_SIZE 2048
+
+struct rtp_demuxer_packet_t
+{
+	struct rtp_packet_t pkt; // must be first, the queue only knows rtp_packet_t
+	struct rtp_demuxer_packet_t* next; // free list
+	int bytes;
+	int capacity; // of inline_data, 0 with a custom allocator
+	uint8_t* data; // inline_data or from the custom allocator
+	void* handle; // custom allocator, NULL once taken
+	uint8_t inline_data[];
+};
+
+struct rtp_demuxer_t
+{
+	rtp_queue_t* queue; // NULL - pass through
+	int jitter;
+	int frequency;
+	int payload;
+
+	rtp_demuxer_onpacket onpkt;
+	void* param;
+
+	int started;
+	uint16_t seq; // last forwarded sequence number
+
+	struct rtp_queue_stats_t stats; // pass through only
+	struct rtp_demuxer_packet_t* pool;
+
+	rtp_demuxer_packet_alloc alloc; // NULL - inline slots
+	rtp_demuxer_packet_free free;
+	struct rtp_demuxer_packet_t* current; // packet handed out via onpkt
+};
+
+static void rtp_demuxer_freepkt(void* param, struct rtp_packet_t* pkt)
+{
+	struct rtp_demuxer_t* rtp;
+	struct rtp_demuxer_packet_t* p;
+	rtp = (struct rtp_demuxer_t*)param;
+	p = (struct rtp_demuxer_packet_t*)pkt;
+	if (p->handle)
+	{
+		rtp->free(rtp->param, p->handle);
+		p->handle = NULL;
+	}
+	if (p->capacity == (rtp->alloc ? 0 : RTP_DEMUXER_SLOT_SIZE))
+	{
+		p->next = rtp->pool;
+		rtp->pool = p;
+	}
+	else
+	{
+		free(p);
+	}
+}
+
+static struct rtp_demuxer_packet_t* rtp_demuxer_alloc(struct rtp_demuxer_t* rtp, int bytes)
+{
+	struct rtp_demuxer_packet_t* p;
+	int capacity;
+	// With a custom allocator the slots only hold the packet header
+	if (rtp->pool && (rtp->alloc || bytes <= RTP_DEMUXER_SLOT_SIZE))
+	{
+		p = rtp->pool;
+		rtp->pool = p->next;
+	}
+	else
+	{
+		capacity = rtp->alloc ? 0 : (bytes > RTP_DEMUXER_SLOT_SIZE ? bytes : RTP_DEMUXER_SLOT_SIZE);
+		p = (struct rtp_demuxer_packet_t*)malloc(sizeof(*p) + capacity);
+		if (!p)
+			return NULL;
+		p->capacity = capacity;
+	}
+	p->data = p->inline_data;
+	p->handle = NULL;
+	if (rtp->alloc)
+	{
+		p->data = (uint8_t*)rtp->alloc(rtp->param, bytes, &p->handle);
+		if (!p->data)
+		{
+			rtp_demuxer_freepkt(rtp, &p->pkt);
+			return NULL;
+		}
+	}
+	return p;
+}
+
+struct rtp_demuxer_t* rtp_demuxer_create(int jitter, int frequency, int payload, const char* encoding, rtp_demuxer_onpacket onpkt, void* param)
+{
+	struct rtp_demuxer_t* rtp;
+	(void)encoding; // no depacketizer, see above
+	rtp = (struct rtp_demuxer_t*)calloc(1, sizeof(*rtp));
+	if (!rtp)
+		return NULL;
+	rtp->jitter = jitter > 0 ? jitter : 0;
+	rtp->frequency = frequency > 0 ? frequency : 90000;
+	rtp->payload = payload;
+	rtp->onpkt = onpkt;
+	rtp->param = param;
+	if (rtp->jitter > 0)
+	{
+		rtp->queue = rtp_queue_create(rtp->jitter, rtp->frequency, rtp_demuxer_freepkt, rtp);
+		if (!rtp->queue)
+		{
+			free(rtp);
+			return NULL;
+		}
+	}
+	return rtp;
+}
+
+void rtp_demuxer_set_allocator(struct rtp_demuxer_t* rtp, rtp_demuxer_packet_alloc palloc, rtp_demuxer_packet_free pfree)
+{
+	assert(!rtp->pool);
+	rtp->alloc = palloc && pfree ? palloc : NULL;
+	rtp->free = palloc && pfree ? pfree : NULL;
+}
+
+void* rtp_demuxer_take_packet(struct rtp_demuxer_t* rtp)
+{
+	void* handle;
+	if (!rtp->current)
+		return NULL;
+	handle = rtp->current->handle;
+	rtp->current->handle = NULL;
+	return handle;
+}
+
+int rtp_demuxer_destroy(struct rtp_demuxer_t** prtp)
+{
+	struct rtp_demuxer_t* rtp;
+	struct rtp_demuxer_packet_t* p;
+	if (!prtp || !*prtp)
+		return 0;
+	rtp = *prtp;
+	if (rtp->queue)
+		rtp_queue_destroy(rtp->queue);
+	while (rtp->pool)
+	{
+		p = rtp->pool;
+		rtp->pool = p->next;
+		free(p);
+	}
+	free(rtp);
+	*prtp = NULL;
+	return 0;
+}
+
+static int rtp_demuxer_onpacket_(struct rtp_demuxer_t* rtp, const struct rtp_packet_t* pkt, const void* data, int bytes)
+{
+	int flags;
+	flags = 0;
+	if (rtp->started && (uint16_t)pkt->rtp.seq != (uint16_t)(rtp->seq + 1))
+		flags |= RTP_PAYLOAD_FLAG_PACKET_LOST;
+	rtp->started = 1;
+	rtp->seq = (uint16_t)pkt->rtp.seq;
+	return rtp->onpkt(rtp->param, data, bytes, pkt->rtp.timestamp, flags);
+}
+
+// No reordering, only count what a jitter buffer would have done
+static int rtp_demuxer_passthrough(struct rtp_demuxer_t* rtp, const struct rtp_packet_t* pkt, const void* data, int bytes)
+{
+	int16_t delta;
+	rtp->stats.total++;
+	if (rtp->started)
+	{
+		delta = (int16_t)((uint16_t)pkt->rtp.seq - (uint16_t)(rtp->seq + 1));
+		if (delta > 0)
+		{
+			rtp->stats.lost += delta;
+		}
+		else if (-1 == delta)
+		{
+			rtp->stats.duplicate++;
+			return 0;
+		}
+		else if (delta < 0)
+		{
+			// counted as lost before, but forwarded anyways
+			rtp->stats.reorder++;
+			if (rtp->stats.lost > 0)
+				rtp->stats.lost--;
+			return rtp->onpkt(rtp->param, data, bytes, pkt->rtp.timestamp, 0);
+		}
+	}
+	return rtp_demuxer_onpacket_(rtp, pkt, data, bytes);
+}
+
+// Hand out everything the queue releases
+static int rtp_demuxer_read(struct rtp_demuxer_t* rtp)
+{
+	int r;
+	struct rtp_packet_t* next;
+	struct rtp_demuxer_packet_t* p;
+
+	r = 0;
+	while (NULL != (next = rtp_queue_read(rtp->queue)))
+	{
+		p = (struct rtp_demuxer_packet_t*)next;
+		rtp->current = p;
+		r = rtp_demuxer_onpacket_(rtp, next, p->data, p->bytes);
+		rtp->current = NULL;
+		rtp_demuxer_freepkt(rtp, next);
+	}
+	return r;
+}
+
+int rtp_demuxer_input(struct rtp_demuxer_t* rtp, const void* data, int bytes)
+{
+	uint8_t pt;
+	struct rtp_packet_t pkt;
+	struct rtp_demuxer_packet_t* p;
+
+	if (bytes < RTP_FIXED_HEADER || RTP_VERSION != (((const uint8_t*)data)[0] >> 6))
+		return -1;
+
+	// RFC5761 - RTCP SR/RR/SDES/BYE/APP (200-204) multiplexed on the same port
+	pt = ((const uint8_t*)data)[1];
+	if (pt >= 200 && pt <= 204)
+		return 1;
+	if (rtp->payload >= 0 && rtp->payload <= 127 && (pt & 0x7F) != rtp->payload)
+		return -1;
+
+	if (!rtp->queue)
+	{
+		if (0 != rtp_packet_deserialize(&pkt, data, bytes))
+			return -1;
+		return rtp_demuxer_passthrough(rtp, &pkt, data, bytes);
+	}
+
+	p = rtp_demuxer_alloc(rtp, bytes);
+	if (!p)
+		return -1;
+	memcpy(p->data, data, bytes);
+	p->bytes = bytes;
+	if (0 != rtp_packet_deserialize(&p->pkt, p->data, bytes))
+	{
+		rtp_demuxer_freepkt(rtp, &p->pkt);
+		return -1;
+	}
+	rtp_queue_write(rtp->queue, &p->pkt);
+	return rtp_demuxer_read(rtp);
+}
+
+int rtp_demuxer_poll(struct rtp_demuxer_t* rtp)
+{
+	if (!rtp->queue)
+		return -1;
+	rtp_demuxer_read(rtp);
+	return rtp_queue_timeout(rtp->queue);
+}
+
+int rtp_demuxer_rtcp(struct rtp_demuxer_t* rtp, void* buf, int len)
+{
+	(void)rtp, (void)buf, (void)len;
+	return 0;
+}
+
+void rtp_demuxer_stats(struct rtp_demuxer_t* rtp, int* lost, int* late, int* misorder, int* duplicate)
+{
+	struct rtp_queue_stats_t stats;
+	if (rtp->queue)
+		rtp_queue_stats(rtp->queue, &stats);
+	else
+		memcpy(&stats, &rtp->stats, sizeof(stats));
+	if (lost)
+		*lost = stats.lost;
+	if (late)
+		*late = stats.late;
+	if (misorder)
+		*misorder = stats.reorder;
+	if (duplicate)
+		*duplicate = stats.duplicate;
+}
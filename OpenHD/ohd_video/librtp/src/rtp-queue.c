@@ -0,0 +1,221 @@
+#include "rtp-queue.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+
+// Bounded rtp reorder (jitter) queue, packets sorted by sequence number.
+// A packet is released once all packets before it were released, or - if there
+// is a gap - once the gap is older than the threshold, either in arrival
+// (wall clock) time or in rtp time (newest queued packet vs the packet after
+// the gap). Threshold 0 releases everything immediately (no reordering).
+// 有界的 rtp 重排序（抖动）队列，按序列号排序。只有当前面的包都已读出时才释放一个包；
+// 如果存在缺口，则当缺口的等待时间（按到达时间或 rtp 时间）超过阈值时释放。
+
+#define RTP_QUEUE_CAPACITY	1024
+// Release even if there is a gap once the queue is that full
+#define RTP_QUEUE_HIGH_WATERMARK (RTP_QUEUE_CAPACITY * 3 / 4)
+// RFC3550 A.1 - sequence numbers further away are considered a sender restart
+#define RTP_MISORDER		100
+#define RTP_DROPOUT			3000
+
+struct rtp_queue_item_t
+{
+	struct rtp_packet_t* pkt;
+	uint64_t clock; // arrival time, ms
+};
+
+struct rtp_queue_t
+{
+	struct rtp_queue_item_t items[RTP_QUEUE_CAPACITY];
+	int pos; // first (oldest) item
+	int size;
+
+	int threshold; // ms
+	int frequency;
+	uint32_t threshold_ticks; // threshold in rtp timestamp units
+
+	int started;
+	uint16_t expected; // next sequence number to read
+	int bad; // got one packet with a bad sequence number
+	uint16_t bad_seq;
+
+	struct rtp_queue_stats_t stats;
+
+	void (*freepkt)(void*, struct rtp_packet_t*);
+	void* param;
+};
+
+static uint64_t rtp_queue_clock(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void rtp_queue_reset(rtp_queue_t* q)
+{
+	int i;
+	for (i = 0; i < q->size; i++)
+		q->freepkt(q->param, q->items[q->pos + i].pkt);
+	q->pos = 0;
+	q->size = 0;
+}
+
+rtp_queue_t* rtp_queue_create(int threshold, int frequency, void (*freepkt)(void*, struct rtp_packet_t*), void* param)
+{
+	struct rtp_queue_t* q;
+	q = (struct rtp_queue_t*)calloc(1, sizeof(*q));
+	if (!q)
+		return NULL;
+	q->threshold = threshold > 0 ? threshold : 0;
+	q->frequency = frequency > 0 ? frequency : 90000;
+	q->threshold_ticks = (uint32_t)((uint64_t)q->threshold * q->frequency / 1000);
+	q->freepkt = freepkt;
+	q->param = param;
+	return q;
+}
+
+int rtp_queue_destroy(rtp_queue_t* q)
+{
+	if (q)
+	{
+		rtp_queue_reset(q);
+		free(q);
+	}
+	return 0;
+}
+
+// Insert at index (relative to pos), keeps the items sorted
+static void rtp_queue_insert(rtp_queue_t* q, int index, struct rtp_packet_t* pkt)
+{
+	struct rtp_queue_item_t* items;
+	if (q->pos + q->size >= RTP_QUEUE_CAPACITY)
+	{
+		// compact, the oldest item moves to the front
+		memmove(q->items, q->items + q->pos, q->size * sizeof(struct rtp_queue_item_t));
+		q->pos = 0;
+	}
+	items = q->items + q->pos;
+	if (index < q->size)
+		memmove(items + index + 1, items + index, (q->size - index) * sizeof(struct rtp_queue_item_t));
+	items[index].pkt = pkt;
+	items[index].clock = rtp_queue_clock();
+	q->size++;
+}
+
+int rtp_queue_write(rtp_queue_t* q, struct rtp_packet_t* pkt)
+{
+	int i;
+	int16_t delta;
+	uint16_t seq;
+
+	seq = (uint16_t)pkt->rtp.seq;
+	q->stats.total++;
+	if (!q->started)
+	{
+		q->started = 1;
+		q->expected = seq;
+	}
+
+	delta = (int16_t)(seq - q->expected);
+	if (delta < 0 && delta >= -RTP_MISORDER)
+	{
+		// the packets after it were already read
+		q->stats.late++;
+		q->freepkt(q->param, pkt);
+		return 0;
+	}
+	if (delta < -RTP_MISORDER || delta > RTP_DROPOUT)
+	{
+		// two sequential packets with a bad sequence number - the sender
+		// restarted, re-sync (the queued packets are obsolete)
+		if (q->bad && seq == q->bad_seq)
+		{
+			rtp_queue_reset(q);
+			q->expected = seq;
+		}
+		else
+		{
+			q->bad = 1;
+			q->bad_seq = (uint16_t)(seq + 1);
+			q->stats.bad++;
+			q->freepkt(q->param, pkt);
+			return 0;
+		}
+	}
+	q->bad = 0;
+
+	if (q->size >= RTP_QUEUE_CAPACITY)
+	{
+		// caller doesn't read
+		q->stats.lost++;
+		q->freepkt(q->param, pkt);
+		return 0;
+	}
+
+	// almost always appended, search from the newest packet
+	for (i = q->size; i > 0; i--)
+	{
+		delta = (int16_t)(seq - (uint16_t)q->items[q->pos + i - 1].pkt->rtp.seq);
+		if (0 == delta)
+		{
+			q->stats.duplicate++;
+			q->freepkt(q->param, pkt);
+			return 0;
+		}
+		if (delta > 0)
+			break;
+	}
+	if (i < q->size)
+		q->stats.reorder++;
+	rtp_queue_insert(q, i, pkt);
+	return 1;
+}
+
+struct rtp_packet_t* rtp_queue_read(rtp_queue_t* q)
+{
+	int16_t delta;
+	struct rtp_packet_t* pkt;
+	struct rtp_queue_item_t* head;
+	struct rtp_queue_item_t* tail;
+
+	if (q->size < 1)
+		return NULL;
+
+	head = q->items + q->pos;
+	delta = (int16_t)((uint16_t)head->pkt->rtp.seq - q->expected);
+	assert(delta >= 0);
+	if (delta > 0)
+	{
+		// wait for the missing packet(s), but not longer than the threshold
+		tail = q->items + q->pos + q->size - 1;
+		if (q->size < RTP_QUEUE_HIGH_WATERMARK
+			&& rtp_queue_clock() - head->clock < (uint64_t)q->threshold
+			&& (int32_t)(tail->pkt->rtp.timestamp - head->pkt->rtp.timestamp) < (int32_t)q->threshold_ticks)
+			return NULL;
+		q->stats.lost += delta;
+	}
+
+	pkt = head->pkt;
+	q->expected = (uint16_t)(pkt->rtp.seq + 1);
+	q->pos++;
+	q->size--;
+	if (0 == q->size)
+		q->pos = 0;
+	return pkt;
+}
+
+int rtp_queue_timeout(rtp_queue_t* q)
+{
+	uint64_t elapsed;
+	if (q->size < 1)
+		return -1;
+	elapsed = rtp_queue_clock() - q->items[q->pos].clock;
+	return elapsed >= (uint64_t)q->threshold ? 0 : (int)((uint64_t)q->threshold - elapsed);
+}
+
+void rtp_queue_stats(rtp_queue_t* q, struct rtp_queue_stats_t* stats)
+{
+	memcpy(stats, &q->stats, sizeof(*stats));
+}
@@ -27,9 +27,12 @@
 #include <gst/app/gstappsink.h>
 #include <gst/gst.h>
 
+#include <chrono>
 #include <optional>
 
+#include "openhd_rtp.h"
 #include "openhd_spdlog.h"
+#include "openhd_video_frame.h"
 
 namespace openhd {
 
@@ -49,6 +52,53 @@ static std::shared_ptr<std::vector<uint8_t>> gst_copy_buffer(
   return ret;
 }
 
+// Copies the buffer into a fragment backed by a (recycled) video buffer pool
+// vector, such that it can be handed to the link without another copy. The
+// buffer is only mapped during the copy. Returns nullptr if the buffer cannot
+// be mapped or is empty.
+// If @param capture_time_us is set, the buffer has to be a rtp packet - the
+// capture time extension is added in place, before the fragment is shared.
+// 将 buffer 拷贝到由（可复用的）视频缓冲池 vector 支持的分片中，这样交给链路时无需再次拷贝。
+// buffer 只在拷贝期间被映射。
+static std::shared_ptr<openhd::VideoFragment> gst_copy_buffer_to_fragment(
+    GstBuffer* buffer, std::optional<int64_t> capture_time_us = std::nullopt) {
+  assert(buffer);
+  GstMapInfo map;
+  if (!gst_buffer_map(buffer, &map, GST_MAP_READ)) return nullptr;
+  std::shared_ptr<openhd::VideoFragment> ret = nullptr;
+  if (map.size > 0) {
+    const auto& pool = BufferPool::video();
+    auto buff = pool->acquire();
+    buff->assign(map.data, map.data + map.size);
+    if (capture_time_us.has_value()) {
+      rtp_capture_time::add_extension(*buff, capture_time_us.value());
+    }
+    ret = std::make_shared<openhd::PooledVideoFragment>(pool, buff);
+  }
+  gst_buffer_unmap(buffer, &map);
+  return ret;
+}
+
+// Converts the buffer timestamp (PTS, DTS if there is no PTS) into the
+// steady clock time point the frame was captured at. This works since the
+// pipeline clock is the (monotonic) system clock and the running time of a live
+// source starts at the pipeline base time. Returns std::nullopt if the buffer
+// has no timestamp or the result is implausible (e.g. non-live source).
+static std::optional<std::chrono::steady_clock::time_point>
+gst_buffer_capture_time(GstElement* pipeline, GstBuffer* buffer) {
+  GstClockTime ts = GST_BUFFER_PTS(buffer);
+  if (!GST_CLOCK_TIME_IS_VALID(ts)) ts = GST_BUFFER_DTS(buffer);
+  if (!GST_CLOCK_TIME_IS_VALID(ts)) return std::nullopt;
+  const GstClockTime base_time = gst_element_get_base_time(pipeline);
+  const auto capture_time = std::chrono::steady_clock::time_point(
+      std::chrono::nanoseconds(base_time + ts));
+  const auto now = std::chrono::steady_clock::now();
+  if (capture_time > now || now - capture_time > std::chrono::seconds(2)) {
+    return std::nullopt;
+  }
+  return capture_time;
+}
+
 struct GstBufferX {
   std::shared_ptr<std::vector<uint8_t>> buffer;
   uint64_t buffer_dts = 0;
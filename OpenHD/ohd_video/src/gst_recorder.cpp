@@ -65,12 +65,14 @@ static std::string create_recording_pipeline(const VideoCodec videoCodec,
 
 static void need_data(GstElement* pipeline, guint size,
                       GstVideoRecorder* self) {
-  openhd::log::get_default()->debug("need_data");
+  OPENHD_DEBUG_EVERY_MS(OPENHD_CACHED_LOGGER("v_gst_recorder"), 1000,
+                        "need_data");
   self->ready_data = true;
 }
 
 static void enough_data(GstElement* pipeline, GstVideoRecorder* self) {
-  openhd::log::get_default()->debug("enough_data");
+  OPENHD_DEBUG_EVERY_MS(OPENHD_CACHED_LOGGER("v_gst_recorder"), 1000,
+                        "enough_data");
   self->ready_data = false;
 }
 
@@ -132,12 +134,13 @@ void GstVideoRecorder::on_video_data(const uint8_t* data, int data_len) {
   // ret = gst_app_src_push_buffer(GST_APP_SRC(m_app_src_element), buffer);
   gst_buffer_unref(buffer);
   if (ret != GST_FLOW_OK) {
-    m_console->warn("Cannot push buffer");
+    OPENHD_WARN_EVERY_MS(m_console, 1000, "Cannot push buffer");
   } else {
-    m_console->debug("Pushed buffer {}", data_len);
+    OPENHD_DEBUG_EVERY_MS(m_console, 1000, "Pushed buffer {}", data_len);
   }
-  m_console->debug("Curr n buffers: {}", gst_app_src_get_current_level_buffers(
-                                             GST_APP_SRC(m_app_src_element)));
+  OPENHD_DEBUG_EVERY_MS(
+      m_console, 1000, "Curr n buffers: {}",
+      gst_app_src_get_current_level_buffers(GST_APP_SRC(m_app_src_element)));
   gst_element_set_state(m_gst_pipeline, GST_STATE_PLAYING);
   /*GstBuffer *buffer;
   GstFlowReturn ret;
@@ -161,7 +164,7 @@ void GstVideoRecorder::on_video_data(const uint8_t* data, int data_len) {
 }
 
 void GstVideoRecorder::enqueue_rtp_fragment(
-    std::shared_ptr<std::vector<uint8_t>> fragment) {
+    std::shared_ptr<openhd::VideoFragment> fragment) {
   on_video_data(fragment->data(), fragment->size());
 }
 
@@ -39,9 +39,9 @@
 #include "nalu/fragment_helper.h"
 #include "nalu/nalu_helper.h"
 #include "openhd_rtp.h"
+#include "openhd_trace.h"
 #include "openhd_util.h"
 #include "rpi_hdmi_to_csi_v4l2_helper.h"
-#include "rtp_eof_helper.h"
 #include "x20_cam_helper.h"
 
 // 构造函数，初始化摄像头流并配置日志、摄像头设置和 GStreamer。
@@ -54,6 +54,10 @@ GStreamerStream::GStreamerStream(std::shared_ptr<CameraHolder> camera_holder, op
     if (OHDFilesystemUtil::exists((std::string(getConfigBasePath()) + "exp_raw.txt").c_str())) {
         dirty_use_raw = true;
     }
+    if (OHDFilesystemUtil::exists(std::string(getConfigBasePath()) + "appsink_poll.txt")) {
+        m_console->warn("Using appsink polling");
+        m_use_appsink_polling = true;
+    }
     m_camera_holder->register_listener([this]() {
         // right now, every time the settings for this camera change, we just
         // re-start the whole stream. That is not ideal, since some cameras support
@@ -89,6 +93,7 @@ void GStreamerStream::start_looping() {
 // 终止循环线程并等待其退出。
 void GStreamerStream::terminate_looping() {
     m_keep_looping = false;
+    notify_stream_thread();
     if (m_loop_thread) {
         m_console->debug("Wating for loop thread to terminate");
         m_loop_thread->join();
@@ -185,6 +190,12 @@ std::string GStreamerStream::create_source_encode_pipeline(const CameraHolder& c
     return pipeline.str();
 }
 
+// appsink new-sample callback, called on the gstreamer streaming thread
+static GstFlowReturn appsink_new_sample_cb(GstAppSink* appsink, gpointer user_data) {
+    auto self = static_cast<GStreamerStream*>(user_data);
+    return self->on_appsink_new_sample_cb();
+}
+
 // 配置 GStreamer 管道并初始化相关组件。
 void GStreamerStream::setup() {
     m_console->debug("GStreamerStream::setup() begin");
@@ -224,7 +235,8 @@ void GStreamerStream::setup() {
         pipeline_content << OHDGstHelper::createOutputAppSink();*/
     } else {
         // 为 GStreamer 管道创建一个 appsink 元素，并返回其描述字符串
-        const int rtp_fragment_size = 1440;
+        // Room for the capture time extension on the first fragment of a frame
+        const int rtp_fragment_size = openhd::RTP_MAX_PACKET_SIZE - openhd::rtp_capture_time::EXTENSION_SIZE;
         m_console->debug("Using {} for rtp fragmentation", rtp_fragment_size);
         pipeline_content << OHDGstHelper::create_parse_and_rtp_packetize(setting.streamed_video_format.videoCodec, rtp_fragment_size);
         pipeline_content << OHDGstHelper::createOutputAppSink();
@@ -275,9 +287,25 @@ void GStreamerStream::setup() {
         gst_bin_get_by_name(GST_BIN(m_gst_pipeline), "out_appsink");  // 我们通过使用 GStreamer 的 "appsink" 元素，将数据从 GStreamer 管道中提取出来，作为 CPU 内存缓冲区。
     assert(m_app_sink_element);
     // m_console->debug("Cam encoding format: {}",(int)cam_info.encoding_format);
-    auto lol_cb = [this](std::vector<std::shared_ptr<std::vector<uint8_t>>> frame_fragments) { x_on_new_rtp_fragmented_frame(frame_fragments); };
-    m_rtp_helper = std::make_shared<openhd::RTPHelper>(setting.streamed_video_format.videoCodec == VideoCodec::H265);
+    auto lol_cb = [this](std::vector<std::shared_ptr<openhd::VideoFragment>> frame_fragments) { x_on_new_rtp_fragmented_frame(frame_fragments); };
+    // The codec is fixed for the lifetime of a pipeline
+    // 编解码器在管道的生命周期内是固定的
+    m_frame_assembler = std::make_unique<openhd::AnyRTPFrameAssembler>(
+        setting.streamed_video_format.videoCodec,
+        [this](std::vector<std::shared_ptr<openhd::VideoFragment>>& frame_fragments, bool is_idr_frame) { on_new_rtp_fragmented_frame(frame_fragments, is_idr_frame); });
+    m_rtp_helper = std::make_shared<openhd::RTPHelper>(setting.streamed_video_format.videoCodec == VideoCodec::H265, setting.streamed_video_format.width,
+                                                       setting.streamed_video_format.height, setting.streamed_video_format.framerate, setting.h26x_bitrate_kbits);
     m_rtp_helper->set_out_cb(lol_cb);
+    if (!m_use_appsink_polling) {
+        // Samples are handed to us on the gstreamer streaming thread as soon as
+        // they are produced (No signals are emitted if callbacks are installed)
+        // 数据一产生就在 gstreamer 流线程上交给我们
+        GstAppSinkCallbacks callbacks{};
+        callbacks.new_sample = appsink_new_sample_cb;
+        gst_app_sink_set_callbacks(GST_APP_SINK(m_app_sink_element), &callbacks, this, nullptr);
+        std::lock_guard<std::mutex> guard(m_appsink_cb_mutex);
+        m_appsink_cb_enabled = true;
+    }
 }
 
 // 启动 GStreamer 管道，使其进入播放状态。
@@ -301,6 +329,12 @@ void GStreamerStream::stop() {
 void GStreamerStream::cleanup_pipe() {
     m_console->debug("GStreamerStream::cleanup_pipe() begin");
     assert(m_gst_pipeline != nullptr);
+    {
+        // Once we hold the lock, no callback is running and no new one will
+        // touch our state anymore
+        std::lock_guard<std::mutex> guard(m_appsink_cb_mutex);
+        m_appsink_cb_enabled = false;
+    }
     // Drop the reference to the bitrate control element (if it exists)
     if (m_bitrate_ctrl_element.has_value()) {
         unref_bitrate_element(m_bitrate_ctrl_element.value());
@@ -347,6 +381,21 @@ void GStreamerStream::cleanup_pipe() {
 // 请求重新启动摄像头流
 void GStreamerStream::request_restart() {
     m_request_restart = true;
+    notify_stream_thread();
+}
+
+void GStreamerStream::notify_stream_thread() {
+    {
+        std::lock_guard<std::mutex> lock(m_events_mutex);
+        m_has_pending_event = true;
+    }
+    m_events_cv.notify_one();
+}
+
+void GStreamerStream::wait_for_event(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(m_events_mutex);
+    m_events_cv.wait_for(lock, timeout, [this] { return m_has_pending_event; });
+    m_has_pending_event = false;
 }
 
 // 根据链路比特率信息动态调整摄像头编码比特率。
@@ -367,10 +416,10 @@ void GStreamerStream::handle_change_bitrate_request(openhd::LinkActionHandler::L
         // kbits_per_second_to_string(MIN_BITRATE_KBITS));
         bitrate_for_encoder_kbits = MIN_BITRATE_KBITS;
     }
-    // The gst thread is responsible for changing the bitrate - it will be applied
-    // (as long as the cam is not bugged or the OS is overloaded) after a max
-    // delay of 40ms
+    // The stream thread is responsible for changing the bitrate - it is woken
+    // up immediately (or, in polling mode, applies it after a max delay of 40ms)
     m_curr_dynamic_bitrate_kbits = bitrate_for_encoder_kbits;
+    notify_stream_thread();
     if (m_camera_holder->get_settings().h26x_bitrate_kbits != bitrate_for_encoder_kbits) {
         m_camera_holder->unsafe_get_settings().h26x_bitrate_kbits = bitrate_for_encoder_kbits;
         m_camera_holder->persist(false);
@@ -462,15 +511,18 @@ void GStreamerStream::stream_once() {
     int currently_applied_bitrate = m_camera_holder->get_settings().h26x_bitrate_kbits;
     m_curr_dynamic_bitrate_kbits = currently_applied_bitrate;
     // Now we should have a running pipeline and are able to pull samples from it
-    // We use a timeout of 40ms to not unnecessarily wake up the thread on up to
-    // 30fps (33ms) but also quickly respond to restart requests or bitrate
-    // change(s)
+    // In polling mode, we use a timeout of 40ms to not unnecessarily wake up the
+    // thread on up to 30fps (33ms) but also quickly respond to restart requests
+    // or bitrate change(s). In event driven mode, samples are delivered via the
+    // appsink callback and this thread only wakes up on events (restart, bitrate
+    // change, terminate) and for the periodic checks below.
+    // 在事件驱动模式下，数据通过 appsink 回调传递，此线程只在事件（重启、比特率变化、终止）
+    // 以及下面的周期性检查时被唤醒。
     const uint64_t timeout_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::milliseconds(40)).count();
     // For 'bugged camera restart' fix
-    std::chrono::steady_clock::time_point m_last_camera_frame = std::chrono::steady_clock::now();
-    m_frame_fragments.resize(0);
+    m_last_camera_frame = std::chrono::steady_clock::now();
     // As soon as we get the first frame, we change the status to streaming
-    bool has_first_frame = false;
+    m_has_first_frame = false;
     // Every X seconds, we check if we are about to run out of space
     std::chrono::steady_clock::time_point m_last_air_recording_remaining_space_check = std::chrono::steady_clock::now();
     while (true) {
@@ -479,7 +531,7 @@ void GStreamerStream::stream_once() {
             break;
         // ANNOYING BUGGED CAMERAS FIX - we restart the pipeline if we don't get a
         // frame from the camera for more than X seconds
-        if (std::chrono::steady_clock::now() - m_last_camera_frame > std::chrono::seconds(5)) {
+        if (std::chrono::steady_clock::now() - m_last_camera_frame.load() > std::chrono::seconds(5)) {
             m_console->warn("Restarting camera due to no frame after 5 seconds");
             m_request_restart = true;
         }
@@ -523,124 +575,155 @@ void GStreamerStream::stream_once() {
             m_camera_holder->check_remaining_space_air_recording(true);
             m_last_air_recording_remaining_space_check = std::chrono::steady_clock::now();
         }
-        // try get a new frame fragment from gst
-        GstSample* sample = gst_app_sink_try_pull_sample(GST_APP_SINK(m_app_sink_element), timeout_ns);  // 从 appsink 中拉取（pull）一个样本，并在指定的时间内等待样本的返回
-        if (sample) {
-            if (!has_first_frame) {
-                has_first_frame = true;
-                // 调用 LinkActionHandler::instance().set_cam_info_status 更新相机的状态为正在流式传输（CAM_STATUS_STREAMING）
-                openhd::LinkActionHandler::instance().set_cam_info_status(m_camera_holder->get_camera().index, CAM_STATUS_STREAMING);
-            }
-            // 从 GstSample 中提取 GstBuffer。GstBuffer 是 GStreamer 中的一个数据容器，通常用于存储音频或视频数据。
-            GstBuffer* buffer = gst_sample_get_buffer(sample);
-            // tmp declaration for give sample back early optimization
-            std::shared_ptr<std::vector<uint8_t>> fragment_data = nullptr;  // 用来存储从 GstBuffer 中提取的原始数据
-            uint64_t buffer_dts = 0;                                        // 用来存储 GstBuffer 的解码时间戳
-            if (buffer && gst_buffer_get_size(buffer) > 0) {
-                // 使用 openhd::gst_copy_buffer(buffer) 将 GstBuffer 中的数据复制到一个新的 std::shared_ptr<std::vector<uint8_t>> 类型的 fragment_data 中
-                fragment_data = openhd::gst_copy_buffer(buffer);
-                buffer_dts = buffer->dts;
-            }
-            // Optimization: Give the buffer back to gstreamer as soon as possible.
-            // After copying the data from the sample, unref it first, then forward
-            // the data via cb
-            gst_sample_unref(sample);
-            sample = nullptr;
-            if (fragment_data && !fragment_data->empty()) {
-                // If we got a new sample, aggregate then forward
-                if (dirty_use_raw) {
-                    // 调用 m_rtp_helper->feed_multiple_nalu()，将 fragment_data 中的数据传递给 RTP 协议处理模块。
-                    // fragment_data->data() 是指向数据的指针，fragment_data->size() 是数据的大小
-                    m_rtp_helper->feed_multiple_nalu(fragment_data->data(), fragment_data->size());
-                } else {
-                    // 调用 on_new_rtp_frame_fragment()，传递 fragment_data 和解码时间戳 buffer_dts，用来进一步处理数据帧
-                    on_new_rtp_frame_fragment(std::move(fragment_data), buffer_dts);
-                }
-                m_last_camera_frame = std::chrono::steady_clock::now();
+        if (m_use_appsink_polling) {
+            // try get a new frame fragment from gst
+            GstSample* sample = gst_app_sink_try_pull_sample(GST_APP_SINK(m_app_sink_element), timeout_ns);  // 从 appsink 中拉取（pull）一个样本，并在指定的时间内等待样本的返回
+            if (sample) {
+                on_appsink_sample(sample);
+                forward_frames(m_pending_frames);
             }
+        } else {
+            // Sleep until something happens - at the latest when the next
+            // remaining space / no frame check is due
+            wait_for_event(std::chrono::milliseconds(1000));
         }
     }
     // If we land here, we need to clean up the pipe and (re) start
     const auto terminate_begin = std::chrono::steady_clock::now();
     stop();
     cleanup_pipe();
-    m_frame_fragments.resize(0);
+    m_frame_assembler = nullptr;
     m_console->debug("Terminating pipeline took {}ms", std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - terminate_begin).count());
 }
 
-// 处理新接收到的 RTP 帧分片。
-// 接收来自 RTP 流的数据包片段，并根据这些片段重新组装完整的帧，执行相应的处理（如判断是否是帧的最后一个分片，或者是否是关键帧等）
-void GStreamerStream::on_new_rtp_frame_fragment(std::shared_ptr<std::vector<uint8_t>> fragment, uint64_t dts) {
-    m_frame_fragments.push_back(fragment);  // 它是一个存储多个 RTP 分片的容器。这些片段会逐步组成一个完整的帧
-    // 获取当前摄像头配置中的视频编码格式。
-    const auto curr_video_codec = m_camera_holder->get_settings().streamed_video_format.videoCodec;
-    openhd::rtp_eof_helper::RTPFragmentInfo info{};
-    const bool is_h265 = curr_video_codec == VideoCodec::H265;
-
-    // 根据视频编码格式调用不同的函数获取 RTP 分片的详细信息
-    if (is_h265) {
-        info = openhd::rtp_eof_helper::h265_more_info(fragment->data(), fragment->size());
-    } else {
-        info = openhd::rtp_eof_helper::h264_more_info(fragment->data(), fragment->size());
+GstFlowReturn GStreamerStream::on_appsink_new_sample_cb() {
+    {
+        std::lock_guard<std::mutex> guard(m_appsink_cb_mutex);
+        if (!m_appsink_cb_enabled) {
+            return GST_FLOW_FLUSHING;
+        }
+        GstSample* sample = gst_app_sink_pull_sample(GST_APP_SINK(m_app_sink_element));
+        if (sample) {
+            on_appsink_sample(sample);
+        }
+        // Take the completed frames, the WB link is called without the lock
+        // 取走已完成的帧，调用 WB 链路时不持有锁
+        std::swap(m_pending_frames, m_frames_to_forward);
     }
+    forward_frames(m_frames_to_forward);
+    return GST_FLOW_OK;
+}
+
+// Capture time as sent in-stream (air unit steady clock, us)
+static int64_t to_capture_time_us(std::chrono::steady_clock::time_point capture_time) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(capture_time.time_since_epoch()).count();
+}
 
-    // 判断是否是 FU 开始分片，并记录 IDR 帧状态
-    if (info.is_fu_start) {
-        if (is_idr_frame(info.nal_unit_type, is_h265)) {
-            m_last_fu_s_idr = true;
+// 处理从 appsink 拉取到的样本（取得所有权，会释放 sample）
+void GStreamerStream::on_appsink_sample(GstSample* sample) {
+    if (!m_has_first_frame) {
+        m_has_first_frame = true;
+        // 调用 LinkActionHandler::instance().set_cam_info_status 更新相机的状态为正在流式传输（CAM_STATUS_STREAMING）
+        openhd::LinkActionHandler::instance().set_cam_info_status(m_camera_holder->get_camera().index, CAM_STATUS_STREAMING);
+    }
+    // 从 GstSample 中提取 GstBuffer。GstBuffer 是 GStreamer 中的一个数据容器，通常用于存储音频或视频数据。
+    GstBuffer* buffer = gst_sample_get_buffer(sample);
+    // tmp declaration for give sample back early optimization
+    std::shared_ptr<openhd::VideoFragment> fragment_data = nullptr;  // GstBuffer 中数据的（池化的）拷贝
+    std::optional<std::chrono::steady_clock::time_point> capture_time = std::nullopt;  // 由 buffer 时间戳得出的采集时间
+    if (buffer && gst_buffer_get_size(buffer) > 0) {
+        // One copy into a pooled vector - the link (wb) takes vectors, from
+        // here on the fragment is shared without any further copy.
+        // 拷贝一次到池化的 vector 中 - 链路（wb）接收 vector，此后分片共享，不再拷贝
+        capture_time = openhd::gst_buffer_capture_time(m_gst_pipeline, buffer);
+        // The first rtp fragment of a frame carries the capture time, such that
+        // the ground can measure the latency - added while copying
+        // 帧的第一个 RTP 分片携带采集时间，以便地面测量延迟 - 在拷贝时加入
+        std::optional<int64_t> tag_capture_time_us = std::nullopt;
+        if (!dirty_use_raw && capture_time.has_value() && m_frame_assembler->empty()) {
+            tag_capture_time_us = to_capture_time_us(capture_time.value());
+        }
+        fragment_data = openhd::gst_copy_buffer_to_fragment(buffer, tag_capture_time_us);
+    }
+    // Done with the buffer, give the sample back immediately
+    gst_sample_unref(sample);
+    if (fragment_data && !fragment_data->empty()) {
+        if (openhd::trace::is_enabled()) {
+            openhd::trace::record(openhd::trace::Stage::APPSINK_SAMPLE, dirty_use_raw ? 0 : openhd::trace::frame_id_from_rtp(fragment_data->data(), fragment_data->size()),
+                                  static_cast<int32_t>(fragment_data->size()));
+        }
+        // If we got a new sample, aggregate then forward
+        if (dirty_use_raw) {
+            // 调用 m_rtp_helper->feed_multiple_nalu()，将 fragment_data 中的数据传递给 RTP 协议处理模块。
+            m_curr_frame_capture_time = capture_time;
+            m_rtp_helper->set_capture_time(capture_time.has_value() ? std::optional<int64_t>(to_capture_time_us(capture_time.value())) : std::nullopt);
+            m_rtp_helper->feed_multiple_nalu(fragment_data->data(), fragment_data->size());
         } else {
-            m_last_fu_s_idr = false;
+            // 调用 on_new_rtp_frame_fragment()，传递 fragment_data 和采集时间 capture_time，用来进一步处理数据帧
+            on_new_rtp_frame_fragment(std::move(fragment_data), capture_time);
         }
+        m_last_camera_frame = std::chrono::steady_clock::now();
     }
-    // m_console->debug("Fragment {} start:{} end:{}
-    // type:{}",m_frame_fragments.size(),
-    //                  OHDUtil::yes_or_no(info.is_fu_start),
-    //                  OHDUtil::yes_or_no(info.is_fu_end),
-    //                  x_get_nal_unit_type_as_string(info.nal_unit_type,is_h265));
-    // 判断是否为帧的最后一个分片
-    bool is_last_fragment_of_frame = info.is_fu_end;
-    // 检查分片数量，防止陷入无限等待
-    if (m_frame_fragments.size() > 500) {
-        // Most likely something wrong with the "find end of frame" workaround
-        m_console->debug("No end of frame found after 1000 fragments");
-        is_last_fragment_of_frame = true;
-    }
-    // 如果是最后一个分片，处理完整帧
-    if (is_last_fragment_of_frame) {
-        on_new_rtp_fragmented_frame();
-        m_frame_fragments.resize(0);
-        m_last_fu_s_idr = false;
+}
+
+// 处理新接收到的 RTP 帧分片。
+// 接收来自 RTP 流的数据包片段，由帧组装器重新组装完整的帧
+void GStreamerStream::on_new_rtp_frame_fragment(std::shared_ptr<openhd::VideoFragment> fragment, std::optional<std::chrono::steady_clock::time_point> capture_time) {
+    if (m_frame_assembler->empty()) {
+        m_curr_frame_capture_time = capture_time;
     }
+    m_frame_assembler->add_fragment(std::move(fragment));
 }
 
 // 将完整的 RTP 帧分片组装并传递给回调函数
-void GStreamerStream::on_new_rtp_fragmented_frame() {
+void GStreamerStream::on_new_rtp_fragmented_frame(std::vector<std::shared_ptr<openhd::VideoFragment>>& frame_fragments, bool is_idr_frame) {
     // m_console->debug("Got frame with {} fragments",rtp_fragments.size());
     if (m_output_cb) {
-        const auto stream_index = m_camera_holder->get_camera().index;                                               // 获取当前摄像头的索引。
         const bool enable_ultra_secure_encryption = m_camera_holder->get_settings().enable_ultra_secure_encryption;  // 获取摄像头设置中是否启用了超安全加密。
         const bool is_intra_enabled =
             m_camera_holder->get_settings().h26x_intra_refresh_type != -1;  // 检查 H.26x 编码的内刷新类型是否有效。如果内刷新类型不为 -1，则说明启用了内刷新。
-        const bool is_intra_frame = m_last_fu_s_idr;  // 一个布尔值，表示当前帧是否为 I 帧（关键帧）。m_last_fu_s_idr 是通过前面的帧信息判断的，具体用途会在后面解释
-        auto frame = openhd::FragmentedVideoFrame{m_frame_fragments, std::chrono::steady_clock::now(), enable_ultra_secure_encryption, nullptr, is_intra_enabled, is_intra_frame};
+        auto frame = openhd::FragmentedVideoFrame{frame_fragments, std::chrono::steady_clock::now(), enable_ultra_secure_encryption, nullptr, is_intra_enabled, is_idr_frame};
+        add_capture_time(frame);
         // m_console->debug("{}",frame.to_string());
-        m_output_cb(stream_index, frame);
+        m_pending_frames.push_back(std::move(frame));
     } else {
         m_console->debug("No output cb");
     }
 }
 
 // 处理通过回调接收到的 RTP 帧分片。
-void GStreamerStream::x_on_new_rtp_fragmented_frame(std::vector<std::shared_ptr<std::vector<uint8_t>>> frame_fragments) {
+void GStreamerStream::x_on_new_rtp_fragmented_frame(std::vector<std::shared_ptr<openhd::VideoFragment>> frame_fragments) {
     if (m_output_cb) {
-        const auto stream_index = m_camera_holder->get_camera().index;
         const bool enable_ultra_secure_encryption = m_camera_holder->get_settings().enable_ultra_secure_encryption;
         const bool is_intra_enabled = m_camera_holder->get_settings().h26x_intra_refresh_type != -1;
-        const bool is_intra_frame = m_last_fu_s_idr;
+        const bool is_intra_frame = m_frame_assembler->contains_idr(frame_fragments);
         auto frame = openhd::FragmentedVideoFrame{frame_fragments, std::chrono::steady_clock::now(), enable_ultra_secure_encryption, nullptr, is_intra_enabled, is_intra_frame};
+        add_capture_time(frame);
         // m_console->debug("{}",frame.to_string());
-        m_output_cb(stream_index, frame);
+        m_pending_frames.push_back(std::move(frame));
     } else {
         m_console->debug("No output cb");
     }
 }
+
+// 将已完成的帧交给 WB 链路
+void GStreamerStream::forward_frames(std::vector<openhd::FragmentedVideoFrame>& frames) {
+    const auto stream_index = m_camera_holder->get_camera().index;
+    for (auto& frame : frames) {
+        m_output_cb(stream_index, frame);
+    }
+    frames.clear();
+}
+
+void GStreamerStream::add_capture_time(openhd::FragmentedVideoFrame& frame) {
+    if (frame.rtp_fragments.empty()) {
+        return;
+    }
+    if (openhd::trace::is_enabled()) {
+        openhd::trace::record(openhd::trace::Stage::FRAME_ASSEMBLED, openhd::trace::frame_id_from_rtp(frame.rtp_fragments[0]->data(), frame.rtp_fragments[0]->size()),
+                              static_cast<int32_t>(frame.rtp_fragments.size()));
+    }
+    // The first fragment already carries the capture time (rtp header
+    // extension), written before the fragment was shared
+    frame.capture_time = m_curr_frame_capture_time;
+}
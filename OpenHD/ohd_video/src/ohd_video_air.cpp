@@ -234,9 +234,12 @@ void OHDVideoAir::on_video_data(int stream_index, const openhd::FragmentedVideoF
         // {}",stream_index,fragmented_video_frame.rtp_fragments.size());
         auto& forwarder = stream_index == 0 ? m_primary_video_forwarder : m_secondary_video_forwarder;
         // 代码会遍历 fragmented_video_frame 中的所有 RTP 分片（rtp_fragments），并通过 UDP 将每个分片的数据发送出去，调用 forwardPacketViaUDP 方法进行转发。
+        std::vector<openhd::UDPPacketRef> packets;
+        packets.reserve(fragmented_video_frame.rtp_fragments.size());
         for (auto& fragment : fragmented_video_frame.rtp_fragments) {
-            forwarder->forwardPacketViaUDP(fragment->data(), fragment->size());
+            packets.push_back({fragment->data(), fragment->size()});
         }
+        forwarder->forwardPacketsViaUDP(packets);
         // 如果有脏帧，则将脏帧切割成多个分片，并通过 UDP 进行转发
         if (fragmented_video_frame.dirty_frame) {
             auto fragments = make_fragments(fragmented_video_frame.dirty_frame->data(), fragmented_video_frame.dirty_frame->size());
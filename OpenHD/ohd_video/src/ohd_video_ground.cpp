@@ -23,10 +23,16 @@
 
 #include "ohd_video_ground.h"
 
+#include <chrono>
 #include <utility>
 
 #include "openhd_config.h"
+#include "openhd_netlink.h"
+#include "openhd_rtp.h"
+#include "openhd_spdlog.h"
+#include "openhd_trace.h"
 #include "openhd_util.h"
+#include "openhd_util_time.h"
 
 OHDVideoGround::OHDVideoGround(std::shared_ptr<OHDLink> link_handle)
     : m_link_handle(std::move(link_handle)) {
@@ -34,16 +40,54 @@ OHDVideoGround::OHDVideoGround(std::shared_ptr<OHDLink> link_handle)
   m_primary_video_forwarder = std::make_unique<openhd::UDPMultiForwarder>();
   m_secondary_video_forwarder = std::make_unique<openhd::UDPMultiForwarder>();
   m_audio_forwarder = std::make_unique<openhd::UDPMultiForwarder>();
-  // We always forward video to localhost::5600 (primary) and 5601 (secondary)
-  // for the default Ground control application (e.g. QOpenHD) to pick up
-  addForwarder("127.0.0.1");
+  const auto config = openhd::load_config();
+  if (config.NW_VIDEO_SHM_OUTPUT) {
+    m_shm_writers[0] =
+        openhd::VideoShmWriter::create(OHD_VIDEO_SHM_NAME_PRIMARY);
+    m_shm_writers[1] =
+        openhd::VideoShmWriter::create(OHD_VIDEO_SHM_NAME_SECONDARY);
+  }
+  if (m_shm_writers[0] && m_shm_writers[1]) {
+    m_console->info("Video shm output {} {}", OHD_VIDEO_SHM_NAME_PRIMARY,
+                    OHD_VIDEO_SHM_NAME_SECONDARY);
+    // UDP to localhost is only the fallback while no local app reads the shm
+    for (int i = 0; i < 2; i++) {
+      m_localhost_video_forwarders[i] =
+          std::make_unique<openhd::UDPMultiForwarder>();
+      m_localhost_video_forwarders[i]->addForwarder("127.0.0.1", 5600 + i);
+    }
+    m_audio_forwarder->addForwarder("127.0.0.1", 5610);
+  } else {
+    m_shm_writers = {};
+    // We always forward video to localhost::5600 (primary) and 5601
+    // (secondary) for the default Ground control application (e.g. QOpenHD)
+    // to pick up
+    addForwarder("127.0.0.1");
+  }
   // See the description in the .config file for more info
-  if (openhd::load_config().NW_FORWARD_TO_LOCALHOST_58XX || true) {
+  if (config.NW_FORWARD_TO_LOCALHOST_58XX || true) {
     m_console->debug("Forwarding video to 5800/5801 localhost is enabled");
     // Adding forwarder for WebRTC
     m_primary_video_forwarder->addForwarder("127.0.0.1", 5800);
     m_secondary_video_forwarder->addForwarder("127.0.0.1", 5801);
   }
+  if (config.NW_FORWARD_VIDEO_UDP_GSO) {
+    m_primary_video_forwarder->set_use_gso(true);
+    m_secondary_video_forwarder->set_use_gso(true);
+  }
+  if (config.NW_VIDEO_JITTER_BUFFER_MS >= 0) {
+    m_console->info("Video jitter buffer {}ms{}",
+                    config.NW_VIDEO_JITTER_BUFFER_MS,
+                    config.NW_VIDEO_JITTER_BUFFER_WHOLE_FRAMES ? ", whole frames" : "");
+    for (int i = 0; i < static_cast<int>(m_jitter_buffers.size()); i++) {
+      m_jitter_buffers[i] = std::make_unique<openhd::RTPJitterBuffer>(
+          i, config.NW_VIDEO_JITTER_BUFFER_MS,
+          config.NW_VIDEO_JITTER_BUFFER_WHOLE_FRAMES,
+          [this, i](std::vector<std::shared_ptr<std::vector<uint8_t>>>& fragments) {
+            on_jitter_buffer_fragments(i, fragments);
+          });
+    }
+  }
   if (m_link_handle) {
     m_link_handle->register_on_receive_video_data_cb(
         [this](int stream_index, const uint8_t* data, int data_len) {
@@ -87,25 +131,114 @@ void OHDVideoGround::removeForwarder(const std::string& client_addr) {
 void OHDVideoGround::on_video_data(int stream_index, const uint8_t* data,
                                    int data_len) {
   // openhd::log::get_default()->debug("on_video_data {}",stream_index);
-  if (stream_index == 0) {
-    m_primary_video_forwarder->forwardPacketViaUDP(data, data_len);
-  } else if (stream_index == 1) {
-    m_secondary_video_forwarder->forwardPacketViaUDP(data, data_len);
-  } else {
-    openhd::log::get_default()->debug("Invalid stream index {}", stream_index);
+  if (openhd::trace::is_enabled()) {
+    openhd::trace::record(openhd::trace::Stage::GND_VIDEO_RX,
+                          openhd::trace::frame_id_from_rtp(data, data_len),
+                          data_len);
+  }
+  if (stream_index != 0 && stream_index != 1) {
+    OPENHD_DEBUG_EVERY_MS(openhd::log::get_default(), 1000,
+                          "Invalid stream index {}", stream_index);
+    return;
+  }
+  measure_capture_latency(stream_index, data, data_len);
+  auto& jitter_buffer = m_jitter_buffers[stream_index];
+  if (jitter_buffer && jitter_buffer->input(data, data_len)) {
+    return;
   }
+  // The data is only valid during this callback, forwarded right away
+  const openhd::UDPPacketRef packet{data, static_cast<std::size_t>(data_len)};
+  forward_video(stream_index, &packet, 1);
 }
 
-static bool ip_is_host_self(const std::string& ip) {
-  if (OHDUtil::str_equal(ip, "127.0.0.1")) {
-    // always self
-    return true;
+void OHDVideoGround::forward_video(int stream_index,
+                                   const openhd::UDPPacketRef* packets,
+                                   std::size_t n_packets) {
+  if (n_packets == 0) return;
+  auto& forwarder = stream_index == 0 ? m_primary_video_forwarder
+                                      : m_secondary_video_forwarder;
+  forwarder->forwardPacketsViaUDP(packets, n_packets);
+  auto& shm_writer = m_shm_writers[stream_index];
+  if (shm_writer) {
+    write_shm(stream_index, packets, n_packets);
+    if (!shm_writer->has_active_reader()) {
+      m_localhost_video_forwarders[stream_index]->forwardPacketsViaUDP(
+          packets, n_packets);
+    }
+  }
+}
+
+void OHDVideoGround::write_shm(int stream_index,
+                               const openhd::UDPPacketRef* packets,
+                               std::size_t n_packets) {
+  std::lock_guard<std::mutex> lock(m_shm_mutex[stream_index]);
+  auto& shm_writer = m_shm_writers[stream_index];
+  auto& frame_timestamp = m_shm_frame_timestamp[stream_index];
+  for (std::size_t i = 0; i < n_packets; i++) {
+    const auto& packet = packets[i];
+    const bool is_rtp = packet.size >= 12;
+    const uint32_t timestamp =
+        openhd::trace::frame_id_from_rtp(packet.data, packet.size);
+    // The end of the previous frame got lost - don't hold it back any longer
+    if (shm_writer->has_unpublished() &&
+        (!is_rtp || timestamp != frame_timestamp)) {
+      shm_writer->publish();
+    }
+    const bool end_of_frame = is_rtp && (packet.data[1] & 0x80) != 0;
+    shm_writer->write_packets(&packet, 1, end_of_frame);
+    frame_timestamp = timestamp;
+    if (end_of_frame || !is_rtp) {
+      shm_writer->publish();
+    }
+  }
+}
+
+void OHDVideoGround::on_jitter_buffer_fragments(
+    int stream_index,
+    std::vector<std::shared_ptr<std::vector<uint8_t>>>& fragments) {
+  auto& refs = m_video_refs[stream_index];
+  refs.clear();
+  for (const auto& fragment : fragments) {
+    refs.push_back({fragment->data(), fragment->size()});
   }
-  const auto hostname_ips = OHDUtil::run_command_out("hostname -I", false);
-  if (hostname_ips.has_value() && OHDUtil::contains(hostname_ips.value(), ip)) {
-    return true;
+  forward_video(stream_index, refs.data(), refs.size());
+  const auto now = std::chrono::steady_clock::now();
+  auto& last_log = m_jitter_buffer_log_time[stream_index];
+  if (now - last_log >= std::chrono::seconds(5)) {
+    last_log = now;
+    m_console->debug("{}",
+                     m_jitter_buffers[stream_index]->get_stats().to_string());
   }
-  return false;
+}
+
+void OHDVideoGround::measure_capture_latency(int stream_index,
+                                             const uint8_t* data,
+                                             int data_len) {
+  // Cheap - only the first fragment of a frame carries a header extension
+  const auto capture_time_air_us =
+      openhd::rtp_capture_time::get_extension(data, data_len);
+  if (!capture_time_air_us.has_value()) return;
+  // We need to know the air unit time offset to map the capture time
+  if (!openhd::util::has_air_unit_time_offset()) return;
+  const int64_t capture_time_us =
+      capture_time_air_us.value() + openhd::util::get_air_unit_time_offset_us();
+  const int64_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                             std::chrono::steady_clock::now().time_since_epoch())
+                             .count();
+  const int64_t latency_us = now_us - capture_time_us;
+  m_latency_tracker.add_sample(stream_index, latency_us);
+  const auto now = std::chrono::steady_clock::now();
+  auto& last_log = m_latency_log_time[stream_index];
+  if (now - last_log >= std::chrono::seconds(5)) {
+    last_log = now;
+    m_console->debug("{}",
+                     m_latency_tracker.get_and_reset(stream_index).to_string());
+  }
+}
+
+static bool ip_is_host_self(const std::string& ip) {
+  // 127.0.0.1 is always self, otherwise any address of a local interface
+  return openhd::NetlinkCache::instance().is_local_address(ip);
 }
 
 void OHDVideoGround::start_stop_forwarding_external_device(
@@ -23,6 +23,8 @@
 
 #include "openhd_rtp.h"
 
+#include <algorithm>
+#include <cstring>
 #include <utility>
 
 #include "nalu/CodecConfigFinder.hpp"
@@ -30,20 +32,16 @@
 #include "nalu/nalu_helper.h"
 #include "openhd_util_time.h"
 #include "rtp-profile.h"
-#include "rtp_eof_helper.h"
 
-static void* rtp_alloc(void* /*param*/, int bytes) {
-    static uint8_t buffer[2 * 1024 * 1024 + 4] = {
-        0,
-        0,
-        0,
-        1,
-    };
-    assert(bytes <= sizeof(buffer) - 4);
-    return buffer + 4;
+static void* rtp_alloc(void* param, int bytes) {
+    auto self = (openhd::RTPHelper*)param;
+    return self->on_rtp_alloc(bytes);
 }
 
-static void rtp_free(void* /*param*/, void* /*packet*/) {}
+static void rtp_free(void* param, void* packet) {
+    auto self = (openhd::RTPHelper*)param;
+    self->on_rtp_free(packet);
+}
 
 static int rtp_encode_packet(void* param, const void* packet, int bytes, uint32_t timestamp, int flags) {
     auto self = (openhd::RTPHelper*)param;
@@ -54,9 +52,17 @@ static int rtp_encode_packet(void* param, const void* packet, int bytes, uint32_
     return 0;
 }
 
-openhd::RTPHelper::RTPHelper(bool is_h265) : m_is_h265(is_h265) {
+openhd::RTPHelper::RTPHelper(bool is_h265, int width, int height, int framerate, int bitrate_kbits) : m_is_h265(is_h265) {
     m_console = openhd::log::create_or_get("RTPHelp");
 
+    // lib rtp fragments to rtp_packet_getsize(), the arena buffers have the
+    // room for the capture time extension on top
+    rtp_packet_setsize(RTP_MAX_PACKET_SIZE - rtp_capture_time::EXTENSION_SIZE);
+    const int rtp_mtu = RTP_MAX_PACKET_SIZE;
+    const int n_buffers = calculate_n_arena_buffers(width, height, framerate, bitrate_kbits, rtp_mtu);
+    m_arena = BufferPool::create(std::string("rtp_") + (m_is_h265 ? "h265" : "h264"), rtp_mtu, n_buffers);
+    m_console->debug("Packetization arena {} buffers of {} bytes", n_buffers, rtp_mtu);
+
     m_handler.alloc = rtp_alloc;
     m_handler.free = rtp_free;
     m_handler.packet = rtp_encode_packet;
@@ -73,17 +79,52 @@ openhd::RTPHelper::RTPHelper(bool is_h265) : m_is_h265(is_h265) {
     assert(encoder);
 }
 
+int openhd::RTPHelper::calculate_n_arena_buffers(int width, int height, int framerate, int bitrate_kbits, int rtp_mtu) {
+    int64_t max_frame_size_bytes = 0;
+    if (bitrate_kbits > 0 && framerate > 0) {
+        // A key frame can easily be 4x the size of an average frame
+        max_frame_size_bytes = static_cast<int64_t>(bitrate_kbits) * 1000 / 8 / framerate * 4;
+    } else if (width > 0 && height > 0) {
+        // Bitrate unknown, assume a (quite bad) compression ratio for the key
+        // frame
+        max_frame_size_bytes = static_cast<int64_t>(width) * height / 4;
+    } else {
+        // 1080p default
+        max_frame_size_bytes = 1920 * 1080 / 4;
+    }
+    const int64_t n_buffers = 2 * (max_frame_size_bytes / std::max(rtp_mtu, 1) + 1);
+    return static_cast<int>(std::clamp<int64_t>(n_buffers, 64, 4096));
+}
+
+void* openhd::RTPHelper::on_rtp_alloc(int bytes) {
+    // lib rtp never asks for more than one MTU - if it did, the buffer just
+    // grows (once)
+    assert(m_curr_packet_buffer == nullptr);
+    m_curr_packet_buffer = m_arena->acquire();
+    m_curr_packet_buffer->resize(bytes);
+    return m_curr_packet_buffer->data();
+}
+
+void openhd::RTPHelper::on_rtp_free(void* packet) {
+    // Only set if the packet was not handed out (error during packetization)
+    if (m_curr_packet_buffer != nullptr) {
+        assert(packet == m_curr_packet_buffer->data());
+        m_arena->release(m_curr_packet_buffer);
+        m_curr_packet_buffer = nullptr;
+    }
+}
+
 openhd::RTPHelper::~RTPHelper() {
     rtp_payload_encode_destroy(encoder);
 }
 
 // 从输入数据流中提取多个 NALU，并调用相应的处理函数对每个 NALU 进行处理
 void openhd::RTPHelper::feed_multiple_nalu(const uint8_t* data, int data_len) {
-    int offset = 0;
-    while (offset < data_len) {
-        int nalu_len = find_next_nal(&data[offset], data_len);
-        on_new_split_nalu(&data[offset], nalu_len);
-        offset += nalu_len;
+    // 一次扫描得到所有 NALU 的边界
+    m_nal_spans.clear();
+    split_nal_units(data, data_len, m_nal_spans);
+    for (const auto& span : m_nal_spans) {
+        on_new_split_nalu(&data[span.offset], span.size);
     }
 }
 
@@ -104,8 +145,26 @@ void openhd::RTPHelper::on_new_rtp_fragment(const uint8_t* data, int data_len, u
     // m_console->debug("on_new_rtp_fragment {} ts:{} last:{}", data_len,
     // timestamp,
     //                  last);
-    auto shared = std::make_shared<std::vector<uint8_t>>(data, data + data_len);
-    m_frame_fragments.emplace_back(shared);
+    std::vector<uint8_t>* buffer = nullptr;
+    if (m_curr_packet_buffer != nullptr && data == m_curr_packet_buffer->data()) {
+        // Written in place, hand the buffer out without a copy
+        buffer = m_curr_packet_buffer;
+        buffer->resize(data_len);
+        m_curr_packet_buffer = nullptr;
+    } else {
+        buffer = m_arena->acquire();
+        buffer->assign(data, data + data_len);
+    }
+    // Tag the first fragment of the frame before it is shared
+    // 在分片被共享之前，给帧的第一个分片加上采集时间
+    if (m_frame_fragments.empty() && m_capture_time_us.has_value()) {
+        rtp_capture_time::add_extension(*buffer, m_capture_time_us.value());
+    }
+    m_frame_fragments.emplace_back(std::make_shared<openhd::PooledVideoFragment>(m_arena, buffer));
+}
+
+void openhd::RTPHelper::set_capture_time(std::optional<int64_t> capture_time_us) {
+    m_capture_time_us = capture_time_us;
 }
 
 void openhd::RTPHelper::set_out_cb(openhd::RTPHelper::OUT_CB cb) {
@@ -113,7 +172,11 @@ void openhd::RTPHelper::set_out_cb(openhd::RTPHelper::OUT_CB cb) {
 }
 
 void openhd::RTPHelper::on_new_split_nalu(const uint8_t* data, int data_len) {
-    NALU nalu(data, data_len);
+    if (data_len < static_cast<int>(NALU::getMinimumNaluSize(m_is_h265))) {
+        // start code without (complete) header, nothing we can do with it
+        return;
+    }
+    NALU nalu(data, data_len, m_is_h265);
     // m_console->debug("Got new NAL {}
     // {}",data_len,nalu.get_nal_unit_type_as_string()); if(nalu.is_sei())return;
     if (m_config_finder.all_config_available(m_is_h265)) {
@@ -150,45 +213,103 @@ void openhd::RTPHelper::on_new_nalu_frame(const uint8_t* data, int data_len) {
     feed_nalu(data, data_len);
 }
 
-openhd::RTPFragmentBuffer::RTPFragmentBuffer() {
+openhd::RTPFragmentBuffer::RTPFragmentBuffer(bool is_h265)
+    : m_frame_assembler(is_h265 ? VideoCodec::H265 : VideoCodec::H264,
+                        [this](std::vector<std::shared_ptr<openhd::VideoFragment>>& frame_fragments, bool is_idr_frame) {
+                            on_new_rtp_fragmented_frame(frame_fragments, is_idr_frame);
+                        }) {
     m_console = openhd::log::create_or_get("RTPFragmentBuffer");
 }
 
-void openhd::RTPFragmentBuffer::buffer_and_forward(std::shared_ptr<std::vector<uint8_t>> fragment, uint64_t dts) {
-    m_frame_fragments.push_back(fragment);
-    openhd::rtp_eof_helper::RTPFragmentInfo info{};
-    if (m_is_h265) {
-        info = openhd::rtp_eof_helper::h265_more_info(fragment->data(), fragment->size());
-    } else {
-        info = openhd::rtp_eof_helper::h264_more_info(fragment->data(), fragment->size());
+void openhd::RTPFragmentBuffer::buffer_and_forward(std::shared_ptr<openhd::VideoFragment> fragment) {
+    m_frame_assembler.add_fragment(std::move(fragment));
+}
+
+void openhd::RTPFragmentBuffer::on_new_rtp_fragmented_frame(std::vector<std::shared_ptr<openhd::VideoFragment>>& frame_fragments, bool is_idr_frame) {
+    auto frame = openhd::FragmentedVideoFrame{frame_fragments, std::chrono::steady_clock::now(), m_enable_ultra_secure_encryption, nullptr, m_uses_intra_refresh, is_idr_frame};
+    // m_console->debug("{}",frame.to_string());
+    if (m_out_cb) {
+        m_out_cb(m_stream_index, frame);
     }
-    if (info.is_fu_start) {
-        if (is_idr_frame(info.nal_unit_type, m_is_h265)) {
-            m_last_fu_s_idr = true;
-        } else {
-            m_last_fu_s_idr = false;
-        }
+}
+
+void openhd::RTPFragmentBuffer::set_out_cb(openhd::ON_ENCODE_FRAME_CB cb) {
+    m_out_cb = std::move(cb);
+}
+
+// 12 bytes fixed header, followed by 0..15 CSRC identifiers
+static constexpr int RTP_FIXED_HEADER_SIZE = 12;
+static constexpr uint16_t RTP_ONE_BYTE_EXTENSION_PROFILE = 0xBEDE;
+
+static int rtp_header_size_without_extension(const uint8_t* data, int data_len) {
+    if (data_len < RTP_FIXED_HEADER_SIZE || (data[0] >> 6) != 2) {
+        return -1;
     }
-    // m_console->debug("Fragment {} start:{} end:{}
-    // type:{}",m_frame_fragments.size(),
-    //                  OHDUtil::yes_or_no(info.is_fu_start),
-    //                  OHDUtil::yes_or_no(info.is_fu_end),
-    //                  x_get_nal_unit_type_as_string(info.nal_unit_type,is_h265));
-    bool is_last_fragment_of_frame = info.is_fu_end;
-    if (m_frame_fragments.size() > 500) {
-        // Most likely something wrong with the "find end of frame" workaround
-        m_console->debug("No end of frame found after 1000 fragments");
-        is_last_fragment_of_frame = true;
+    const int csrc_count = data[0] & 0x0F;
+    const int header_size = RTP_FIXED_HEADER_SIZE + csrc_count * 4;
+    return header_size <= data_len ? header_size : -1;
+}
+
+bool openhd::rtp_capture_time::add_extension(std::vector<uint8_t>& packet, int64_t capture_time_us) {
+    const int data_len = static_cast<int>(packet.size());
+    const int header_size = rtp_header_size_without_extension(packet.data(), data_len);
+    if (header_size < 0 || (packet[0] & 0x10) != 0) {
+        return false;
     }
-    if (is_last_fragment_of_frame) {
-        on_new_rtp_fragmented_frame();
-        m_frame_fragments.resize(0);
-        m_last_fu_s_idr = false;
+    packet.resize(data_len + EXTENSION_SIZE);
+    uint8_t* data = packet.data();
+    // make room for the extension between header and payload
+    std::memmove(data + header_size + EXTENSION_SIZE, data + header_size, data_len - header_size);
+    // set the X bit
+    data[0] |= 0x10;
+    uint8_t* ext = data + header_size;
+    ext[0] = RTP_ONE_BYTE_EXTENSION_PROFILE >> 8;
+    ext[1] = RTP_ONE_BYTE_EXTENSION_PROFILE & 0xFF;
+    // length in 32 bit words, excluding the extension header
+    ext[2] = 0;
+    ext[3] = (EXTENSION_SIZE - 4) / 4;
+    ext[4] = (EXTENSION_ID << 4) | (8 - 1);
+    const auto value = static_cast<uint64_t>(capture_time_us);
+    for (int i = 0; i < 8; i++) {
+        ext[5 + i] = static_cast<uint8_t>(value >> (56 - i * 8));
     }
+    // padding
+    std::memset(ext + 13, 0, EXTENSION_SIZE - 13);
+    return true;
 }
 
-void openhd::RTPFragmentBuffer::on_new_rtp_fragmented_frame() {
-    const bool is_intra_frame = m_last_fu_s_idr;
-    auto frame = openhd::FragmentedVideoFrame{m_frame_fragments, std::chrono::steady_clock::now(), m_enable_ultra_secure_encryption, nullptr, m_uses_intra_refresh, is_intra_frame};
-    // m_console->debug("{}",frame.to_string());
+std::optional<int64_t> openhd::rtp_capture_time::get_extension(const uint8_t* data, int data_len) {
+    const int header_size = rtp_header_size_without_extension(data, data_len);
+    if (header_size < 0 || (data[0] & 0x10) == 0 || header_size + 4 > data_len) {
+        return std::nullopt;
+    }
+    const uint8_t* ext = data + header_size;
+    const uint16_t profile = (ext[0] << 8) | ext[1];
+    const int ext_len = ((ext[2] << 8) | ext[3]) * 4;
+    if (profile != RTP_ONE_BYTE_EXTENSION_PROFILE || header_size + 4 + ext_len > data_len) {
+        return std::nullopt;
+    }
+    const uint8_t* p = ext + 4;
+    const uint8_t* end = p + ext_len;
+    while (p < end) {
+        if (*p == 0) {
+            // padding
+            p++;
+            continue;
+        }
+        const int id = *p >> 4;
+        const int len = (*p & 0x0F) + 1;
+        if (id == 15 || p + 1 + len > end) {
+            break;
+        }
+        if (id == EXTENSION_ID && len == 8) {
+            uint64_t value = 0;
+            for (int i = 0; i < 8; i++) {
+                value = (value << 8) | p[1 + i];
+            }
+            return static_cast<int64_t>(value);
+        }
+        p += 1 + len;
+    }
+    return std::nullopt;
 }
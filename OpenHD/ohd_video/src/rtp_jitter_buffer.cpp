@@ -0,0 +1,227 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "rtp_jitter_buffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <utility>
+
+#include "openhd_buffer_pool.h"
+#include "openhd_spdlog.h"
+#include "rtp-demuxer.h"
+#include "rtp-payload.h"
+
+// h264 / h265
+static constexpr int RTP_VIDEO_FREQUENCY = 90000;
+
+openhd::RTPJitterBuffer::RTPJitterBuffer(int stream_index, int jitter_ms,
+                                         bool emit_whole_frames, OUT_CB out_cb)
+    : m_stream_index(stream_index),
+      m_jitter_ms(jitter_ms > 0 ? jitter_ms : 0),
+      m_emit_whole_frames(emit_whole_frames),
+      m_out_cb(std::move(out_cb)) {
+  // Any payload type - the air unit decides
+  m_demuxer = rtp_demuxer_create(m_jitter_ms, RTP_VIDEO_FREQUENCY, -1, nullptr,
+                                 &RTPJitterBuffer::on_packet, this);
+  if (m_demuxer == nullptr) {
+    openhd::log::get_default()->warn("Cannot create rtp demuxer");
+  } else {
+    rtp_demuxer_set_allocator(m_demuxer, &RTPJitterBuffer::on_packet_alloc,
+                              &RTPJitterBuffer::on_packet_free);
+  }
+  m_fragments.reserve(MAX_N_FRAGMENTS_PER_FRAME);
+  if (m_demuxer != nullptr && (m_jitter_ms > 0 || m_emit_whole_frames)) {
+    m_timer_thread =
+        std::make_unique<std::thread>(&RTPJitterBuffer::loop_timer, this);
+  }
+}
+
+openhd::RTPJitterBuffer::~RTPJitterBuffer() {
+  if (m_timer_thread) {
+    {
+      std::lock_guard<std::recursive_mutex> lock(m_mutex);
+      m_timer_stop = true;
+    }
+    m_timer_cv.notify_one();
+    m_timer_thread->join();
+    m_timer_thread = nullptr;
+  }
+  rtp_demuxer_destroy(&m_demuxer);
+}
+
+bool openhd::RTPJitterBuffer::input(const uint8_t* data, int data_len) {
+  if (m_demuxer == nullptr) return false;
+  std::lock_guard<std::recursive_mutex> lock(m_mutex);
+  if (rtp_demuxer_input(m_demuxer, data, data_len) < 0) return false;
+  // Something is waiting for a missing packet or the end of the frame - wake
+  // up the timer
+  if (m_timer_thread && m_timer_idle &&
+      (rtp_demuxer_poll(m_demuxer) >= 0 || (m_emit_whole_frames && m_in_frame))) {
+    m_timer_idle = false;
+    m_timer_cv.notify_one();
+  }
+  // Otherwise, forward whatever the jitter buffer released
+  if (!m_emit_whole_frames && !m_fragments.empty()) {
+    forward_fragments();
+  }
+  return true;
+}
+
+void openhd::RTPJitterBuffer::loop_timer() {
+  std::unique_lock<std::recursive_mutex> lock(m_mutex);
+  while (!m_timer_stop) {
+    // Release what waited for a missing packet for jitter_ms
+    int timeout_ms = rtp_demuxer_poll(m_demuxer);
+    if (!m_emit_whole_frames && !m_fragments.empty()) {
+      forward_fragments();
+    }
+    // The end of the frame got lost and nothing came in since
+    if (m_emit_whole_frames && m_in_frame) {
+      const auto elapsed_ms =
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              std::chrono::steady_clock::now() - m_last_fragment_time)
+              .count();
+      if (elapsed_ms >= FRAME_TIMEOUT_MS) {
+        end_frame(false);
+      } else {
+        const int frame_timeout_ms = FRAME_TIMEOUT_MS - static_cast<int>(elapsed_ms);
+        timeout_ms = timeout_ms < 0 ? frame_timeout_ms
+                                    : std::min(timeout_ms, frame_timeout_ms);
+      }
+    }
+    m_timer_idle = timeout_ms < 0;
+    if (m_timer_idle) {
+      m_timer_cv.wait(lock, [this] { return m_timer_stop || !m_timer_idle; });
+    } else {
+      m_timer_cv.wait_for(lock,
+                          std::chrono::milliseconds(std::max(timeout_ms, 1)));
+    }
+  }
+}
+
+int openhd::RTPJitterBuffer::on_packet(void* param, const void* packet,
+                                       int bytes, uint32_t timestamp,
+                                       int flags) {
+  auto self = static_cast<RTPJitterBuffer*>(param);
+  const auto* data = static_cast<const uint8_t*>(packet);
+  const auto timestamp_delta =
+      static_cast<int32_t>(timestamp - self->m_curr_frame_timestamp);
+  if (self->m_count_frames > 0 || self->m_in_frame) {
+    if (timestamp_delta < 0 || (!self->m_in_frame && timestamp_delta == 0)) {
+      // Straggler of an already forwarded frame (only in pass through mode).
+      // A whole frame must not start with the tail of an older one - drop it.
+      if (!self->m_emit_whole_frames) {
+        self->m_fragments.push_back(self->take_packet(data, bytes));
+      }
+      return 0;
+    }
+    if (self->m_in_frame && timestamp_delta > 0) {
+      // The end of the previous frame got lost
+      self->end_frame(false);
+    }
+  }
+  if (flags & RTP_PAYLOAD_FLAG_PACKET_LOST) {
+    self->m_curr_frame_lost = true;
+  }
+  self->m_fragments.push_back(self->take_packet(data, bytes));
+  self->m_last_fragment_time = std::chrono::steady_clock::now();
+  self->m_in_frame = true;
+  self->m_curr_frame_timestamp = timestamp;
+  const bool marker = (data[1] & 0x80) != 0;
+  if (marker) {
+    self->end_frame(true);
+  } else if (self->m_fragments.size() >= MAX_N_FRAGMENTS_PER_FRAME) {
+    self->forward_fragments();
+  }
+  return 0;
+}
+
+void* openhd::RTPJitterBuffer::on_packet_alloc(void* /*param*/, int bytes,
+                                               void** handle) {
+  auto buffer = BufferPool::video()->acquire();
+  buffer->resize(bytes);
+  *handle = buffer;
+  return buffer->data();
+}
+
+void openhd::RTPJitterBuffer::on_packet_free(void* /*param*/, void* handle) {
+  BufferPool::video()->release(static_cast<std::vector<uint8_t>*>(handle));
+}
+
+std::shared_ptr<std::vector<uint8_t>> openhd::RTPJitterBuffer::take_packet(
+    const uint8_t* data, int bytes) {
+  auto buffer =
+      static_cast<std::vector<uint8_t>*>(rtp_demuxer_take_packet(m_demuxer));
+  if (buffer != nullptr) {
+    return BufferPool::video()->adopt(buffer);
+  }
+  // Pass through - only valid during the callback
+  return BufferPool::video()->get_buffer_and_copy(data, bytes);
+}
+
+void openhd::RTPJitterBuffer::end_frame(bool marker) {
+  m_count_frames++;
+  if (!marker || m_curr_frame_lost) {
+    m_count_frames_incomplete++;
+  }
+  m_curr_frame_lost = false;
+  m_in_frame = false;
+  if (m_emit_whole_frames && !m_fragments.empty()) {
+    forward_fragments();
+  }
+}
+
+void openhd::RTPJitterBuffer::forward_fragments() {
+  m_out_cb(m_fragments);
+  m_fragments.clear();
+}
+
+openhd::RTPJitterBuffer::Stats openhd::RTPJitterBuffer::get_stats() const {
+  std::lock_guard<std::recursive_mutex> lock(m_mutex);
+  Stats ret{};
+  ret.stream_index = m_stream_index;
+  ret.jitter_ms = m_jitter_ms;
+  if (m_demuxer != nullptr) {
+    int lost = 0, late = 0, misordered = 0, duplicate = 0;
+    rtp_demuxer_stats(m_demuxer, &lost, &late, &misordered, &duplicate);
+    ret.count_lost = lost;
+    ret.count_late = late;
+    ret.count_misordered = misordered;
+    ret.count_duplicate = duplicate;
+  }
+  ret.count_frames = m_count_frames;
+  ret.count_frames_incomplete = m_count_frames_incomplete;
+  return ret;
+}
+
+std::string openhd::RTPJitterBuffer::Stats::to_string() const {
+  std::stringstream ss;
+  ss << "RTPJitterBuffer::Stats{stream_index:" << stream_index
+     << ",jitter:" << jitter_ms << "ms,lost:" << count_lost
+     << ",late:" << count_late << ",misordered:" << count_misordered
+     << ",duplicate:" << count_duplicate << ",frames:" << count_frames
+     << ",incomplete:" << count_frames_incomplete << "}";
+  return ss.str();
+}
@@ -0,0 +1,160 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "video_shm_writer.h"
+
+#include <utility>
+
+#include "openhd_spdlog.h"
+
+std::unique_ptr<openhd::VideoShmWriter> openhd::VideoShmWriter::create(
+    const std::string& name, std::size_t capacity) {
+  // Header on its own page(s), data region page aligned
+  const std::size_t page_size = sysconf(_SC_PAGESIZE);
+  const std::size_t header_size =
+      (sizeof(ohd_video_shm_header) + page_size - 1) / page_size * page_size;
+  capacity = (capacity + page_size - 1) / page_size * page_size;
+  const std::size_t map_size = header_size + capacity;
+  // A stale object (crash) from a previous run is replaced - readers that
+  // still map it need to re-open
+  shm_unlink(name.c_str());
+  // Owner and group only (the ground station UI runs in the same group)
+  const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0660);
+  if (fd < 0) {
+    openhd::log::get_default()->warn("Cannot create shm {}: {}", name,
+                                     strerror(errno));
+    return nullptr;
+  }
+  if (ftruncate(fd, static_cast<off_t>(map_size)) != 0) {
+    openhd::log::get_default()->warn("Cannot resize shm {}: {}", name,
+                                     strerror(errno));
+    close(fd);
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+  void* map =
+      mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    openhd::log::get_default()->warn("Cannot map shm {}: {}", name,
+                                     strerror(errno));
+    close(fd);
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+  auto header = static_cast<ohd_video_shm_header*>(map);
+  memset(header, 0, sizeof(ohd_video_shm_header));
+  header->capacity = capacity;
+  header->header_size = header_size;
+  header->writer_pid = getpid();
+  header->version = OHD_VIDEO_SHM_VERSION;
+  // Readers check the magic last
+  __atomic_store_n(&header->magic, OHD_VIDEO_SHM_MAGIC, __ATOMIC_RELEASE);
+  return std::unique_ptr<VideoShmWriter>(
+      new VideoShmWriter(name, fd, map, map_size));
+}
+
+openhd::VideoShmWriter::VideoShmWriter(std::string name, int fd, void* map,
+                                       std::size_t map_size)
+    : m_name(std::move(name)), m_fd(fd), m_map(map), m_map_size(map_size) {
+  m_header = static_cast<ohd_video_shm_header*>(m_map);
+  m_data = static_cast<uint8_t*>(m_map) + m_header->header_size;
+  m_capacity = m_header->capacity;
+  m_write_pos = 0;
+  m_published_pos = 0;
+}
+
+openhd::VideoShmWriter::~VideoShmWriter() {
+  munmap(m_map, m_map_size);
+  close(m_fd);
+  shm_unlink(m_name.c_str());
+}
+
+void openhd::VideoShmWriter::write_record(const uint8_t* data, uint32_t size,
+                                          uint32_t flags,
+                                          uint64_t write_time_us) {
+  const uint64_t record_size =
+      sizeof(ohd_video_shm_record) + ohd_video_shm_align(size);
+  m_write_pos = ohd_video_shm_skip_tail(m_write_pos, m_capacity);
+  const uint64_t offset = m_write_pos % m_capacity;
+  // Doesn't fit before the end of the ring - readers skip to the begin
+  const bool wrap = offset + record_size > m_capacity;
+  const uint64_t record_pos =
+      wrap ? m_write_pos + m_capacity - offset : m_write_pos;
+  // Readers must not trust what we are about to overwrite
+  __atomic_store_n(&m_header->reserve_pos, record_pos + record_size,
+                   __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (wrap) {
+    auto wrap_record =
+        reinterpret_cast<ohd_video_shm_record*>(m_data + offset);
+    wrap_record->size = 0;
+    wrap_record->flags = OHD_VIDEO_SHM_FLAG_WRAP;
+    m_write_pos = record_pos;
+  }
+  auto record = reinterpret_cast<ohd_video_shm_record*>(
+      m_data + m_write_pos % m_capacity);
+  record->size = size;
+  record->flags = flags;
+  record->write_time_us = write_time_us;
+  memcpy(record + 1, data, size);
+  m_write_pos += record_size;
+}
+
+void openhd::VideoShmWriter::write_packets(const UDPPacketRef* packets,
+                                           std::size_t n_packets,
+                                           bool end_of_frame) {
+  if (n_packets == 0) return;
+  const uint64_t now_us = ohd_video_shm_clock_us();
+  for (std::size_t i = 0; i < n_packets; i++) {
+    const auto& packet = packets[i];
+    // Can never fit (and is no rtp fragment anyways)
+    if (packet.size + sizeof(ohd_video_shm_record) > m_capacity / 4) continue;
+    const bool is_last = i == n_packets - 1;
+    write_record(packet.data, static_cast<uint32_t>(packet.size),
+                 is_last && end_of_frame ? OHD_VIDEO_SHM_FLAG_FRAME_END : 0,
+                 now_us);
+    // Readers must not be overrun by what they cannot see yet (e.g. a
+    // corrupted stream without end of frame)
+    if (m_write_pos - m_published_pos > m_capacity / 4) publish();
+  }
+}
+
+void openhd::VideoShmWriter::publish() {
+  if (!has_unpublished()) return;
+  m_published_pos = m_write_pos;
+  // Publish the whole frame / burst at once, then wake up readers (if any is
+  // waiting)
+  __atomic_store_n(&m_header->write_pos, m_write_pos, __ATOMIC_RELEASE);
+  __atomic_fetch_add(&m_header->futex_seq, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&m_header->n_waiters, __ATOMIC_SEQ_CST) > 0) {
+    syscall(SYS_futex, &m_header->futex_seq, FUTEX_WAKE, INT_MAX, nullptr,
+            nullptr, 0);
+  }
+}
+
+bool openhd::VideoShmWriter::has_active_reader() const {
+  const uint64_t heartbeat_ms =
+      __atomic_load_n(&m_header->reader_heartbeat_ms, __ATOMIC_RELAXED);
+  if (heartbeat_ms == 0) return false;
+  return ohd_video_shm_clock_us() / 1000 - heartbeat_ms < READER_TIMEOUT_MS;
+}
@@ -0,0 +1,103 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "camera_holder.h"
+#include "config_paths.h"
+#include "gstreamerstream.h"
+#include "openhd_test_helper.h"
+#include "openhd_util.h"
+#include "openhd_util_filesystem.h"
+
+// Runs GStreamerStream with the dummy camera, once with the appsink
+// new-sample callback (default) and once with the old 40ms polling
+// (appsink_poll.txt), and measures how long it takes from the capture time
+// of a frame until it reaches the output (WB link) callback.
+// Optional argument: duration per mode in seconds.
+
+namespace {
+
+struct Result {
+    std::mutex mutex;
+    int n_frames = 0;
+    std::vector<int64_t> latencies_us;
+};
+
+bool run(bool use_polling, std::chrono::seconds duration) {
+    const std::string poll_file = std::string(getConfigBasePath()) + "appsink_poll.txt";
+    const bool had_poll_file = OHDFilesystemUtil::exists(poll_file);
+    if (use_polling) {
+        OHDFilesystemUtil::write_file(poll_file, "");
+    } else {
+        OHDFilesystemUtil::remove_if_existing(poll_file);
+    }
+    Result result;
+    auto cb = [&result](int, const openhd::FragmentedVideoFrame& frame) {
+        std::lock_guard<std::mutex> guard(result.mutex);
+        result.n_frames++;
+        if (frame.capture_time.has_value()) {
+            const auto latency = std::chrono::steady_clock::now() - frame.capture_time.value();
+            result.latencies_us.push_back(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+        }
+    };
+    {
+        auto camera_holder = std::make_shared<CameraHolder>(XCamera{X_CAM_TYPE_DUMMY_SW, 0, 0});
+        auto stream = std::make_shared<GStreamerStream>(camera_holder, cb);
+        stream->start_looping();
+        std::this_thread::sleep_for(duration);
+        stream->terminate_looping();
+    }
+    // Leave the config dir as we found it
+    if (had_poll_file) {
+        OHDFilesystemUtil::write_file(poll_file, "");
+    } else {
+        OHDFilesystemUtil::remove_if_existing(poll_file);
+    }
+    std::lock_guard<std::mutex> guard(result.mutex);
+    using openhd_test_helper::percentile;
+    const auto& v = result.latencies_us;
+    std::cout << (use_polling ? "polling " : "callback") << " frames:" << result.n_frames << " latency p50:" << percentile(v, 0.5) << "us p90:" << percentile(v, 0.9)
+              << "us p99:" << percentile(v, 0.99) << "us max:" << percentile(v, 1.0) << "us" << std::endl;
+    return result.n_frames > 0;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    // We need root to read / write camera settings.
+    OHDUtil::terminate_if_not_root();
+    const auto duration = std::chrono::seconds(argc > 1 ? std::max(1, std::atoi(argv[1])) : 10);
+    bool ok = true;
+    ok &= openhd_test_helper::check(run(true, duration), "polling delivers frames");
+    ok &= openhd_test_helper::check(run(false, duration), "callback delivers frames");
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,187 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "camera_settings.hpp"
+#include "ffmpeg_videosamples.hpp"
+#include "nalu/NALU.hpp"
+#include "nalu/nalu_helper.h"
+#include "openhd_rtp.h"
+#include "rtp_eof_helper.h"
+#include "rtp_frame_assembler.hpp"
+
+//
+// Validates RTPFrameAssembler against the previous frame assembly code
+// (GStreamerStream::on_new_rtp_frame_fragment - codec looked up from the
+// camera settings and h264_more_info / h265_more_info on every fragment) and
+// compares their throughput.
+// 验证 RTPFrameAssembler 与之前的帧组装代码（GStreamerStream::on_new_rtp_frame_fragment）结果一致，并比较吞吐量。
+
+namespace {
+
+struct Frame {
+  size_t n_fragments;
+  bool is_idr;
+};
+
+// Copy of the previous implementation
+class LegacyAssembler {
+ public:
+  explicit LegacyAssembler(const CameraSettings& settings) : m_settings(settings) {}
+  std::vector<Frame> frames;
+  void on_new_rtp_frame_fragment(std::shared_ptr<openhd::VideoFragment> fragment) {
+    m_frame_fragments.push_back(fragment);
+    const auto curr_video_codec = m_settings.streamed_video_format.videoCodec;
+    openhd::rtp_eof_helper::RTPFragmentInfo info{};
+    const bool is_h265 = curr_video_codec == VideoCodec::H265;
+    if (is_h265) {
+      info = openhd::rtp_eof_helper::h265_more_info(fragment->data(), fragment->size());
+    } else {
+      info = openhd::rtp_eof_helper::h264_more_info(fragment->data(), fragment->size());
+    }
+    if (info.is_fu_start) {
+      m_last_fu_s_idr = is_idr_frame(info.nal_unit_type, is_h265);
+    }
+    bool is_last_fragment_of_frame = info.is_fu_end;
+    if (m_frame_fragments.size() > 500) {
+      is_last_fragment_of_frame = true;
+    }
+    if (is_last_fragment_of_frame) {
+      frames.push_back({m_frame_fragments.size(), m_last_fu_s_idr});
+      m_frame_fragments.resize(0);
+      m_last_fu_s_idr = false;
+    }
+  }
+
+ private:
+  const CameraSettings& m_settings;
+  std::vector<std::shared_ptr<openhd::VideoFragment>> m_frame_fragments;
+  bool m_last_fu_s_idr = false;
+};
+
+// 1 IDR every 30 frames, packetized with lib rtp
+std::vector<std::shared_ptr<openhd::VideoFragment>> create_rtp_stream(bool is_h265, int n_frames) {
+  std::vector<std::shared_ptr<openhd::VideoFragment>> ret;
+  openhd::RTPHelper helper(is_h265);
+  helper.set_out_cb([&ret](std::vector<std::shared_ptr<openhd::VideoFragment>> fragments) {
+    ret.insert(ret.end(), fragments.begin(), fragments.end());
+  });
+  // Only the codec config of the sample frame (its slices would be single NAL
+  // unit packets with the marker bit set, which the legacy code does not treat
+  // as end of frame)
+  const uint8_t* sample = is_h265 ? k_HEVCMainTestFrame : k_H264TestFrame;
+  const int sample_len = is_h265 ? sizeof(k_HEVCMainTestFrame) : sizeof(k_H264TestFrame);
+  std::vector<NalUnitSpan> spans;
+  split_nal_units(sample, sample_len, spans);
+  for (const auto& span : spans) {
+    const uint8_t* nal = &sample[span.offset];
+    const uint8_t header = nal[nal[2] == 1 ? 3 : 4];
+    const bool is_config = is_h265 ? ((header >> 1) & 0x3f) >= 32 : (header & 0x1f) == 7 || (header & 0x1f) == 8;
+    if (is_config) helper.feed_multiple_nalu(nal, span.size);
+  }
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> dist(1, 255);
+  for (int i = 0; i < n_frames; i++) {
+    const bool idr = i % 30 == 0;
+    std::vector<uint8_t> nalu = {0, 0, 0, 1};
+    if (is_h265) {
+      // IDR_N_LP / TRAIL_R
+      nalu.insert(nalu.end(), {static_cast<uint8_t>(idr ? 20 << 1 : 1 << 1), 1});
+    } else {
+      nalu.push_back(idr ? 0x65 : 0x41);
+    }
+    const int size = idr ? 60 * 1000 : 15 * 1000;
+    for (int j = 0; j < size; j++) nalu.push_back(static_cast<uint8_t>(dist(rng)));
+    helper.feed_multiple_nalu(nalu.data(), static_cast<int>(nalu.size()));
+  }
+  return ret;
+}
+
+// Best of 5, returns fragments/s
+template <typename F>
+double benchmark(const std::vector<std::shared_ptr<openhd::VideoFragment>>& stream, int n_runs, F&& f) {
+  double best = 0;
+  for (int repeat = 0; repeat < 5; repeat++) {
+    const auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < n_runs; i++) {
+      for (const auto& fragment : stream) f(fragment);
+    }
+    const double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    best = std::max(best, static_cast<double>(stream.size()) * n_runs / elapsed_s);
+  }
+  return best;
+}
+
+bool validate_and_benchmark(VideoCodec codec, int n_runs) {
+  const bool is_h265 = codec == VideoCodec::H265;
+  const auto stream = create_rtp_stream(is_h265, 300);
+  CameraSettings settings{};
+  settings.streamed_video_format.videoCodec = codec;
+  LegacyAssembler legacy(settings);
+  std::vector<Frame> frames;
+  openhd::AnyRTPFrameAssembler assembler(codec, [&frames](std::vector<std::shared_ptr<openhd::VideoFragment>>& fragments, bool is_idr) {
+    frames.push_back({fragments.size(), is_idr});
+  });
+  for (const auto& fragment : stream) {
+    legacy.on_new_rtp_frame_fragment(fragment);
+    assembler.add_fragment(fragment);
+  }
+  bool ok = frames.size() == legacy.frames.size();
+  int n_idr = 0;
+  for (size_t i = 0; ok && i < frames.size(); i++) {
+    ok &= frames[i].n_fragments == legacy.frames[i].n_fragments;
+    // The previous h265 code never reported IDR frames
+    if (!is_h265) ok &= frames[i].is_idr == legacy.frames[i].is_idr;
+    n_idr += frames[i].is_idr;
+  }
+  ok &= n_idr == 10;
+  std::cout << video_codec_to_string(codec) << ": " << stream.size() << " fragments, " << frames.size() << " frames, " << n_idr << " IDR "
+            << (ok ? "OK" : "MISMATCH") << std::endl;
+
+  int n_frames = 0;
+  LegacyAssembler legacy_bench(settings);
+  const double legacy_fps = benchmark(stream, n_runs, [&legacy_bench](const std::shared_ptr<openhd::VideoFragment>& fragment) {
+    legacy_bench.on_new_rtp_frame_fragment(fragment);
+    if (legacy_bench.frames.size() > 1000) legacy_bench.frames.clear();
+  });
+  openhd::AnyRTPFrameAssembler assembler_bench(codec, [&n_frames](std::vector<std::shared_ptr<openhd::VideoFragment>>&, bool) { n_frames++; });
+  const double fps =
+      benchmark(stream, n_runs, [&assembler_bench](const std::shared_ptr<openhd::VideoFragment>& fragment) { assembler_bench.add_fragment(fragment); });
+  std::cout << "  legacy:    " << legacy_fps / 1e6 << " M fragments/s" << std::endl;
+  std::cout << "  assembler: " << fps / 1e6 << " M fragments/s (" << fps / legacy_fps << "x)" << std::endl;
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const int n_runs = argc > 1 ? std::atoi(argv[1]) : 50;
+  bool ok = validate_and_benchmark(VideoCodec::H264, n_runs);
+  ok &= validate_and_benchmark(VideoCodec::H265, n_runs);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,222 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ffmpeg_videosamples.hpp"
+#include "nalu/nalu_helper.h"
+
+//
+// Validates the annex-b start code scanner (split_nal_units) against a naive
+// implementation and compares its throughput with the legacy find_next_nal
+// state machine and the scalar fallback.
+// 验证 Annex-B 起始码扫描器（split_nal_units），并与旧的 find_next_nal 状态机以及标量实现比较吞吐量。
+
+namespace {
+
+// Obviously correct, slow reference
+std::vector<NalUnitSpan> split_naive(const uint8_t* data, int data_len) {
+  std::vector<int> begins;
+  for (int i = 0; i + 2 < data_len; i++) {
+    if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+      begins.push_back((i > 0 && data[i - 1] == 0) ? i - 1 : i);
+    }
+  }
+  std::vector<NalUnitSpan> ret;
+  for (size_t i = 0; i < begins.size(); i++) {
+    const int end = i + 1 < begins.size() ? begins[i + 1] : data_len;
+    ret.push_back({begins[i], end - begins[i]});
+  }
+  return ret;
+}
+
+int split_scalar(const uint8_t* data, int data_len,
+                 std::vector<NalUnitSpan>& out) {
+  const uint8_t* end = data + data_len;
+  const uint8_t* sc = find_start_code_scalar(data, end);
+  while (sc != end) {
+    int begin = static_cast<int>(sc - data);
+    if (begin > 0 && data[begin - 1] == 0) begin--;
+    const uint8_t* next = find_start_code_scalar(sc + 3, end);
+    int next_begin = static_cast<int>(next - data);
+    if (next != end && data[next_begin - 1] == 0) next_begin--;
+    out.push_back({begin, next_begin - begin});
+    sc = next;
+  }
+  return static_cast<int>(out.size());
+}
+
+int split_legacy(const uint8_t* data, int data_len) {
+  int offset = 0;
+  int n = 0;
+  while (offset < data_len) {
+    offset += find_next_nal(&data[offset], data_len - offset);
+    n++;
+  }
+  return n;
+}
+
+bool equal(const std::vector<NalUnitSpan>& a,
+           const std::vector<NalUnitSpan>& b) {
+  if (a.size() != b.size()) return false;
+  for (size_t i = 0; i < a.size(); i++) {
+    if (a[i].offset != b[i].offset || a[i].size != b[i].size) return false;
+  }
+  return true;
+}
+
+// Random payload with emulation prevention applied, like an encoder would
+// produce. zero_percent controls how "flat" the content is.
+std::vector<uint8_t> create_synthetic_stream(size_t size, int zero_percent,
+                                             std::mt19937& rng) {
+  std::uniform_int_distribution<int> byte_dist(0, 255);
+  std::uniform_int_distribution<int> percent_dist(0, 99);
+  std::uniform_int_distribution<int> nal_size_dist(16, 64 * 1024);
+  std::vector<uint8_t> ret;
+  ret.reserve(size + 128 * 1024);
+  while (ret.size() < size) {
+    if (percent_dist(rng) < 50) ret.push_back(0);
+    ret.insert(ret.end(), {0, 0, 1, static_cast<uint8_t>(byte_dist(rng) | 1)});
+    const int nal_size = nal_size_dist(rng);
+    int n_zeros = 0;
+    for (int i = 0; i < nal_size; i++) {
+      uint8_t b = percent_dist(rng) < zero_percent ? 0 : byte_dist(rng);
+      if (n_zeros >= 2 && b <= 3) {
+        ret.push_back(3);
+        n_zeros = 0;
+      }
+      ret.push_back(b);
+      n_zeros = b == 0 ? n_zeros + 1 : 0;
+    }
+    // A NAL never ends with a zero byte
+    if (ret.back() == 0) ret.push_back(0x80);
+  }
+  return ret;
+}
+
+bool validate(const std::string& tag, const uint8_t* data, int data_len) {
+  std::vector<NalUnitSpan> fast;
+  split_nal_units(data, data_len, fast);
+  std::vector<NalUnitSpan> scalar;
+  split_scalar(data, data_len, scalar);
+  const auto naive = split_naive(data, data_len);
+  const bool ok = equal(fast, naive) && equal(scalar, naive);
+  std::cout << tag << ": " << naive.size() << " NALUs "
+            << (ok ? "OK" : "MISMATCH") << std::endl;
+  return ok;
+}
+
+template <typename F>
+void benchmark(const std::string& tag, const std::vector<uint8_t>& data,
+               int n_runs, F&& f) {
+  int n_nalus = 0;
+  const auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < n_runs; i++) {
+    n_nalus += f(data.data(), static_cast<int>(data.size()));
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - begin;
+  const double elapsed_s = std::chrono::duration<double>(elapsed).count();
+  const double mbytes = static_cast<double>(data.size()) * n_runs / 1e6;
+  std::cout << "  " << tag << ": " << mbytes / elapsed_s << " MB/s ("
+            << n_nalus / n_runs << " NALUs/run)" << std::endl;
+}
+
+void benchmark_all(const std::string& tag, const std::vector<uint8_t>& data,
+                   int n_runs) {
+  std::cout << tag << " (" << data.size() << " bytes x " << n_runs << ")"
+            << std::endl;
+  std::vector<NalUnitSpan> spans;
+  benchmark("legacy find_next_nal", data, n_runs,
+            [](const uint8_t* d, int len) { return split_legacy(d, len); });
+  benchmark("scalar", data, n_runs, [&spans](const uint8_t* d, int len) {
+    spans.clear();
+    return split_scalar(d, len, spans);
+  });
+  benchmark("split_nal_units", data, n_runs, [&spans](const uint8_t* d, int len) {
+    spans.clear();
+    split_nal_units(d, len, spans);
+    return static_cast<int>(spans.size());
+  });
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+#if defined(__SSE2__)
+  std::cout << "Using SSE2" << std::endl;
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  std::cout << "Using NEON" << std::endl;
+#else
+  std::cout << "Using scalar fallback" << std::endl;
+#endif
+  std::mt19937 rng(42);
+  bool ok = true;
+  ok &= validate("k_H264TestFrame", k_H264TestFrame, sizeof(k_H264TestFrame));
+  ok &= validate("k_HEVCMainTestFrame", k_HEVCMainTestFrame,
+                 sizeof(k_HEVCMainTestFrame));
+  // Edge cases - start codes at the very beginning / end, short buffers
+  const std::vector<std::vector<uint8_t>> edge_cases = {
+      {},
+      {0, 0, 1},
+      {0, 0, 0, 1},
+      {1, 2, 0, 0, 1, 9},
+      {0, 0, 1, 9, 0, 0, 0, 1},
+      {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 5}};
+  for (size_t i = 0; i < edge_cases.size(); i++) {
+    ok &= validate("edge case " + std::to_string(i), edge_cases[i].data(),
+                   static_cast<int>(edge_cases[i].size()));
+  }
+  // Start codes at every alignment relative to the 16 byte blocks
+  for (int pos = 0; pos < 40; pos++) {
+    std::vector<uint8_t> buff(64, 0xAB);
+    buff[pos] = 0;
+    buff[pos + 1] = 0;
+    buff[pos + 2] = 1;
+    ok &= validate("alignment " + std::to_string(pos), buff.data(),
+                   static_cast<int>(buff.size()));
+  }
+  const auto synthetic = create_synthetic_stream(8 * 1024 * 1024, 1, rng);
+  const auto synthetic_flat = create_synthetic_stream(8 * 1024 * 1024, 30, rng);
+  ok &= validate("synthetic", synthetic.data(),
+                 static_cast<int>(synthetic.size()));
+  ok &= validate("synthetic (many zeros)", synthetic_flat.data(),
+                 static_cast<int>(synthetic_flat.size()));
+  if (!ok) {
+    std::cerr << "Validation failed" << std::endl;
+    return 1;
+  }
+  const std::vector<uint8_t> h264(k_H264TestFrame,
+                                  k_H264TestFrame + sizeof(k_H264TestFrame));
+  const std::vector<uint8_t> h265(
+      k_HEVCMainTestFrame, k_HEVCMainTestFrame + sizeof(k_HEVCMainTestFrame));
+  benchmark_all("k_H264TestFrame", h264, 200000);
+  benchmark_all("k_HEVCMainTestFrame", h265, 200000);
+  benchmark_all("synthetic", synthetic, 20);
+  benchmark_all("synthetic (many zeros)", synthetic_flat, 20);
+  return 0;
+}
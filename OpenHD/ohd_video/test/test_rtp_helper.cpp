@@ -0,0 +1,144 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "ffmpeg_videosamples.hpp"
+#include "openhd_rtp.h"
+
+//
+// Runs two RTPHelper instances (like with 2 cameras on the raw NALU path)
+// concurrently on 2 threads and validates that the de-packetized NALUs match
+// what was fed in - with the old (shared, function-static) packetization buffer
+// the streams corrupted each other.
+// 在两个线程上并发运行两个 RTPHelper 实例（类似于两个摄像头使用原始 NALU 路径），
+// 并验证解包后的 NALU 与输入一致 - 使用旧的（共享的静态）打包缓冲区时，两路流会互相破坏。
+
+namespace {
+
+// Big (several rtp fragments) IDR slice with random content, no start code
+// emulation (no zero bytes)
+std::vector<uint8_t> create_idr_nalu(int size, std::mt19937& rng) {
+  std::uniform_int_distribution<int> dist(1, 255);
+  std::vector<uint8_t> ret = {0, 0, 0, 1, 0x65};
+  for (int i = 0; i < size; i++) {
+    ret.push_back(static_cast<uint8_t>(dist(rng)));
+  }
+  return ret;
+}
+
+// Re-assembles one h264 NALU (without start code) from single NAL / FU-A rtp
+// packets
+std::vector<uint8_t> depacketize(
+    const std::vector<std::shared_ptr<openhd::VideoFragment>>& fragments) {
+  std::vector<uint8_t> ret;
+  for (const auto& fragment : fragments) {
+    const uint8_t* payload = fragment->data() + 12;
+    const int payload_len = static_cast<int>(fragment->size()) - 12;
+    if (payload_len < 2) continue;
+    if ((payload[0] & 0x1f) == 28) {
+      if (payload[1] & 0x80) {
+        ret.push_back((payload[0] & 0xE0) | (payload[1] & 0x1f));
+      }
+      ret.insert(ret.end(), payload + 2, payload + payload_len);
+    } else {
+      ret.insert(ret.end(), payload, payload + payload_len);
+    }
+  }
+  return ret;
+}
+
+struct Result {
+  int n_frames_ok = 0;
+  int n_frames_corrupted = 0;
+  double elapsed_s = 0;
+  openhd::BufferPool::Stats arena_stats{};
+};
+
+Result run(int seed, int n_frames) {
+  std::mt19937 rng(seed);
+  // 1080p30 @ 8MBit/s
+  openhd::RTPHelper helper(false, 1920, 1080, 30, 8000);
+  std::vector<std::vector<uint8_t>> idr_nalus;
+  for (int i = 0; i < 8; i++) {
+    idr_nalus.push_back(create_idr_nalu(20 * 1000 + i * 1000, rng));
+  }
+  Result result;
+  const std::vector<uint8_t>* curr_nalu = nullptr;
+  helper.set_out_cb(
+      [&](std::vector<std::shared_ptr<openhd::VideoFragment>> fragments) {
+        const auto nalu = depacketize(fragments);
+        // Codec config (re-sent every second) is not validated
+        if (curr_nalu == nullptr || nalu.size() < 1000) return;
+        if (nalu.size() == curr_nalu->size() - 4 &&
+            std::equal(nalu.begin(), nalu.end(), curr_nalu->begin() + 4)) {
+          result.n_frames_ok++;
+        } else {
+          result.n_frames_corrupted++;
+        }
+      });
+  // Codec config first (from the sample frame)
+  helper.feed_multiple_nalu(k_H264TestFrame, sizeof(k_H264TestFrame));
+  const auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < n_frames; i++) {
+    curr_nalu = &idr_nalus[i % idr_nalus.size()];
+    helper.feed_multiple_nalu(curr_nalu->data(),
+                              static_cast<int>(curr_nalu->size()));
+  }
+  result.elapsed_s = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - begin)
+                         .count();
+  result.arena_stats = helper.get_arena_stats();
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const int n_frames = argc > 1 ? std::atoi(argv[1]) : 2000;
+  std::cout << "arena buffers 1080p30 8MBit/s:"
+            << openhd::RTPHelper::calculate_n_arena_buffers(1920, 1080, 30,
+                                                            8000, 1434)
+            << std::endl;
+  Result results[2];
+  std::thread t0([&] { results[0] = run(0, n_frames); });
+  std::thread t1([&] { results[1] = run(1, n_frames); });
+  t0.join();
+  t1.join();
+  bool ok = true;
+  for (int i = 0; i < 2; i++) {
+    const auto& result = results[i];
+    std::cout << "Stream " << i << ": ok:" << result.n_frames_ok
+              << " corrupted:" << result.n_frames_corrupted << " "
+              << n_frames / result.elapsed_s << " frames/s arena:"
+              << result.arena_stats.to_string() << std::endl;
+    ok &= result.n_frames_ok == n_frames && result.n_frames_corrupted == 0;
+  }
+  std::cout << (ok ? "OK" : "FAILED") << std::endl;
+  return ok ? 0 : 1;
+}
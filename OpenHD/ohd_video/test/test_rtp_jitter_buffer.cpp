@@ -0,0 +1,241 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "rtp_jitter_buffer.h"
+
+//
+// Feeds a synthetic rtp video stream (with misordered, duplicate, lost and
+// late packets) through the ground jitter buffer and validates order, stats
+// and whole frame output.
+// 将合成的 rtp 视频流（包含乱序、重复、丢失和迟到的包）送入地面抖动缓冲，验证顺序、统计和整帧输出。
+
+namespace {
+
+constexpr int N_FRAGMENTS_PER_FRAME = 10;
+// 30 fps
+constexpr uint32_t TIMESTAMP_INCREMENT = 3000;
+
+std::vector<uint8_t> create_packet(uint16_t seq, uint32_t timestamp,
+                                   bool marker) {
+  std::vector<uint8_t> ret(100, 0xAB);
+  ret[0] = 0x80;
+  ret[1] = 96 | (marker ? 0x80 : 0);
+  ret[2] = seq >> 8;
+  ret[3] = seq & 0xff;
+  ret[4] = timestamp >> 24;
+  ret[5] = timestamp >> 16;
+  ret[6] = timestamp >> 8;
+  ret[7] = timestamp;
+  return ret;
+}
+
+// Sequence numbers wrap around on purpose
+std::vector<std::vector<uint8_t>> create_stream(int n_frames) {
+  std::vector<std::vector<uint8_t>> ret;
+  uint16_t seq = 65000;
+  for (int i = 0; i < n_frames; i++) {
+    for (int j = 0; j < N_FRAGMENTS_PER_FRAME; j++) {
+      ret.push_back(create_packet(seq++, i * TIMESTAMP_INCREMENT,
+                                  j == N_FRAGMENTS_PER_FRAME - 1));
+    }
+  }
+  return ret;
+}
+
+uint16_t get_seq(const std::vector<uint8_t>& packet) {
+  return (packet[2] << 8) | packet[3];
+}
+
+struct Output {
+  std::vector<uint16_t> seqs;
+  int n_batches = 0;
+  int n_batches_not_frame = 0;
+};
+
+Output run(const std::vector<std::vector<uint8_t>>& packets, int jitter_ms,
+           bool whole_frames,
+           openhd::RTPJitterBuffer::Stats& stats,
+           int wait_ms = 0) {
+  Output output;
+  openhd::RTPJitterBuffer jitter_buffer(
+      0, jitter_ms, whole_frames,
+      [&output](std::vector<std::shared_ptr<std::vector<uint8_t>>>& fragments) {
+        output.n_batches++;
+        // A frame ends with the marker bit
+        if (((*fragments.back())[1] & 0x80) == 0) output.n_batches_not_frame++;
+        for (const auto& fragment : fragments) {
+          output.seqs.push_back(get_seq(*fragment));
+        }
+      });
+  for (const auto& packet : packets) {
+    jitter_buffer.input(packet.data(), static_cast<int>(packet.size()));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(wait_ms));
+  stats = jitter_buffer.get_stats();
+  return output;
+}
+
+bool is_in_order(const std::vector<uint16_t>& seqs) {
+  for (size_t i = 1; i < seqs.size(); i++) {
+    if (static_cast<int16_t>(seqs[i] - seqs[i - 1]) <= 0) return false;
+  }
+  return true;
+}
+
+bool check(bool ok, const std::string& what,
+           const openhd::RTPJitterBuffer::Stats& stats) {
+  std::cout << (ok ? "OK     " : "FAILED ") << what << " " << stats.to_string()
+            << std::endl;
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const int n_frames = 300;
+  const auto stream = create_stream(n_frames);
+  const int n_packets = static_cast<int>(stream.size());
+  bool ok = true;
+  openhd::RTPJitterBuffer::Stats stats{};
+  {
+    const auto output = run(stream, 50, true, stats);
+    ok &= check(output.seqs.size() == stream.size() && is_in_order(output.seqs) &&
+                    output.n_batches == n_frames &&
+                    output.n_batches_not_frame == 0 &&
+                    stats.count_frames == n_frames &&
+                    stats.count_frames_incomplete == 0 && stats.count_lost == 0,
+                "clean stream, whole frames", stats);
+  }
+  // Swap every 7th packet with its successor, duplicate every 13th
+  std::vector<std::vector<uint8_t>> misordered;
+  int n_swapped = 0;
+  int n_duplicates = 0;
+  for (int i = 0; i < n_packets; i++) {
+    if (i % 7 == 3 && i + 1 < n_packets) {
+      misordered.push_back(stream[i + 1]);
+      misordered.push_back(stream[i]);
+      n_swapped++;
+      i++;
+    } else {
+      misordered.push_back(stream[i]);
+    }
+    if (i % 13 == 0) {
+      misordered.push_back(stream[i]);
+      n_duplicates++;
+    }
+  }
+  {
+    const auto output = run(misordered, 50, true, stats);
+    ok &= check(output.seqs.size() == stream.size() && is_in_order(output.seqs) &&
+                    output.n_batches_not_frame == 0 &&
+                    stats.count_misordered == static_cast<uint32_t>(n_swapped) &&
+                    // a duplicate of an already forwarded packet is late
+                    stats.count_duplicate + stats.count_late == static_cast<uint32_t>(n_duplicates) &&
+                    stats.count_lost == 0 && stats.count_frames_incomplete == 0,
+                "misordered + duplicates, jitter 50ms", stats);
+  }
+  {
+    // pass through - forwarded as it comes in (minus direct duplicates), a
+    // frame counts as incomplete if a fragment was missing when forwarded
+    const auto output = run(misordered, 0, false, stats);
+    ok &= check(output.seqs.size() >= stream.size() && !is_in_order(output.seqs) &&
+                    stats.count_misordered == static_cast<uint32_t>(n_swapped) &&
+                    stats.count_frames == n_frames,
+                "misordered + duplicates, pass through", stats);
+  }
+  // Drop every 50th packet - released once the next frame is older than the
+  // jitter (20ms < 33ms frame interval)
+  std::vector<std::vector<uint8_t>> lossy;
+  int n_dropped = 0;
+  for (int i = 0; i < n_packets; i++) {
+    if (i % 50 == 25) {
+      n_dropped++;
+      continue;
+    }
+    lossy.push_back(stream[i]);
+  }
+  {
+    const auto output = run(lossy, 20, true, stats);
+    ok &= check(output.seqs.size() == lossy.size() && is_in_order(output.seqs) &&
+                    stats.count_lost == static_cast<uint32_t>(n_dropped) &&
+                    stats.count_frames_incomplete == static_cast<uint32_t>(n_dropped),
+                "lossy, jitter 20ms", stats);
+  }
+  // A packet delayed by 3 frames (more than the jitter) is late
+  std::vector<std::vector<uint8_t>> late = stream;
+  std::rotate(late.begin() + 105, late.begin() + 106, late.begin() + 106 + 3 * N_FRAGMENTS_PER_FRAME);
+  {
+    const auto output = run(late, 20, false, stats);
+    ok &= check(output.seqs.size() == stream.size() - 1 && is_in_order(output.seqs) &&
+                    stats.count_late == 1 && stats.count_lost == 1,
+                "late packet, jitter 20ms", stats);
+  }
+  // The stream stops right after a gap - the timer releases the rest
+  {
+    std::vector<std::vector<uint8_t>> gap(stream.begin(), stream.begin() + 20);
+    gap.erase(gap.begin() + 15);
+    const auto output = run(gap, 20, false, stats, 100);
+    ok &= check(output.seqs.size() == gap.size() && is_in_order(output.seqs) &&
+                    stats.count_lost == 1,
+                "gap at the end, released by the timer", stats);
+  }
+  // The end of the last frame got lost and the stream stops - the timer
+  // flushes the unfinished frame
+  for (const int jitter_ms : {20, 0}) {
+    std::vector<std::vector<uint8_t>> no_marker(
+        stream.begin(), stream.begin() + 2 * N_FRAGMENTS_PER_FRAME - 1);
+    const auto output = run(no_marker, jitter_ms, true, stats,
+                            openhd::RTPJitterBuffer::FRAME_TIMEOUT_MS + 100);
+    ok &= check(output.seqs.size() == no_marker.size() &&
+                    output.n_batches == 2 && output.n_batches_not_frame == 1 &&
+                    stats.count_frames_incomplete == 1,
+                "lost end of frame, flushed by the timer, jitter " +
+                    std::to_string(jitter_ms) + "ms",
+                stats);
+  }
+  // The late packet must not end up in front of a newer frame
+  {
+    const auto output = run(late, 0, true, stats);
+    ok &= check(output.seqs.size() == stream.size() - 1 &&
+                    is_in_order(output.seqs) && output.n_batches_not_frame == 0,
+                "late packet, pass through, whole frames", stats);
+  }
+  // Throughput
+  {
+    const auto big_stream = create_stream(30000);
+    const auto begin = std::chrono::steady_clock::now();
+    const auto output = run(big_stream, 50, true, stats);
+    const double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::cout << "Throughput: " << big_stream.size() / elapsed_s / 1e6 << " M packets/s" << std::endl;
+    ok &= output.seqs.size() == big_stream.size();
+  }
+  std::cout << (ok ? "OK" : "FAILED") << std::endl;
+  return ok ? 0 : 1;
+}
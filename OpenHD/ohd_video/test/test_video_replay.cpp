@@ -0,0 +1,421 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ffmpeg_videosamples.hpp"
+#include "nalu/nalu_helper.h"
+#include "openhd_link.hpp"
+#include "openhd_rtp.h"
+#include "rtp_frame_assembler.hpp"
+
+//
+// Replays a recorded (or synthetic) video stream through the air unit video
+// hot path - without camera, gstreamer or radio - and reports throughput,
+// allocations per frame and per stage latency histograms. Use it to catch
+// regressions between releases.
+// Input:
+//  Annex-B (raw h264 / h265) -> RTPHelper (lib rtp packetization, like the raw
+//  NALU path of GStreamerStream) -> frame -> DummyDebugLink
+//  rtpdump (rtptools format, e.g. recorded from the gstreamer rtp output) ->
+//  RTPFragmentBuffer (FU-E based frame assembly, same as GStreamerStream for
+//  rtp from appsink) -> DummyDebugLink
+// Without a file, a synthetic 1080p-like stream (1 IDR every 30 frames) is used
+// such that results are comparable between machines / releases.
+// 在不需要摄像头、gstreamer 或无线电的情况下，通过空中端视频热路径回放录制的（或合成的）视频流，
+// 并报告吞吐量、每帧内存分配次数和各阶段延迟直方图。用于发现版本之间的性能回归。
+//
+// Usage: test_video_replay [--h265] [--rtp] [--fps N] [--loops N] [file]
+//  --fps 0 (default) runs at max speed, otherwise frames are paced in real time
+
+namespace {
+
+// Counts heap allocations while enabled
+std::atomic<bool> g_count_allocations{false};
+std::atomic<uint64_t> g_n_allocations{0};
+
+// Log2 histogram of latencies in ns
+class LatencyHistogram {
+ public:
+  void add(std::chrono::nanoseconds duration) {
+    const int64_t ns = std::max<int64_t>(duration.count(), 1);
+    m_buckets[std::min<int>(63 - __builtin_clzll(ns), N_BUCKETS - 1)]++;
+    m_samples_ns.push_back(ns);
+  }
+  void print(const std::string& stage) {
+    if (m_samples_ns.empty()) return;
+    std::sort(m_samples_ns.begin(), m_samples_ns.end());
+    const auto percentile = [this](double p) {
+      return m_samples_ns[static_cast<size_t>(p * (m_samples_ns.size() - 1))] /
+             1000.0;
+    };
+    std::cout << "  " << std::left << std::setw(10) << stage << std::right
+              << std::fixed << std::setprecision(1)
+              << " n=" << m_samples_ns.size() << " p50=" << percentile(0.5)
+              << "us p90=" << percentile(0.9) << "us p99=" << percentile(0.99)
+              << "us max=" << m_samples_ns.back() / 1000.0 << "us" << std::endl;
+    for (int i = 0; i < N_BUCKETS; i++) {
+      if (m_buckets[i] == 0) continue;
+      std::cout << "    <" << std::setw(9) << std::setprecision(1)
+                << static_cast<double>(2LL << i) / 1000.0 << "us "
+                << std::setw(8) << m_buckets[i] << " "
+                << std::string(std::max<size_t>(
+                                   1, 50 * m_buckets[i] / m_samples_ns.size()),
+                               '#')
+                << std::endl;
+    }
+  }
+
+ private:
+  static constexpr int N_BUCKETS = 40;
+  std::array<uint64_t, N_BUCKETS> m_buckets{};
+  std::vector<int64_t> m_samples_ns;
+};
+
+struct Options {
+  bool is_h265 = false;
+  bool is_rtp = false;
+  int fps = 0;
+  int n_loops = 1;
+  std::string filename;
+};
+
+bool is_vcl(const uint8_t* nal_header, bool is_h265) {
+  if (is_h265) {
+    return ((nal_header[0] >> 1) & 0x3f) < 32;
+  }
+  const int type = nal_header[0] & 0x1f;
+  return type >= 1 && type <= 5;
+}
+
+// Splits the annex-b stream into access units, assuming one (VCL) slice per
+// frame - non-VCL NALUs (SPS, PPS, SEI, AUD) are prepended to the next slice.
+std::vector<std::vector<uint8_t>> split_access_units(
+    const std::vector<uint8_t>& stream, bool is_h265) {
+  std::vector<NalUnitSpan> spans;
+  split_nal_units(stream.data(), static_cast<int>(stream.size()), spans);
+  std::vector<std::vector<uint8_t>> ret;
+  std::vector<uint8_t> curr;
+  for (const auto& span : spans) {
+    const uint8_t* nal = &stream[span.offset];
+    const int start_code_len = nal[2] == 1 ? 3 : 4;
+    if (span.size <= start_code_len + 1) continue;
+    curr.insert(curr.end(), nal, nal + span.size);
+    if (is_vcl(nal + start_code_len, is_h265)) {
+      ret.push_back(std::move(curr));
+      curr = {};
+    }
+  }
+  if (!curr.empty()) ret.push_back(std::move(curr));
+  return ret;
+}
+
+// 30 fps, 8 MBit/s - 1 IDR every 30 frames, random (non zero) slice data
+std::vector<uint8_t> create_synthetic_annex_b(bool is_h265, int n_frames) {
+  std::vector<uint8_t> ret;
+  if (is_h265) {
+    ret.insert(ret.end(), k_HEVCMainTestFrame,
+               k_HEVCMainTestFrame + sizeof(k_HEVCMainTestFrame));
+  } else {
+    ret.insert(ret.end(), k_H264TestFrame,
+               k_H264TestFrame + sizeof(k_H264TestFrame));
+  }
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> dist(1, 255);
+  for (int i = 0; i < n_frames; i++) {
+    const bool idr = i % 30 == 0;
+    const int size = idr ? 120 * 1000 : 30 * 1000;
+    ret.insert(ret.end(), {0, 0, 0, 1});
+    if (is_h265) {
+      // IDR_W_RADL / TRAIL_R
+      ret.insert(ret.end(), {static_cast<uint8_t>(idr ? 19 << 1 : 1 << 1), 1});
+    } else {
+      ret.push_back(idr ? 0x65 : 0x41);
+    }
+    for (int j = 0; j < size; j++) ret.push_back(static_cast<uint8_t>(dist(rng)));
+  }
+  return ret;
+}
+
+std::vector<uint8_t> read_file(const std::string& filename) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file) {
+    std::cerr << "Cannot open " << filename << std::endl;
+    exit(1);
+  }
+  return {std::istreambuf_iterator<char>(file), {}};
+}
+
+// rtptools rtpdump: "#!rtpplay1.0 address/port\n", 16 bytes file header, then
+// per packet a 8 bytes header (u16 length incl. header, u16 packet length, u32
+// offset ms) followed by the rtp packet
+std::vector<std::vector<uint8_t>> parse_rtpdump(const std::vector<uint8_t>& file) {
+  std::vector<std::vector<uint8_t>> ret;
+  const auto line_end = std::find(file.begin(), file.end(), '\n');
+  if (file.size() < 12 || std::memcmp(file.data(), "#!rtpplay", 9) != 0 ||
+      line_end == file.end()) {
+    std::cerr << "Not a rtpdump file" << std::endl;
+    exit(1);
+  }
+  size_t offset = (line_end - file.begin()) + 1 + 16;
+  while (offset + 8 <= file.size()) {
+    const int length = (file[offset] << 8) | file[offset + 1];
+    const int packet_length = (file[offset + 2] << 8) | file[offset + 3];
+    if (length < 8 || offset + length > file.size()) break;
+    // packet_length == 0 marks a RTCP packet (not interesting)
+    if (packet_length != 0 && length - 8 >= 12) {
+      ret.emplace_back(file.begin() + offset + 8, file.begin() + offset + length);
+    }
+    offset += length;
+  }
+  return ret;
+}
+
+// Packetizes the annex-b stream once, such that rtp mode also works without a
+// recorded file
+std::vector<std::vector<uint8_t>> packetize(
+    const std::vector<std::vector<uint8_t>>& access_units, bool is_h265) {
+  std::vector<std::vector<uint8_t>> ret;
+  openhd::RTPHelper helper(is_h265);
+  helper.set_out_cb(
+      [&ret](std::vector<std::shared_ptr<openhd::VideoFragment>> fragments) {
+        for (const auto& fragment : fragments) {
+          ret.emplace_back(fragment->data(), fragment->data() + fragment->size());
+        }
+      });
+  for (const auto& access_unit : access_units) {
+    helper.feed_multiple_nalu(access_unit.data(),
+                              static_cast<int>(access_unit.size()));
+  }
+  return ret;
+}
+
+uint32_t get_rtp_timestamp(const std::vector<uint8_t>& packet) {
+  return (packet[4] << 24) | (packet[5] << 16) | (packet[6] << 8) | packet[7];
+}
+
+struct Replay {
+  explicit Replay(const Options& options) : m_options(options) {
+    m_link = std::make_shared<DummyDebugLink>();
+    m_link->m_opt_frame_cb = [this](int stream_index,
+                                    const openhd::FragmentedVideoFrame& frame) {
+      const auto now = std::chrono::steady_clock::now();
+      m_n_frames++;
+      m_n_fragments += frame.rtp_fragments.size();
+      for (const auto& fragment : frame.rtp_fragments) m_n_bytes += fragment->size();
+      m_hist_total.add(now - m_curr_input_ts);
+    };
+  }
+  // Frame assembled (same as GStreamerStream / RTPFragmentBuffer), forward to
+  // the link
+  void on_frame(const openhd::FragmentedVideoFrame& frame) {
+    const auto before_link = std::chrono::steady_clock::now();
+    m_hist_assemble.add(before_link - m_curr_stage_ts);
+    m_link->transmit_video_data(0, frame);
+    m_hist_link.add(std::chrono::steady_clock::now() - before_link);
+  }
+  void pace(int frame_index, std::chrono::steady_clock::time_point begin) {
+    if (m_options.fps <= 0) return;
+    std::this_thread::sleep_until(
+        begin + std::chrono::nanoseconds(1000000000LL * frame_index / m_options.fps));
+  }
+  void run_annex_b(const std::vector<std::vector<uint8_t>>& access_units) {
+    openhd::RTPHelper helper(m_options.is_h265);
+    helper.set_out_cb(
+        [this](std::vector<std::shared_ptr<openhd::VideoFragment>> fragments) {
+          const auto now = std::chrono::steady_clock::now();
+          m_hist_packetize.add(now - m_curr_stage_ts);
+          m_curr_stage_ts = now;
+          const bool is_idr = m_options.is_h265 ? openhd::RTPFrameAssembler<VideoCodec::H265>::contains_idr(fragments)
+                                                : openhd::RTPFrameAssembler<VideoCodec::H264>::contains_idr(fragments);
+          on_frame(openhd::FragmentedVideoFrame{fragments, now, false, nullptr, false, is_idr});
+          m_curr_stage_ts = std::chrono::steady_clock::now();
+        });
+    const auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < access_units.size(); i++) {
+      pace(static_cast<int>(i), begin);
+      m_curr_input_ts = m_curr_stage_ts = std::chrono::steady_clock::now();
+      helper.feed_multiple_nalu(access_units[i].data(),
+                                static_cast<int>(access_units[i].size()));
+    }
+  }
+  void run_rtp(const std::vector<std::vector<uint8_t>>& packets) {
+    openhd::RTPFragmentBuffer buffer(m_options.is_h265);
+    buffer.set_out_cb([this](int stream_index, const openhd::FragmentedVideoFrame& frame) { on_frame(frame); });
+    const auto begin = std::chrono::steady_clock::now();
+    int frame_index = 0;
+    bool is_first_fragment = true;
+    uint32_t last_rtp_timestamp = 0;
+    for (const auto& packet : packets) {
+      const uint32_t rtp_timestamp = get_rtp_timestamp(packet);
+      if (rtp_timestamp != last_rtp_timestamp) {
+        pace(frame_index++, begin);
+        last_rtp_timestamp = rtp_timestamp;
+      }
+      // Frame latency is measured from the first fragment
+      if (is_first_fragment) {
+        m_curr_input_ts = m_curr_stage_ts = std::chrono::steady_clock::now();
+      }
+      const size_t n_frames_before = m_n_frames;
+      // Like appsink, each fragment arrives in its own buffer
+      buffer.buffer_and_forward(openhd::make_video_fragment(packet.data(), packet.size()));
+      is_first_fragment = m_n_frames != n_frames_before;
+    }
+  }
+  void print_results(double elapsed_s, uint64_t n_allocations) {
+    std::cout << std::fixed << std::setprecision(1) << "Frames:" << m_n_frames
+              << " " << m_n_frames / elapsed_s << " frames/s "
+              << m_n_fragments / elapsed_s << " fragments/s "
+              << m_n_bytes * 8 / elapsed_s / 1e6 << " MBit/s "
+              << std::setprecision(2)
+              << static_cast<double>(n_allocations) / std::max<size_t>(m_n_frames, 1)
+              << " allocs/frame" << std::endl;
+    std::cout << "Latency per stage:" << std::endl;
+    m_hist_packetize.print("packetize");
+    m_hist_assemble.print("assemble");
+    m_hist_link.print("link");
+    m_hist_total.print("total");
+  }
+
+  const Options m_options;
+  std::shared_ptr<DummyDebugLink> m_link;
+  std::chrono::steady_clock::time_point m_curr_input_ts;
+  std::chrono::steady_clock::time_point m_curr_stage_ts;
+  size_t m_n_frames = 0;
+  size_t m_n_fragments = 0;
+  uint64_t m_n_bytes = 0;
+  LatencyHistogram m_hist_packetize;
+  LatencyHistogram m_hist_assemble;
+  LatencyHistogram m_hist_link;
+  LatencyHistogram m_hist_total;
+};
+
+Options parse_options(int argc, char* argv[]) {
+  static const struct option long_options[] = {
+      {"h265", no_argument, nullptr, 'h'},
+      {"rtp", no_argument, nullptr, 'r'},
+      {"fps", required_argument, nullptr, 'f'},
+      {"loops", required_argument, nullptr, 'l'},
+      {nullptr, 0, nullptr, 0},
+  };
+  Options ret{};
+  int opt;
+  while ((opt = getopt_long(argc, argv, "hrf:l:", long_options, nullptr)) != -1) {
+    switch (opt) {
+      case 'h':
+        ret.is_h265 = true;
+        break;
+      case 'r':
+        ret.is_rtp = true;
+        break;
+      case 'f':
+        ret.fps = std::atoi(optarg);
+        break;
+      case 'l':
+        ret.n_loops = std::max(1, std::atoi(optarg));
+        break;
+      default:
+        std::cerr << "Usage: test_video_replay [--h265] [--rtp] [--fps N] [--loops N] [file]" << std::endl;
+        exit(1);
+    }
+  }
+  if (optind < argc) ret.filename = argv[optind];
+  return ret;
+}
+
+}  // namespace
+
+// Replaced global allocation functions - count every operator new while
+// replaying
+__attribute__((noinline)) void* operator new(std::size_t size) {
+  if (g_count_allocations.load(std::memory_order_relaxed)) {
+    g_n_allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  void* ptr = std::malloc(size == 0 ? 1 : size);
+  if (!ptr) throw std::bad_alloc();
+  return ptr;
+}
+__attribute__((noinline)) void* operator new[](std::size_t size) {
+  return operator new(size);
+}
+__attribute__((noinline)) void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+__attribute__((noinline)) void operator delete[](void* ptr) noexcept {
+  std::free(ptr);
+}
+__attribute__((noinline)) void operator delete(void* ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+__attribute__((noinline)) void operator delete[](void* ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+int main(int argc, char* argv[]) {
+  const auto options = parse_options(argc, argv);
+  std::vector<std::vector<uint8_t>> access_units;
+  std::vector<std::vector<uint8_t>> rtp_packets;
+  if (options.is_rtp && !options.filename.empty()) {
+    rtp_packets = parse_rtpdump(read_file(options.filename));
+  } else {
+    const auto annex_b = options.filename.empty()
+                             ? create_synthetic_annex_b(options.is_h265, 300)
+                             : read_file(options.filename);
+    access_units = split_access_units(annex_b, options.is_h265);
+    if (options.is_rtp) rtp_packets = packetize(access_units, options.is_h265);
+  }
+  std::cout << "Replaying " << (options.filename.empty() ? "synthetic stream" : options.filename)
+            << (options.is_h265 ? " H265 " : " H264 ") << (options.is_rtp ? "rtp" : "annex-b")
+            << " (" << (options.is_rtp ? rtp_packets.size() : access_units.size())
+            << (options.is_rtp ? " packets" : " access units") << ") x" << options.n_loops
+            << (options.fps > 0 ? " at " + std::to_string(options.fps) + " fps" : " at max speed")
+            << std::endl;
+  Replay replay(options);
+  g_count_allocations = true;
+  const auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < options.n_loops; i++) {
+    if (options.is_rtp) {
+      replay.run_rtp(rtp_packets);
+    } else {
+      replay.run_annex_b(access_units);
+    }
+  }
+  const double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  g_count_allocations = false;
+  replay.print_results(elapsed_s, g_n_allocations.load());
+  return replay.m_n_frames > 0 ? 0 : 1;
+}
@@ -0,0 +1,246 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "openhd_test_helper.h"
+#include "openhd_udp.h"
+#include "openhd_video_shm_ring.h"
+#include "video_shm_writer.h"
+
+//
+// Loopback benchmark of the two ways the ground hands video to a local app -
+// UDP to localhost (sendmmsg per frame) vs the shared memory ring (futex
+// wake-up, zero copy read). 50 MBit/s, 60 fps, rtp sized packets. Reports CPU usage (writer + reader, whole process) and the packet
+// latency, validates that nothing got lost / reordered.
+// 本地回环基准测试：比较地面端向本地应用传递视频的两种方式 - UDP 发往 localhost 与共享内存环形缓冲。
+//
+// Usage: test_video_shm [seconds]
+
+namespace {
+
+constexpr int BITRATE_MBIT = 50;
+constexpr int FPS = 60;
+constexpr int PACKET_SIZE = 1400;
+constexpr int PACKETS_PER_FRAME = BITRATE_MBIT * 1000 * 1000 / 8 / FPS / PACKET_SIZE;
+constexpr int UDP_PORT = 5690;
+constexpr auto SHM_NAME = "/openhd_video_test";
+
+using openhd_test_helper::get_cpu_time_s;
+using openhd_test_helper::now_us;
+using openhd_test_helper::percentile;
+
+// Packet: rtp like header (seq), send time, filler
+struct Frame {
+  std::vector<std::vector<uint8_t>> packets;
+  std::vector<openhd::UDPPacketRef> refs;
+};
+
+Frame create_frame(uint32_t& seq) {
+  Frame frame;
+  const uint64_t ts = now_us();
+  for (int i = 0; i < PACKETS_PER_FRAME; i++) {
+    std::vector<uint8_t> packet(PACKET_SIZE, 0xAB);
+    packet[0] = 0x80;
+    packet[1] = 96 | (i == PACKETS_PER_FRAME - 1 ? 0x80 : 0);
+    memcpy(&packet[4], &seq, sizeof(seq));
+    memcpy(&packet[12], &ts, sizeof(ts));
+    seq++;
+    frame.packets.push_back(std::move(packet));
+  }
+  for (const auto& packet : frame.packets) {
+    frame.refs.push_back({packet.data(), packet.size()});
+  }
+  return frame;
+}
+
+struct ReceiverStats {
+  std::vector<uint32_t> latencies_us;
+  uint32_t next_seq = 0;
+  uint32_t n_packets = 0;
+  uint32_t n_out_of_order = 0;
+  void on_packet(const uint8_t* data, std::size_t size) {
+    const uint64_t now = now_us();
+    uint32_t seq;
+    uint64_t ts;
+    memcpy(&seq, data + 4, sizeof(seq));
+    memcpy(&ts, data + 12, sizeof(ts));
+    if (seq != next_seq) n_out_of_order++;
+    next_seq = seq + 1;
+    n_packets++;
+    latencies_us.push_back(static_cast<uint32_t>(now - ts));
+  }
+};
+
+// Paced at FPS, calls send for each frame
+template <class SEND>
+void run_writer(int duration_s, uint32_t& n_packets_sent, SEND send) {
+  uint32_t seq = 0;
+  const auto begin = std::chrono::steady_clock::now();
+  const int n_frames = duration_s * FPS;
+  for (int i = 0; i < n_frames; i++) {
+    std::this_thread::sleep_until(begin + std::chrono::microseconds(1000000LL * i / FPS));
+    const auto frame = create_frame(seq);
+    send(frame);
+  }
+  n_packets_sent = seq;
+}
+
+bool print_result(const std::string& tag, const ReceiverStats& stats,
+                  uint32_t n_packets_sent, double cpu_s, double wall_s) {
+  const auto& latencies = stats.latencies_us;
+  const bool ok = stats.n_packets == n_packets_sent && stats.n_out_of_order == 0;
+  std::cout << std::left << std::setw(5) << tag << std::right << std::fixed
+            << std::setprecision(1) << " CPU:" << 100 * cpu_s / wall_s
+            << "% latency p50:" << percentile(latencies, 0.5)
+            << "us p99:" << percentile(latencies, 0.99)
+            << "us max:" << percentile(latencies, 1.0)
+            << "us received:" << stats.n_packets << "/" << n_packets_sent
+            << (ok ? " OK" : " FAILED") << std::endl;
+  return ok;
+}
+
+bool run_udp(int duration_s) {
+  ReceiverStats stats;
+  openhd::UDPReceiver receiver(
+      openhd::ADDRESS_LOCALHOST, UDP_PORT,
+      [&stats](const uint8_t* payload, std::size_t payload_size) {
+        stats.on_packet(payload, payload_size);
+      });
+  receiver.runInBackground();
+  openhd::UDPMultiForwarder forwarder;
+  forwarder.addForwarder(openhd::ADDRESS_LOCALHOST, UDP_PORT);
+  uint32_t n_packets_sent = 0;
+  const double cpu_begin = get_cpu_time_s();
+  const auto begin = std::chrono::steady_clock::now();
+  run_writer(duration_s, n_packets_sent, [&forwarder](const Frame& frame) {
+    forwarder.forwardPacketsViaUDP(frame.refs);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  const double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  const double cpu_s = get_cpu_time_s() - cpu_begin;
+  receiver.stopBackground();
+  return print_result("udp", stats, n_packets_sent, cpu_s, wall_s);
+}
+
+bool run_shm(int duration_s) {
+  auto writer = openhd::VideoShmWriter::create(SHM_NAME);
+  if (!writer) {
+    std::cerr << "Cannot create shm" << std::endl;
+    return false;
+  }
+  ReceiverStats stats;
+  std::atomic<bool> stop{false};
+  std::atomic<bool> reader_open{false};
+  uint64_t n_overruns = 0;
+  std::thread reader_thread([&stats, &stop, &reader_open, &n_overruns]() {
+    ohd_video_shm_reader reader;
+    if (ohd_video_shm_reader_open(&reader, SHM_NAME) != 0) {
+      std::cerr << "Cannot open shm" << std::endl;
+      reader_open = true;
+      return;
+    }
+    // Readers start at the newest data
+    reader_open = true;
+    while (!stop) {
+      const uint8_t* data;
+      uint32_t len, flags;
+      const int r = ohd_video_shm_reader_next(&reader, &data, &len, &flags);
+      if (r == OHD_VIDEO_SHM_NONE) {
+        ohd_video_shm_reader_wait(&reader, 50);
+        continue;
+      }
+      if (r == OHD_VIDEO_SHM_PACKET) {
+        // zero copy
+        stats.on_packet(data, len);
+        if (!ohd_video_shm_reader_valid(&reader)) n_overruns++;
+      }
+    }
+    n_overruns += reader.n_overruns;
+    ohd_video_shm_reader_close(&reader);
+  });
+  while (!reader_open) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  uint32_t n_packets_sent = 0;
+  const double cpu_begin = get_cpu_time_s();
+  const auto begin = std::chrono::steady_clock::now();
+  run_writer(duration_s, n_packets_sent, [&writer](const Frame& frame) {
+    writer->write_packets(frame.refs, true);
+    writer->publish();
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  const double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  const double cpu_s = get_cpu_time_s() - cpu_begin;
+  const bool has_active_reader = writer->has_active_reader();
+  stop = true;
+  reader_thread.join();
+  return print_result("shm", stats, n_packets_sent, cpu_s, wall_s) &&
+         n_overruns == 0 && has_active_reader;
+}
+
+// Nothing is visible to readers before publish()
+bool test_publish() {
+  auto writer = openhd::VideoShmWriter::create(SHM_NAME);
+  ohd_video_shm_reader reader;
+  if (!writer || ohd_video_shm_reader_open(&reader, SHM_NAME) != 0) {
+    std::cerr << "Cannot create / open shm" << std::endl;
+    return false;
+  }
+  uint32_t seq = 0;
+  const auto frame = create_frame(seq);
+  const uint8_t* data;
+  uint32_t len, flags;
+  writer->write_packets(frame.refs, true);
+  bool ok = ohd_video_shm_reader_next(&reader, &data, &len, &flags) ==
+            OHD_VIDEO_SHM_NONE;
+  writer->publish();
+  uint32_t n_packets = 0;
+  while (ohd_video_shm_reader_next(&reader, &data, &len, &flags) ==
+         OHD_VIDEO_SHM_PACKET) {
+    n_packets++;
+  }
+  ok &= n_packets == seq && (flags & OHD_VIDEO_SHM_FLAG_FRAME_END) != 0 &&
+        !writer->has_unpublished();
+  ohd_video_shm_reader_close(&reader);
+  std::cout << "publish " << (ok ? "OK" : "FAILED") << std::endl;
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const int duration_s = argc > 1 ? std::max(1, std::atoi(argv[1])) : 3;
+  std::cout << BITRATE_MBIT << " MBit/s, " << FPS << " fps, "
+            << PACKETS_PER_FRAME << " packets of " << PACKET_SIZE
+            << " bytes per frame, " << duration_s << "s" << std::endl;
+  bool ok = test_publish();
+  ok &= run_udp(duration_s);
+  ok &= run_shm(duration_s);
+  std::cout << (ok ? "OK" : "FAILED") << std::endl;
+  return ok ? 0 : 1;
+}